@@ -31,7 +31,27 @@ SOURCES += \
     main_window.cc \
     glwidget.cc \
     camera.cc \
-    tiny_obj_loader.cc
+    tiny_obj_loader.cc \
+    parallel.cc \
+    texture_compression.cc \
+    texture_cache.cc \
+    texture_io.cc \
+    material_library.cc \
+    environment_library.cc \
+    light_clusters.cc \
+    mesh_buffers.cc \
+    scene.cc \
+    bvh.cc \
+    simplify.cc \
+    chunked_mesh.cc \
+    chunk_streamer.cc \
+    ambient_occlusion.cc \
+    software_rasterizer.cc \
+    thumbnails.cc \
+    turntable.cc \
+    frame_capture.cc \
+    render_graph.cc \
+    gbuffer_formats.cc
 
 HEADERS  += \
     triangle_mesh.h \
@@ -39,7 +59,28 @@ HEADERS  += \
     main_window.h \
     glwidget.h \
     camera.h \
-    tiny_obj_loader.h
+    tiny_obj_loader.h \
+    parallel.h \
+    texture_compression.h \
+    texture_cache.h \
+    texture_io.h \
+    material_library.h \
+    resident_set.h \
+    environment_library.h \
+    light_clusters.h \
+    mesh_buffers.h \
+    scene.h \
+    bvh.h \
+    simplify.h \
+    chunked_mesh.h \
+    chunk_streamer.h \
+    ambient_occlusion.h \
+    software_rasterizer.h \
+    thumbnails.h \
+    turntable.h \
+    frame_capture.h \
+    render_graph.h \
+    gbuffer_formats.h
 
 FORMS    += \
     main_window.ui
@@ -0,0 +1,147 @@
+#include <ambient_occlusion.h>
+
+#include <glm/geometric.hpp>
+#include <glm/vec3.hpp>
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <utility>
+
+#include "./parallel.h"
+
+namespace data_representation {
+
+namespace {
+
+// Van der Corput radical inverse in base 2, the second Hammersley coordinate
+float RadicalInverse(uint32_t bits) {
+  bits = (bits << 16u) | (bits >> 16u);
+  bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+  bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+  bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+  bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+  return bits * 2.3283064365386963e-10f;
+}
+
+// Integer hash of the vertex index, uniform in [0, 1)
+float Hash(uint32_t value) {
+  value ^= value >> 16;
+  value *= 0x7feb352du;
+  value ^= value >> 15;
+  value *= 0x846ca68bu;
+  value ^= value >> 16;
+  return (value >> 8) * (1.0f / 16777216.0f);
+}
+
+}  // namespace
+
+std::vector<float> BakeAmbientOcclusion(const TriangleMesh &mesh, const Bvh &bvh) {
+  const size_t kVertices = mesh.vertices_.size() / 3;
+  std::vector<float> occlusion(kVertices, 1.0f);
+  if (bvh.Empty() || mesh.normals_.size() != mesh.vertices_.size()) return occlusion;
+
+  const float kDiagonal = glm::length(mesh.max_ - mesh.min_);
+  const float kReach = kAoDistance * kDiagonal;
+  // Keeps the rays off the faces around the vertex
+  const float kOffset = 1e-4f * kDiagonal;
+
+  // Cosine distributed directions around +z: radius sqrt(u) on the disk
+  // lifted to the hemisphere, at angle 2 pi v
+  struct Sample {
+    float radius_, angle_, height_;
+  };
+  std::vector<Sample> samples(kAoRays);
+  for (int i = 0; i < kAoRays; ++i) {
+    float u = (i + 0.5f) / kAoRays;
+    samples[i] = {std::sqrt(u), 2.0f * 3.14159265f * RadicalInverse(i),
+                  std::sqrt(1.0f - u)};
+  }
+
+  utils::ParallelFor(0, kVertices, [&](size_t begin, size_t end) {
+    for (size_t v = begin; v < end; ++v) {
+      glm::vec3 normal(mesh.normals_[3 * v], mesh.normals_[3 * v + 1],
+                       mesh.normals_[3 * v + 2]);
+      float length = glm::length(normal);
+      if (!(length > 0.0f)) continue;
+      normal /= length;
+
+      // Orthonormal basis around the normal (Duff et al.)
+      float sign = std::copysign(1.0f, normal.z);
+      float a = -1.0f / (sign + normal.z);
+      float b = normal.x * normal.y * a;
+      glm::vec3 tangent(1.0f + sign * normal.x * normal.x * a, sign * b, -sign * normal.x);
+      glm::vec3 bitangent(b, sign + normal.y * normal.y * a, -normal.y);
+
+      glm::vec3 origin(mesh.vertices_[3 * v], mesh.vertices_[3 * v + 1],
+                       mesh.vertices_[3 * v + 2]);
+      origin += normal * kOffset;
+      const float kRotation = 2.0f * 3.14159265f * Hash(v);
+      int open = 0;
+      for (const Sample &sample : samples) {
+        float angle = sample.angle_ + kRotation;
+        Ray ray = {origin, tangent * (sample.radius_ * std::cos(angle)) +
+                               bitangent * (sample.radius_ * std::sin(angle)) +
+                               normal * sample.height_};
+        if (!bvh.AnyHit(ray, kReach)) ++open;
+      }
+      occlusion[v] = static_cast<float>(open) / kAoRays;
+    }
+  }, 256);
+  return occlusion;
+}
+
+bool ReadAmbientOcclusion(const std::string &filename,
+                          const std::vector<size_t> &vertex_counts,
+                          std::vector<std::vector<float>> *occlusion) {
+  std::ifstream fin(filename.c_str(), std::ios_base::in | std::ios_base::binary);
+  if (!fin.is_open()) return false;
+
+  char magic[8];
+  uint32_t meshes = 0;
+  fin.read(magic, sizeof(magic));
+  fin.read(reinterpret_cast<char *>(&meshes), sizeof(meshes));
+  if (!fin.good() || std::memcmp(magic, kAoCacheMagic, sizeof(magic)) != 0 ||
+      meshes != vertex_counts.size())
+    return false;
+
+  std::vector<std::vector<float>> values(meshes);
+  for (uint32_t i = 0; i < meshes; ++i) {
+    uint32_t vertices = 0;
+    fin.read(reinterpret_cast<char *>(&vertices), sizeof(vertices));
+    if (!fin.good() || vertices != vertex_counts[i]) return false;
+    values[i].resize(vertices);
+    fin.read(reinterpret_cast<char *>(values[i].data()), vertices * sizeof(float));
+  }
+  if (!fin.good()) return false;
+
+  *occlusion = std::move(values);
+  return true;
+}
+
+bool WriteAmbientOcclusion(const std::string &filename,
+                           const std::vector<std::vector<float>> &occlusion) {
+  std::ofstream fout(filename.c_str(), std::ios_base::out | std::ios_base::binary);
+  if (!fout.is_open()) {
+    std::cerr << "Unable to write " << filename << std::endl;
+    return false;
+  }
+
+  uint32_t meshes = occlusion.size();
+  fout.write(kAoCacheMagic, sizeof(kAoCacheMagic));
+  fout.write(reinterpret_cast<const char *>(&meshes), sizeof(meshes));
+  for (const std::vector<float> &values : occlusion) {
+    uint32_t vertices = values.size();
+    fout.write(reinterpret_cast<const char *>(&vertices), sizeof(vertices));
+    fout.write(reinterpret_cast<const char *>(values.data()), values.size() * sizeof(float));
+  }
+  if (!fout.good()) {
+    std::cerr << "Unable to write " << filename << std::endl;
+    return false;
+  }
+  return true;
+}
+
+}  // namespace data_representation
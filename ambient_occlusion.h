@@ -0,0 +1,64 @@
+#ifndef AMBIENT_OCCLUSION_H_
+#define AMBIENT_OCCLUSION_H_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "./bvh.h"
+#include "./triangle_mesh.h"
+
+namespace data_representation {
+
+/**
+ * @brief kAoRays Rays traced per vertex by BakeAmbientOcclusion.
+ */
+const int kAoRays = 64;
+
+/**
+ * @brief kAoDistance Reach of the occlusion rays, relative to the diagonal of
+ * the bounding box of the mesh. Farther geometry does not occlude.
+ */
+const float kAoDistance = 0.25f;
+
+/**
+ * @brief kAoCacheMagic First bytes of an occlusion cache file.
+ */
+const char kAoCacheMagic[8] = "VPBSAO1";
+
+/**
+ * @brief BakeAmbientOcclusion Ambient visibility of the vertices of mesh: the
+ * fraction of kAoRays cosine distributed rays over the hemisphere of the
+ * vertex normal that travel kAoDistance without hitting the mesh. The
+ * directions are a stratified (Hammersley) set that every vertex rotates by
+ * its own angle around the normal, so that neighbouring vertices do not band
+ * the same way. Runs in parallel over the vertices.
+ * @param bvh Hierarchy built over the triangles of mesh.
+ * @return One value per vertex, 1 unoccluded and 0 fully occluded. Vertices
+ * without a normal get 1.
+ */
+std::vector<float> BakeAmbientOcclusion(const TriangleMesh &mesh, const Bvh &bvh);
+
+/**
+ * @brief ReadAmbientOcclusion Reads the occlusion of every mesh of a model
+ * stored by WriteAmbientOcclusion.
+ * @param vertex_counts Vertices of each mesh of the model. A cache of another
+ * model, or of another version of it, does not match them.
+ * @return Whether the cache exists and matches.
+ */
+bool ReadAmbientOcclusion(const std::string &filename,
+                          const std::vector<size_t> &vertex_counts,
+                          std::vector<std::vector<float>> *occlusion);
+
+/**
+ * @brief WriteAmbientOcclusion Stores the occlusion of every mesh of a model:
+ * kAoCacheMagic, the mesh count and, for each mesh, its vertex count and its
+ * values, all 32 bit.
+ * @return Whether the file was written.
+ */
+bool WriteAmbientOcclusion(const std::string &filename,
+                           const std::vector<std::vector<float>> &occlusion);
+
+}  // namespace data_representation
+
+#endif  //  AMBIENT_OCCLUSION_H_
@@ -0,0 +1,342 @@
+#include <bvh.h>
+
+#include <glm/geometric.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <mutex>
+
+#include "./parallel.h"
+
+namespace data_representation {
+
+namespace {
+
+/**
+ * @brief kBins Centroid bins per axis where the SAH splits are evaluated.
+ */
+const int kBins = 16;
+
+/**
+ * @brief kMaxLeafSize Nodes with more triangles are always split, smaller ones
+ * only when the SAH finds it cheaper.
+ */
+const size_t kMaxLeafSize = 8;
+
+/**
+ * @brief kTraversalCost Cost of visiting a node relative to intersecting a
+ * triangle.
+ */
+const float kTraversalCost = 1.0f;
+
+/**
+ * @brief kMaxDepth Nodes deeper than this become leaves, it bounds the
+ * traversal stack.
+ */
+const int kMaxDepth = 60;
+const int kStackSize = kMaxDepth + 4;
+
+/**
+ * @brief kParallelSize Nodes with more triangles than this are bounded and
+ * binned in parallel.
+ */
+const size_t kParallelSize = 1 << 15;
+
+struct Bounds {
+  glm::vec3 min_;
+  glm::vec3 max_;
+
+  Bounds()
+      : min_(std::numeric_limits<float>::max()),
+        max_(std::numeric_limits<float>::lowest()) {}
+
+  void Grow(const glm::vec3 &lower, const glm::vec3 &upper) {
+    min_ = glm::min(min_, lower);
+    max_ = glm::max(max_, upper);
+  }
+
+  void Grow(const Bounds &bounds) { Grow(bounds.min_, bounds.max_); }
+
+  float Area() const {
+    if (min_.x > max_.x) return 0.0f;
+    glm::vec3 d = max_ - min_;
+    return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+  }
+};
+
+struct NodeBounds {
+  Bounds bounds_;
+  Bounds centroids_;
+};
+
+struct Bins {
+  Bounds bounds_[3][kBins];
+  size_t counts_[3][kBins] = {};
+};
+
+// Accumulates body(begin, end, partial) over [0, count) into result, in
+// parallel chunks merged with merge when count is large. T() is the identity.
+template <typename T, typename Body, typename Merge>
+void Accumulate(size_t count, T *result, const Body &body, const Merge &merge) {
+  if (count < kParallelSize) {
+    body(0, count, result);
+    return;
+  }
+
+  std::mutex mutex;
+  utils::ParallelFor(0, count, [&](size_t begin, size_t end) {
+    T partial;
+    body(begin, end, &partial);
+    std::lock_guard<std::mutex> lock(mutex);
+    merge(partial, result);
+  }, kParallelSize / 4);
+}
+
+bool IntersectBox(const glm::vec3 &min, const glm::vec3 &max,
+                  const glm::vec3 &origin, const glm::vec3 &inverse_direction,
+                  float t_max, float *t_near) {
+  // Slab test, the min/max pairs handle negative directions without branches
+  glm::vec3 t0 = (min - origin) * inverse_direction;
+  glm::vec3 t1 = (max - origin) * inverse_direction;
+  glm::vec3 t_enter = glm::min(t0, t1);
+  glm::vec3 t_exit = glm::max(t0, t1);
+  float enter = std::max(std::max(t_enter.x, t_enter.y), std::max(t_enter.z, 0.0f));
+  float exit = std::min(std::min(t_exit.x, t_exit.y), std::min(t_exit.z, t_max));
+  *t_near = enter;
+  return enter <= exit;
+}
+
+}  // namespace
+
+Bvh::Bvh() {}
+
+void Bvh::Build(const TriangleMesh &mesh) {
+  nodes_.clear();
+  triangles_.clear();
+  ids_.clear();
+
+  const size_t kTriangles = mesh.faces_.size() / 3;
+  if (kTriangles == 0) return;
+
+  std::vector<glm::vec3> lower(kTriangles), upper(kTriangles);
+  std::vector<Triangle> triangles(kTriangles);
+  ids_.resize(kTriangles);
+  utils::ParallelFor(0, kTriangles, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      glm::vec3 v[3];
+      for (int j = 0; j < 3; ++j) {
+        const int kVertex = mesh.faces_[3 * i + j];
+        v[j] = glm::vec3(mesh.vertices_[3 * kVertex], mesh.vertices_[3 * kVertex + 1],
+                         mesh.vertices_[3 * kVertex + 2]);
+      }
+      lower[i] = glm::min(v[0], glm::min(v[1], v[2]));
+      upper[i] = glm::max(v[0], glm::max(v[1], v[2]));
+      triangles[i] = {v[0], v[1] - v[0], v[2] - v[0]};
+      ids_[i] = i;
+    }
+  }, 4096);
+
+  nodes_.reserve(2 * kTriangles);
+  nodes_.push_back(Node());
+  Subdivide(0, 0, kTriangles, 0, lower, upper);
+  nodes_.shrink_to_fit();
+
+  // Leaves read their triangles contiguously
+  triangles_.resize(kTriangles);
+  for (size_t i = 0; i < kTriangles; ++i) triangles_[i] = triangles[ids_[i]];
+}
+
+void Bvh::Subdivide(uint32_t node, size_t first, size_t count, int depth,
+                    const std::vector<glm::vec3> &lower,
+                    const std::vector<glm::vec3> &upper) {
+  const uint32_t *kIds = &ids_[first];
+
+  NodeBounds node_bounds;
+  Accumulate(count, &node_bounds,
+             [&](size_t begin, size_t end, NodeBounds *partial) {
+               for (size_t i = begin; i < end; ++i) {
+                 glm::vec3 centroid = (lower[kIds[i]] + upper[kIds[i]]) * 0.5f;
+                 partial->bounds_.Grow(lower[kIds[i]], upper[kIds[i]]);
+                 partial->centroids_.Grow(centroid, centroid);
+               }
+             },
+             [](const NodeBounds &partial, NodeBounds *result) {
+               result->bounds_.Grow(partial.bounds_);
+               result->centroids_.Grow(partial.centroids_);
+             });
+  nodes_[node].min_ = node_bounds.bounds_.min_;
+  nodes_[node].max_ = node_bounds.bounds_.max_;
+  nodes_[node].first_ = first;
+  nodes_[node].count_ = count;
+  if (count == 1 || depth >= kMaxDepth) return;
+
+  // Centroid bins along every axis with some extent
+  const glm::vec3 kCentroidMin = node_bounds.centroids_.min_;
+  const glm::vec3 kExtent = node_bounds.centroids_.max_ - kCentroidMin;
+  float scale[3];
+  for (int axis = 0; axis < 3; ++axis)
+    scale[axis] = kExtent[axis] > 0.0f ? kBins / kExtent[axis] : 0.0f;
+  auto bin = [&](uint32_t id, int axis) {
+    float centroid = (lower[id][axis] + upper[id][axis]) * 0.5f;
+    int index = static_cast<int>((centroid - kCentroidMin[axis]) * scale[axis]);
+    return std::min(kBins - 1, std::max(0, index));
+  };
+
+  Bins bins;
+  Accumulate(count, &bins,
+             [&](size_t begin, size_t end, Bins *partial) {
+               for (size_t i = begin; i < end; ++i)
+                 for (int axis = 0; axis < 3; ++axis) {
+                   if (scale[axis] == 0.0f) continue;
+                   int b = bin(kIds[i], axis);
+                   partial->counts_[axis][b]++;
+                   partial->bounds_[axis][b].Grow(lower[kIds[i]], upper[kIds[i]]);
+                 }
+             },
+             [](const Bins &partial, Bins *result) {
+               for (int axis = 0; axis < 3; ++axis)
+                 for (int b = 0; b < kBins; ++b) {
+                   result->counts_[axis][b] += partial.counts_[axis][b];
+                   result->bounds_[axis][b].Grow(partial.bounds_[axis][b]);
+                 }
+             });
+
+  // Cheapest split between consecutive bins, sweeping from both sides
+  float best_cost = std::numeric_limits<float>::max();
+  int best_axis = -1, best_split = 0;
+  for (int axis = 0; axis < 3; ++axis) {
+    if (scale[axis] == 0.0f) continue;
+    float left_area[kBins - 1];
+    size_t left_count[kBins - 1];
+    Bounds left;
+    size_t left_total = 0;
+    for (int b = 0; b < kBins - 1; ++b) {
+      left.Grow(bins.bounds_[axis][b]);
+      left_total += bins.counts_[axis][b];
+      left_area[b] = left.Area();
+      left_count[b] = left_total;
+    }
+    Bounds right;
+    size_t right_total = 0;
+    for (int b = kBins - 1; b > 0; --b) {
+      right.Grow(bins.bounds_[axis][b]);
+      right_total += bins.counts_[axis][b];
+      float cost = left_count[b - 1] * left_area[b - 1] + right_total * right.Area();
+      if (left_count[b - 1] > 0 && right_total > 0 && cost < best_cost) {
+        best_cost = cost;
+        best_axis = axis;
+        best_split = b;
+      }
+    }
+  }
+
+  const float kArea = node_bounds.bounds_.Area();
+  const float kSplitCost =
+      kTraversalCost + (kArea > 0.0f ? best_cost / kArea : 0.0f);
+  if (count <= kMaxLeafSize && (best_axis < 0 || kSplitCost >= count)) return;
+
+  size_t left_count;
+  if (best_axis >= 0) {
+    uint32_t *middle = std::partition(
+        &ids_[first], &ids_[first] + count,
+        [&](uint32_t id) { return bin(id, best_axis) < best_split; });
+    left_count = middle - &ids_[first];
+  } else {
+    // All the centroids coincide, any halving is as good
+    left_count = count / 2;
+  }
+
+  const uint32_t kChildren = nodes_.size();
+  nodes_.push_back(Node());
+  nodes_.push_back(Node());
+  nodes_[node].first_ = kChildren;
+  nodes_[node].count_ = 0;
+  Subdivide(kChildren, first, left_count, depth + 1, lower, upper);
+  Subdivide(kChildren + 1, first + left_count, count - left_count, depth + 1,
+            lower, upper);
+}
+
+bool Bvh::ClosestHit(const Ray &ray, float t_max, RayHit *hit) const {
+  return Traverse(ray, t_max, false, hit);
+}
+
+bool Bvh::AnyHit(const Ray &ray, float t_max) const {
+  RayHit hit;
+  return Traverse(ray, t_max, true, &hit);
+}
+
+bool Bvh::Traverse(const Ray &ray, float t_max, bool any_hit, RayHit *hit) const {
+  if (nodes_.empty()) return false;
+
+  const glm::vec3 kInverseDirection = 1.0f / ray.direction_;
+  struct Entry {
+    uint32_t node_;
+    float t_near_;
+  } stack[kStackSize];
+
+  float t_near;
+  if (!IntersectBox(nodes_[0].min_, nodes_[0].max_, ray.origin_,
+                    kInverseDirection, t_max, &t_near))
+    return false;
+
+  int size = 0;
+  stack[size++] = {0, t_near};
+  bool found = false;
+  float closest = t_max;
+  while (size > 0) {
+    const Entry kEntry = stack[--size];
+    if (kEntry.t_near_ > closest) continue;
+    const Node &node = nodes_[kEntry.node_];
+
+    if (node.count_ > 0) {
+      // Moller-Trumbore against every triangle of the leaf
+      for (uint32_t i = node.first_; i < node.first_ + node.count_; ++i) {
+        const Triangle &triangle = triangles_[i];
+        glm::vec3 p = glm::cross(ray.direction_, triangle.e2_);
+        float determinant = glm::dot(triangle.e1_, p);
+        if (std::fabs(determinant) < 1e-12f) continue;
+        float inverse_determinant = 1.0f / determinant;
+        glm::vec3 s = ray.origin_ - triangle.v0_;
+        float u = glm::dot(s, p) * inverse_determinant;
+        if (u < 0.0f || u > 1.0f) continue;
+        glm::vec3 q = glm::cross(s, triangle.e1_);
+        float v = glm::dot(ray.direction_, q) * inverse_determinant;
+        if (v < 0.0f || u + v > 1.0f) continue;
+        float t = glm::dot(triangle.e2_, q) * inverse_determinant;
+        if (t <= 0.0f || t > closest) continue;
+
+        closest = t;
+        found = true;
+        *hit = {t, static_cast<int>(ids_[i]), u, v};
+        if (any_hit) return true;
+      }
+      continue;
+    }
+
+    // Nearest child popped first
+    float t_left, t_right;
+    const Node &left = nodes_[node.first_];
+    const Node &right = nodes_[node.first_ + 1];
+    bool hit_left = IntersectBox(left.min_, left.max_, ray.origin_,
+                                 kInverseDirection, closest, &t_left);
+    bool hit_right = IntersectBox(right.min_, right.max_, ray.origin_,
+                                  kInverseDirection, closest, &t_right);
+    if (hit_left && hit_right) {
+      if (t_left <= t_right) {
+        stack[size++] = {node.first_ + 1, t_right};
+        stack[size++] = {node.first_, t_left};
+      } else {
+        stack[size++] = {node.first_, t_left};
+        stack[size++] = {node.first_ + 1, t_right};
+      }
+    } else if (hit_left) {
+      stack[size++] = {node.first_, t_left};
+    } else if (hit_right) {
+      stack[size++] = {node.first_ + 1, t_right};
+    }
+  }
+  return found;
+}
+
+}  // namespace data_representation
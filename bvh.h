@@ -0,0 +1,115 @@
+#ifndef BVH_H_
+#define BVH_H_
+
+#include <glm/vec3.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "./triangle_mesh.h"
+
+namespace data_representation {
+
+/**
+ * @brief Ray A ray origin + t * direction. The direction does not need to be
+ * normalized, hit distances are in units of its length.
+ */
+struct Ray {
+  glm::vec3 origin_;
+  glm::vec3 direction_;
+};
+
+/**
+ * @brief RayHit Closest intersection of a ray with a triangle.
+ */
+struct RayHit {
+  float t_;        // Ray parameter of the hit
+  int triangle_;   // Triangle index, faces_[3 * triangle_] is its first vertex
+  float u_, v_;    // Barycentric coordinates of the second and third vertices
+};
+
+/**
+ * @brief Bvh Bounding volume hierarchy over the triangles of a mesh, for ray
+ * queries (picking, occlusion). Built top-down with the surface area
+ * heuristic evaluated over kBins centroid bins per axis; the large nodes near
+ * the root are binned in parallel.
+ *
+ * The nodes are stored in a flat array of 32 byte entries with the two
+ * children of a node next to each other, and the triangles are copied in leaf
+ * order as (vertex, edge, edge) so that a leaf is a contiguous read. The
+ * structure keeps no reference to the mesh once built.
+ */
+class Bvh {
+ public:
+  Bvh();
+
+  /**
+   * @brief Build Builds the hierarchy over the triangles of mesh, replacing
+   * the previous one.
+   */
+  void Build(const TriangleMesh &mesh);
+
+  /**
+   * @brief ClosestHit Finds the closest triangle hit by the ray with t in
+   * (0, t_max].
+   * @return Whether any triangle is hit.
+   */
+  bool ClosestHit(const Ray &ray, float t_max, RayHit *hit) const;
+
+  /**
+   * @brief AnyHit Whether any triangle is hit by the ray with t in
+   * (0, t_max], stopping at the first one found. Cheaper than ClosestHit for
+   * occlusion queries.
+   */
+  bool AnyHit(const Ray &ray, float t_max) const;
+
+  bool Empty() const { return nodes_.empty(); }
+  size_t NodeCount() const { return nodes_.size(); }
+
+ private:
+  /**
+   * @brief Node Bounds of the node and either its triangles (count_ > 0, the
+   * range first_, first_ + count_ of triangles_) or its children (count_ ==
+   * 0, nodes first_ and first_ + 1).
+   */
+  struct Node {
+    glm::vec3 min_;
+    uint32_t first_;
+    glm::vec3 max_;
+    uint32_t count_;
+  };
+
+  /**
+   * @brief Triangle A triangle prepared for intersection: its first vertex
+   * and the edges to the other two.
+   */
+  struct Triangle {
+    glm::vec3 v0_;
+    glm::vec3 e1_;
+    glm::vec3 e2_;
+  };
+
+  /**
+   * @brief Subdivide Bounds node, covering ids_[first, first + count) at the
+   * given depth, and splits it and its descendants. lower and upper are the
+   * bounds of every mesh triangle.
+   */
+  void Subdivide(uint32_t node, size_t first, size_t count, int depth,
+                 const std::vector<glm::vec3> &lower,
+                 const std::vector<glm::vec3> &upper);
+
+  /**
+   * @brief Traverse Walks the nodes hit by the ray nearest first. With
+   * any_hit it returns at the first triangle found.
+   */
+  bool Traverse(const Ray &ray, float t_max, bool any_hit, RayHit *hit) const;
+
+  std::vector<Node> nodes_;
+  std::vector<Triangle> triangles_;
+  std::vector<uint32_t> ids_;   // Mesh triangle of each entry of triangles_
+};
+
+}  // namespace data_representation
+
+#endif  //  BVH_H_
@@ -86,10 +86,8 @@ glm::mat4 Camera::SetProjection(double fov, double znear, double zfar) {
 }
 
 glm::mat4 Camera::SetProjection() const {
-  const double kAR = static_cast<double>(viewport_width_) /
-                     static_cast<double>(viewport_height_);
-
-  return glm::perspective((field_of_view_ * M_PI / 180.0), kAR, z_near_, z_far_);
+  return glm::perspective((field_of_view_ * M_PI / 180.0), GetAspectRatio(),
+                          z_near_, z_far_);
 }
 
 void Camera::Zoom(double modifier) {
@@ -119,6 +117,11 @@ void Camera::Rotate(double modifier) {
   rotation_y_ += AngleIncrement * modifier;
 }
 
+void Camera::SetOrbit(double rotation_x, double rotation_y) {
+  rotation_x_ = std::min(std::max(rotation_x, kMinRotationX), MaxRotationX);
+  rotation_y_ = rotation_y;
+}
+
 void Camera::UpdateModel(glm::vec3 min, glm::vec3 max) {
   glm::vec3 center = (min + max) / 2.f;
   centering_x_ = -center[0];
@@ -198,4 +201,15 @@ glm::vec3 Camera::GetPosition() const {
   return glm::vec3(viewInverse[3]);
 }
 
+double Camera::GetFieldOfView() const { return field_of_view_; }
+
+double Camera::GetZNear() const { return z_near_; }
+
+double Camera::GetZFar() const { return z_far_; }
+
+double Camera::GetAspectRatio() const {
+  return static_cast<double>(viewport_width_) /
+         static_cast<double>(viewport_height_);
+}
+
 }  //  namespace data_visualization
@@ -230,6 +230,12 @@ class Camera {
    */
   void Rotate(double modifier);
 
+  /**
+   * @brief SetOrbit Places the camera at the given rotations around the X and
+   * Y axes, in radians, keeping its distance.
+   */
+  void SetOrbit(double rotation_x, double rotation_y);
+
   /**
    * @brief UpdateModel Updates the intrinsic parameters to compute a modeling
    * transform that centers the bounding box of the model and makes its longest
@@ -312,6 +318,26 @@ class Camera {
    * @return The camera position as a glm::vec3
    */
   glm::vec3 GetPosition() const;
+
+  /**
+   * @brief GetFieldOfView Returns the vertical field of view in degrees.
+   */
+  double GetFieldOfView() const;
+
+  /**
+   * @brief GetZNear Returns the near plane distance.
+   */
+  double GetZNear() const;
+
+  /**
+   * @brief GetZFar Returns the far plane distance.
+   */
+  double GetZFar() const;
+
+  /**
+   * @brief GetAspectRatio Returns the viewport width over its height.
+   */
+  double GetAspectRatio() const;
 };
 
 }  //  namespace data_visualization
@@ -0,0 +1,346 @@
+#include <chunk_streamer.h>
+
+#include <glm/geometric.hpp>
+#include <glm/matrix.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <numeric>
+
+#include "./mesh_buffers.h"
+
+namespace data_visualization {
+
+namespace {
+
+const size_t kVertexBytes = 6 * sizeof(float);
+const size_t kPageVertexBytes = data_representation::kPageVertices * kVertexBytes;
+const size_t kPageIndexBytes = data_representation::kPageTriangles * 3 * sizeof(uint16_t);
+
+// Reading a byte every kFaultStride bytes faults in every memory page.
+const size_t kFaultStride = 4096;
+
+size_t PageBytes(const data_representation::ChunkPage &page) {
+  return page.vertex_count_ * kVertexBytes + page.index_count_ * sizeof(uint16_t);
+}
+
+bool InFrustum(const data_representation::ChunkNode &node, const glm::vec4 *planes) {
+  for (int i = 0; i < 6; ++i)
+    if (glm::dot(glm::vec3(planes[i]), node.center_) + planes[i].w < -node.radius_)
+      return false;
+  return true;
+}
+
+}  // namespace
+
+ChunkStreamer::ChunkStreamer()
+    : gl_(nullptr),
+      vertex_buffer_(0),
+      index_buffer_(0),
+      vertex_array_(0),
+      data_(nullptr),
+      header_(nullptr),
+      nodes_(nullptr),
+      pages_(nullptr),
+      resident_(kStreamingPages - 1),
+      drawn_triangles_(0) {}
+
+ChunkStreamer::~ChunkStreamer() { Close(); }
+
+void ChunkStreamer::Initialize(QOpenGLFunctions_3_3_Core *gl) {
+  gl_ = gl;
+  gl_->glGenBuffers(1, &vertex_buffer_);
+  gl_->glGenBuffers(1, &index_buffer_);
+  gl_->glGenVertexArrays(1, &vertex_array_);
+
+  gl_->glBindVertexArray(vertex_array_);
+  gl_->glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer_);
+  gl_->glBufferData(GL_ARRAY_BUFFER, kStreamingPages * kPageVertexBytes, nullptr,
+                    GL_DYNAMIC_DRAW);
+  gl_->glVertexAttribPointer(kVertexAttributeIdx, 3, GL_FLOAT, GL_FALSE, kVertexBytes,
+                             (void *)0);
+  gl_->glEnableVertexAttribArray(kVertexAttributeIdx);
+  gl_->glVertexAttribPointer(kNormalAttributeIdx, 3, GL_FLOAT, GL_FALSE, kVertexBytes,
+                             (void *)(3 * sizeof(float)));
+  gl_->glEnableVertexAttribArray(kNormalAttributeIdx);
+  gl_->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer_);
+  gl_->glBufferData(GL_ELEMENT_ARRAY_BUFFER, kStreamingPages * kPageIndexBytes,
+                    nullptr, GL_DYNAMIC_DRAW);
+  gl_->glBindVertexArray(0);
+  gl_->glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void ChunkStreamer::Release() {
+  Close();
+  if (gl_ == nullptr) return;
+
+  gl_->glDeleteBuffers(1, &vertex_buffer_);
+  gl_->glDeleteBuffers(1, &index_buffer_);
+  gl_->glDeleteVertexArrays(1, &vertex_array_);
+  vertex_buffer_ = index_buffer_ = vertex_array_ = 0;
+  gl_ = nullptr;
+}
+
+bool ChunkStreamer::Open(const std::string &filename) {
+  Close();
+
+  file_.setFileName(QString::fromStdString(filename));
+  if (!file_.open(QIODevice::ReadOnly)) return false;
+  const uint64_t kSize = file_.size();
+  if (kSize >= sizeof(data_representation::ChunkedMeshHeader))
+    data_ = file_.map(0, kSize);
+
+  // The tables are used in place, every offset is checked once here
+  const data_representation::ChunkedMeshHeader *header =
+      reinterpret_cast<const data_representation::ChunkedMeshHeader *>(data_);
+  bool valid = data_ != nullptr &&
+               std::memcmp(header->magic_, data_representation::kChunkedMeshMagic,
+                           sizeof(header->magic_)) == 0 &&
+               header->node_count_ > 0 && header->table_offset_ % 8 == 0 &&
+               header->table_offset_ +
+                       header->node_count_ * sizeof(data_representation::ChunkNode) +
+                       header->page_count_ * sizeof(data_representation::ChunkPage) <=
+                   kSize;
+  if (valid) {
+    nodes_ = reinterpret_cast<const data_representation::ChunkNode *>(
+        data_ + header->table_offset_);
+    pages_ = reinterpret_cast<const data_representation::ChunkPage *>(
+        nodes_ + header->node_count_);
+    for (uint32_t i = 0; i < header->page_count_ && valid; ++i)
+      valid = pages_[i].vertex_count_ <= data_representation::kPageVertices &&
+              pages_[i].index_count_ <= 3 * data_representation::kPageTriangles &&
+              pages_[i].index_count_ > 0 && pages_[i].offset_ % 4 == 0 &&
+              pages_[i].offset_ + PageBytes(pages_[i]) <= kSize;
+    // A node needs all its pages in the pool at once, with room left for the
+    // ones of its parent
+    for (uint32_t i = 0; i < header->node_count_ && valid; ++i)
+      valid = nodes_[i].first_page_ + uint64_t(nodes_[i].page_count_) <= header->page_count_ &&
+              nodes_[i].page_count_ < kStreamingPages - 1 &&
+              (nodes_[i].first_child_ < 0 ||
+               (uint32_t(nodes_[i].first_child_) > i &&
+                uint64_t(nodes_[i].first_child_) + 1 < header->node_count_));
+  }
+  if (!valid) {
+    std::cerr << filename << " is not a valid chunked mesh" << std::endl;
+    if (data_ != nullptr) file_.unmap(data_);
+    file_.close();
+    data_ = nullptr;
+    nodes_ = nullptr;
+    pages_ = nullptr;
+    return false;
+  }
+
+  header_ = header;
+  resident_.Reset(header_->page_count_);
+  loading_.assign(header_->node_count_, 0);
+  std::cout << filename << ": " << header_->triangles_ << " triangles in "
+            << header_->node_count_ << " chunks" << std::endl;
+  return true;
+}
+
+void ChunkStreamer::Close() {
+  // The loads read the mapping
+  for (Load &load : loads_) load.read_.wait();
+  loads_.clear();
+  if (data_ != nullptr) file_.unmap(data_);
+  file_.close();
+  data_ = nullptr;
+  header_ = nullptr;
+  nodes_ = nullptr;
+  pages_ = nullptr;
+
+  resident_.Clear();
+  resident_.Reset(0);
+  free_pages_.resize(kStreamingPages);
+  std::iota(free_pages_.begin(), free_pages_.end(), 0);
+  loading_.clear();
+  counts_.clear();
+  offsets_.clear();
+  base_vertices_.clear();
+  drawn_triangles_ = 0;
+}
+
+void ChunkStreamer::Update(const glm::mat4 &model, const glm::mat4 &view,
+                           const glm::mat4 &projection, int viewport_height) {
+  if (!IsOpen()) return;
+
+  for (size_t i = 0; i < loads_.size();) {
+    if (loads_[i].read_.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+      ++i;
+      continue;
+    }
+    // A chunk with bad indices is never uploaded nor requested again
+    if (loads_[i].read_.get()) {
+      Upload(loads_[i].node_);
+      loading_[loads_[i].node_] = 0;
+    } else {
+      std::cerr << "Chunk " << loads_[i].node_ << " indexes past its vertices" << std::endl;
+    }
+    loads_.erase(loads_.begin() + i);
+  }
+
+  // Frustum planes and camera in the space of the file, where the ratio of a
+  // length to its distance is the same as in view space
+  glm::mat4 to_clip = projection * view * model;
+  glm::vec4 planes[6];
+  for (int axis = 0; axis < 3; ++axis) {
+    for (int side = 0; side < 2; ++side) {
+      glm::vec4 plane;
+      for (int column = 0; column < 4; ++column)
+        plane[column] = to_clip[column][3] +
+                        (side == 0 ? 1.0f : -1.0f) * to_clip[column][axis];
+      planes[2 * axis + side] = plane / glm::length(glm::vec3(plane));
+    }
+  }
+  glm::vec3 eye = glm::vec3(glm::inverse(view * model) * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+
+  counts_.clear();
+  offsets_.clear();
+  base_vertices_.clear();
+  drawn_triangles_ = 0;
+  requests_.clear();
+  Visit(0, planes, eye, projection[1][1] * 0.5f * viewport_height);
+
+  std::sort(requests_.begin(), requests_.end(),
+            std::greater<std::pair<float, uint32_t>>());
+  for (const std::pair<float, uint32_t> &request : requests_) {
+    if (loads_.size() >= kMaxChunkLoads) break;
+    const uint32_t kNode = request.second;
+    if (loading_[kNode]) continue;
+    loading_[kNode] = 1;
+
+    // Touching the mapped pages here makes the system read them from disk on
+    // this task instead of during the upload. The indices are read whole, to
+    // check that they stay in the vertices of their page
+    const uchar *data = data_;
+    const data_representation::ChunkPage *pages = pages_ + nodes_[kNode].first_page_;
+    const uint32_t kPages = nodes_[kNode].page_count_;
+    loads_.push_back({kNode, std::async(std::launch::async, [data, pages, kPages]() {
+                        // Volatile, so that the reads are not optimized away
+                        volatile uint32_t sum = 0;
+                        for (uint32_t p = 0; p < kPages; ++p) {
+                          const uchar *begin = data + pages[p].offset_;
+                          const size_t kVertexDataBytes = pages[p].vertex_count_ * kVertexBytes;
+                          for (size_t i = 0; i < kVertexDataBytes; i += kFaultStride)
+                            sum += begin[i];
+                          uint16_t index;
+                          for (uint32_t i = 0; i < pages[p].index_count_; ++i) {
+                            std::memcpy(&index, begin + kVertexDataBytes + i * sizeof(index),
+                                        sizeof(index));
+                            if (index >= pages[p].vertex_count_) return false;
+                          }
+                        }
+                        return true;
+                      })});
+  }
+}
+
+void ChunkStreamer::Draw() {
+  if (counts_.empty()) return;
+
+  gl_->glBindVertexArray(vertex_array_);
+  // The locations without an array read these values
+  for (int column = 0; column < 4; ++column)
+    gl_->glVertexAttrib4f(kInstanceAttributeIdx + column, column == 0, column == 1,
+                          column == 2, column == 3);
+  gl_->glVertexAttrib2f(kTexCoordAttributeIdx, 0.0f, 0.0f);
+  gl_->glVertexAttribI1i(kMaterialAttributeIdx, 0);
+  gl_->glVertexAttrib1f(kOcclusionAttributeIdx, 1.0f);
+  gl_->glMultiDrawElementsBaseVertex(GL_TRIANGLES, counts_.data(), GL_UNSIGNED_SHORT,
+                                     offsets_.data(), counts_.size(),
+                                     base_vertices_.data());
+  gl_->glBindVertexArray(0);
+}
+
+bool ChunkStreamer::Resident(uint32_t node) const {
+  const data_representation::ChunkNode &chunk = nodes_[node];
+  for (uint32_t p = chunk.first_page_; p < chunk.first_page_ + chunk.page_count_; ++p)
+    if (!resident_.Contains(p)) return false;
+  return true;
+}
+
+void ChunkStreamer::Visit(uint32_t node, const glm::vec4 *planes,
+                          const glm::vec3 &eye, float pixels_per_unit) {
+  const data_representation::ChunkNode &chunk = nodes_[node];
+  if (!InFrustum(chunk, planes)) return;
+
+  float distance = glm::length(chunk.center_ - eye) - chunk.radius_;
+  float error = distance > 0.0f ? chunk.error_ * pixels_per_unit / distance
+                                : std::numeric_limits<float>::max();
+  const bool kLeaf = chunk.first_child_ < 0;
+
+  // The children replace the chunk once all the visible ones are resident
+  bool children_ready = !kLeaf;
+  for (int i = 0; i < 2 && !kLeaf; ++i) {
+    uint32_t child = chunk.first_child_ + i;
+    if (InFrustum(nodes_[child], planes) && !Resident(child)) {
+      children_ready = false;
+      if (error > kMaxPixelError) Request(child, error);
+    }
+  }
+
+  if (!kLeaf && error > kMaxPixelError && children_ready) {
+    // Keeps the chunk resident for when the camera moves back
+    uint32_t slot;
+    for (uint32_t p = chunk.first_page_; p < chunk.first_page_ + chunk.page_count_; ++p)
+      resident_.Use(p, &slot);
+    for (int i = 0; i < 2; ++i) Visit(chunk.first_child_ + i, planes, eye, pixels_per_unit);
+    return;
+  }
+
+  if (Resident(node)) {
+    AddDraw(node);
+    return;
+  }
+  Request(node, error);
+  // Finer chunks are better than a hole while it loads
+  if (children_ready)
+    for (int i = 0; i < 2; ++i) Visit(chunk.first_child_ + i, planes, eye, pixels_per_unit);
+}
+
+void ChunkStreamer::Request(uint32_t node, float priority) {
+  requests_.push_back({priority, node});
+}
+
+void ChunkStreamer::Upload(uint32_t node) {
+  const data_representation::ChunkNode &chunk = nodes_[node];
+  gl_->glBindVertexArray(vertex_array_);
+  gl_->glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer_);
+  for (uint32_t p = chunk.first_page_; p < chunk.first_page_ + chunk.page_count_; ++p) {
+    if (resident_.Contains(p)) continue;
+
+    const uint32_t kSlot = free_pages_.back();
+    free_pages_.pop_back();
+    std::vector<uint32_t> evicted;
+    resident_.Insert(p, kSlot, 1, &evicted);
+    free_pages_.insert(free_pages_.end(), evicted.begin(), evicted.end());
+
+    const data_representation::ChunkPage &page = pages_[p];
+    const uchar *source = data_ + page.offset_;
+    gl_->glBufferSubData(GL_ARRAY_BUFFER, kSlot * kPageVertexBytes,
+                         page.vertex_count_ * kVertexBytes, source);
+    gl_->glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, kSlot * kPageIndexBytes,
+                         page.index_count_ * sizeof(uint16_t),
+                         source + page.vertex_count_ * kVertexBytes);
+  }
+  gl_->glBindVertexArray(0);
+  gl_->glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void ChunkStreamer::AddDraw(uint32_t node) {
+  const data_representation::ChunkNode &chunk = nodes_[node];
+  for (uint32_t p = chunk.first_page_; p < chunk.first_page_ + chunk.page_count_; ++p) {
+    uint32_t slot;
+    resident_.Use(p, &slot);
+    counts_.push_back(pages_[p].index_count_);
+    offsets_.push_back((void *)(slot * kPageIndexBytes));
+    base_vertices_.push_back(slot * data_representation::kPageVertices);
+    drawn_triangles_ += pages_[p].index_count_ / 3;
+  }
+}
+
+}  //  namespace data_visualization
@@ -0,0 +1,180 @@
+#ifndef CHUNK_STREAMER_H_
+#define CHUNK_STREAMER_H_
+
+#include <QFile>
+#include <QOpenGLFunctions_3_3_Core>
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <string>
+#include <vector>
+
+#include "./chunked_mesh.h"
+#include "./resident_set.h"
+
+namespace data_visualization {
+
+/**
+ * @brief kStreamingPages Pages of the GPU pool of the chunk streamer, each
+ * holding data_representation::kPageVertices vertices and kPageTriangles
+ * triangles (about 240 KB).
+ */
+const size_t kStreamingPages = 512;
+
+/**
+ * @brief kMaxPixelError A chunk is refined into its children while the mean
+ * edge length of its triangles projects to more pixels than this.
+ */
+const float kMaxPixelError = 4.0f;
+
+/**
+ * @brief kMaxChunkLoads Chunks being read from disk at the same time.
+ */
+const size_t kMaxChunkLoads = 8;
+
+/**
+ * @brief ChunkStreamer Out of core renderer of a chunked mesh file (see
+ * data_representation::WriteChunkedMesh). The file is memory mapped, so only
+ * the pages actually read are brought into memory, and the chunks needed by
+ * the view are streamed into a fixed pool of GPU pages.
+ *
+ * Every frame Update walks the chunk hierarchy, refining the chunks whose
+ * projected error exceeds kMaxPixelError when their children are resident,
+ * and requests the missing ones, most urgent first. A request reads the pages
+ * of the chunk on a background task, so the page faults of the mapping never
+ * stall the frame; the next frames copy the loaded chunk into free GPU pages,
+ * evicting the least recently drawn ones when the pool is full. Until then
+ * the coarser chunk that covers it is drawn instead.
+ */
+class ChunkStreamer {
+ public:
+  ChunkStreamer();
+  ~ChunkStreamer();
+
+  /**
+   * @brief Initialize Creates the page pool and its vertex array. Needs a
+   * current context.
+   * @param gl Functions of the context the buffers belong to.
+   */
+  void Initialize(QOpenGLFunctions_3_3_Core *gl);
+
+  /**
+   * @brief Release Closes the file and deletes the pool. Needs a current
+   * context.
+   */
+  void Release();
+
+  /**
+   * @brief Open Maps a chunked mesh file, replacing the previous one.
+   * @return Whether the file is a valid chunked mesh.
+   */
+  bool Open(const std::string &filename);
+
+  /**
+   * @brief Close Waits for the pending loads and unmaps the file.
+   */
+  void Close();
+
+  bool IsOpen() const { return header_ != nullptr; }
+  glm::vec3 Min() const { return header_->min_; }
+  glm::vec3 Max() const { return header_->max_; }
+  uint64_t Triangles() const { return header_->triangles_; }
+
+  /**
+   * @brief Update Uploads the chunks loaded since the last call, selects the
+   * chunks drawn for the view and requests the missing ones.
+   * @param viewport_height Height of the viewport in pixels.
+   */
+  void Update(const glm::mat4 &model, const glm::mat4 &view,
+              const glm::mat4 &projection, int viewport_height);
+
+  /**
+   * @brief Draw Draws the chunks selected by the last Update with a single
+   * multi draw. The mesh shaders get the identity as instance transform and
+   * the global material.
+   */
+  void Draw();
+
+  /**
+   * @brief Loading Whether chunks requested by the last Update are still
+   * being read.
+   */
+  bool Loading() const { return !loads_.empty(); }
+
+  /**
+   * @brief DrawnTriangles Triangles drawn by Draw.
+   */
+  size_t DrawnTriangles() const { return drawn_triangles_; }
+
+ private:
+  /**
+   * @brief Load A chunk being read by a background task.
+   */
+  struct Load {
+    uint32_t node_;
+    std::future<bool> read_;   // Whether the indices are valid
+  };
+
+  /**
+   * @brief Resident Whether every page of a node is in the pool.
+   */
+  bool Resident(uint32_t node) const;
+
+  /**
+   * @brief Visit Selects the chunks drawn for the subtree of node.
+   */
+  void Visit(uint32_t node, const glm::vec4 *planes, const glm::vec3 &eye,
+             float pixels_per_unit);
+
+  /**
+   * @brief Request Asks for node to be loaded with the given priority.
+   */
+  void Request(uint32_t node, float priority);
+
+  /**
+   * @brief Upload Copies the pages of a loaded node to free pool pages.
+   */
+  void Upload(uint32_t node);
+
+  /**
+   * @brief AddDraw Adds the pages of a resident node to the draw list.
+   */
+  void AddDraw(uint32_t node);
+
+  QOpenGLFunctions_3_3_Core *gl_;
+  GLuint vertex_buffer_;
+  GLuint index_buffer_;
+  GLuint vertex_array_;
+
+  QFile file_;
+  uchar *data_;
+  const data_representation::ChunkedMeshHeader *header_;
+  const data_representation::ChunkNode *nodes_;
+  const data_representation::ChunkPage *pages_;
+
+  /**
+   * @brief resident_ Pool page of each resident file page. Its budget is one
+   * page less than the pool, so that a free page is always left for the next
+   * upload.
+   */
+  data_representation::ResidentSet<uint32_t> resident_;
+  std::vector<uint32_t> free_pages_;
+
+  std::vector<Load> loads_;
+  std::vector<char> loading_;   // Per node
+  std::vector<std::pair<float, uint32_t>> requests_;
+
+  std::vector<GLsizei> counts_;
+  std::vector<const void *> offsets_;
+  std::vector<GLint> base_vertices_;
+  size_t drawn_triangles_;
+};
+
+}  //  namespace data_visualization
+
+#endif  //  CHUNK_STREAMER_H_
@@ -0,0 +1,268 @@
+#include <chunked_mesh.h>
+
+#include <glm/geometric.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <numeric>
+#include <vector>
+
+#include "./parallel.h"
+#include "./simplify.h"
+
+namespace data_representation {
+
+namespace {
+
+// Triangles an inner node keeps of its cell when the levels of detail do not
+// go that coarse, a few pages at most.
+const size_t kMaxNodeTriangles = 2 * kChunkTriangles;
+
+// Splitting plane of an inner node, the triangles with a smaller centroid
+// coordinate go to the first child.
+struct Split {
+  int axis_;
+  float position_;
+};
+
+glm::vec3 Centroid(const TriangleMesh &mesh, const std::vector<int> &faces,
+                   size_t triangle) {
+  glm::vec3 sum(0.0f);
+  for (int i = 0; i < 3; ++i) {
+    int v = faces[3 * triangle + i];
+    sum += glm::vec3(mesh.vertices_[3 * v], mesh.vertices_[3 * v + 1],
+                     mesh.vertices_[3 * v + 2]);
+  }
+  return sum / 3.0f;
+}
+
+// Median splits of ids[begin, end) until the given depth.
+void Partition(const TriangleMesh &mesh, int node, int depth, size_t begin,
+               size_t end, std::vector<uint32_t> *ids, std::vector<Split> *splits,
+               std::vector<std::pair<size_t, size_t>> *leaves) {
+  if (depth == 0) {
+    (*leaves)[node] = {begin, end};
+    return;
+  }
+
+  glm::vec3 lower(std::numeric_limits<float>::max());
+  glm::vec3 upper(std::numeric_limits<float>::lowest());
+  for (size_t i = begin; i < end; ++i) {
+    glm::vec3 centroid = Centroid(mesh, mesh.faces_, (*ids)[i]);
+    lower = glm::min(lower, centroid);
+    upper = glm::max(upper, centroid);
+  }
+  glm::vec3 extent = upper - lower;
+  int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2)
+                                 : (extent.y > extent.z ? 1 : 2);
+
+  size_t middle = begin + (end - begin) / 2;
+  std::nth_element(ids->begin() + begin, ids->begin() + middle, ids->begin() + end,
+                   [&mesh, axis](uint32_t a, uint32_t b) {
+                     return Centroid(mesh, mesh.faces_, a)[axis] <
+                            Centroid(mesh, mesh.faces_, b)[axis];
+                   });
+  (*splits)[node] = {axis, middle < end ? Centroid(mesh, mesh.faces_, (*ids)[middle])[axis]
+                                        : lower[axis]};
+  Partition(mesh, 2 * node + 1, depth - 1, begin, middle, ids, splits, leaves);
+  Partition(mesh, 2 * node + 2, depth - 1, middle, end, ids, splits, leaves);
+}
+
+}  // namespace
+
+bool WriteChunkedMesh(const TriangleMesh &mesh, const std::string &filename) {
+  const size_t kTriangles = mesh.faces_.size() / 3;
+  const size_t kVertices = mesh.vertices_.size() / 3;
+  if (kTriangles == 0) return false;
+
+  int depth = 0;
+  while (kTriangles > (kChunkTriangles << depth)) ++depth;
+  const size_t kNodes = (size_t(2) << depth) - 1;
+  const size_t kFirstLeaf = (size_t(1) << depth) - 1;
+
+  std::vector<std::vector<int>> lods;
+  if (depth > 0) lods = BuildLods(mesh);
+
+  // Full detail triangles of the leaves
+  std::vector<uint32_t> ids(kTriangles);
+  std::iota(ids.begin(), ids.end(), 0);
+  std::vector<Split> splits(kFirstLeaf);
+  std::vector<std::pair<size_t, size_t>> leaves(kNodes);
+  Partition(mesh, 0, depth, 0, kTriangles, &ids, &splits, &leaves);
+
+  // Faces and triangles of each node, the nodes of height h take level h (or
+  // the coarsest one when the chain is shorter)
+  std::vector<const std::vector<int> *> node_faces(kNodes, &mesh.faces_);
+  std::vector<std::vector<uint32_t>> node_triangles(kNodes);
+  for (size_t node = kFirstLeaf; node < kNodes; ++node)
+    node_triangles[node].assign(ids.begin() + leaves[node].first,
+                                ids.begin() + leaves[node].second);
+  for (int height = 1; height <= depth; ++height) {
+    const std::vector<int> &faces =
+        lods.empty() ? mesh.faces_ : lods[std::min<size_t>(height, lods.size()) - 1];
+    const size_t kLevelTriangles = faces.size() / 3;
+    std::vector<uint32_t> cell(kLevelTriangles);
+    utils::ParallelFor(0, kLevelTriangles, [&](size_t begin, size_t end) {
+      for (size_t t = begin; t < end; ++t) {
+        glm::vec3 centroid = Centroid(mesh, faces, t);
+        size_t node = 0;
+        for (int level = 0; level < depth - height; ++level) {
+          const Split &split = splits[node];
+          node = 2 * node + (centroid[split.axis_] < split.position_ ? 1 : 2);
+        }
+        cell[t] = node;
+      }
+    }, 1 << 14);
+    for (size_t t = 0; t < kLevelTriangles; ++t) {
+      node_faces[cell[t]] = &faces;
+      node_triangles[cell[t]].push_back(t);
+    }
+  }
+
+  // Without levels of detail for their height (none when the simplification
+  // stalls right away) the inner nodes would hold most of the triangles of
+  // their cell, the root all of them, more than fit in the streaming pool.
+  // They keep an evenly spaced subset, whose gaps grow their error
+  std::vector<float> coarsening(kNodes, 1.0f);
+  for (size_t node = 0; node < kFirstLeaf; ++node) {
+    std::vector<uint32_t> &triangles = node_triangles[node];
+    if (triangles.size() <= kMaxNodeTriangles) continue;
+    const size_t kStride = (triangles.size() + kMaxNodeTriangles - 1) / kMaxNodeTriangles;
+    size_t kept = 0;
+    for (size_t i = 0; i < triangles.size(); i += kStride) triangles[kept++] = triangles[i];
+    triangles.resize(kept);
+    coarsening[node] = std::sqrt(static_cast<float>(kStride));
+  }
+
+  std::ofstream fout(filename.c_str(), std::ios_base::out | std::ios_base::binary);
+  if (!fout.is_open()) {
+    std::cerr << "Unable to write " << filename << std::endl;
+    return false;
+  }
+
+  // The tables are written after the pages, once their offsets are known
+  ChunkedMeshHeader header;
+  std::memcpy(header.magic_, kChunkedMeshMagic, sizeof(header.magic_));
+  header.node_count_ = kNodes;
+  header.min_ = mesh.min_;
+  header.max_ = mesh.max_;
+  header.triangles_ = kTriangles;
+  std::vector<ChunkNode> nodes(kNodes);
+  std::vector<ChunkPage> pages;
+  uint64_t offset = sizeof(ChunkedMeshHeader);
+  fout.seekp(offset);
+
+  const bool kHasNormals = mesh.normals_.size() == mesh.vertices_.size();
+  std::vector<uint32_t> stamp(kVertices, 0), local(kVertices, 0);
+  uint32_t page_stamp = 0;
+  std::vector<glm::vec3> lower(kNodes, glm::vec3(std::numeric_limits<float>::max()));
+  std::vector<glm::vec3> upper(kNodes, glm::vec3(std::numeric_limits<float>::lowest()));
+  for (size_t node = 0; node < kNodes; ++node) {
+    const std::vector<int> &faces = *node_faces[node];
+    const std::vector<uint32_t> &triangles = node_triangles[node];
+    nodes[node].first_child_ = node < kFirstLeaf ? 2 * node + 1 : -1;
+    nodes[node].first_page_ = pages.size();
+
+    std::vector<float> vertex_data;
+    std::vector<uint16_t> indices;
+    double edges = 0.0;
+    auto flush = [&]() {
+      if (indices.empty()) return;
+      pages.push_back({offset, static_cast<uint32_t>(vertex_data.size() / 6),
+                       static_cast<uint32_t>(indices.size())});
+      fout.write(reinterpret_cast<const char *>(vertex_data.data()),
+                 vertex_data.size() * sizeof(float));
+      fout.write(reinterpret_cast<const char *>(indices.data()),
+                 indices.size() * sizeof(uint16_t));
+      offset += vertex_data.size() * sizeof(float) + indices.size() * sizeof(uint16_t);
+      // Keeps the floats of the next page aligned
+      if (offset % 4 != 0) {
+        fout.put(0);
+        fout.put(0);
+        offset += 2;
+      }
+      vertex_data.clear();
+      indices.clear();
+      ++page_stamp;
+    };
+
+    ++page_stamp;
+    for (uint32_t t : triangles) {
+      int corners[3] = {faces[3 * t], faces[3 * t + 1], faces[3 * t + 2]};
+      size_t added = 0;
+      for (int v : corners) added += stamp[v] != page_stamp;
+      if (vertex_data.size() / 6 + added > kPageVertices ||
+          indices.size() == 3 * kPageTriangles)
+        flush();
+
+      for (int v : corners) {
+        if (stamp[v] != page_stamp) {
+          stamp[v] = page_stamp;
+          local[v] = vertex_data.size() / 6;
+          for (int i = 0; i < 3; ++i) vertex_data.push_back(mesh.vertices_[3 * v + i]);
+          for (int i = 0; i < 3; ++i)
+            vertex_data.push_back(kHasNormals ? mesh.normals_[3 * v + i] : 0.0f);
+          glm::vec3 p(mesh.vertices_[3 * v], mesh.vertices_[3 * v + 1],
+                      mesh.vertices_[3 * v + 2]);
+          lower[node] = glm::min(lower[node], p);
+          upper[node] = glm::max(upper[node], p);
+        }
+        indices.push_back(local[v]);
+      }
+      for (int i = 0; i < 3; ++i) {
+        int a = corners[i], b = corners[(i + 1) % 3];
+        edges += glm::length(glm::vec3(mesh.vertices_[3 * a] - mesh.vertices_[3 * b],
+                                       mesh.vertices_[3 * a + 1] - mesh.vertices_[3 * b + 1],
+                                       mesh.vertices_[3 * a + 2] - mesh.vertices_[3 * b + 2]));
+      }
+    }
+    flush();
+    nodes[node].page_count_ = pages.size() - nodes[node].first_page_;
+
+    // An inner node without triangles always refines into its children
+    if (node >= kFirstLeaf)
+      nodes[node].error_ = 0.0f;
+    else if (triangles.empty())
+      nodes[node].error_ = std::numeric_limits<float>::max();
+    else
+      nodes[node].error_ = coarsening[node] * edges / (3.0 * triangles.size());
+  }
+
+  // Bounds of the subtrees, children after their parents in heap order
+  for (size_t node = kNodes; node-- > 0;) {
+    if (node < kFirstLeaf) {
+      for (size_t child = 2 * node + 1; child <= 2 * node + 2; ++child) {
+        lower[node] = glm::min(lower[node], lower[child]);
+        upper[node] = glm::max(upper[node], upper[child]);
+      }
+    }
+    bool empty = lower[node].x > upper[node].x;
+    nodes[node].center_ = empty ? glm::vec3(0.0f) : (lower[node] + upper[node]) * 0.5f;
+    nodes[node].radius_ = empty ? 0.0f : glm::length(upper[node] - lower[node]) * 0.5f;
+  }
+
+  // The page table holds 64 bit offsets
+  while (offset % 8 != 0) {
+    fout.put(0);
+    ++offset;
+  }
+  header.page_count_ = pages.size();
+  header.table_offset_ = offset;
+  fout.write(reinterpret_cast<const char *>(nodes.data()), nodes.size() * sizeof(ChunkNode));
+  fout.write(reinterpret_cast<const char *>(pages.data()), pages.size() * sizeof(ChunkPage));
+  fout.seekp(0);
+  fout.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  if (!fout.good()) {
+    std::cerr << "Unable to write " << filename << std::endl;
+    return false;
+  }
+  std::cout << filename << ": " << kNodes << " chunks, " << pages.size()
+            << " pages" << std::endl;
+  return true;
+}
+
+}  // namespace data_representation
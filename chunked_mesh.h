@@ -0,0 +1,89 @@
+#ifndef CHUNKED_MESH_H_
+#define CHUNKED_MESH_H_
+
+#include <glm/vec3.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "./triangle_mesh.h"
+
+namespace data_representation {
+
+/**
+ * @brief kChunkTriangles Largest number of full detail triangles of a leaf
+ * chunk.
+ */
+const size_t kChunkTriangles = 8192;
+
+/**
+ * @brief kPageVertices, kPageTriangles Capacity of a page, the unit of
+ * storage and streaming of the chunks. Pages index their own vertices with
+ * 16 bit indices.
+ */
+const size_t kPageVertices = 8192;
+const size_t kPageTriangles = 8192;
+
+/**
+ * @brief kChunkedMeshMagic First bytes of a chunked mesh file.
+ */
+const char kChunkedMeshMagic[8] = "VPBSCHK";
+
+/**
+ * @brief ChunkedMeshHeader Start of a chunked mesh file. It is followed by
+ * the data of the pages and, at table_offset_, node_count_ ChunkNode and
+ * page_count_ ChunkPage.
+ */
+struct ChunkedMeshHeader {
+  char magic_[8];
+  uint32_t node_count_;
+  uint32_t page_count_;
+  glm::vec3 min_;
+  glm::vec3 max_;
+  uint64_t triangles_;    // Of the full detail mesh
+  uint64_t table_offset_;
+};
+
+/**
+ * @brief ChunkNode Node of the chunk hierarchy: a complete binary kd-tree
+ * stored in heap order, whose leaves hold the full detail triangles of their
+ * cell and whose inner nodes hold the level of detail of their cell with
+ * about as many triangles as a leaf.
+ */
+struct ChunkNode {
+  glm::vec3 center_;      // Bounding sphere of the node and its descendants
+  float radius_;
+  float error_;           // Mean edge length of its triangles, 0 for a leaf
+  int32_t first_child_;   // Children first_child_ and first_child_ + 1, -1 for a leaf
+  uint32_t first_page_;
+  uint32_t page_count_;
+};
+
+/**
+ * @brief ChunkPage A page of triangles: vertex_count_ vertices of six floats
+ * (position, normal) at offset_ bytes from the start of the file, followed by
+ * index_count_ 16 bit indices.
+ */
+struct ChunkPage {
+  uint64_t offset_;
+  uint32_t vertex_count_;
+  uint32_t index_count_;
+};
+
+/**
+ * @brief WriteChunkedMesh Splits mesh into the chunk hierarchy of an out of
+ * core rendering file. The cells are median splits of the triangle centroids
+ * along their longest axis, as deep as needed for the leaves to hold at most
+ * kChunkTriangles; the inner nodes of height h take the triangles of the h-th
+ * level of detail of the mesh (see BuildLods) whose centroid lies in their
+ * cell, or the coarsest one when the chain is shorter, evenly subsampled to
+ * at most twice kChunkTriangles. Needs the whole mesh in memory, it is meant
+ * to be run offline.
+ * @return Whether the file was written.
+ */
+bool WriteChunkedMesh(const TriangleMesh &mesh, const std::string &filename);
+
+}  // namespace data_representation
+
+#endif  //  CHUNKED_MESH_H_
@@ -0,0 +1,197 @@
+#include <environment_library.h>
+
+#include <QDir>
+#include <QFileInfo>
+
+#include <algorithm>
+#include <chrono>
+#include <utility>
+
+#include "./texture_cache.h"
+
+namespace data_representation {
+
+const char *const kCubeFaces[6] = {"/right.png",  "/left.png",
+                                   "/top.png",    "/bottom.png",
+                                   "/back.png",   "/front.png"};
+
+namespace {
+
+// Path of the cube map folder dir/name, empty if it has no faces.
+std::string CubeMapFolder(const QDir &dir, const QString &name) {
+  QString folder = dir.filePath(name);
+  if (!QFileInfo::exists(folder + kCubeFaces[0])) return "";
+  return folder.toStdString();
+}
+
+}  // namespace
+
+std::vector<EnvironmentMaps> FindEnvironments(const std::string &dir) {
+  std::map<std::string, EnvironmentMaps> found, flat;
+  QDir root(QString::fromStdString(dir));
+  QFileInfoList folders =
+      root.entryInfoList(QDir::Dirs | QDir::NoDotAndDotDot, QDir::Name);
+  for (const QFileInfo &info : folders) {
+    QDir folder(info.filePath());
+    QString name = info.fileName();
+
+    // Flat "<name>_specular" and "<name>_diffuse" cube map folders
+    int separator = name.lastIndexOf('_');
+    QString kind = name.mid(separator + 1).toLower();
+    std::string faces = CubeMapFolder(root, name);
+    if (separator > 0 && !faces.empty() &&
+        (kind == "specular" || kind == "diffuse")) {
+      EnvironmentMaps &environment = flat[name.left(separator).toStdString()];
+      (kind == "specular" ? environment.sky_ : environment.irradiance_) = faces;
+      continue;
+    }
+
+    EnvironmentMaps environment;
+    environment.sky_ = CubeMapFolder(folder, "sky");
+    environment.irradiance_ = CubeMapFolder(folder, "irradiance_map");
+    environment.specular_prefilter_ =
+        CubeMapFolder(folder, "specular_prefilter");
+    if (QFileInfo::exists(folder.filePath("brdf_lut.png")))
+      environment.brdf_lut_ = folder.filePath("brdf_lut.png").toStdString();
+
+    if (!environment.sky_.empty() || !environment.irradiance_.empty() ||
+        !environment.specular_prefilter_.empty() ||
+        !environment.brdf_lut_.empty())
+      found[name.toStdString()] = environment;
+  }
+
+  // The flat folders only fill the maps the environment folder lacks
+  for (const auto &maps : flat) {
+    EnvironmentMaps &environment = found[maps.first];
+    if (environment.sky_.empty()) environment.sky_ = maps.second.sky_;
+    if (environment.irradiance_.empty())
+      environment.irradiance_ = maps.second.irradiance_;
+  }
+
+  std::vector<EnvironmentMaps> environments;
+  for (auto &environment : found) {
+    environment.second.name_ = environment.first;
+    environments.push_back(environment.second);
+  }
+  return environments;
+}
+
+size_t BytesCopied(const ImageData &data) {
+  return data.compressed_ ? 0 : data.image_.bytes_copied_;
+}
+
+bool ReadImageData(const std::string &path, BlockFormat format, bool compress,
+                   bool mipmaps, ImageData *data) {
+  data->compressed_ = compress;
+  if (compress) return LoadCompressedTexture(path, format, mipmaps, &data->texture_);
+  return DecodeImage(path, PixelFormat::kBGRA8, &data->image_);
+}
+
+bool ReadCubeMapData(const std::string &dir, bool compress, bool mipmaps,
+                     std::vector<ImageData> *faces) {
+  faces->resize(6);
+  for (int i = 0; i < 6; ++i)
+    if (!ReadImageData(dir + kCubeFaces[i], BlockFormat::kBC1, compress,
+                       mipmaps, &(*faces)[i]))
+      return false;
+  return true;
+}
+
+namespace {
+
+bool ReadEnvironment(const EnvironmentMaps &maps, bool compress_cube_maps,
+                     bool compress_brdf_lut, EnvironmentData *data) {
+  bool res = true;
+  if (!maps.sky_.empty())
+    res = res && ReadCubeMapData(maps.sky_, compress_cube_maps, false,
+                                 &data->sky_);
+  if (!maps.irradiance_.empty())
+    res = res && ReadCubeMapData(maps.irradiance_, compress_cube_maps, false,
+                                 &data->irradiance_);
+  if (!maps.specular_prefilter_.empty())
+    res = res && ReadCubeMapData(maps.specular_prefilter_, compress_cube_maps,
+                                 true, &data->specular_prefilter_);
+  data->has_brdf_lut_ = !maps.brdf_lut_.empty();
+  if (data->has_brdf_lut_)
+    res = res && ReadImageData(maps.brdf_lut_, BlockFormat::kBC5,
+                               compress_brdf_lut, true, &data->brdf_lut_);
+  return res;
+}
+
+}  // namespace
+
+size_t BytesCopied(const EnvironmentData &data) {
+  size_t bytes = data.has_brdf_lut_ ? BytesCopied(data.brdf_lut_) : 0;
+  for (const auto *faces :
+       {&data.sky_, &data.irradiance_, &data.specular_prefilter_})
+    for (const ImageData &face : *faces) bytes += BytesCopied(face);
+  return bytes;
+}
+
+EnvironmentLibrary::EnvironmentLibrary(size_t budget) : resident_(budget) {}
+
+size_t EnvironmentLibrary::Scan(const std::string &dir) {
+  for (auto &pending : pending_) pending.second.wait();
+  pending_.clear();
+  pending_order_.clear();
+  dropped_.clear();
+
+  environments_ = FindEnvironments(dir);
+  resident_.Reset(environments_.size());
+  return environments_.size();
+}
+
+void EnvironmentLibrary::Prefetch(size_t index, bool compress_cube_maps,
+                                  bool compress_brdf_lut) {
+  ReleaseDropped();
+  if (index >= environments_.size() || resident_.Contains(index) ||
+      pending_.count(index) > 0)
+    return;
+
+  if (pending_order_.size() >= kMaxPrefetched) {
+    auto oldest = pending_.find(pending_order_.front());
+    dropped_.push_back(std::move(oldest->second));
+    pending_.erase(oldest);
+    pending_order_.pop_front();
+  }
+
+  EnvironmentMaps maps = environments_[index];
+  pending_[index] = std::async(std::launch::async, [=]() {
+    DataPtr data(new EnvironmentData());
+    if (!ReadEnvironment(maps, compress_cube_maps, compress_brdf_lut,
+                         data.get()))
+      data.reset();
+    return data;
+  });
+  pending_order_.push_back(index);
+}
+
+bool EnvironmentLibrary::Read(size_t index, bool compress_cube_maps,
+                              bool compress_brdf_lut, EnvironmentData *data) {
+  ReleaseDropped();
+  auto pending = pending_.find(index);
+  if (pending == pending_.end())
+    return ReadEnvironment(environments_[index], compress_cube_maps,
+                           compress_brdf_lut, data);
+
+  DataPtr result = pending->second.get();
+  pending_.erase(pending);
+  pending_order_.erase(
+      std::find(pending_order_.begin(), pending_order_.end(), index));
+  if (!result) return false;
+
+  *data = std::move(*result);
+  return true;
+}
+
+void EnvironmentLibrary::ReleaseDropped() {
+  dropped_.erase(
+      std::remove_if(dropped_.begin(), dropped_.end(),
+                     [](const std::future<DataPtr> &read) {
+                       return read.wait_for(std::chrono::seconds(0)) ==
+                              std::future_status::ready;
+                     }),
+      dropped_.end());
+}
+
+}  // namespace data_representation
@@ -0,0 +1,222 @@
+#ifndef ENVIRONMENT_LIBRARY_H_
+#define ENVIRONMENT_LIBRARY_H_
+
+#include <resident_set.h>
+#include <texture_compression.h>
+#include <texture_io.h>
+
+#include <cstddef>
+#include <deque>
+#include <future>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace data_representation {
+
+/**
+ * @brief kCubeFaces File names of the faces of a cube map folder, in the order
+ * of the GL_TEXTURE_CUBE_MAP_POSITIVE_X + i targets.
+ */
+extern const char *const kCubeFaces[6];
+
+/**
+ * @brief EnvironmentMaps Paths of the maps used for image based lighting with
+ * one environment. Empty when the environment does not provide that map.
+ */
+struct EnvironmentMaps {
+  std::string name_;
+  std::string sky_;                 // Cube map folder
+  std::string irradiance_;          // Cube map folder
+  std::string specular_prefilter_;  // Cube map folder, mipmapped
+  std::string brdf_lut_;            // Image
+};
+
+/**
+ * @brief FindEnvironments Lists the environments of dir: every subdirectory
+ * with a "sky", "irradiance_map" or "specular_prefilter" cube map folder or a
+ * "brdf_lut.png" image. Flat cube map folders "<name>_specular" and
+ * "<name>_diffuse" (as loaded by Load Specular and Load Diffuse) are the sky
+ * and the irradiance of environment <name>, unless its own folder has them.
+ * @param dir Root directory of the textures.
+ * @return The environments found, sorted by name.
+ */
+std::vector<EnvironmentMaps> FindEnvironments(const std::string &dir);
+
+/**
+ * @brief ImageData CPU side pixels of an image, ready to be uploaded: block
+ * compressed with its mip chain or decoded.
+ */
+struct ImageData {
+  bool compressed_;
+  CompressedTexture texture_;
+  DecodedImage image_;
+};
+
+/**
+ * @brief BytesCopied Bytes copied after decoding the image (see
+ * DecodedImage::bytes_copied_), 0 for block compressed images, which are not
+ * uploaded from the decoder buffer.
+ */
+size_t BytesCopied(const ImageData &data);
+
+/**
+ * @brief ReadImageData Reads the image at path, from the texture cache when
+ * compress is set.
+ * @return Whether it was able to read the image.
+ */
+bool ReadImageData(const std::string &path, BlockFormat format, bool compress,
+                   bool mipmaps, ImageData *data);
+
+/**
+ * @brief ReadCubeMapData Reads the six faces of the cube map folder dir, in
+ * kCubeFaces order, as BC1 when compress is set.
+ * @return Whether it was able to read every face.
+ */
+bool ReadCubeMapData(const std::string &dir, bool compress, bool mipmaps,
+                     std::vector<ImageData> *faces);
+
+/**
+ * @brief EnvironmentData CPU side pixels of all the maps of an environment.
+ * Missing maps have no faces (cube maps) or no pixels (BRDF LUT).
+ */
+struct EnvironmentData {
+  std::vector<ImageData> sky_;
+  std::vector<ImageData> irradiance_;
+  std::vector<ImageData> specular_prefilter_;
+  ImageData brdf_lut_;
+  bool has_brdf_lut_;
+};
+
+/**
+ * @brief BytesCopied Bytes copied after decoding all the maps of an
+ * environment.
+ */
+size_t BytesCopied(const EnvironmentData &data);
+
+/**
+ * @brief EnvironmentLibrary Environments found in a textures folder, the GPU
+ * textures of the ones that are currently resident and the environments that
+ * are being read in the background. Resident environments are kept under a
+ * memory budget, evicting the least recently used ones first. The library
+ * only does the bookkeeping and the file reading, the owner creates and
+ * deletes the textures.
+ */
+class EnvironmentLibrary {
+ public:
+  /**
+   * @brief Resident GPU textures of an environment and the memory they use.
+   */
+  struct Resident {
+    unsigned int sky_;
+    unsigned int irradiance_;
+    unsigned int specular_prefilter_;
+    unsigned int brdf_lut_;
+    size_t bytes_;
+  };
+
+  /**
+   * @brief EnvironmentLibrary Creates an empty library.
+   * @param budget Maximum bytes of the resident textures.
+   */
+  explicit EnvironmentLibrary(size_t budget);
+
+  /**
+   * @brief Scan Replaces the environments by the ones found in dir (see
+   * FindEnvironments). Waits for the pending reads, the resident textures
+   * have to be released with Clear before.
+   * @return The number of environments found.
+   */
+  size_t Scan(const std::string &dir);
+
+  size_t Size() const { return environments_.size(); }
+  const EnvironmentMaps &Maps(size_t index) const {
+    return environments_[index];
+  }
+  size_t ResidentBytes() const { return resident_.Bytes(); }
+
+  /**
+   * @brief kMaxPrefetched Maximum number of background reads kept at once,
+   * the neighbours of the current environment.
+   */
+  static const size_t kMaxPrefetched = 2;
+
+  /**
+   * @brief Prefetch Starts reading the maps of an environment in the
+   * background, unless it is resident or already being read. Drops the oldest
+   * background read when there are kMaxPrefetched already. Never waits.
+   * @param compress_cube_maps Whether to read the cube maps as BC1.
+   * @param compress_brdf_lut Whether to read the BRDF LUT as BC5.
+   */
+  void Prefetch(size_t index, bool compress_cube_maps, bool compress_brdf_lut);
+
+  /**
+   * @brief Read Returns the maps of an environment, waiting for its
+   * background read when there is one or reading them otherwise.
+   * @return Whether it was able to read the maps.
+   */
+  bool Read(size_t index, bool compress_cube_maps, bool compress_brdf_lut,
+            EnvironmentData *data);
+
+  /**
+   * @brief Use Looks up the textures of a resident environment and marks it
+   * as the most recently used one.
+   * @return Whether the environment is resident.
+   */
+  bool Use(size_t index, Resident *resident) {
+    return resident_.Use(index, resident);
+  }
+
+  /**
+   * @brief Insert Makes an environment resident with the given textures and
+   * evicts the least recently used environments until the budget is met
+   * again. The inserted environment is never evicted.
+   * @param evicted Textures of the evicted environments, to be deleted by the
+   * caller.
+   */
+  void Insert(size_t index, const Resident &resident,
+              std::vector<Resident> *evicted) {
+    resident_.Insert(index, resident, resident.bytes_, evicted);
+  }
+
+  /**
+   * @brief Clear Evicts every environment.
+   * @return Textures of the evicted environments, to be deleted by the
+   * caller.
+   */
+  std::vector<Resident> Clear() { return resident_.Clear(); }
+
+ private:
+  typedef std::unique_ptr<EnvironmentData> DataPtr;
+
+  std::vector<EnvironmentMaps> environments_;
+  ResidentSet<Resident> resident_;
+
+  /**
+   * @brief pending_ Background reads, by environment index.
+   */
+  std::map<size_t, std::future<DataPtr>> pending_;
+
+  /**
+   * @brief pending_order_ Indices of pending_, oldest first.
+   */
+  std::deque<size_t> pending_order_;
+
+  /**
+   * @brief dropped_ Background reads dropped by Prefetch. Destroying a
+   * running std::async future waits for it, so they are kept until they
+   * finish.
+   */
+  std::vector<std::future<DataPtr>> dropped_;
+
+  /**
+   * @brief ReleaseDropped Frees the dropped reads that finished, without
+   * waiting for the others.
+   */
+  void ReleaseDropped();
+};
+
+}  // namespace data_representation
+
+#endif  // ENVIRONMENT_LIBRARY_H_
@@ -0,0 +1,293 @@
+#include <frame_capture.h>
+
+#include <QImage>
+#include <QString>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+namespace data_visualization {
+
+namespace {
+
+typedef FrameCapture::Layout Layout;
+
+// Time a capture waits for a buffer of the ring, in nanoseconds
+const GLuint64 kFenceTimeout = 1000000000;
+
+size_t PixelBytes(Layout layout) {
+  switch (layout) {
+    case Layout::kGray: return 1;
+    case Layout::kOctahedral: return 8;
+    default: return 4;
+  }
+}
+
+// Decodes the octahedral normals of the G-buffer (see gbuffer.frag) into the
+// [0, 1] encoding of the four channel normal targets, as BGRA8.
+std::vector<uint8_t> DecodeOctahedral(const std::vector<uint8_t> &pixels) {
+  const float *rg = reinterpret_cast<const float *>(pixels.data());
+  std::vector<uint8_t> bgra(pixels.size() / 2);
+  for (size_t i = 0; i < bgra.size() / 4; ++i) {
+    float x = rg[2 * i] * 2.0f - 1.0f, y = rg[2 * i + 1] * 2.0f - 1.0f;
+    float z = 1.0f - std::abs(x) - std::abs(y);
+    float t = std::max(-z, 0.0f);
+    x += x >= 0.0f ? -t : t;
+    y += y >= 0.0f ? -t : t;
+    float length = std::max(std::sqrt(x * x + y * y + z * z), 1e-6f);
+    const float kNormal[3] = {x / length, y / length, z / length};
+    for (int c = 0; c < 3; ++c)
+      bgra[4 * i + 2 - c] = static_cast<uint8_t>((kNormal[c] * 0.5f + 0.5f) * 255.0f + 0.5f);
+    bgra[4 * i + 3] = 255;
+  }
+  return bgra;
+}
+
+// Writes a frame read by glReadPixels, bottom row first
+bool WriteFrame(std::vector<uint8_t> pixels, int width, int height,
+                Layout layout, CaptureEncoding encoding, const std::string &file) {
+  if (layout == Layout::kOctahedral) {
+    pixels = DecodeOctahedral(pixels);
+    layout = Layout::kColor;
+  }
+
+  const size_t kRowBytes = size_t(width) * PixelBytes(layout);
+  if (encoding == CaptureEncoding::kRaw) {
+    std::ofstream fout(file.c_str(), std::ios_base::out | std::ios_base::binary);
+    for (int y = height - 1; y >= 0; --y)
+      fout.write(reinterpret_cast<const char *>(pixels.data() + y * kRowBytes), kRowBytes);
+    if (!fout.good()) {
+      std::cerr << "Unable to write " << file << std::endl;
+      return false;
+    }
+    return true;
+  }
+
+  QImage image;
+  if (layout == Layout::kDepth) {
+    // Full 16 bit precision, the depth of the scene is close to 1
+    image = QImage(width, height, QImage::Format_Grayscale16);
+    for (int y = 0; y < height; ++y) {
+      const float *row = reinterpret_cast<const float *>(pixels.data() + (height - 1 - y) * kRowBytes);
+      uint16_t *line = reinterpret_cast<uint16_t *>(image.scanLine(y));
+      for (int x = 0; x < width; ++x) line[x] = static_cast<uint16_t>(row[x] * 65535.0f + 0.5f);
+    }
+  } else if (layout == Layout::kGray) {
+    image = QImage(pixels.data(), width, height, kRowBytes, QImage::Format_Grayscale8).mirrored();
+  } else {
+    // BGRA bytes are the little endian ARGB words of QImage
+    image = QImage(pixels.data(), width, height, kRowBytes, QImage::Format_RGB32).mirrored();
+  }
+  if (!image.save(QString::fromStdString(file))) {
+    std::cerr << "Unable to write " << file << std::endl;
+    return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+FrameCapture::FrameCapture()
+    : gl_(nullptr),
+      read_framebuffer_(0),
+      next_(0),
+      recording_(false),
+      encoding_(CaptureEncoding::kPng),
+      frames_(0),
+      stalls_(0) {}
+
+FrameCapture::~FrameCapture() {
+  for (std::future<bool> &encode : encodes_) encode.wait();
+}
+
+void FrameCapture::Initialize(QOpenGLFunctions_3_3_Core *gl) {
+  gl_ = gl;
+  gl_->glGenFramebuffers(1, &read_framebuffer_);
+  ring_.resize(kCaptureRing);
+  for (Readback &readback : ring_) {
+    gl_->glGenBuffers(1, &readback.buffer_);
+    readback.capacity_ = 0;
+    readback.fence_ = nullptr;
+  }
+  next_ = 0;
+}
+
+void FrameCapture::Release() {
+  if (gl_ == nullptr) return;
+
+  Retire(true);
+  recording_ = false;
+  screenshot_.clear();
+  for (Readback &readback : ring_) gl_->glDeleteBuffers(1, &readback.buffer_);
+  ring_.clear();
+  gl_->glDeleteFramebuffers(1, &read_framebuffer_);
+  read_framebuffer_ = 0;
+  gl_ = nullptr;
+  for (std::future<bool> &encode : encodes_) encode.get();
+  encodes_.clear();
+}
+
+void FrameCapture::Start(const std::string &prefix, CaptureEncoding encoding) {
+  prefix_ = prefix;
+  encoding_ = encoding;
+  frames_ = 0;
+  stalls_ = 0;
+  recording_ = true;
+}
+
+void FrameCapture::Stop() {
+  if (!recording_) return;
+
+  recording_ = false;
+  if (gl_ != nullptr) Retire(true);
+  for (std::future<bool> &encode : encodes_) encode.get();
+  encodes_.clear();
+  std::cout << "Recorded " << frames_ << " frames to " << prefix_ << ", "
+            << stalls_ << " stalls" << std::endl;
+}
+
+void FrameCapture::Screenshot(const std::string &file) { screenshot_ = file; }
+
+bool FrameCapture::Pending() const {
+  for (const Readback &readback : ring_)
+    if (readback.fence_ != nullptr) return true;
+  return false;
+}
+
+void FrameCapture::Update() {
+  if (gl_ != nullptr) Retire(false);
+}
+
+void FrameCapture::ReadFramebuffer(GLuint framebuffer, int width, int height) {
+  if (gl_ == nullptr || !Active()) return;
+
+  GLint previous = 0;
+  gl_->glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &previous);
+  gl_->glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+  gl_->glReadBuffer(framebuffer == 0 ? GL_BACK : GL_COLOR_ATTACHMENT0);
+  Read(Layout::kColor, width, height);
+  gl_->glBindFramebuffer(GL_READ_FRAMEBUFFER, previous);
+}
+
+void FrameCapture::ReadTexture(GLuint texture, const RenderTargetFormat &format, int width,
+                               int height) {
+  if (gl_ == nullptr || !Active()) return;
+
+  Layout layout = Layout::kColor;
+  if (format.format_ == GL_DEPTH_COMPONENT)
+    layout = Layout::kDepth;
+  else if (format.format_ == GL_RED)
+    layout = Layout::kGray;
+  else if (format.format_ == GL_RG)
+    layout = Layout::kOctahedral;
+  const bool depth = layout == Layout::kDepth;
+
+  GLint previous = 0;
+  gl_->glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &previous);
+  gl_->glBindFramebuffer(GL_READ_FRAMEBUFFER, read_framebuffer_);
+  gl_->glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+                              depth ? 0 : texture, 0);
+  gl_->glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D,
+                              depth ? texture : 0, 0);
+  gl_->glReadBuffer(depth ? GL_NONE : GL_COLOR_ATTACHMENT0);
+  Read(layout, width, height);
+  gl_->glBindFramebuffer(GL_READ_FRAMEBUFFER, previous);
+}
+
+void FrameCapture::Read(Layout layout, int width, int height) {
+  // The buffers reached since the last capture, then the one reused if the
+  // GPU is that far behind
+  Retire(false);
+  Readback &readback = ring_[next_];
+  if (readback.fence_ != nullptr) {
+    ++stalls_;
+    Retire(true);
+  }
+
+  const GLenum kFormats[] = {GL_BGRA, GL_RED, GL_RG, GL_DEPTH_COMPONENT};
+  const GLenum kTypes[] = {GL_UNSIGNED_BYTE, GL_UNSIGNED_BYTE, GL_FLOAT, GL_FLOAT};
+  const size_t kBytes = size_t(width) * height * PixelBytes(layout);
+  gl_->glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer_);
+  if (kBytes > readback.capacity_) {
+    gl_->glBufferData(GL_PIXEL_PACK_BUFFER, kBytes, nullptr, GL_STREAM_READ);
+    readback.capacity_ = kBytes;
+  }
+  // Rows of gray frames are not a multiple of 4 bytes wide
+  gl_->glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  gl_->glReadPixels(0, 0, width, height, kFormats[static_cast<int>(layout)],
+                    kTypes[static_cast<int>(layout)], nullptr);
+  gl_->glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  readback.fence_ = gl_->glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  readback.width_ = width;
+  readback.height_ = height;
+  readback.layout_ = layout;
+
+  if (!screenshot_.empty()) {
+    readback.file_ = screenshot_;
+    readback.encoding_ = CaptureEncoding::kPng;
+    screenshot_.clear();
+  } else {
+    std::ostringstream file;
+    file << prefix_ << std::setw(6) << std::setfill('0') << frames_++
+         << (encoding_ == CaptureEncoding::kPng ? ".png" : ".raw");
+    readback.file_ = file.str();
+    readback.encoding_ = encoding_;
+  }
+  next_ = (next_ + 1) % ring_.size();
+}
+
+void FrameCapture::Retire(bool wait) {
+  for (size_t i = 0; i < ring_.size(); ++i) {
+    Readback &readback = ring_[(next_ + i) % ring_.size()];
+    if (readback.fence_ == nullptr) continue;
+
+    GLenum status = gl_->glClientWaitSync(readback.fence_, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0,
+                                          wait ? kFenceTimeout : 0);
+    if (status == GL_TIMEOUT_EXPIRED) {
+      if (!wait) return;
+      std::cerr << "Capture readback timed out" << std::endl;
+    }
+    Encode(&readback);
+  }
+}
+
+void FrameCapture::Encode(Readback *readback) {
+  const size_t kBytes = size_t(readback->width_) * readback->height_ * PixelBytes(readback->layout_);
+  std::vector<uint8_t> pixels(kBytes);
+  gl_->glBindBuffer(GL_PIXEL_PACK_BUFFER, readback->buffer_);
+  const void *data = gl_->glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, kBytes, GL_MAP_READ_BIT);
+  if (data != nullptr) {
+    std::memcpy(pixels.data(), data, kBytes);
+    gl_->glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+  }
+  gl_->glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  gl_->glDeleteSync(readback->fence_);
+  readback->fence_ = nullptr;
+  if (data == nullptr) {
+    std::cerr << "Unable to map capture buffer" << std::endl;
+    return;
+  }
+
+  // Bounded, so that a slow disk does not pile up frames in memory
+  while (encodes_.size() >= kMaxCaptureEncodes) {
+    ++stalls_;
+    encodes_.front().get();
+    encodes_.pop_front();
+  }
+  while (!encodes_.empty() &&
+         encodes_.front().wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+    encodes_.front().get();
+    encodes_.pop_front();
+  }
+  encodes_.push_back(std::async(std::launch::async, WriteFrame, std::move(pixels),
+                                readback->width_, readback->height_, readback->layout_,
+                                readback->encoding_, readback->file_));
+}
+
+}  //  namespace data_visualization
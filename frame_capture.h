@@ -0,0 +1,172 @@
+#ifndef FRAME_CAPTURE_H_
+#define FRAME_CAPTURE_H_
+
+#include <QOpenGLFunctions_3_3_Core>
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <string>
+#include <vector>
+
+#include "./render_graph.h"
+
+namespace data_visualization {
+
+/**
+ * @brief kCaptureRing Pixel pack buffers of the capture ring, so a frame is
+ * mapped this many captures after its read was queued.
+ */
+const size_t kCaptureRing = 4;
+
+/**
+ * @brief kMaxCaptureEncodes Frames waiting for or being encoded before the
+ * capture waits for the oldest one.
+ */
+const size_t kMaxCaptureEncodes = 32;
+
+/**
+ * @brief CaptureEncoding How the captured frames are written: PNG, or raw
+ * pixels (BGRA8, 8 bit gray for single channel targets or 32 bit floats for
+ * depth, top row first) for sequences that are encoded afterwards.
+ */
+enum class CaptureEncoding { kPng, kRaw };
+
+/**
+ * @brief FrameCapture Screenshots and frame sequences without stalling the
+ * frame. A capture only queues the read of the framebuffer, or of a texture,
+ * into the next pixel pack buffer of a kCaptureRing ring and puts a fence
+ * after it; the buffers whose fence was reached are mapped by the following
+ * captures, by when the GPU is done with them, and their pixels are handed
+ * to background tasks that encode and write them.
+ */
+class FrameCapture {
+ public:
+  FrameCapture();
+  ~FrameCapture();
+
+  /**
+   * @brief Initialize Creates the ring. Needs a current context.
+   * @param gl Functions of the context the buffers belong to.
+   */
+  void Initialize(QOpenGLFunctions_3_3_Core *gl);
+
+  /**
+   * @brief Release Writes the pending frames and deletes the ring. Needs a
+   * current context.
+   */
+  void Release();
+
+  /**
+   * @brief Start Records every following capture as
+   * <prefix><frame number>.png or .raw until Stop.
+   */
+  void Start(const std::string &prefix, CaptureEncoding encoding);
+
+  /**
+   * @brief Stop Ends the recording, waiting for its frames to be written.
+   * Needs a current context.
+   */
+  void Stop();
+
+  /**
+   * @brief Screenshot Writes the next capture to file as PNG.
+   */
+  void Screenshot(const std::string &file);
+
+  /**
+   * @brief Active Whether the next frame has to be captured.
+   */
+  bool Active() const { return recording_ || !screenshot_.empty(); }
+
+  bool Recording() const { return recording_; }
+
+  /**
+   * @brief Pending Whether frames are still being read back.
+   */
+  bool Pending() const;
+
+  /**
+   * @brief Update Encodes the frames whose read the GPU finished. Called
+   * every frame, also after the last capture.
+   */
+  void Update();
+
+  /**
+   * @brief ReadFramebuffer Captures the first color attachment of
+   * framebuffer, or the back buffer for 0.
+   */
+  void ReadFramebuffer(GLuint framebuffer, int width, int height);
+
+  /**
+   * @brief ReadTexture Captures a 2D render target. Single channel targets
+   * are written as grayscale and two channel ones are taken as octahedral
+   * normals (see OctahedralNormals) and written decoded, like the normals of
+   * a four channel target.
+   * @param format Format the texture was allocated with.
+   */
+  void ReadTexture(GLuint texture, const RenderTargetFormat &format, int width,
+                   int height);
+
+  /**
+   * @brief Layout Pixels read into a pixel pack buffer.
+   *  - kColor: BGRA8.
+   *  - kGray: One 8 bit channel.
+   *  - kOctahedral: Two 32 bit floats, an octahedral encoded normal.
+   *  - kDepth: One 32 bit float.
+   */
+  enum class Layout { kColor, kGray, kOctahedral, kDepth };
+
+ private:
+  /**
+   * @brief Readback A pixel pack buffer of the ring and the frame read into
+   * it, pending while fence_ is set.
+   */
+  struct Readback {
+    GLuint buffer_;
+    size_t capacity_;
+    GLsync fence_;
+    int width_;
+    int height_;
+    Layout layout_;
+    std::string file_;
+    CaptureEncoding encoding_;
+  };
+
+  /**
+   * @brief Read Queues the read of the bound read framebuffer into the next
+   * buffer of the ring.
+   */
+  void Read(Layout layout, int width, int height);
+
+  /**
+   * @brief Retire Maps the pending buffers, oldest first, and encodes their
+   * frames. Stops at the first one the GPU did not reach unless wait.
+   */
+  void Retire(bool wait);
+
+  /**
+   * @brief Encode Copies the frame of a reached buffer to a background
+   * encode and frees the buffer.
+   */
+  void Encode(Readback *readback);
+
+  QOpenGLFunctions_3_3_Core *gl_;
+  GLuint read_framebuffer_;   // Attaches the captured textures
+  std::vector<Readback> ring_;
+  size_t next_;
+
+  bool recording_;
+  std::string prefix_;
+  CaptureEncoding encoding_;
+  std::string screenshot_;
+  size_t frames_;        // Of the recording
+  size_t stalls_;        // Captures that waited for the GPU or the encoders
+
+  std::deque<std::future<bool>> encodes_;
+};
+
+}  //  namespace data_visualization
+
+#endif  //  FRAME_CAPTURE_H_
@@ -0,0 +1,120 @@
+#include <gbuffer_formats.h>
+
+#include <iomanip>
+#include <iostream>
+
+namespace data_visualization {
+
+namespace {
+
+const RenderTargetFormat kRgba8 = {GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE};
+const RenderTargetFormat kRg16 = {GL_RG16, GL_RG, GL_UNSIGNED_SHORT};
+const RenderTargetFormat kRg8 = {GL_RG8, GL_RG, GL_UNSIGNED_BYTE};
+const RenderTargetFormat kR8 = {GL_R8, GL_RED, GL_UNSIGNED_BYTE};
+const RenderTargetFormat kDepth24 = {GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT};
+const RenderTargetFormat kDepth32F = {GL_DEPTH_COMPONENT32F, GL_DEPTH_COMPONENT, GL_FLOAT};
+const RenderTargetFormat kDepth32 = {GL_DEPTH_COMPONENT32, GL_DEPTH_COMPONENT, GL_FLOAT};
+
+const double kMegabyte = 1024.0 * 1024.0;
+
+// Bytes per pixel of each target, in the order the report lists them
+std::vector<size_t> TargetBytes(const GBufferFormats &formats) {
+  return {TexelBytes(formats.albedo_.internal_format_),
+          TexelBytes(formats.normal_.internal_format_),
+          TexelBytes(formats.material_.internal_format_),
+          TexelBytes(formats.depth_.internal_format_),
+          TexelBytes(formats.ao_.internal_format_),
+          TexelBytes(formats.ao_.internal_format_)};
+}
+
+// Bytes per pixel each pass reads and writes, in the order the report lists
+// them
+std::vector<size_t> PassBytes(const GBufferFormats &formats, int ssao_taps, int blur_taps) {
+  size_t albedo = TexelBytes(formats.albedo_.internal_format_);
+  size_t normal = TexelBytes(formats.normal_.internal_format_);
+  size_t material = TexelBytes(formats.material_.internal_format_);
+  size_t depth = TexelBytes(formats.depth_.internal_format_);
+  size_t ao = TexelBytes(formats.ao_.internal_format_);
+  return {albedo + normal + material + depth,
+          normal + depth * (1 + ssao_taps) + ao,
+          (ao + normal + depth) * blur_taps + ao,
+          albedo + normal + material + depth + ao};
+}
+
+void PrintMegabytes(const std::string &name, const std::string &format, double bytes,
+                    double full_bytes) {
+  std::cout << "  " << std::left << std::setw(14) << name << std::setw(6) << format
+            << std::right << std::fixed << std::setprecision(1) << std::setw(8)
+            << bytes / kMegabyte << " MB (" << full_bytes / kMegabyte << " MB full)"
+            << std::endl;
+}
+
+}  // namespace
+
+GBufferFormats CompactGBufferFormats() {
+  return {kRgba8, kRg16, kRgba8, kDepth24, kR8};
+}
+
+GBufferFormats FullGBufferFormats() {
+  return {kRgba8, kRgba8, kRgba8, kDepth32, kRgba8};
+}
+
+std::vector<RenderTargetFormat> NormalFormats() { return {kRg16, kRg8, kRgba8}; }
+
+std::vector<RenderTargetFormat> AoFormats() { return {kR8, kRgba8}; }
+
+std::vector<RenderTargetFormat> DepthFormats() { return {kDepth24, kDepth32F, kDepth32}; }
+
+std::string FormatName(const RenderTargetFormat &format) {
+  switch (format.internal_format_) {
+    case GL_RGBA8: return "RGBA8";
+    case GL_RG16: return "RG16";
+    case GL_RG8: return "RG8";
+    case GL_R8: return "R8";
+    case GL_DEPTH_COMPONENT24: return "D24";
+    case GL_DEPTH_COMPONENT32F: return "D32F";
+    case GL_DEPTH_COMPONENT32: return "D32";
+    default: return "?";
+  }
+}
+
+bool OctahedralNormals(const RenderTargetFormat &normal_format) {
+  return normal_format.format_ == GL_RG;
+}
+
+void ReportGBuffer(const GBufferFormats &formats, int width, int height,
+                   int ssao_taps, int blur_taps) {
+  const double kPixels = double(width) * height;
+  const GBufferFormats kFull = FullGBufferFormats();
+  const std::vector<RenderTargetFormat> kFormats = {formats.albedo_, formats.normal_,
+                                                    formats.material_, formats.depth_,
+                                                    formats.ao_, formats.ao_};
+  const char *kTargets[] = {"albedo", "normal", "material", "depth", "ssao", "blurred_ssao"};
+  const char *kPasses[] = {"gbuffer", "ssao", "blur", "final"};
+
+  std::vector<size_t> target_bytes = TargetBytes(formats);
+  std::vector<size_t> full_target_bytes = TargetBytes(kFull);
+  double total = 0.0, full_total = 0.0;
+  std::cout << "G-Buffer at " << width << "x" << height << ":" << std::endl;
+  for (size_t i = 0; i < target_bytes.size(); ++i) {
+    PrintMegabytes(kTargets[i], FormatName(kFormats[i]), target_bytes[i] * kPixels,
+                   full_target_bytes[i] * kPixels);
+    total += target_bytes[i] * kPixels;
+    full_total += full_target_bytes[i] * kPixels;
+  }
+  PrintMegabytes("total", "", total, full_total);
+
+  std::vector<size_t> pass_bytes = PassBytes(formats, ssao_taps, blur_taps);
+  std::vector<size_t> full_pass_bytes = PassBytes(kFull, ssao_taps, blur_taps);
+  total = full_total = 0.0;
+  std::cout << "Traffic per frame, " << ssao_taps << " SSAO taps, " << blur_taps
+            << " blur taps:" << std::endl;
+  for (size_t i = 0; i < pass_bytes.size(); ++i) {
+    PrintMegabytes(kPasses[i], "", pass_bytes[i] * kPixels, full_pass_bytes[i] * kPixels);
+    total += pass_bytes[i] * kPixels;
+    full_total += full_pass_bytes[i] * kPixels;
+  }
+  PrintMegabytes("total", "", total, full_total);
+}
+
+}  //  namespace data_visualization
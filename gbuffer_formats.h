@@ -0,0 +1,81 @@
+#ifndef GBUFFER_FORMATS_H_
+#define GBUFFER_FORMATS_H_
+
+#include <string>
+#include <vector>
+
+#include "./render_graph.h"
+
+namespace data_visualization {
+
+/**
+ * @brief GBufferFormats Formats of the targets of the SSAO pipeline. ao_ is
+ * the format of the SSAO and the blurred SSAO targets.
+ *
+ * A normal target with two channels holds octahedral encoded normals, see
+ * OctahedralNormals; the shaders decode them when octahedral_normals is set.
+ */
+struct GBufferFormats {
+  RenderTargetFormat albedo_;
+  RenderTargetFormat normal_;
+  RenderTargetFormat material_;
+  RenderTargetFormat depth_;
+  RenderTargetFormat ao_;
+};
+
+/**
+ * @brief CompactGBufferFormats The default formats: RG16 octahedral normals,
+ * R8 ambient occlusion and 24 bit depth.
+ */
+GBufferFormats CompactGBufferFormats();
+
+/**
+ * @brief FullGBufferFormats RGBA8 colors and 32 bit depth for every target,
+ * what the compact formats are compared to.
+ */
+GBufferFormats FullGBufferFormats();
+
+/**
+ * @brief NormalFormats Formats the normal target can take, the compact one
+ * first.
+ */
+std::vector<RenderTargetFormat> NormalFormats();
+
+/**
+ * @brief AoFormats Formats the ambient occlusion targets can take, the compact
+ * one first.
+ */
+std::vector<RenderTargetFormat> AoFormats();
+
+/**
+ * @brief DepthFormats Formats the depth target can take, the compact one
+ * first.
+ */
+std::vector<RenderTargetFormat> DepthFormats();
+
+/**
+ * @brief FormatName Short name of the internal format, as shown in the menus
+ * and the report.
+ */
+std::string FormatName(const RenderTargetFormat &format);
+
+/**
+ * @brief OctahedralNormals Whether the normal format only has room for the
+ * octahedral encoding.
+ */
+bool OctahedralNormals(const RenderTargetFormat &normal_format);
+
+/**
+ * @brief ReportGBuffer Prints the memory of every target and an estimate of
+ * the bytes each pass reads and writes per frame, against the full formats.
+ * Reads count one texel per tap, ignoring the texture cache, and the G-Buffer
+ * writes one texel per pixel, ignoring overdraw.
+ * @param ssao_taps Depth samples per pixel of the SSAO pass.
+ * @param blur_taps Texels of the bilateral blur kernel.
+ */
+void ReportGBuffer(const GBufferFormats &formats, int width, int height,
+                   int ssao_taps, int blur_taps);
+
+}  //  namespace data_visualization
+
+#endif  //  GBUFFER_FORMATS_H_
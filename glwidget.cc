@@ -2,16 +2,29 @@
 
 #include <glwidget.h>
 
+#include <QTimer>
+
+#include <algorithm>
+#include <chrono>
 #include <fstream>
 #include <iostream>
 #include <memory>
+#include <random>
 #include <string>
 #include <sstream>
 
+#include "./ambient_occlusion.h"
+#include "./bvh.h"
 #include "./mesh_io.h"
+#include "./render_graph.h"
+#include "./scene.h"
+#include "./simplify.h"
+#include "./texture_cache.h"
+#include "./texture_io.h"
 #include "./triangle_mesh.h"
 
 #include <glm/mat4x4.hpp>
+#include <glm/trigonometric.hpp>
 
 namespace {
 
@@ -40,45 +53,38 @@ const std::vector<std::string> kSSAOShaderFiles = {
 const std::vector<std::string> kBlurShaderFiles = {
     "../shaders/quad.vert", "../shaders/blur.frag"  // Blur pass
 };
-
-const int kVertexAttributeIdx = 0;
-const int kNormalAttributeIdx = 1;
-const int kTexCoordAttributeIdx = 2;
-
-// Define the Skybox
-const float kSkySize = 10.0f;
-float kSkyVertices[24] = {
-    -0.5f * kSkySize, -0.5f * kSkySize, -0.5f * kSkySize,	
-     0.5f * kSkySize, -0.5f * kSkySize, -0.5f * kSkySize,	
-    -0.5f * kSkySize, -0.5f * kSkySize,  0.5f * kSkySize, 
-     0.5f * kSkySize, -0.5f * kSkySize,  0.5f * kSkySize,
-    -0.5f * kSkySize,  0.5f * kSkySize, -0.5f * kSkySize,
-     0.5f * kSkySize,  0.5f * kSkySize, -0.5f * kSkySize,
-    -0.5f * kSkySize,  0.5f * kSkySize,  0.5f * kSkySize, 
-     0.5f * kSkySize,  0.5f * kSkySize,  0.5f * kSkySize
+const std::vector<std::string> kDepthShaderFiles = {
+    "../shaders/depth.vert", "../shaders/depth.frag"  // Depth pre-pass
 };
-
-unsigned int kSkyFaces[36] = {
-  // Top
-  4, 7, 6,
-  4, 5, 7,
-  // Bottom
-  0, 3, 1,
-  0, 2, 3,
-  // Back
-  6, 3, 2,
-  6, 7, 3,
-  // Front
-  0, 1, 4,
-  4, 1, 5,
-  // Left
-  6, 0, 2,
-  6, 4, 0,
-  // Right
-  1, 3, 7,
-  7, 5, 1
+const std::vector<std::string> kOverdrawShaderFiles = {
+    "../shaders/depth.vert", "../shaders/overdraw.frag"  // Overdraw visualization
 };
 
+// Brightness added by every shaded fragment in the overdraw view, white
+// means shaded 8 or more times
+const float kOverdrawIncrement = 1.0f / 8.0f;
+
+// GPU memory kept for the textures of the material and environment libraries
+const size_t kMaterialBudget = 256 * 1024 * 1024;
+const size_t kEnvironmentBudget = 256 * 1024 * 1024;
+
+// Lights added at once by AddRandomLights
+const int kRandomLights = 64;
+
+// Passes of renderWithSSAO, as bits of the passes a change makes stale. A
+// pass also runs again when a pass it reads from does
+const unsigned kGBufferPass = 1 << 0;
+const unsigned kSsaoPass = 1 << 1;
+const unsigned kBlurPass = 1 << 2;
+const unsigned kFinalPass = 1 << 3;
+const unsigned kAllPasses = kGBufferPass | kSsaoPass | kBlurPass | kFinalPass;
+
+// Milliseconds between the frames that only show background progress
+const int kProgressFrameInterval = 33;
+
+const uint64_t kFnvOffset = 14695981039346656037ull;
+const uint64_t kFnvPrime = 1099511628211ull;
+
 float quadVertices[] = {
     // vertex attributes for a quad that fills the entire screen in Normalized Device Coordinates.
     // NOTE that this plane is now much smaller and at the top of the screen
@@ -92,6 +98,16 @@ float quadVertices[] = {
      1.0f,  1.0f,  1.0f, 1.0f
 };
 
+// FNV-1a of the bytes of the inputs of a pass, chained to hash
+uint64_t HashInputs(uint64_t hash) { return hash; }
+
+template <typename T, typename... Inputs>
+uint64_t HashInputs(uint64_t hash, const T &input, const Inputs &... inputs) {
+  const unsigned char *bytes = reinterpret_cast<const unsigned char *>(&input);
+  for (size_t i = 0; i < sizeof(T); ++i) hash = (hash ^ bytes[i]) * kFnvPrime;
+  return HashInputs(hash, inputs...);
+}
+
 bool ReadFile(const std::string filename, std::string *shader_source) {
   std::ifstream infile(filename.c_str());
 
@@ -108,35 +124,244 @@ bool ReadFile(const std::string filename, std::string *shader_source) {
   return true;
 }
 
-bool LoadImage(const std::string &path, GLuint cube_map_pos, int mip_level = 0) {
-  QImage image;
-  bool res = image.load(path.c_str());
-  if (res) {
-    QImage gl_image = image.mirrored();
-    glTexImage2D(cube_map_pos, mip_level, GL_RGBA, image.width(), image.height(), 0,
-                 GL_BGRA, GL_UNSIGNED_BYTE, image.bits());
+GLenum CompressedInternalFormat(data_representation::BlockFormat format) {
+  switch (format) {
+    case data_representation::BlockFormat::kBC1:
+      return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    case data_representation::BlockFormat::kBC4:
+      return GL_COMPRESSED_RED_RGTC1;
+    case data_representation::BlockFormat::kBC5:
+      return GL_COMPRESSED_RG_RGTC2;
   }
-  return res;
+  return GL_NONE;
+}
+
+/**
+ * Uploads every mip level of texture to the given target. Returns the number
+ * of uploaded levels.
+ */
+int UploadCompressedTexture(QOpenGLFunctions_3_3_Core *gl, GLenum target,
+                            const data_representation::CompressedTexture &texture) {
+  int width = texture.width_, height = texture.height_;
+  for (size_t level = 0; level < texture.levels_.size(); ++level) {
+    gl->glCompressedTexImage2D(target, level, CompressedInternalFormat(texture.format_),
+                               width, height, 0,
+                               static_cast<GLsizei>(texture.levels_[level].size()),
+                               texture.levels_[level].data());
+    width = std::max(1, width / 2);
+    height = std::max(1, height / 2);
+  }
+  return static_cast<int>(texture.levels_.size());
 }
 
-bool LoadCubeMap(const QString &dir) {
-  std::string path = dir.toUtf8().constData();
-  bool res = LoadImage(path + "/right.png", GL_TEXTURE_CUBE_MAP_POSITIVE_X);
-  res = res && LoadImage(path + "/left.png", GL_TEXTURE_CUBE_MAP_NEGATIVE_X);
-  res = res && LoadImage(path + "/top.png", GL_TEXTURE_CUBE_MAP_POSITIVE_Y);
-  res = res && LoadImage(path + "/bottom.png", GL_TEXTURE_CUBE_MAP_NEGATIVE_Y);
-  res = res && LoadImage(path + "/back.png", GL_TEXTURE_CUBE_MAP_POSITIVE_Z);
-  res = res && LoadImage(path + "/front.png", GL_TEXTURE_CUBE_MAP_NEGATIVE_Z);
+/**
+ * Uploads an image read by data_representation::ReadImageData to the given
+ * target (GL_TEXTURE_2D or a cube map face). Returns the number of uploaded
+ * mip levels of compressed images, 0 for decoded ones whose mip chain still
+ * has to be generated.
+ */
+int UploadImageData(QOpenGLFunctions_3_3_Core *gl, GLenum target,
+                    const data_representation::ImageData &data) {
+  if (data.compressed_) return UploadCompressedTexture(gl, target, data.texture_);
+
+  glTexImage2D(target, 0, GL_RGBA, data.image_.width_, data.image_.height_, 0,
+               GL_BGRA, GL_UNSIGNED_BYTE, data.image_.Pixels());
+  return 0;
+}
 
-  if (res) {
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+/**
+ * Prints the bytes copied after decoding the maps of one load, to check that
+ * the uploads come straight from the decoder buffers.
+ */
+void ReportBytesCopied(const std::string &name, size_t bytes) {
+  std::cout << "Loaded " << name << ", " << bytes
+            << " bytes copied after decoding" << std::endl;
+}
+
+/**
+ * Sets the mipmapped sampling parameters of the currently bound
+ * GL_TEXTURE_2D. Compressed textures come with their own mip chain of levels
+ * levels, the chain of uncompressed ones (levels == 0) is generated.
+ */
+void SetMipmappedSampling(QOpenGLFunctions_3_3_Core *gl, int levels) {
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+
+  if (levels > 0) {
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+  } else {
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 1000);
+    gl->glGenerateMipmap(GL_TEXTURE_2D); // Generate mipmaps for better quality at different distances
   }
+}
 
-  return res;
+/**
+ * Uploads an image to the currently bound GL_TEXTURE_2D and sets the
+ * mipmapped sampling parameters.
+ */
+void UploadTexture(QOpenGLFunctions_3_3_Core *gl,
+                   const data_representation::ImageData &data) {
+  SetMipmappedSampling(gl, UploadImageData(gl, GL_TEXTURE_2D, data));
+}
+
+/**
+ * Loads the image at path into the currently bound GL_TEXTURE_2D, compressed
+ * with format when compress is set, and sets the mipmapped sampling
+ * parameters. Adds the bytes copied after decoding to bytes_copied.
+ */
+bool LoadTexture(QOpenGLFunctions_3_3_Core *gl, const std::string &path,
+                 data_representation::BlockFormat format, bool compress,
+                 size_t *bytes_copied) {
+  data_representation::ImageData data;
+  if (!data_representation::ReadImageData(path, format, compress, true, &data))
+    return false;
+
+  *bytes_copied += data_representation::BytesCopied(data);
+  UploadTexture(gl, data);
+  return true;
+}
+
+/**
+ * Packs the occlusion, roughness and metalness maps (any of them may be
+ * empty) into the red, green and blue channels of the currently bound
+ * GL_TEXTURE_2D, through the texture cache. It is left uncompressed: BC1
+ * shares its endpoints between the three channels, which blurs scalar maps
+ * that BC4 kept apart. Adds the bytes copied after decoding to bytes_copied.
+ */
+bool LoadORMTexture(QOpenGLFunctions_3_3_Core *gl, const std::string &occlusion,
+                    const std::string &roughness, const std::string &metalness,
+                    size_t *bytes_copied) {
+  std::vector<unsigned char> rgba;
+  int width, height;
+  size_t copied;
+  if (!data_representation::LoadORMImage(occlusion, roughness, metalness,
+                                         &rgba, &width, &height, &copied))
+    return false;
+  *bytes_copied += copied;
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA,
+               GL_UNSIGNED_BYTE, rgba.data());
+
+  SetMipmappedSampling(gl, 0);
+  return true;
+}
+
+/**
+ * Bytes used by all the mip levels of the image bound to target
+ * (GL_TEXTURE_2D or a cube map face), uncompressed levels are assumed to be
+ * RGBA8.
+ */
+size_t TextureBytes(GLenum target = GL_TEXTURE_2D) {
+  size_t bytes = 0;
+  for (int level = 0;; ++level) {
+    GLint width = 0, height = 0, compressed = GL_FALSE;
+    glGetTexLevelParameteriv(target, level, GL_TEXTURE_WIDTH, &width);
+    glGetTexLevelParameteriv(target, level, GL_TEXTURE_HEIGHT, &height);
+    if (width == 0 || height == 0) break;
+
+    glGetTexLevelParameteriv(target, level, GL_TEXTURE_COMPRESSED, &compressed);
+    if (compressed == GL_TRUE) {
+      GLint size = 0;
+      glGetTexLevelParameteriv(target, level,
+                               GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &size);
+      bytes += size;
+    } else {
+      bytes += static_cast<size_t>(width) * height * 4;
+    }
+  }
+  return bytes;
+}
+
+/**
+ * Bytes used by the six faces of the currently bound GL_TEXTURE_CUBE_MAP.
+ */
+size_t CubeMapBytes() {
+  size_t bytes = 0;
+  for (int face = 0; face < 6; ++face)
+    bytes += TextureBytes(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face);
+  return bytes;
+}
+
+/**
+ * Uploads the faces read by data_representation::ReadCubeMapData to the
+ * currently bound GL_TEXTURE_CUBE_MAP and sets its sampling parameters,
+ * trilinear when mipmaps is set (generating the mip chain of uncompressed
+ * faces) and bilinear otherwise.
+ */
+void UploadCubeMap(QOpenGLFunctions_3_3_Core *gl,
+                   const std::vector<data_representation::ImageData> &faces,
+                   bool mipmaps) {
+  int levels = 0;
+  for (int face = 0; face < 6; ++face)
+    levels = UploadImageData(gl, GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, faces[face]);
+
+  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER,
+                  mipmaps ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_BASE_LEVEL, 0);
+  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL,
+                  levels > 0 ? levels - 1 : 1000);
+
+  // Compressed cube maps already come with their mip chain
+  if (mipmaps && levels == 0) gl->glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+}
+
+bool LoadCubeMap(QOpenGLFunctions_3_3_Core *gl, const QString &dir, bool compress,
+                 bool mipmaps, size_t *bytes_copied) {
+  std::vector<data_representation::ImageData> faces;
+  if (!data_representation::ReadCubeMapData(dir.toUtf8().constData(), compress,
+                                            mipmaps, &faces))
+    return false;
+
+  for (const auto &face : faces) *bytes_copied += data_representation::BytesCopied(face);
+
+  UploadCubeMap(gl, faces, mipmaps);
+  return true;
+}
+
+// Creates a buffer texture with the given texel format over a new buffer.
+void CreateBufferTexture(QOpenGLFunctions_3_3_Core *gl, GLenum format,
+                         GLuint *buffer, GLuint *texture) {
+  gl->glGenBuffers(1, buffer);
+  gl->glGenTextures(1, texture);
+  gl->glBindBuffer(GL_TEXTURE_BUFFER, *buffer);
+  gl->glBufferData(GL_TEXTURE_BUFFER, 16, nullptr, GL_STREAM_DRAW);
+  gl->glBindTexture(GL_TEXTURE_BUFFER, *texture);
+  gl->glTexBuffer(GL_TEXTURE_BUFFER, format, *buffer);
+  gl->glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+// Replaces the contents of the buffer of a buffer texture. Empty data keeps a
+// single zero texel, so that the buffer is never left without storage.
+template <typename T>
+void UploadBufferTexture(QOpenGLFunctions_3_3_Core *gl, GLuint buffer,
+                         const std::vector<T> &data) {
+  static const T kZero[4] = {};
+  gl->glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+  if (data.empty())
+    gl->glBufferData(GL_TEXTURE_BUFFER, sizeof(kZero), kZero, GL_STREAM_DRAW);
+  else
+    gl->glBufferData(GL_TEXTURE_BUFFER, data.size() * sizeof(T), data.data(),
+                     GL_STREAM_DRAW);
+  gl->glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+// The single light the PBS shader used before lights could be added.
+data_visualization::Light DefaultLight() {
+  data_visualization::Light light;
+  light.type_ = data_visualization::LightType::kPoint;
+  light.position_ = glm::vec3(10, 0, 0);
+  light.color_ = glm::vec3(1.0f);
+  light.range_ = 0.0f;
+  light.direction_ = glm::vec3(-1, 0, 0);
+  light.inner_angle_ = 0.0f;
+  light.outer_angle_ = 0.0f;
+  return light;
 }
 
 bool LoadProgram(const std::string &vertex, const std::string &fragment,
@@ -150,19 +375,39 @@ bool LoadProgram(const std::string &vertex, const std::string &fragment,
                                      vertex_shader.c_str());
     program->addShaderFromSourceCode(QOpenGLShader::Fragment,
                                      fragment_shader.c_str());
-    program->bindAttributeLocation("vertex", kVertexAttributeIdx);
-    program->bindAttributeLocation("normal", kNormalAttributeIdx);
-    program->bindAttributeLocation("texCoord", kTexCoordAttributeIdx);
+    program->bindAttributeLocation("vertex", data_visualization::kVertexAttributeIdx);
+    program->bindAttributeLocation("normal", data_visualization::kNormalAttributeIdx);
+    program->bindAttributeLocation("texCoord", data_visualization::kTexCoordAttributeIdx);
+    program->bindAttributeLocation("instance_transform", data_visualization::kInstanceAttributeIdx);
+    program->bindAttributeLocation("material_id", data_visualization::kMaterialAttributeIdx);
+    program->bindAttributeLocation("baked_occlusion", data_visualization::kOcclusionAttributeIdx);
     program->link();
   }
 
   return res;
 }
 
+// Directions from the center of the bounding box, which shade a mesh roughly
+// like a convex shape until its normals are computed
+std::vector<float> PreviewNormals(const data_representation::TriangleMesh &mesh) {
+  const glm::vec3 kCenter = (mesh.min_ + mesh.max_) * 0.5f;
+  std::vector<float> normals(mesh.vertices_.size(), 0.0f);
+  for (size_t i = 0; i + 2 < mesh.vertices_.size(); i += 3) {
+    glm::vec3 direction(mesh.vertices_[i] - kCenter.x, mesh.vertices_[i + 1] - kCenter.y,
+                        mesh.vertices_[i + 2] - kCenter.z);
+    float length = glm::length(direction);
+    if (length == 0.0f) continue;
+    for (int j = 0; j < 3; ++j) normals[i + j] = direction[j] / length;
+  }
+  return normals;
+}
+
 }  // namespace
 
 GLWidget::GLWidget(QWidget *parent)
     : QOpenGLWidget(parent),
+      ao_bake_queued_(false),
+      gbuffer_formats_(data_visualization::CompactGBufferFormats()),
       initialized_(false),
       width_(0.0),
       height_(0.0),
@@ -189,39 +434,65 @@ GLWidget::GLWidget(QWidget *parent)
       normal_threshold_(0.8f),
       depth_threshold_(0.01f),
       bias_angle_(0.1f),
-      ao_strength_(1.0f)
+      ao_strength_(1.0f),
+      compress_textures_(true),
+      s3tc_supported_(false),
+      materials_(kMaterialBudget),
+      active_color_map_(0),
+      active_orm_map_(0),
+      environments_(kEnvironmentBudget),
+      active_environment_(-1),
+      active_specular_map_(0),
+      active_diffuse_map_(0),
+      active_weighted_specular_map_(0),
+      active_brdfLUT_map_(0),
+      lights_(1, DefaultLight()),
+      lights_changed_(true),
+      depth_prepass_(false),
+      show_overdraw_(false),
+      backface_culling_(false),
+      ply_streaming_(false),
+      background_builds_(true),
+      capture_source_(0),
+      dirty_passes_(kAllPasses),
+      progress_frame_(false),
+      mesh_version_(0),
+      gbuffer_key_(0),
+      ssao_key_(0),
+      blur_key_(0),
+      noise_texture_(0)
       {
   setFocusPolicy(Qt::StrongFocus);
 }
 
 GLWidget::~GLWidget() {
+  // Does not wait for the whole file to be read
+  if (ply_stream_) ply_stream_->Cancel();
+
   if (initialized_) {
     glDeleteTextures(1, &specular_map_);
     glDeleteTextures(1, &diffuse_map_);
     glDeleteTextures(1, &brdfLUT_map_);
     glDeleteTextures(1, &color_map_);
-    glDeleteTextures(1, &roughness_map_);
-    glDeleteTextures(1, &metalness_map_);
+    glDeleteTextures(1, &orm_map_);
     glDeleteTextures(1, &weighted_specular_map_);
+    ReleaseMaterials();
+    ReleaseEnvironments();
 
-    glDeleteFramebuffers(1, &g_buffer_FBO_);
-    glDeleteTextures(1, &albedo_texture_);
-    glDeleteTextures(1, &normal_texture_);
-    glDeleteTextures(1, &depth_texture_);
-    glDeleteFramebuffers(1, &ssao_FBO_);
-    glDeleteTextures(1, &ssao_texture_);
-    glDeleteFramebuffers(1, &blur_FBO_);
-    glDeleteTextures(1, &blurred_ssao_texture_);
+    render_graph_.Release();
     glDeleteTextures(1, &noise_texture_);
 
-    glDeleteVertexArrays(1, &VAO);
-    glDeleteBuffers(1, &VBO_v);
-    glDeleteBuffers(1, &VBO_n);
-    glDeleteBuffers(1, &VBO_tc);
-    glDeleteBuffers(1, &VBO_i);
+    glDeleteTextures(1, &light_texture_);
+    glDeleteTextures(1, &cluster_grid_texture_);
+    glDeleteTextures(1, &cluster_lights_texture_);
+    glDeleteBuffers(1, &light_buffer_);
+    glDeleteBuffers(1, &cluster_grid_buffer_);
+    glDeleteBuffers(1, &cluster_lights_buffer_);
+
+    mesh_buffers_.Release();
+    chunk_streamer_.Release();
+    capture_.Release();
     glDeleteVertexArrays(1, &VAO_sky);
-    glDeleteBuffers(1, &VBO_v_sky);
-    glDeleteBuffers(1, &VBO_i_sky);
   }
 }
 
@@ -230,135 +501,397 @@ bool GLWidget::LoadModel(const QString &filename) {
   size_t pos = file.find_last_of(".");
   std::string type = file.substr(pos + 1);
 
-  std::unique_ptr<data_representation::TriangleMesh> mesh =
-      std::make_unique<data_representation::TriangleMesh>();
+  CancelPlyLoad();
 
-  bool res = false;
-  if (type.compare("ply") == 0) {
-    res = data_representation::ReadFromPly(file, mesh.get());
-  } else if (type.compare("obj") == 0) {
-    res = data_representation::ReadFromObj(file, mesh.get());
-  } else if(type.compare("null") == 0) {
-    res = data_representation::CreateSphere(mesh.get());
+  // Out of core meshes are streamed from their file instead of loaded
+  if (type.compare("chunks") == 0) return OpenChunkedMesh(file);
+  // PLY models are shown while they are read
+  if (type.compare("ply") == 0 && initialized_) return LoadPly(file);
+
+  data_representation::Scene scene;
+  bool res = data_representation::ReadModel(file, &scene);
+  return res && ShowScene(&scene, type.compare("null") == 0 ? "" : file);
+}
+
+bool GLWidget::ShowModel(data_representation::Scene *scene, const QString &filename) {
+  CancelPlyLoad();
+  return ShowScene(scene, filename.toUtf8().constData());
+}
+
+bool GLWidget::ShowScene(data_representation::Scene *scene, const std::string &file) {
+  glm::vec3 min, max;
+  if (!scene->Bounds(&min, &max)) return false;
+
+  // Occlusion baked for this model before
+  std::vector<size_t> vertex_counts;
+  for (size_t i = 0; i < scene->MeshCount(); ++i)
+    vertex_counts.push_back(scene->Mesh(i).vertices_.size() / 3);
+  std::vector<std::vector<float>> occlusion;
+  if (!file.empty() &&
+      data_representation::ReadAmbientOcclusion(file + ".ao", vertex_counts, &occlusion)) {
+    for (size_t i = 0; i < occlusion.size(); ++i)
+      scene->Mesh(i).ao_ = std::move(occlusion[i]);
+    std::cout << "Ambient occlusion read from " << file << ".ao" << std::endl;
   }
 
-  if (res) {
-    mesh_.reset(mesh.release());
-    camera_.UpdateModel(mesh_->min_, mesh_->max_);
-    // mesh_->computeNormals();
+  WaitForBuilds();
+  chunk_streamer_.Close();
+  scene_ = std::move(*scene);
+  model_file_ = file;
+  camera_.UpdateModel(min, max);
+  BuildBvhs();
+  BuildLods();
 
-    GLenum error = glGetError();
-    if (error != GL_NO_ERROR) {
-        std::cerr << "OpenGL error at line " << __LINE__ << ": " << error << std::endl;
+  GLenum error = glGetError();
+  if (error != GL_NO_ERROR) {
+      std::cerr << "OpenGL error at line " << __LINE__ << ": " << error << std::endl;
+  }
+
+  UploadScene();
+
+  emit SetFaces(QString(std::to_string(scene_.Faces()).c_str()));
+  emit SetVertices(QString(std::to_string(scene_.Vertices()).c_str()));
+  return true;
+}
+
+bool GLWidget::LoadPly(const std::string &file) {
+  if (!std::ifstream(file.c_str(), std::ios_base::binary).good()) return false;
+
+  ply_file_ = file;
+  ply_mesh_ = std::make_unique<data_representation::TriangleMesh>();
+  ply_stream_ = std::make_unique<data_representation::PlyStream>();
+  data_representation::TriangleMesh *mesh = ply_mesh_.get();
+  data_representation::PlyStream *stream = ply_stream_.get();
+  ply_load_ = std::async(std::launch::async, [file, mesh, stream]() {
+    return data_representation::ReadFromPly(file, mesh, stream);
+  });
+  update();
+  return true;
+}
+
+void GLWidget::UpdatePlyLoad() {
+  if (!ply_load_.valid()) return;
+
+  bool has_normals = false;
+  size_t faces = 0;
+  if (!ply_streaming_ && ply_stream_->Vertices(&has_normals, &faces)) {
+    // The previous model goes away once the new one has something to show
+    WaitForBuilds();
+    chunk_streamer_.Close();
+    scene_.Clear();
+    model_file_.clear();
+    BuildBvhs();
+    BuildLods();
+    camera_.UpdateModel(ply_mesh_->min_, ply_mesh_->max_);
+    // The normals in the file are final, computed ones come at the end
+    mesh_buffers_.BeginStream(*ply_mesh_,
+                              has_normals ? ply_mesh_->normals_ : PreviewNormals(*ply_mesh_),
+                              faces * 3);
+    ply_streaming_ = true;
+
+    emit SetFaces(QString(std::to_string(faces).c_str()));
+    emit SetVertices(QString(std::to_string(ply_mesh_->vertices_.size() / 3).c_str()));
+  }
+  if (ply_streaming_) {
+    std::vector<int> indices;
+    ply_stream_->TakeFaces(&indices);
+    if (!indices.empty()) {
+      mesh_buffers_.AppendFaces(indices);
+      ++mesh_version_;
     }
+  }
 
-    // Generate VAO
-    glGenVertexArrays(1, &VAO); 
+  // Keeps drawing the faces as they arrive
+  if (ply_load_.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+    ScheduleProgressFrame(kAllPasses);
+    return;
+  }
+
+  bool read = ply_load_.get();
+  data_representation::Scene scene;
+  if (read)
+    scene.AddNode(-1, scene.AddMesh(std::move(ply_mesh_)), glm::mat4(1.0f));
+  ply_mesh_.reset();
+  ply_stream_.reset();
+  bool shown = read && ShowScene(&scene, ply_file_);
+  if (!read) std::cerr << "Unable to read the PLY model" << std::endl;
+  // Without the model, the partial one is dropped
+  if (!shown && ply_streaming_) UploadScene();
+  ply_streaming_ = false;
+}
 
-    // Create vertices VBOs
-    glGenBuffers(1, &VBO_v);
-    glGenBuffers(1, &VBO_n);
-    glGenBuffers(1, &VBO_tc);
-    glGenBuffers(1, &VBO_i);
+void GLWidget::CancelPlyLoad() {
+  if (!ply_load_.valid()) return;
 
-    // bind VAO 
-    glBindVertexArray(VAO);
+  ply_stream_->Cancel();
+  ply_load_.wait();
+  ply_load_ = std::future<bool>();
+  ply_mesh_.reset();
+  ply_stream_.reset();
+  if (ply_streaming_) UploadScene();
+  ply_streaming_ = false;
+}
 
-    glBindBuffer(GL_ARRAY_BUFFER, VBO_v);
-    glBufferData(GL_ARRAY_BUFFER, mesh_->vertices_.size() * sizeof(float), &mesh_->vertices_[0], GL_STATIC_DRAW);
-    glVertexAttribPointer(kVertexAttributeIdx, 3, GL_FLOAT, GL_FALSE, 0, (void *)0); // mesh_->vertices -> attrib location 0
-    glEnableVertexAttribArray(kVertexAttributeIdx); 
+bool GLWidget::OpenChunkedMesh(const std::string &file) {
+  if (!chunk_streamer_.Open(file)) return false;
 
-    glBindBuffer(GL_ARRAY_BUFFER, VBO_n);
-    glBufferData(GL_ARRAY_BUFFER, mesh_->normals_.size() * sizeof(float), &mesh_->normals_[0], GL_STATIC_DRAW);
-    glVertexAttribPointer(kNormalAttributeIdx, 3, GL_FLOAT, GL_FALSE, 0, (void *)0); // mesh_->normals -> attrib location 1
-    glEnableVertexAttribArray(kNormalAttributeIdx);
+  WaitForBuilds();
+  scene_.Clear();
+  model_file_.clear();
+  BuildBvhs();
+  BuildLods();
+  UploadScene();
+  camera_.UpdateModel(chunk_streamer_.Min(), chunk_streamer_.Max());
 
-  
-    glBindBuffer(GL_ARRAY_BUFFER, VBO_tc);
-    glBufferData(GL_ARRAY_BUFFER, mesh_->texCoords_.size() * sizeof(float), &mesh_->texCoords_[0], GL_STATIC_DRAW);
-    glVertexAttribPointer(kTexCoordAttributeIdx, 2, GL_FLOAT, GL_FALSE, 0, (void *)0); // mesh_->texCoords -> attrib location 2
-    glEnableVertexAttribArray(kTexCoordAttributeIdx);
+  emit SetFaces(QString(std::to_string(chunk_streamer_.Triangles()).c_str()));
+  emit SetVertices(QString("-"));
+  return true;
+}
 
-    
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, VBO_i);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh_->faces_.size() * sizeof(int), &mesh_->faces_[0], GL_STATIC_DRAW);
+void GLWidget::UploadScene() {
+  if (initialized_) makeCurrent();
 
-    // unbind VAO
-    glBindVertexArray(0);
+  // Reuses the buffers of the previous scene when the new one fits
+  mesh_buffers_.Upload(scene_);
+  ++mesh_version_;
+  update();
+  std::cout << "Mesh buffers: " << mesh_buffers_.Bytes() / 1024 << " KB (peak "
+            << mesh_buffers_.PeakBytes() / 1024 << " KB), "
+            << mesh_buffers_.DrawCount() << " draws" << std::endl;
+}
 
-    //SKY BOX:
-    // Store the vertices and faces of the skybox
-    skyVertices_.assign(kSkyVertices, kSkyVertices + sizeof(kSkyVertices)/sizeof(float));
-    skyFaces_.assign(kSkyFaces, kSkyFaces + sizeof(kSkyFaces)/sizeof(unsigned int));
+void GLWidget::BuildBvhs() {
+  bvhs_.clear();
+  if (!background_builds_) {
+    bvh_build_ = std::future<std::vector<std::unique_ptr<data_representation::Bvh>>>();
+    return;
+  }
 
-    // Generate the VAO and VBOs for the skybox
-    glGenVertexArrays(1, &VAO_sky);
-    glGenBuffers(1, &VBO_v_sky);
-    glGenBuffers(1, &VBO_i_sky);
+  const data_representation::Scene *scene = &scene_;
+  bvh_build_ = std::async(std::launch::async, [scene]() {
+    std::vector<std::unique_ptr<data_representation::Bvh>> bvhs;
+    for (size_t i = 0; i < scene->MeshCount(); ++i) {
+      bvhs.emplace_back(new data_representation::Bvh());
+      bvhs.back()->Build(scene->Mesh(i));
+    }
+    return bvhs;
+  });
+}
 
-    // bind VAO
-    glBindVertexArray(VAO_sky);
+void GLWidget::BuildLods() {
+  if (!background_builds_) {
+    lod_build_ = std::future<std::vector<std::vector<std::vector<int>>>>();
+    return;
+  }
 
-    // vertices -> attrib location 0
-    glBindBuffer(GL_ARRAY_BUFFER, VBO_v_sky);
-    glBufferData(GL_ARRAY_BUFFER, skyVertices_.size() * sizeof(float), &skyVertices_[0], GL_STATIC_DRAW);
-    glVertexAttribPointer(kVertexAttributeIdx, 3, GL_FLOAT, GL_FALSE, 0, (void *)0); 
-    glEnableVertexAttribArray(kVertexAttributeIdx);
+  const data_representation::Scene *scene = &scene_;
+  lod_build_ = std::async(std::launch::async, [scene]() {
+    std::vector<std::vector<std::vector<int>>> lods;
+    for (size_t i = 0; i < scene->MeshCount(); ++i)
+      lods.push_back(data_representation::BuildLods(scene->Mesh(i)));
+    return lods;
+  });
+}
 
-    // faces -> elements
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, VBO_i_sky);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, skyFaces_.size() * sizeof(int), &skyFaces_[0], GL_STATIC_DRAW);
-    
-    // unbind VAO
-    glBindVertexArray(0);
+void GLWidget::WaitForBuilds() {
+  if (bvh_build_.valid()) bvh_build_.wait();
+  if (lod_build_.valid()) lod_build_.wait();
+  if (ao_bake_.valid()) {
+    ao_bake_.wait();
+    ao_bake_ = std::future<std::vector<std::vector<float>>>();
+  }
+  ao_bake_queued_ = false;
+}
 
-    // unbind VBO
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+void GLWidget::BakeAmbientOcclusion() {
+  if (scene_.MeshCount() == 0 || ao_bake_.valid() || ao_bake_queued_) return;
 
+  ao_bake_queued_ = true;
+  std::cout << "Baking ambient occlusion" << std::endl;
+  UpdateAmbientOcclusion();
+}
 
+void GLWidget::StartAmbientOcclusionBake() {
+  // The bake traces against the BVHs of scene_
+  if (bvhs_.size() != scene_.MeshCount()) {
+    std::cerr << "Ambient occlusion needs the BVHs, enable background builds" << std::endl;
+    return;
+  }
+  const data_representation::Scene *scene = &scene_;
+  const std::vector<std::unique_ptr<data_representation::Bvh>> *bvhs = &bvhs_;
+  std::string cache = model_file_.empty() ? "" : model_file_ + ".ao";
+  ao_bake_ = std::async(std::launch::async, [scene, bvhs, cache]() {
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::vector<float>> occlusion;
+    for (size_t i = 0; i < scene->MeshCount(); ++i)
+      occlusion.push_back(data_representation::BakeAmbientOcclusion(scene->Mesh(i), *(*bvhs)[i]));
+    std::cout << "Baked ambient occlusion in "
+              << std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count()
+              << " s" << std::endl;
+    if (!cache.empty()) data_representation::WriteAmbientOcclusion(cache, occlusion);
+    return occlusion;
+  });
+}
 
-    emit SetFaces(QString(std::to_string(mesh_->faces_.size() / 3).c_str()));
-    emit SetVertices(
-        QString(std::to_string(mesh_->vertices_.size() / 3).c_str()));
-    return true;
+void GLWidget::UpdateAmbientOcclusion() {
+  if (ao_bake_queued_) {
+    if (bvh_build_.valid()) {
+      if (bvh_build_.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+        ScheduleProgressFrame(0);
+        return;
+      }
+      bvhs_ = bvh_build_.get();
+    }
+    ao_bake_queued_ = false;
+    StartAmbientOcclusionBake();
+  }
+
+  if (!ao_bake_.valid()) return;
+  if (ao_bake_.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+    ScheduleProgressFrame(0);
+    return;
+  }
+
+  std::vector<std::vector<float>> occlusion = ao_bake_.get();
+  for (size_t i = 0; i < occlusion.size(); ++i)
+    scene_.Mesh(i).ao_ = std::move(occlusion[i]);
+  UploadScene();
+}
+
+void GLWidget::UpdateLods() {
+  if (!lod_build_.valid() ||
+      lod_build_.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+    return;
+
+  std::vector<std::vector<std::vector<int>>> lods = lod_build_.get();
+  size_t levels = 0;
+  for (size_t i = 0; i < lods.size(); ++i) {
+    levels += lods[i].size();
+    scene_.Mesh(i).lods_ = std::move(lods[i]);
   }
+  if (levels == 0) return;
 
-  return false;
+  std::cout << "Levels of detail: " << levels << std::endl;
+  UploadScene();
+}
+
+bool GLWidget::Pick(int x, int y, glm::vec3 *position) {
+  if (bvh_build_.valid()) {
+    if (bvh_build_.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+      std::cout << "Picking is not available until the BVH is built" << std::endl;
+      return false;
+    }
+    bvhs_ = bvh_build_.get();
+  }
+
+  auto start = std::chrono::steady_clock::now();
+
+  // Segment from the near to the far plane through the pixel, before the
+  // model matrix
+  glm::mat4x4 model = camera_.SetModel();
+  glm::mat4x4 inverse_view_projection =
+      glm::inverse(camera_.SetProjection() * camera_.SetView());
+  float ndc_x = 2.0f * x / width() - 1.0f;
+  float ndc_y = 1.0f - 2.0f * y / height();
+  glm::vec4 near_point = inverse_view_projection * glm::vec4(ndc_x, ndc_y, -1.0f, 1.0f);
+  glm::vec4 far_point = inverse_view_projection * glm::vec4(ndc_x, ndc_y, 1.0f, 1.0f);
+  near_point = near_point / near_point.w;
+  far_point = far_point / far_point.w;
+
+  // Affine transforms keep the segment parameter, so the hits of every
+  // instance are compared on the same t
+  std::vector<std::vector<glm::mat4>> instances = scene_.Instances();
+  float closest = 1.0f;
+  int hit_mesh = -1;
+  data_representation::RayHit hit;
+  for (size_t i = 0; i < bvhs_.size(); ++i) {
+    for (const glm::mat4 &instance : instances[i]) {
+      glm::mat4 to_object = glm::inverse(model * instance);
+      glm::vec3 origin = glm::vec3(to_object * near_point);
+      data_representation::Ray ray = {origin, glm::vec3(to_object * far_point) - origin};
+      if (bvhs_[i]->ClosestHit(ray, closest, &hit)) {
+        closest = hit.t_;
+        hit_mesh = i;
+      }
+    }
+  }
+
+  double elapsed = std::chrono::duration<double, std::milli>(
+                       std::chrono::steady_clock::now() - start).count();
+  if (hit_mesh < 0) {
+    std::cout << "Picked nothing in " << elapsed << " ms" << std::endl;
+    return false;
+  }
+
+  *position = glm::vec3(near_point + (far_point - near_point) * closest);
+  std::cout << "Picked triangle " << hit.triangle_ << " of mesh " << hit_mesh
+            << " at (" << (*position)[0] << ", " << (*position)[1] << ", "
+            << (*position)[2] << ") in " << elapsed << " ms" << std::endl;
+  return true;
+}
+
+void GLWidget::DrawScene(QOpenGLShaderProgram *program) {
+  // Positions only passes have no materials
+  if (program == nullptr) {
+    if (backface_culling_) glEnable(GL_CULL_FACE);
+    mesh_buffers_.DrawPositions();
+    chunk_streamer_.Draw();
+    glDisable(GL_CULL_FACE);
+    return;
+  }
+
+  glActiveTexture(GL_TEXTURE15);
+  glBindTexture(GL_TEXTURE_BUFFER, mesh_buffers_.MaterialTexture());
+  glUniform1i(program->uniformLocation("material_buffer"), 15);
+
+  if (backface_culling_) glEnable(GL_CULL_FACE);
+  mesh_buffers_.Draw();
+  chunk_streamer_.Draw();
+  glDisable(GL_CULL_FACE);
+}
+
+void GLWidget::SetSceneView(const glm::mat4x4 &model, const glm::mat4x4 &view,
+                            const glm::mat4x4 &projection) {
+  mesh_buffers_.SetView(model, view, projection, height_, backface_culling_);
+  chunk_streamer_.Update(model, view, projection, height_);
+  // Keeps refining the view while chunks arrive
+  if (chunk_streamer_.Loading()) ScheduleProgressFrame(kAllPasses);
 }
 
 bool GLWidget::LoadSpecularMap(const QString &dir) {
   glBindTexture(GL_TEXTURE_CUBE_MAP, specular_map_);
-  bool res = LoadCubeMap(dir);
+  size_t bytes_copied = 0;
+  bool res = LoadCubeMap(this, dir, compress_textures_ && s3tc_supported_, false,
+                         &bytes_copied);
   glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
-  update();
+  if (res) ReportBytesCopied(dir.toStdString(), bytes_copied);
+  active_specular_map_ = specular_map_;
+  Invalidate(kFinalPass);
   return res;
 }
 
 bool GLWidget::LoadDiffuseMap(const QString &dir) {
   glBindTexture(GL_TEXTURE_CUBE_MAP, diffuse_map_);
-  bool res = LoadCubeMap(dir);
+  size_t bytes_copied = 0;
+  bool res = LoadCubeMap(this, dir, compress_textures_ && s3tc_supported_, false,
+                         &bytes_copied);
   glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
-  update();
+  if (res) ReportBytesCopied(dir.toStdString(), bytes_copied);
+  active_diffuse_map_ = diffuse_map_;
+  Invalidate(kFinalPass);
   return res;
 }
 
 bool GLWidget::LoadWeightedSpecularMap(const QString &dir) {
+  // Mipmapped for the roughness based prefiltered lookups
   glBindTexture(GL_TEXTURE_CUBE_MAP, weighted_specular_map_);
-  bool res = LoadCubeMap(dir);
-
-  // Generate mipmaps for the specular map
-  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-  glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
-
+  size_t bytes_copied = 0;
+  bool res = LoadCubeMap(this, dir, compress_textures_ && s3tc_supported_, true,
+                         &bytes_copied);
   glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
-  update();
+  if (res) ReportBytesCopied(dir.toStdString(), bytes_copied);
+  active_weighted_specular_map_ = weighted_specular_map_;
+  Invalidate(kFinalPass);
   return res;
 }
 
@@ -367,22 +900,16 @@ bool GLWidget::LoadBRDFLUTMap(const QString &filename)
     glBindTexture(GL_TEXTURE_2D, brdfLUT_map_);
 
     std::string path = filename.toUtf8().constData();
-    bool res = LoadImage(path, GL_TEXTURE_2D);
-
-    // Set texture parameters
-    if (res) {
-      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-
-      glGenerateMipmap(GL_TEXTURE_2D); // Generate mipmaps for better quality at different distances
-    }
+    size_t bytes_copied = 0;
+    bool res = LoadTexture(this, path, data_representation::BlockFormat::kBC5,
+                           compress_textures_, &bytes_copied);
+    if (res) ReportBytesCopied(path, bytes_copied);
+    active_brdfLUT_map_ = brdfLUT_map_;
 
     // Unbind the texture
     glBindTexture(GL_TEXTURE_2D, 0);
 
-    update();
+    Invalidate(kFinalPass);
     return res;
 
 }
@@ -392,72 +919,196 @@ bool GLWidget::LoadColorMap(const QString &filename)
     glBindTexture(GL_TEXTURE_2D, color_map_);
 
     std::string path = filename.toUtf8().constData();
-    bool res = LoadImage(path, GL_TEXTURE_2D);
-
-    // Set texture parameters
-    if (res) {
-      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-
-      glGenerateMipmap(GL_TEXTURE_2D); // Generate mipmaps for better quality at different distances
-    }
+    size_t bytes_copied = 0;
+    bool res = LoadTexture(this, path, data_representation::BlockFormat::kBC1,
+                           compress_textures_ && s3tc_supported_, &bytes_copied);
+    if (res) ReportBytesCopied(path, bytes_copied);
+    active_color_map_ = color_map_;
+    active_orm_map_ = orm_map_;
 
     // Unbind the texture
     glBindTexture(GL_TEXTURE_2D, 0);
 
-    update();
+    Invalidate(kAllPasses);
     return res;
 
 }
 
-bool GLWidget::LoadRoughnessMap(const QString &filename)
+bool GLWidget::LoadORMMaps(const QString &occlusion, const QString &roughness,
+                           const QString &metalness)
 {
-    glBindTexture(GL_TEXTURE_2D, roughness_map_);
-    
-    std::string path = filename.toUtf8().constData();
-    bool res = LoadImage(path, GL_TEXTURE_2D);
+    std::string occlusion_path = occlusion.toUtf8().constData();
+    std::string roughness_path = roughness.toUtf8().constData();
+    std::string metalness_path = metalness.toUtf8().constData();
 
-    // Set texture parameters
-    if (res) {
-      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glBindTexture(GL_TEXTURE_2D, orm_map_);
 
-      glGenerateMipmap(GL_TEXTURE_2D); // Generate mipmaps for better quality at different distances
+    // The paths repack the texture when a single map changes, so they are
+    // only kept once they loaded
+    size_t bytes_copied = 0;
+    bool res = LoadORMTexture(this, occlusion_path, roughness_path, metalness_path,
+                              &bytes_copied);
+    if (res) {
+      ReportBytesCopied("ORM maps", bytes_copied);
+      occlusion_path_ = occlusion_path;
+      roughness_path_ = roughness_path;
+      metalness_path_ = metalness_path;
     }
+    active_color_map_ = color_map_;
+    active_orm_map_ = orm_map_;
 
     // Unbind the texture
     glBindTexture(GL_TEXTURE_2D, 0);
-    
-    update();
+
+    Invalidate(kAllPasses);
     return res;
 }
 
+bool GLWidget::LoadOcclusionMap(const QString &filename)
+{
+    return LoadORMMaps(filename, QString::fromStdString(roughness_path_),
+                       QString::fromStdString(metalness_path_));
+}
+
+bool GLWidget::LoadRoughnessMap(const QString &filename)
+{
+    return LoadORMMaps(QString::fromStdString(occlusion_path_), filename,
+                       QString::fromStdString(metalness_path_));
+}
+
 bool GLWidget::LoadMetalnessMap(const QString &filename)
 {
-    glBindTexture(GL_TEXTURE_2D, metalness_map_);
+    return LoadORMMaps(QString::fromStdString(occlusion_path_),
+                       QString::fromStdString(roughness_path_), filename);
+}
 
-    std::string path = filename.toUtf8().constData();
-    bool res = LoadImage(path, GL_TEXTURE_2D);
-    
-    // Set texture parameters
-    if (res) {
-      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+QStringList GLWidget::LoadMaterialLibrary(const QString &dir)
+{
+    if (initialized_) {
+      makeCurrent();
+      ReleaseMaterials();
+    }
+    materials_.Scan(dir.toUtf8().constData());
 
-      glGenerateMipmap(GL_TEXTURE_2D); // Generate mipmaps for better quality at different distances
+    QStringList names;
+    for (size_t i = 0; i < materials_.Size(); ++i)
+      names << QString::fromStdString(materials_.Maps(i).name_);
+    return names;
+}
+
+bool GLWidget::UploadMaterial(const data_representation::MaterialMaps &maps,
+                              data_representation::MaterialLibrary::Resident *resident)
+{
+    bool compress = compress_textures_ && s3tc_supported_;
+    bool res = true;
+    size_t bytes_copied = 0;
+    resident->bytes_ = 0;
+
+    // Materials without a color map are white
+    glGenTextures(1, &resident->color_map_);
+    glBindTexture(GL_TEXTURE_2D, resident->color_map_);
+    if (maps.color_.empty()) {
+      const unsigned char kWhite[4] = {255, 255, 255, 255};
+      glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, kWhite);
+      SetMipmappedSampling(this, 1);
+    } else {
+      res = LoadTexture(this, maps.color_, data_representation::BlockFormat::kBC1, compress,
+                        &bytes_copied);
     }
+    resident->bytes_ += TextureBytes();
+
+    glGenTextures(1, &resident->orm_map_);
+    glBindTexture(GL_TEXTURE_2D, resident->orm_map_);
+    res = res && LoadORMTexture(this, maps.occlusion_, maps.roughness_,
+                                maps.metalness_, &bytes_copied);
+    resident->bytes_ += TextureBytes();
 
-    // Unbind the texture
     glBindTexture(GL_TEXTURE_2D, 0);
+    if (!res) {
+      glDeleteTextures(1, &resident->color_map_);
+      glDeleteTextures(1, &resident->orm_map_);
+      return false;
+    }
+    ReportBytesCopied("material " + maps.name_, bytes_copied);
+    return true;
+}
 
-    update();
-    return res;
+void GLWidget::ReleaseMaterials()
+{
+    for (const auto &resident : materials_.Clear()) {
+      if (resident.color_map_ == active_color_map_ || resident.orm_map_ == active_orm_map_) {
+        active_color_map_ = color_map_;
+        active_orm_map_ = orm_map_;
+      }
+      glDeleteTextures(1, &resident.color_map_);
+      glDeleteTextures(1, &resident.orm_map_);
+    }
+}
+
+QStringList GLWidget::LoadEnvironmentLibrary(const QString &dir)
+{
+    if (initialized_) {
+      makeCurrent();
+      ReleaseEnvironments();
+    }
+    environments_.Scan(dir.toUtf8().constData());
+
+    QStringList names;
+    for (size_t i = 0; i < environments_.Size(); ++i)
+      names << QString::fromStdString(environments_.Maps(i).name_);
+    return names;
+}
+
+void GLWidget::UploadEnvironment(const data_representation::EnvironmentData &data,
+                                 data_representation::EnvironmentLibrary::Resident *resident)
+{
+    resident->bytes_ = 0;
+
+    // Missing maps are left as 0 and fall back to the loaded ones
+    GLuint *cube_maps[3] = {&resident->sky_, &resident->irradiance_,
+                            &resident->specular_prefilter_};
+    const std::vector<data_representation::ImageData> *faces[3] = {
+        &data.sky_, &data.irradiance_, &data.specular_prefilter_};
+    for (int i = 0; i < 3; ++i) {
+      *cube_maps[i] = 0;
+      if (faces[i]->empty()) continue;
+
+      glGenTextures(1, cube_maps[i]);
+      glBindTexture(GL_TEXTURE_CUBE_MAP, *cube_maps[i]);
+      UploadCubeMap(this, *faces[i], cube_maps[i] == &resident->specular_prefilter_);
+      resident->bytes_ += CubeMapBytes();
+    }
+    glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+
+    resident->brdf_lut_ = 0;
+    if (data.has_brdf_lut_) {
+      glGenTextures(1, &resident->brdf_lut_);
+      glBindTexture(GL_TEXTURE_2D, resident->brdf_lut_);
+      UploadTexture(this, data.brdf_lut_);
+      resident->bytes_ += TextureBytes();
+      glBindTexture(GL_TEXTURE_2D, 0);
+    }
+}
+
+void GLWidget::DeleteEnvironment(const data_representation::EnvironmentLibrary::Resident &resident)
+{
+    glDeleteTextures(1, &resident.sky_);
+    glDeleteTextures(1, &resident.irradiance_);
+    glDeleteTextures(1, &resident.specular_prefilter_);
+    glDeleteTextures(1, &resident.brdf_lut_);
+}
+
+void GLWidget::ReleaseEnvironments()
+{
+    for (const auto &resident : environments_.Clear()) DeleteEnvironment(resident);
+
+    if (active_environment_ >= 0) {
+      active_specular_map_ = specular_map_;
+      active_diffuse_map_ = diffuse_map_;
+      active_weighted_specular_map_ = weighted_specular_map_;
+      active_brdfLUT_map_ = brdfLUT_map_;
+      active_environment_ = -1;
+    }
 }
 
 void GLWidget::initializeGL ()
@@ -482,14 +1133,25 @@ void GLWidget::initializeGL ()
   glCullFace(GL_BACK);
   glEnable(GL_DEPTH_TEST);
 
+  // BC1 needs S3TC, BC5 (RGTC) is core since OpenGL 3.0
+  s3tc_supported_ = context()->hasExtension("GL_EXT_texture_compression_s3tc");
+
   //generating needed textures
   glGenTextures(1, &specular_map_);
   glGenTextures(1, &diffuse_map_);
   glGenTextures(1, &weighted_specular_map_);
   glGenTextures(1, &brdfLUT_map_);
   glGenTextures(1, &color_map_);
-  glGenTextures(1, &roughness_map_);
-  glGenTextures(1, &metalness_map_);
+  glGenTextures(1, &orm_map_);
+
+  // The sky is a fullscreen triangle generated from gl_VertexID, its VAO has
+  // no attributes but the core profile still needs one to draw
+  glGenVertexArrays(1, &VAO_sky);
+
+  // Light list and light clusters of the PBS shader
+  CreateBufferTexture(this, GL_RGBA32F, &light_buffer_, &light_texture_);
+  CreateBufferTexture(this, GL_RG32UI, &cluster_grid_buffer_, &cluster_grid_texture_);
+  CreateBufferTexture(this, GL_R32UI, &cluster_lights_buffer_, &cluster_lights_texture_);
 
   //create shader programs
   programs_.push_back(std::make_unique<QOpenGLShaderProgram>());//phong
@@ -541,6 +1203,20 @@ void GLWidget::initializeGL ()
       exit(0);
   }
 
+  // Load depth pre-pass and overdraw shaders
+  depth_program_ = std::make_unique<QOpenGLShaderProgram>();
+  overdraw_program_ = std::make_unique<QOpenGLShaderProgram>();
+  res = LoadProgram(kDepthShaderFiles[0], kDepthShaderFiles[1], depth_program_.get());
+  res = res && LoadProgram(kOverdrawShaderFiles[0], kOverdrawShaderFiles[1], overdraw_program_.get());
+  if (!res) {
+      std::cerr << "Error loading depth pre-pass shaders." << std::endl;
+      exit(0);
+  }
+
+  mesh_buffers_.Initialize(this);
+  chunk_streamer_.Initialize(this);
+  capture_.Initialize(this);
+  render_graph_.Initialize(this);
   LoadModel(".null"); // Load a sphere as default model
   // LoadModel("../models/mercedes-benz-clk430-convertible_ply/Mercedes-Benz CLK 430 Convertible.ply");
 
@@ -551,86 +1227,11 @@ void GLWidget::initializeGL ()
   initialized_ = true;
 }
 
-// Helper to print framebuffer status as string
-static const char* fbStatusString(GLenum status) {
-    switch (status) {
-        case GL_FRAMEBUFFER_COMPLETE: return "GL_FRAMEBUFFER_COMPLETE";
-        case GL_FRAMEBUFFER_UNDEFINED: return "GL_FRAMEBUFFER_UNDEFINED";
-        case GL_FRAMEBUFFER_INCOMPLETE_ATTACHMENT: return "GL_FRAMEBUFFER_INCOMPLETE_ATTACHMENT";
-        case GL_FRAMEBUFFER_INCOMPLETE_MISSING_ATTACHMENT: return "GL_FRAMEBUFFER_INCOMPLETE_MISSING_ATTACHMENT";
-        case GL_FRAMEBUFFER_INCOMPLETE_DRAW_BUFFER: return "GL_FRAMEBUFFER_INCOMPLETE_DRAW_BUFFER";
-        case GL_FRAMEBUFFER_INCOMPLETE_READ_BUFFER: return "GL_FRAMEBUFFER_INCOMPLETE_READ_BUFFER";
-        case GL_FRAMEBUFFER_UNSUPPORTED: return "GL_FRAMEBUFFER_UNSUPPORTED";
-        case GL_FRAMEBUFFER_INCOMPLETE_MULTISAMPLE: return "GL_FRAMEBUFFER_INCOMPLETE_MULTISAMPLE";
-        case GL_FRAMEBUFFER_INCOMPLETE_LAYER_TARGETS: return "GL_FRAMEBUFFER_INCOMPLETE_LAYER_TARGETS";
-        default: return "Unknown";
-    }
-}
-
 void GLWidget::InitializeSSAO() {
-  // Use actual widget size for G-buffer textures
+  // Use actual widget size for the noise texture
   GLint scrWidth = static_cast<GLint>(width_ > 0 ? width_ : 600);
   GLint scrHeight = static_cast<GLint>(height_ > 0 ? height_ : 600);
 
-  // Clean up previous FBO/textures if they exist
-  if (g_buffer_FBO_) glDeleteFramebuffers(1, &g_buffer_FBO_);
-  if (albedo_texture_) glDeleteTextures(1, &albedo_texture_);
-  if (normal_texture_) glDeleteTextures(1, &normal_texture_);
-  if (depth_texture_) glDeleteTextures(1, &depth_texture_);
-
-  // generate textures where info will be stored
-  glGenTextures(1, &albedo_texture_);
-  glBindTexture(GL_TEXTURE_2D, albedo_texture_);
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, scrWidth, scrHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-
-  glGenTextures(1, &normal_texture_);
-  glBindTexture(GL_TEXTURE_2D, normal_texture_);
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, scrWidth, scrHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-
-  glGenTextures(1, &depth_texture_);
-  glBindTexture(GL_TEXTURE_2D, depth_texture_);
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32, scrWidth, scrHeight, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-  GLenum depthError = glGetError();
-  if (depthError != GL_NO_ERROR) {
-      std::cerr << "OpenGL error after depth texture creation: " << depthError << std::endl;
-  }
-
-  // Generate the G-Buffer FBO to attach the textures
-  glGenFramebuffers(1, &g_buffer_FBO_);
-  glBindFramebuffer(GL_FRAMEBUFFER, g_buffer_FBO_);
-
-  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, albedo_texture_, 0);
-  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, normal_texture_, 0);
-  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depth_texture_, 0);
-
-  GLenum drawBuffers[2] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
-  glDrawBuffers(2, drawBuffers);
-
-  // Print FBO status and texture IDs for debugging
-  GLenum fbStatus2 = glCheckFramebufferStatus(GL_FRAMEBUFFER);
-  // std::cerr << "[InitializeSSAO] FBO status after glDrawBuffers: 0x" << std::hex << fbStatus2 << " (" << fbStatusString(fbStatus2) << ")" << std::endl;
-  // std::cerr << "[InitializeSSAO] albedo_texture_=" << albedo_texture_ << ", normal_texture_=" << normal_texture_ << std::endl;
-
-  GLenum fbStatus = glCheckFramebufferStatus(GL_FRAMEBUFFER);
-  if (fbStatus != GL_FRAMEBUFFER_COMPLETE) {
-      qDebug() << "ERROR::FRAMEBUFFER:: Framebuffer is not complete! Status:" << fbStatus << fbStatusString(fbStatus);
-      std::cerr << "ERROR::FRAMEBUFFER:: Framebuffer is not complete! Status: 0x" << std::hex << fbStatus << " (" << fbStatusString(fbStatus) << ")" << std::endl;
-  }
-
-  glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
   // Generate VAO and VBO to render the quad (only once)
   static bool quad_initialized = false;
   if (!quad_initialized) {
@@ -654,40 +1255,6 @@ void GLWidget::InitializeSSAO() {
       std::cerr << "OpenGL error at line " << __LINE__ << ": " << error << std::endl;
   }
 
-  // SSAO texture
-  glGenTextures(1, &ssao_texture_);
-  glBindTexture(GL_TEXTURE_2D, ssao_texture_);
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, scrWidth, scrHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-
-  // Generate the SSAO FBO to attach the texture
-  glGenFramebuffers(1, &ssao_FBO_);
-  glBindFramebuffer(GL_FRAMEBUFFER, ssao_FBO_);
-  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, ssao_texture_, 0);
-  glDrawBuffer(GL_COLOR_ATTACHMENT0);
-
-  glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-  // Create blurred SSAO texture
-  glGenTextures(1, &blurred_ssao_texture_);
-  glBindTexture(GL_TEXTURE_2D, blurred_ssao_texture_);
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, scrWidth, scrHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-
-  // Generate the blurred SSAO FBO to attach the texture
-  glGenFramebuffers(1, &blur_FBO_);
-  glBindFramebuffer(GL_FRAMEBUFFER, blur_FBO_);
-  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, blurred_ssao_texture_, 0);
-  glDrawBuffer(GL_COLOR_ATTACHMENT0);
-
-  glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
   // Create Noise texture for SSAO
   const int noise_size = scrWidth > scrHeight ? scrWidth : scrHeight;
   std::vector<glm::vec3> noise_data(noise_size * noise_size);
@@ -702,6 +1269,7 @@ void GLWidget::InitializeSSAO() {
       noise_data[i] = glm::normalize(noise_vec);
   }
 
+  if (noise_texture_) glDeleteTextures(1, &noise_texture_);
   glGenTextures(1, &noise_texture_);
   glBindTexture(GL_TEXTURE_2D, noise_texture_);
   glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, scrWidth, scrHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, &noise_data[0]);
@@ -731,16 +1299,11 @@ void GLWidget::LoadDefaultMaterials(){
     std::cerr << "Error loading color map." << std::endl;
   }
 
-  // Initialize a Roughness Map
-  bool roughness_loaded = LoadRoughnessMap("../textures/Metal053C_2K-PNG_Roughness.png");
-  if (!roughness_loaded) {
-    std::cerr << "Error loading roughness map." << std::endl;
-  }
-
-  // Initialize a Metalness Map
-  bool metalness_loaded = LoadMetalnessMap("../textures/Metal053C_2K-PNG_Metalness.png");
-  if (!metalness_loaded) {
-    std::cerr << "Error loading metalness map." << std::endl;
+  // Initialize the packed Occlusion/Roughness/Metalness Map
+  bool orm_loaded = LoadORMMaps("", "../textures/Metal053C_2K-PNG_Roughness.png",
+                                "../textures/Metal053C_2K-PNG_Metalness.png");
+  if (!orm_loaded) {
+    std::cerr << "Error loading roughness and metalness maps." << std::endl;
   }
 
   // Initialize a BRDF LUT Map
@@ -765,36 +1328,46 @@ void GLWidget::resizeGL (int w, int h)
     camera_.SetViewport(0, 0, w, h);
     camera_.SetProjection(kFieldOfView, kZNear, kZFar);
     InitializeSSAO(); // Ensure G-buffer matches window size
+    Invalidate(kAllPasses);
 }
 
 void GLWidget::mousePressEvent(QMouseEvent *event) {
+  glm::mat4x4 view = camera_.SetView();
   if (event->button() == Qt::LeftButton) {
     camera_.StartRotating(event->x(), event->y());
   }
   if (event->button() == Qt::RightButton) {
     camera_.StartZooming(event->x(), event->y());
   }
-  update();
+  if (event->button() == Qt::MiddleButton) {
+    glm::vec3 position;
+    Pick(event->x(), event->y(), &position);
+  }
+  if (camera_.SetView() != view) Invalidate(kAllPasses);
 }
 
 void GLWidget::mouseMoveEvent(QMouseEvent *event) {
+  // Moves without a button down leave the camera as it is
+  glm::mat4x4 view = camera_.SetView();
   camera_.SetRotationX(event->y());
   camera_.SetRotationY(event->x());
   camera_.SafeZoom(event->y());
-  update();
+  if (camera_.SetView() != view) Invalidate(kAllPasses);
 }
 
 void GLWidget::mouseReleaseEvent(QMouseEvent *event) {
+  glm::mat4x4 view = camera_.SetView();
   if (event->button() == Qt::LeftButton) {
     camera_.StopRotating(event->x(), event->y());
   }
   if (event->button() == Qt::RightButton) {
     camera_.StopZooming(event->x(), event->y());
   }
-  update();
+  if (camera_.SetView() != view) Invalidate(kAllPasses);
 }
 
 void GLWidget::keyPressEvent(QKeyEvent *event) {
+  glm::mat4x4 view = camera_.SetView();
   if (event->key() == Qt::Key_Up) camera_.Zoom(-1);
   if (event->key() == Qt::Key_Down) camera_.Zoom(1);
 
@@ -829,16 +1402,17 @@ void GLWidget::keyPressEvent(QKeyEvent *event) {
       final_program_.reset();
       final_program_ = std::make_unique<QOpenGLShaderProgram>();
       LoadProgram(kFinalShaderFiles[0], kFinalShaderFiles[1], final_program_.get());
+      Invalidate(kAllPasses);
   }
 
-  update();
+  if (camera_.SetView() != view) Invalidate(kAllPasses);
 }
 
 void GLWidget::renderMesh(glm::mat4x4 model, glm::mat4x4 view, glm::mat4x4 projection, glm::mat3 normal)
 {
   GLint projection_location, view_location, model_location,
   normal_matrix_location, specular_map_location, diffuse_map_location, brdfLUT_map_location,
-  weighted_specular_map_location, fresnel_location, color_map_location, roughness_map_location, metalness_map_location,
+  weighted_specular_map_location, fresnel_location, color_map_location, orm_map_location,
   current_text_location, light_location, camera_location, roughness_location, metalness_location, 
   use_textures_location, apply_gamma_correction_location, albedo_location;
 
@@ -854,8 +1428,7 @@ void GLWidget::renderMesh(glm::mat4x4 model, glm::mat4x4 view, glm::mat4x4 proje
   weighted_specular_map_location  = programs_[currentShader_]->uniformLocation("weighted_specular_map");
   brdfLUT_map_location            = programs_[currentShader_]->uniformLocation("brdfLUT_map");
   color_map_location              = programs_[currentShader_]->uniformLocation("color_map");
-  roughness_map_location          = programs_[currentShader_]->uniformLocation("roughness_map");
-  metalness_map_location          = programs_[currentShader_]->uniformLocation("metalness_map");
+  orm_map_location                = programs_[currentShader_]->uniformLocation("orm_map");
   current_text_location           = programs_[currentShader_]->uniformLocation("current_texture");
   fresnel_location                = programs_[currentShader_]->uniformLocation("fresnel");
   light_location                  = programs_[currentShader_]->uniformLocation("light");
@@ -874,39 +1447,34 @@ void GLWidget::renderMesh(glm::mat4x4 model, glm::mat4x4 view, glm::mat4x4 proje
 
   // Specular CubeMap
   glActiveTexture(GL_TEXTURE0);
-  glBindTexture(GL_TEXTURE_CUBE_MAP, specular_map_);
+  glBindTexture(GL_TEXTURE_CUBE_MAP, active_specular_map_);
   glUniform1i(specular_map_location, 0);
 
   // Diffuse CubeMap
   glActiveTexture(GL_TEXTURE1);
-  glBindTexture(GL_TEXTURE_CUBE_MAP, diffuse_map_);
+  glBindTexture(GL_TEXTURE_CUBE_MAP, active_diffuse_map_);
   glUniform1i(diffuse_map_location, 1);
 
   // Weighted Specular CubeMap
   glActiveTexture(GL_TEXTURE6);
-  glBindTexture(GL_TEXTURE_CUBE_MAP, weighted_specular_map_);
+  glBindTexture(GL_TEXTURE_CUBE_MAP, active_weighted_specular_map_);
   glUniform1i(weighted_specular_map_location, 6);
 
   // BRDF LUT Texture
   glActiveTexture(GL_TEXTURE2);
-  glBindTexture(GL_TEXTURE_2D, brdfLUT_map_);
+  glBindTexture(GL_TEXTURE_2D, active_brdfLUT_map_);
   glUniform1i(brdfLUT_map_location, 2);
 
   // Textures
   // Color Map (Texture unit 3)
   glActiveTexture(GL_TEXTURE3);
-  glBindTexture(GL_TEXTURE_2D, color_map_);
+  glBindTexture(GL_TEXTURE_2D, active_color_map_);
   glUniform1i(color_map_location, 3);
 
-  // Roughness Map (Texture unit 4)
+  // Occlusion/Roughness/Metalness Map (Texture unit 4)
   glActiveTexture(GL_TEXTURE4);
-  glBindTexture(GL_TEXTURE_2D, roughness_map_);
-  glUniform1i(roughness_map_location, 4);
-
-  // Metalness Map (Texture unit 5)
-  glActiveTexture(GL_TEXTURE5);
-  glBindTexture(GL_TEXTURE_2D, metalness_map_);
-  glUniform1i(metalness_map_location, 5);
+  glBindTexture(GL_TEXTURE_2D, active_orm_map_);
+  glUniform1i(orm_map_location, 4);
 
   glUniform1i(current_text_location, currentTexture_);
   glUniform3f(fresnel_location, fresnel_[0], fresnel_[1], fresnel_[2]);
@@ -918,58 +1486,47 @@ void GLWidget::renderMesh(glm::mat4x4 model, glm::mat4x4 view, glm::mat4x4 proje
   glUniform1i(use_textures_location, useTextures_ ? 1 : 0);
   glUniform1i(apply_gamma_correction_location, applyGammaCorrection_ ? 1 : 0);
 
-  // Bind the VAO and draw the elements
-  glBindVertexArray(VAO);
-  glDrawElements(GL_TRIANGLES, mesh_->faces_.size(), GL_UNSIGNED_INT, (GLvoid*)0);
-  glBindVertexArray(0);
+  // Clustered point and spot lights
+  if (currentShader_ == 3) BindLightClusters(programs_[currentShader_].get(), view);
+
+  // Draw every instance of the scene meshes
+  DrawScene(programs_[currentShader_].get());
 }
 
 
-void GLWidget::renderSkybox(glm::mat4x4 model, glm::mat4x4 view, glm::mat4x4 projection, glm::mat3 normal) 
+void GLWidget::renderSkybox(glm::mat4x4 view, glm::mat4x4 projection)
 {
-  GLint projection_location, view_location, model_location,
-  normal_matrix_location, specular_map_location;
-
-  //model = camera_.SetIdentity();
-
-  // Set depth function for skybox
-  GLint oldDepthFunc;
-  glGetIntegerv(GL_DEPTH_FUNC, &oldDepthFunc);
-  
+  // Rays from the camera through the far plane, without the camera
+  // translation so that the sky looks infinitely far away
+  glm::mat4x4 sky_view = view;
+  sky_view[3] = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+  glm::mat4x4 inverse_view_projection = glm::inverse(projection * sky_view);
+
+  // The triangle lies at depth 1.0, the pixels covered by the mesh fail the
+  // depth test before shading
   glDepthFunc(GL_LEQUAL);
 
-  programs_[programs_.size()-1]->bind();
-
-  projection_location     = programs_[programs_.size()-1]->uniformLocation("projection");
-  view_location           = programs_[programs_.size()-1]->uniformLocation("view");
-  model_location          = programs_[programs_.size()-1]->uniformLocation("model");
-  normal_matrix_location  = programs_[programs_.size()-1]->uniformLocation("normal_matrix");
-  specular_map_location   = programs_[programs_.size()-1]->uniformLocation("specular_map");
-
-
-  glUniformMatrix4fv(projection_location, 1, GL_FALSE, &projection[0][0]);
-  glUniformMatrix4fv(view_location, 1, GL_FALSE, &view[0][0]);
-  glUniformMatrix4fv(model_location, 1, GL_FALSE, &model[0][0]);
-  glUniformMatrix3fv(normal_matrix_location, 1, GL_FALSE, &normal[0][0]);
+  QOpenGLShaderProgram *program = programs_[programs_.size() - 1].get();
+  program->bind();
+  glUniformMatrix4fv(program->uniformLocation("inverse_view_projection"), 1, GL_FALSE, &inverse_view_projection[0][0]);
 
   glActiveTexture(GL_TEXTURE0);
-  glBindTexture(GL_TEXTURE_CUBE_MAP, specular_map_);
-  programs_[programs_.size() - 1]->setUniformValue("specular_map", 0);
+  glBindTexture(GL_TEXTURE_CUBE_MAP, active_specular_map_);
+  glUniform1i(program->uniformLocation("specular_map"), 0);
 
-  // Bind the VAO and draw the elements
   glBindVertexArray(VAO_sky);
-  glDrawElements(GL_TRIANGLES, skyFaces_.size(), GL_UNSIGNED_INT, (GLvoid*)0);
+  glDrawArrays(GL_TRIANGLES, 0, 3);
   glBindVertexArray(0);
-  programs_[programs_.size() - 1]->release();
-
-  // Restore original depth function
-  glDepthFunc(oldDepthFunc);
+  program->release();
 
+  glDepthFunc(GL_LESS);
 }
 
 void GLWidget::renderDefault ()
 {
-    glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
+    // The overdraw view adds up from black
+    if (show_overdraw_) glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    else glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
     if (initialized_) {
@@ -987,17 +1544,63 @@ void GLWidget::renderDefault ()
                 normal[i][j] = t[i][j];
          normal = glm::transpose(glm::inverse(normal));
 
-        if (mesh_ != nullptr) {
-            renderMesh(model, view, projection, normal);
+        if (scene_.NodeCount() > 0 || chunk_streamer_.IsOpen() || ply_streaming_) {
+            SetSceneView(model, view, projection);
 
-            if(skyVisible_) {
-                renderSkybox(model, view, projection, normal);
+            // Only the fragments that end up visible are shaded after the pre-pass
+            if (depth_prepass_) {
+                renderDepthPrepass(model, view, projection);
+                glDepthFunc(GL_EQUAL);
+                glDepthMask(GL_FALSE);
+            }
+
+            if (show_overdraw_) {
+                renderOverdraw(model, view, projection);
+            } else {
+                renderMesh(model, view, projection, normal);
+            }
+
+            glDepthFunc(GL_LESS);
+            glDepthMask(GL_TRUE);
+
+            if(skyVisible_ && !show_overdraw_) {
+                renderSkybox(view, projection);
             }
         }
 
     }
 }
 
+void GLWidget::renderDepthPrepass(glm::mat4x4 model, glm::mat4x4 view, glm::mat4x4 projection)
+{
+  glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+
+  depth_program_->bind();
+  glUniformMatrix4fv(depth_program_->uniformLocation("projection"), 1, GL_FALSE, &projection[0][0]);
+  glUniformMatrix4fv(depth_program_->uniformLocation("view"), 1, GL_FALSE, &view[0][0]);
+  glUniformMatrix4fv(depth_program_->uniformLocation("model"), 1, GL_FALSE, &model[0][0]);
+
+  DrawScene(nullptr);
+
+  glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+}
+
+void GLWidget::renderOverdraw(glm::mat4x4 model, glm::mat4x4 view, glm::mat4x4 projection)
+{
+  glEnable(GL_BLEND);
+  glBlendFunc(GL_ONE, GL_ONE);
+
+  overdraw_program_->bind();
+  glUniformMatrix4fv(overdraw_program_->uniformLocation("projection"), 1, GL_FALSE, &projection[0][0]);
+  glUniformMatrix4fv(overdraw_program_->uniformLocation("view"), 1, GL_FALSE, &view[0][0]);
+  glUniformMatrix4fv(overdraw_program_->uniformLocation("model"), 1, GL_FALSE, &model[0][0]);
+  glUniform1f(overdraw_program_->uniformLocation("increment"), kOverdrawIncrement);
+
+  DrawScene(nullptr);
+
+  glDisable(GL_BLEND);
+}
+
 void GLWidget::renderWithSSAO ()
 {
     glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
@@ -1020,316 +1623,684 @@ void GLWidget::renderWithSSAO ()
               normal[i][j] = t[i][j];
       normal = glm::transpose(glm::inverse(normal));
 
-      // Activate Textures
-      glActiveTexture(GL_TEXTURE0); glBindTexture(GL_TEXTURE_2D, albedo_texture_);
-      glActiveTexture(GL_TEXTURE1); glBindTexture(GL_TEXTURE_2D, normal_texture_);
-      glActiveTexture(GL_TEXTURE2); glBindTexture(GL_TEXTURE_2D, depth_texture_);
-      glActiveTexture(GL_TEXTURE3); glBindTexture(GL_TEXTURE_2D, noise_texture_);
-      glActiveTexture(GL_TEXTURE4); glBindTexture(GL_TEXTURE_2D, ssao_texture_);
-      glActiveTexture(GL_TEXTURE5); glBindTexture(GL_TEXTURE_2D, blurred_ssao_texture_);
-      glActiveTexture(GL_TEXTURE6); glBindTexture(GL_TEXTURE_2D, color_map_);
+      // The inputs of each pass, chained to the ones of the pass it reads
+      // from. The passes whose inputs changed or that were marked stale run,
+      // and the graph runs the ones reading their targets, the others keep
+      // their targets from the previous frame
+      uint64_t gbuffer_key = HashInputs(kFnvOffset, projection, view, model, width_, height_,
+                                        mesh_version_, albedo_, roughness_, metalness_,
+                                        useTextures_, backface_culling_, active_color_map_,
+                                        active_orm_map_);
+      uint64_t ssao_key = HashInputs(gbuffer_key, ssao_num_directions_,
+                                     ssao_samples_per_direction_, ssao_sample_radius_,
+                                     ao_algorithm_, use_randomization_, bias_angle_);
+      uint64_t blur_key = HashInputs(ssao_key, blur_type_, blur_radius_, normal_threshold_,
+                                     depth_threshold_);
+      unsigned passes = dirty_passes_;
+      if (gbuffer_key != gbuffer_key_) passes |= kGBufferPass;
+      if (ssao_key != ssao_key_) passes |= kSsaoPass;
+      if (blur_key != blur_key_) passes |= kBlurPass;
+      gbuffer_key_ = gbuffer_key;
+      ssao_key_ = ssao_key;
+      blur_key_ = blur_key;
+      dirty_passes_ = 0;
+
+      render_graph_.Begin(width_, height_);
+      int albedo_target = render_graph_.AddTarget("albedo", gbuffer_formats_.albedo_);
+      int normal_target = render_graph_.AddTarget("normal", gbuffer_formats_.normal_);
+      int material_target = render_graph_.AddTarget("material", gbuffer_formats_.material_);
+      int depth_target = render_graph_.AddTarget("depth", gbuffer_formats_.depth_);
+      int ssao_target = render_graph_.AddTarget("ssao", gbuffer_formats_.ao_);
+      int blurred_ssao_target = render_graph_.AddTarget("blurred_ssao", gbuffer_formats_.ao_);
+      const bool kOctahedral = data_visualization::OctahedralNormals(gbuffer_formats_.normal_);
+      // Read back after the frame
+      if (capture_.Active() && capture_source_ > 0) {
+        const int kCaptureTargets[] = {albedo_target, normal_target, material_target,
+                                       depth_target, ssao_target, blurred_ssao_target};
+        render_graph_.Keep(kCaptureTargets[capture_source_ - 1]);
+      }
 
       // FIRST PASS: G-Buffer generation
-      glBindFramebuffer(GL_FRAMEBUFFER, g_buffer_FBO_);
-      // Check framebuffer status after binding
-      // GLenum fbStatus = glCheckFramebufferStatus(GL_FRAMEBUFFER);
-      // if (fbStatus != GL_FRAMEBUFFER_COMPLETE) {
-      //     std::cerr << "[renderWithSSAO] FBO incomplete! Status: 0x" << std::hex << fbStatus << " (" << fbStatusString(fbStatus) << ")" << std::endl;
-      // }
-
-      glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-      glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-      if (mesh_ != nullptr) {
-          GLint projection_location, view_location, model_location, normal_matrix_location, albedo_location, color_map_location,
-          use_textures_location;
-
-          gbuffer_program_->bind();
-
-          projection_location     = gbuffer_program_->uniformLocation("projection");
-          view_location           = gbuffer_program_->uniformLocation("view");
-          model_location          = gbuffer_program_->uniformLocation("model");
-          normal_matrix_location  = gbuffer_program_->uniformLocation("normal_matrix");
-          albedo_location         = gbuffer_program_->uniformLocation("albedo");
-          color_map_location      = gbuffer_program_->uniformLocation("color_map");
-          use_textures_location   = gbuffer_program_->uniformLocation("use_textures");
-
-          glUniformMatrix4fv(projection_location, 1, GL_FALSE, &projection[0][0]);
-          glUniformMatrix4fv(view_location, 1, GL_FALSE, &view[0][0]);
-          glUniformMatrix4fv(model_location, 1, GL_FALSE, &model[0][0]);
-          glUniformMatrix3fv(normal_matrix_location, 1, GL_FALSE, &normal[0][0]);
-          glUniform3f(albedo_location, albedo_[0], albedo_[1], albedo_[2]);
-          glUniform1i(color_map_location, 6);
-          glUniform1i(use_textures_location, useTextures_ ? 1 : 0);
-
-          glBindVertexArray(VAO);
-          glDrawElements(GL_TRIANGLES, mesh_->faces_.size(), GL_UNSIGNED_INT, (GLvoid*)0);
-          glBindVertexArray(0);
-      }
+      render_graph_.AddPass("gbuffer", {}, {albedo_target, normal_target, material_target, depth_target},
+                            !(passes & kGBufferPass), [&]() {
+        glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        if (scene_.NodeCount() > 0 || chunk_streamer_.IsOpen() || ply_streaming_) {
+            SetSceneView(model, view, projection);
+
+            GLint projection_location, view_location, model_location, normal_matrix_location, albedo_location, color_map_location,
+            orm_map_location, roughness_location, metalness_location, use_textures_location;
+
+            gbuffer_program_->bind();
+
+            projection_location     = gbuffer_program_->uniformLocation("projection");
+            view_location           = gbuffer_program_->uniformLocation("view");
+            model_location          = gbuffer_program_->uniformLocation("model");
+            normal_matrix_location  = gbuffer_program_->uniformLocation("normal_matrix");
+            albedo_location         = gbuffer_program_->uniformLocation("albedo");
+            color_map_location      = gbuffer_program_->uniformLocation("color_map");
+            orm_map_location        = gbuffer_program_->uniformLocation("orm_map");
+            roughness_location      = gbuffer_program_->uniformLocation("roughness");
+            metalness_location      = gbuffer_program_->uniformLocation("metalness");
+            use_textures_location   = gbuffer_program_->uniformLocation("use_textures");
+
+            glActiveTexture(GL_TEXTURE6); glBindTexture(GL_TEXTURE_2D, active_color_map_);
+            glActiveTexture(GL_TEXTURE7); glBindTexture(GL_TEXTURE_2D, active_orm_map_);
+
+            glUniformMatrix4fv(projection_location, 1, GL_FALSE, &projection[0][0]);
+            glUniformMatrix4fv(view_location, 1, GL_FALSE, &view[0][0]);
+            glUniformMatrix4fv(model_location, 1, GL_FALSE, &model[0][0]);
+            glUniformMatrix3fv(normal_matrix_location, 1, GL_FALSE, &normal[0][0]);
+            glUniform3f(albedo_location, albedo_[0], albedo_[1], albedo_[2]);
+            glUniform1i(color_map_location, 6);
+            glUniform1i(orm_map_location, 7);
+            glUniform1f(roughness_location, roughness_);
+            glUniform1f(metalness_location, metalness_);
+            glUniform1i(use_textures_location, useTextures_ ? 1 : 0);
+            glUniform1i(gbuffer_program_->uniformLocation("octahedral_normals"), kOctahedral ? 1 : 0);
+
+            DrawScene(gbuffer_program_.get());
+        }
+      });
 
       // PASS 2: SSAO calculation → Pure AO output
-      glBindFramebuffer(GL_FRAMEBUFFER, ssao_FBO_);
-      glViewport(0, 0, width_, height_);
-      glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
-      glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-      ssao_program_->bind();
-
-      // Textures
-      glUniform1i(ssao_program_->uniformLocation("normal_texture"), 1);
-      glUniform1i(ssao_program_->uniformLocation("depth_texture"), 2);
-      glUniform1i(ssao_program_->uniformLocation("noise_texture"), 3);
-
-      // Set SSAO parameters
-      glUniform1i(ssao_program_->uniformLocation("num_directions"), ssao_num_directions_);
-      glUniform1i(ssao_program_->uniformLocation("samples_per_direction"), ssao_samples_per_direction_);
-      glUniform1f(ssao_program_->uniformLocation("sample_radius"), ssao_sample_radius_);
-      glUniformMatrix4fv(ssao_program_->uniformLocation("projection"), 1, GL_FALSE, &projection[0][0]);
-      glUniform2f(ssao_program_->uniformLocation("viewport_size"), width_, height_);
-
-      glUniform2f(ssao_program_->uniformLocation("noise_scale"), width_/4.0f, height_/4.0f);
-      glUniform1f(ssao_program_->uniformLocation("zNear"), static_cast<float>(kZNear));
-      glUniform1f(ssao_program_->uniformLocation("zFar"), static_cast<float>(kZFar));
-      glUniform1f(ssao_program_->uniformLocation("fov"), static_cast<float>(kFieldOfView));
-      glUniform1i(ssao_program_->uniformLocation("ao_algorithm"), ao_algorithm_);
-      glUniform1i(ssao_program_->uniformLocation("use_randomization"), use_randomization_ ? 1 : 0);
-      glUniform1f(ssao_program_->uniformLocation("bias_angle"), bias_angle_);
-
-      glBindVertexArray(quad_VAO);
-      glDrawArrays(GL_TRIANGLES, 0, 6);
-      glBindVertexArray(0);
-      ssao_program_->release();
+      render_graph_.AddPass("ssao", {normal_target, depth_target}, {ssao_target},
+                            !(passes & kSsaoPass), [&]() {
+        glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+
+        ssao_program_->bind();
+
+        // Textures
+        glActiveTexture(GL_TEXTURE6); glBindTexture(GL_TEXTURE_2D, noise_texture_);
+        glUniform1i(ssao_program_->uniformLocation("normal_texture"), render_graph_.Unit(normal_target));
+        glUniform1i(ssao_program_->uniformLocation("depth_texture"), render_graph_.Unit(depth_target));
+        glUniform1i(ssao_program_->uniformLocation("noise_texture"), 6);
+        glUniform1i(ssao_program_->uniformLocation("octahedral_normals"), kOctahedral ? 1 : 0);
+
+        // Set SSAO parameters
+        glUniform1i(ssao_program_->uniformLocation("num_directions"), ssao_num_directions_);
+        glUniform1i(ssao_program_->uniformLocation("samples_per_direction"), ssao_samples_per_direction_);
+        glUniform1f(ssao_program_->uniformLocation("sample_radius"), ssao_sample_radius_);
+        glUniformMatrix4fv(ssao_program_->uniformLocation("projection"), 1, GL_FALSE, &projection[0][0]);
+        glUniform2f(ssao_program_->uniformLocation("viewport_size"), width_, height_);
+
+        glUniform2f(ssao_program_->uniformLocation("noise_scale"), width_/4.0f, height_/4.0f);
+        glUniform1f(ssao_program_->uniformLocation("zNear"), static_cast<float>(kZNear));
+        glUniform1f(ssao_program_->uniformLocation("zFar"), static_cast<float>(kZFar));
+        glUniform1f(ssao_program_->uniformLocation("fov"), static_cast<float>(kFieldOfView));
+        glUniform1i(ssao_program_->uniformLocation("ao_algorithm"), ao_algorithm_);
+        glUniform1i(ssao_program_->uniformLocation("use_randomization"), use_randomization_ ? 1 : 0);
+        glUniform1f(ssao_program_->uniformLocation("bias_angle"), bias_angle_);
+
+        glBindVertexArray(quad_VAO);
+        glDrawArrays(GL_TRIANGLES, 0, 6);
+        glBindVertexArray(0);
+        ssao_program_->release();
+      });
 
       // PASS 3: Blur SSAO texture
-      glBindFramebuffer(GL_FRAMEBUFFER, blur_FBO_);
-      glViewport(0, 0, width_, height_);
-      glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
-      glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-      blur_program_->bind();
-
-      // Send textures to the shader
-      glUniform1i(blur_program_->uniformLocation("ssao_texture"), 4);
-      glUniform1i(blur_program_->uniformLocation("normal_texture"), 1);
-      glUniform1i(blur_program_->uniformLocation("depth_texture"), 2);
-
-      glUniform2f(blur_program_->uniformLocation("viewport_size"), width_, height_);
-      glUniform1i(blur_program_->uniformLocation("blur_type"), blur_type_);
-      glUniform1f(blur_program_->uniformLocation("blur_radius"), blur_radius_);
-      glUniform1f(blur_program_->uniformLocation("normal_threshold"), normal_threshold_);
-      glUniform1f(blur_program_->uniformLocation("depth_threshold"), depth_threshold_);
-
-      glBindVertexArray(quad_VAO);
-      glDrawArrays(GL_TRIANGLES, 0, 6);
-      glBindVertexArray(0);
-      blur_program_->release();
-
-      // FINAL STEP: Render to the screen
-      GLuint albedo_texture_location, normal_texture_location, depth_texture_location, ssao_texture_location, ao_strength_location,
-      ssao_render_mode_location, z_near_location, z_far_location, use_blur_location, blur_ssao_texture_location;
-
-      glBindFramebuffer(GL_FRAMEBUFFER, defaultFBO);
-      glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
-      glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-      final_program_->bind();
-      albedo_texture_location         = final_program_->uniformLocation("albedo_texture");
-      normal_texture_location         = final_program_->uniformLocation("normal_texture");
-      depth_texture_location          = final_program_->uniformLocation("depth_texture");
-      ssao_texture_location           = final_program_->uniformLocation("ssao_texture");
-      ssao_render_mode_location       = final_program_->uniformLocation("ssao_render_mode");
-      z_near_location                 = final_program_->uniformLocation("zNear");
-      z_far_location                  = final_program_->uniformLocation("zFar");
-      use_blur_location               = final_program_->uniformLocation("use_blurred_ssao");
-      blur_ssao_texture_location      = final_program_->uniformLocation("blurred_ssao_texture");
-      ao_strength_location            = final_program_->uniformLocation("ao_strength");
-
-      glUniform1i(albedo_texture_location, 0);      // albedo texture
-      glUniform1i(normal_texture_location, 1);      // normal texture
-      glUniform1i(depth_texture_location, 2);       // depth texture
-      glUniform1i(ssao_texture_location, 4);        // SSAO texture
-      glUniform1i(blur_ssao_texture_location, 5);   // Blur SSAO texture
-      glUniform1i(ssao_render_mode_location, currentSSAORenderMode_);
-      glUniform1i(use_blur_location, use_blur_ ? 1 : 0);
-      glUniform1f(ao_strength_location, ao_strength_);
-
-      glUniform1f(z_near_location, static_cast<float>(kZNear));
-      glUniform1f(z_far_location, static_cast<float>(kZFar));
-      
-      glBindVertexArray(quad_VAO);
-      glDrawArrays(GL_TRIANGLES, 0, 6);
-      glBindVertexArray(0);
-      final_program_->release();
+      render_graph_.AddPass("blur", {ssao_target, normal_target, depth_target}, {blurred_ssao_target},
+                            !(passes & kBlurPass), [&]() {
+        glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+
+        blur_program_->bind();
+
+        // Send textures to the shader
+        glUniform1i(blur_program_->uniformLocation("ssao_texture"), render_graph_.Unit(ssao_target));
+        glUniform1i(blur_program_->uniformLocation("normal_texture"), render_graph_.Unit(normal_target));
+        glUniform1i(blur_program_->uniformLocation("depth_texture"), render_graph_.Unit(depth_target));
+        glUniform1i(blur_program_->uniformLocation("octahedral_normals"), kOctahedral ? 1 : 0);
+
+        glUniform2f(blur_program_->uniformLocation("viewport_size"), width_, height_);
+        glUniform1i(blur_program_->uniformLocation("blur_type"), blur_type_);
+        glUniform1f(blur_program_->uniformLocation("blur_radius"), blur_radius_);
+        glUniform1f(blur_program_->uniformLocation("normal_threshold"), normal_threshold_);
+        glUniform1f(blur_program_->uniformLocation("depth_threshold"), depth_threshold_);
+
+        glBindVertexArray(quad_VAO);
+        glDrawArrays(GL_TRIANGLES, 0, 6);
+        glBindVertexArray(0);
+        blur_program_->release();
+      });
+
+      // FINAL STEP: Render to the screen. Only what the visualization mode
+      // shows is read, the passes computing the rest are culled
+      int lighting_model = currentShader_ == 3 ? 1 : currentShader_ == 4 ? 2 : 0;
+      int ao_target = use_blur_ ? blurred_ssao_target : ssao_target;
+      std::vector<int> final_reads;
+      switch (currentSSAORenderMode_) {
+        case 0: final_reads = {normal_target}; break;
+        case 2: final_reads = {depth_target}; break;
+        case 3: final_reads = {ssao_target}; break;
+        case 4: final_reads = {blurred_ssao_target}; break;
+        case 5:
+          if (lighting_model == 0)
+            final_reads = {albedo_target, ao_target};
+          else
+            final_reads = {albedo_target, normal_target, material_target, depth_target, ao_target};
+          break;
+        default: final_reads = {albedo_target};
+      }
+
+      render_graph_.AddPass("final", final_reads, {}, false, [&]() {
+        GLuint albedo_texture_location, normal_texture_location, depth_texture_location, ssao_texture_location, ao_strength_location,
+        ssao_render_mode_location, z_near_location, z_far_location, use_blur_location, blur_ssao_texture_location;
+
+        glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        final_program_->bind();
+        albedo_texture_location         = final_program_->uniformLocation("albedo_texture");
+        normal_texture_location         = final_program_->uniformLocation("normal_texture");
+        depth_texture_location          = final_program_->uniformLocation("depth_texture");
+        ssao_texture_location           = final_program_->uniformLocation("ssao_texture");
+        ssao_render_mode_location       = final_program_->uniformLocation("ssao_render_mode");
+        z_near_location                 = final_program_->uniformLocation("zNear");
+        z_far_location                  = final_program_->uniformLocation("zFar");
+        use_blur_location               = final_program_->uniformLocation("use_blurred_ssao");
+        blur_ssao_texture_location      = final_program_->uniformLocation("blurred_ssao_texture");
+        ao_strength_location            = final_program_->uniformLocation("ao_strength");
+
+        glUniform1i(albedo_texture_location, render_graph_.Unit(albedo_target));
+        glUniform1i(normal_texture_location, render_graph_.Unit(normal_target));
+        glUniform1i(depth_texture_location, render_graph_.Unit(depth_target));
+        glUniform1i(ssao_texture_location, render_graph_.Unit(ssao_target));
+        glUniform1i(blur_ssao_texture_location, render_graph_.Unit(blurred_ssao_target));
+        glUniform1i(ssao_render_mode_location, currentSSAORenderMode_);
+        glUniform1i(use_blur_location, use_blur_ ? 1 : 0);
+        glUniform1f(ao_strength_location, ao_strength_);
+
+        glUniform1f(z_near_location, static_cast<float>(kZNear));
+        glUniform1f(z_far_location, static_cast<float>(kZFar));
+
+        // Deferred shading of the final composition with the PBS and IBL-PBS shaders
+        glm::mat4x4 inverse_view_projection = glm::inverse(projection * view);
+        glm::mat4x4 inverse_view = glm::inverse(view);
+        glm::vec3 camera_position = camera_.GetPosition();
+
+        glActiveTexture(GL_TEXTURE9); glBindTexture(GL_TEXTURE_CUBE_MAP, active_diffuse_map_);
+        glActiveTexture(GL_TEXTURE10); glBindTexture(GL_TEXTURE_CUBE_MAP, active_weighted_specular_map_);
+        glActiveTexture(GL_TEXTURE11); glBindTexture(GL_TEXTURE_2D, active_brdfLUT_map_);
+
+        glUniform1i(final_program_->uniformLocation("material_texture"), render_graph_.Unit(material_target));
+        glUniform1i(final_program_->uniformLocation("octahedral_normals"), kOctahedral ? 1 : 0);
+        glUniform1i(final_program_->uniformLocation("diffuse_map"), 9);
+        glUniform1i(final_program_->uniformLocation("weighted_specular_map"), 10);
+        glUniform1i(final_program_->uniformLocation("brdfLUT_map"), 11);
+        glUniform1i(final_program_->uniformLocation("lighting_model"), lighting_model);
+        glUniformMatrix4fv(final_program_->uniformLocation("inverse_view_projection"), 1, GL_FALSE, &inverse_view_projection[0][0]);
+        glUniformMatrix4fv(final_program_->uniformLocation("inverse_view"), 1, GL_FALSE, &inverse_view[0][0]);
+        glUniform3f(final_program_->uniformLocation("camera_position"), camera_position.x, camera_position.y, camera_position.z);
+        glUniform3f(final_program_->uniformLocation("fresnel"), fresnel_[0], fresnel_[1], fresnel_[2]);
+        glUniform1i(final_program_->uniformLocation("gamma_correction"), applyGammaCorrection_ ? 1 : 0);
+        if (lighting_model == 1) BindLightClusters(final_program_.get(), view);
+
+        glBindVertexArray(quad_VAO);
+        glDrawArrays(GL_TRIANGLES, 0, 6);
+        glBindVertexArray(0);
+        final_program_->release();
+      });
+
+      render_graph_.Execute(defaultFBO);
     }
 }
 
 void GLWidget::paintGL ()
 {
+  UpdatePlyLoad();
+  UpdateLods();
+  UpdateAmbientOcclusion();
+
   if (SSAO_enabled_) {
       renderWithSSAO();
   }
   else {
     renderDefault();
   }
+
+  CaptureFrame();
 }
 
-void GLWidget::SetReflection(bool set) {
-    if(set) currentShader_ = 2;
+void GLWidget::CaptureFrame() {
+  capture_.Update();
+  // The intermediates of the last frame with SSAO, kept for the capture
+  const char *kCaptureTargets[] = {"albedo", "normal", "material", "depth", "ssao", "blurred_ssao"};
+  data_visualization::RenderTargetFormat format;
+  GLuint texture = capture_source_ > 0
+                       ? render_graph_.Texture(kCaptureTargets[capture_source_ - 1], &format)
+                       : 0;
+  if (texture != 0)
+    capture_.ReadTexture(texture, format, width_, height_);
+  else
+    capture_.ReadFramebuffer(defaultFramebufferObject(), width_, height_);
+  if (capture_.Recording() || capture_.Pending()) update();
+}
+
+void GLWidget::Invalidate(unsigned passes) {
+  dirty_passes_ |= passes;
+  // Qt merges the requests into a single frame at the next refresh
+  update();
+}
+
+void GLWidget::ScheduleProgressFrame(unsigned passes) {
+  dirty_passes_ |= passes;
+  if (progress_frame_) return;
+
+  progress_frame_ = true;
+  QTimer::singleShot(kProgressFrameInterval, this, [this]() {
+    progress_frame_ = false;
     update();
+  });
+}
+
+void GLWidget::SetCaptureSource(int source) {
+  capture_source_ = source;
+}
+
+void GLWidget::SetGBufferFormats(const data_visualization::GBufferFormats &formats) {
+  gbuffer_formats_ = formats;
+  data_visualization::ReportGBuffer(gbuffer_formats_, int(width_), int(height_),
+                                    ssao_num_directions_ * ssao_samples_per_direction_,
+                                    (2 * int(blur_radius_) + 1) * (2 * int(blur_radius_) + 1));
+  Invalidate(kAllPasses);
+}
+
+void GLWidget::SaveScreenshot(const QString &filename) {
+  capture_.Screenshot(filename.toStdString());
+  Invalidate(kFinalPass);
+}
+
+void GLWidget::StartRecording(const QString &prefix, bool raw) {
+  capture_.Start(prefix.toStdString(), raw ? data_visualization::CaptureEncoding::kRaw
+                                           : data_visualization::CaptureEncoding::kPng);
+  Invalidate(kFinalPass);
+}
+
+void GLWidget::StopRecording() {
+  if (initialized_) makeCurrent();
+  capture_.Stop();
+}
+
+// The shader only changes the lighting of the final composition
+void GLWidget::SetReflection(bool set) {
+    if (!set || currentShader_ == 2) return;
+    currentShader_ = 2;
+    Invalidate(kFinalPass);
 }
 
 void GLWidget::SetPBS(bool set) {
-    if(set) currentShader_ = 3;
-    update();
+    if (!set || currentShader_ == 3) return;
+    currentShader_ = 3;
+    Invalidate(kFinalPass);
 }
 
 void GLWidget::SetIBLPBS(bool set) {
-    if(set) currentShader_ = 4;
-    update();
+    if (!set || currentShader_ == 4) return;
+    currentShader_ = 4;
+    Invalidate(kFinalPass);
 }
 
 void GLWidget::SetPhong(bool set)
 {
-    if(set) currentShader_ = 0;
-    update();
+    if (!set || currentShader_ == 0) return;
+    currentShader_ = 0;
+    Invalidate(kFinalPass);
 }
 
 void GLWidget::SetTexMap(bool set)
 {
-    if(set) currentShader_ = 1;
-    update();
+    if (!set || currentShader_ == 1) return;
+    currentShader_ = 1;
+    Invalidate(kFinalPass);
 }
 
 void GLWidget::SetFresnelR(double r) {
+    if (fresnel_[0] == static_cast<float>(r)) return;
     fresnel_[0] = r;
-    update();
+    Invalidate(kFinalPass);
 }
 
 void GLWidget::SetFresnelG(double g) {
+    if (fresnel_[1] == static_cast<float>(g)) return;
     fresnel_[1] = g;
-    update();
+    Invalidate(kFinalPass);
 }
 
 void GLWidget::SetAlbedo(double r, double g, double b) {
-    albedo_[0] = r;
-    albedo_[1] = g;
-    albedo_[2] = b;
-    update();
+    glm::vec3 albedo(r, g, b);
+    if (albedo_ == albedo) return;
+    albedo_ = albedo;
+    Invalidate(kAllPasses);
+}
+
+void GLWidget::SetLights(const std::vector<data_visualization::Light> &lights) {
+  lights_ = lights;
+  lights_changed_ = true;
+  Invalidate(kFinalPass);
+}
+
+void GLWidget::AddLight(const data_visualization::Light &light) {
+  lights_.push_back(light);
+  lights_changed_ = true;
+  Invalidate(kFinalPass);
+}
+
+void GLWidget::AddRandomLights() {
+  // The model is scaled to fit a unit cube centered at the origin
+  std::mt19937 generator(lights_.size());
+  std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+  for (int i = 0; i < kRandomLights; ++i) {
+    data_visualization::Light light;
+    light.type_ = i % 2 == 0 ? data_visualization::LightType::kPoint
+                             : data_visualization::LightType::kSpot;
+    light.position_ = glm::vec3(unit(generator), unit(generator),
+                                unit(generator)) * 2.0f - glm::vec3(1.0f);
+    light.color_ = glm::vec3(unit(generator), unit(generator),
+                             unit(generator)) * 2.0f;
+    light.range_ = 0.3f + 0.5f * unit(generator);
+    light.direction_ = -light.position_;
+    light.outer_angle_ = glm::radians(20.0f + 25.0f * unit(generator));
+    light.inner_angle_ = 0.8f * light.outer_angle_;
+    lights_.push_back(light);
+  }
+  lights_changed_ = true;
+  std::cout << lights_.size() << " lights" << std::endl;
+  Invalidate(kFinalPass);
+}
+
+void GLWidget::ClearLights() {
+  if (lights_.empty()) return;
+  lights_.clear();
+  lights_changed_ = true;
+  Invalidate(kFinalPass);
+}
+
+void GLWidget::BindLightClusters(QOpenGLShaderProgram *program,
+                                 const glm::mat4x4 &view) {
+  if (lights_changed_) {
+    UploadBufferTexture(this, light_buffer_, data_visualization::PackLights(lights_));
+    lights_changed_ = false;
+  }
+
+  light_clusters_.Build(lights_, view, camera_.GetFieldOfView(),
+                        camera_.GetAspectRatio(), camera_.GetZNear(),
+                        camera_.GetZFar());
+  UploadBufferTexture(this, cluster_grid_buffer_, light_clusters_.Grid());
+  UploadBufferTexture(this, cluster_lights_buffer_, light_clusters_.Indices());
+
+  glActiveTexture(GL_TEXTURE12);
+  glBindTexture(GL_TEXTURE_BUFFER, light_texture_);
+  glActiveTexture(GL_TEXTURE13);
+  glBindTexture(GL_TEXTURE_BUFFER, cluster_grid_texture_);
+  glActiveTexture(GL_TEXTURE14);
+  glBindTexture(GL_TEXTURE_BUFFER, cluster_lights_texture_);
+
+  glUniform1i(program->uniformLocation("light_buffer"), 12);
+  glUniform1i(program->uniformLocation("cluster_grid"), 13);
+  glUniform1i(program->uniformLocation("cluster_lights"), 14);
+  glUniform3i(program->uniformLocation("cluster_size"),
+              data_visualization::kClusterTilesX,
+              data_visualization::kClusterTilesY,
+              data_visualization::kClusterSlices);
+  glUniform2f(program->uniformLocation("viewport_size"), width_, height_);
+  glUniform1f(program->uniformLocation("slice_scale"), light_clusters_.SliceScale());
+  glUniform1f(program->uniformLocation("slice_bias"), light_clusters_.SliceBias());
+  glUniform1f(program->uniformLocation("zNear"), camera_.GetZNear());
+  glUniform1f(program->uniformLocation("zFar"), camera_.GetZFar());
+}
+
+// Only drawn without SSAO, which renders every pass
+void GLWidget::SetDepthPrepass(bool set) {
+  if (depth_prepass_ == set) return;
+  depth_prepass_ = set;
+  Invalidate(kFinalPass);
+}
+
+void GLWidget::SetShowOverdraw(bool set) {
+  if (show_overdraw_ == set) return;
+  show_overdraw_ = set;
+  Invalidate(kFinalPass);
+}
+
+void GLWidget::SetOrbit(double rotation_x, double rotation_y) {
+  camera_.SetOrbit(rotation_x, rotation_y);
+  Invalidate(kAllPasses);
+}
+
+void GLWidget::SetBackgroundBuilds(bool set) {
+  background_builds_ = set;
+}
+
+void GLWidget::SetBackfaceCulling(bool set) {
+  if (backface_culling_ == set) return;
+  backface_culling_ = set;
+  Invalidate(kAllPasses);
 }
 
 void GLWidget::SetUseTextures(bool use) {
+    if (useTextures_ == use) return;
     useTextures_ = use;
-    update();
+    Invalidate(kAllPasses);
+}
+
+void GLWidget::SetMaterial(int index) {
+    if (!initialized_ || index < 0 || static_cast<size_t>(index) >= materials_.Size())
+      return;
+
+    makeCurrent();
+    data_representation::MaterialLibrary::Resident resident;
+    if (!materials_.Use(index, &resident)) {
+      if (!UploadMaterial(materials_.Maps(index), &resident)) {
+        std::cerr << "Error loading material " << materials_.Maps(index).name_ << std::endl;
+        return;
+      }
+
+      std::vector<data_representation::MaterialLibrary::Resident> evicted;
+      materials_.Insert(index, resident, &evicted);
+      for (const auto &textures : evicted) {
+        glDeleteTextures(1, &textures.color_map_);
+        glDeleteTextures(1, &textures.orm_map_);
+      }
+      std::cout << "Material " << materials_.Maps(index).name_ << " resident, "
+                << materials_.ResidentBytes() / 1024 << " KB of material textures" << std::endl;
+    }
+
+    active_color_map_ = resident.color_map_;
+    active_orm_map_ = resident.orm_map_;
+    Invalidate(kAllPasses);
+}
+
+void GLWidget::SetEnvironment(int index) {
+    if (!initialized_ || index < 0 || static_cast<size_t>(index) >= environments_.Size())
+      return;
+
+    makeCurrent();
+    bool compress_cube_maps = compress_textures_ && s3tc_supported_;
+    data_representation::EnvironmentLibrary::Resident resident;
+    if (!environments_.Use(index, &resident)) {
+      // Usually already read in the background by the prefetch of the
+      // previous switch, only the upload is left
+      data_representation::EnvironmentData data;
+      if (!environments_.Read(index, compress_cube_maps, compress_textures_, &data)) {
+        std::cerr << "Error loading environment " << environments_.Maps(index).name_ << std::endl;
+        return;
+      }
+      UploadEnvironment(data, &resident);
+      // Decoded on a worker thread when prefetched, reported here
+      ReportBytesCopied("environment " + environments_.Maps(index).name_,
+                        data_representation::BytesCopied(data));
+
+      std::vector<data_representation::EnvironmentLibrary::Resident> evicted;
+      environments_.Insert(index, resident, &evicted);
+      for (const auto &textures : evicted) DeleteEnvironment(textures);
+      std::cout << "Environment " << environments_.Maps(index).name_ << " resident, "
+                << environments_.ResidentBytes() / 1024 << " KB of environment textures" << std::endl;
+    }
+
+    active_environment_ = index;
+    active_diffuse_map_ = resident.irradiance_ ? resident.irradiance_ : diffuse_map_;
+    active_weighted_specular_map_ =
+        resident.specular_prefilter_ ? resident.specular_prefilter_ : weighted_specular_map_;
+    active_brdfLUT_map_ = resident.brdf_lut_ ? resident.brdf_lut_ : brdfLUT_map_;
+    // Without a sky the prefiltered map is shown at its sharpest level
+    if (resident.sky_)
+      active_specular_map_ = resident.sky_;
+    else if (resident.specular_prefilter_)
+      active_specular_map_ = resident.specular_prefilter_;
+    else
+      active_specular_map_ = specular_map_;
+
+    // Read the neighbours in the menu in the background
+    size_t count = environments_.Size();
+    environments_.Prefetch((index + 1) % count, compress_cube_maps, compress_textures_);
+    environments_.Prefetch((index + count - 1) % count, compress_cube_maps, compress_textures_);
+
+    Invalidate(kFinalPass);
 }
 
 void GLWidget::ApplyGammaCorrection(bool apply) {
+    if (applyGammaCorrection_ == apply) return;
     applyGammaCorrection_ = apply;
-    update();
+    Invalidate(kFinalPass);
 }
 
 void GLWidget::SetCurrentTexture(int i)
 {
+    if (currentTexture_ == i) return;
     currentTexture_ = i;
-    update();
+    Invalidate(kFinalPass);
 }
 
 void GLWidget::SetSkyVisible(bool set)
 {
+    if (skyVisible_ == set) return;
     skyVisible_ = set;
-    update();
+    Invalidate(kFinalPass);
 }
 
 void GLWidget::SetFresnelB(double b) {
+    if (fresnel_[2] == static_cast<float>(b)) return;
     fresnel_[2] = b;
-    update();
+    Invalidate(kFinalPass);
 }
 
+// The material is written to the G-buffer
 void GLWidget::SetMetalness(double d) {
+    if (metalness_ == static_cast<float>(d)) return;
     metalness_ = d;
-    update();
+    Invalidate(kAllPasses);
 }
 
 void GLWidget::SetRoughness(double d) {
+    if (roughness_ == static_cast<float>(d)) return;
     roughness_ = d;
-    update();
+    Invalidate(kAllPasses);
 }
 
 void GLWidget::SetSSAODirections(int directions) {
-    ssao_num_directions_ = std::max(4, directions);
-    update();
+    directions = std::max(4, directions);
+    if (ssao_num_directions_ == directions) return;
+    ssao_num_directions_ = directions;
+    Invalidate(kSsaoPass);
 }
 
 void GLWidget::SetSSAOSamplesPerDirection(int samples) {
-    ssao_samples_per_direction_ = std::max(1, samples);
-    update();
+    samples = std::max(1, samples);
+    if (ssao_samples_per_direction_ == samples) return;
+    ssao_samples_per_direction_ = samples;
+    Invalidate(kSsaoPass);
 }
 
 void GLWidget::SetSSAORadius(double radius) {
-    ssao_sample_radius_ = static_cast<float>(std::max(0.01, radius));
-    update();
+    float sample_radius = static_cast<float>(std::max(0.01, radius));
+    if (ssao_sample_radius_ == sample_radius) return;
+    ssao_sample_radius_ = sample_radius;
+    Invalidate(kSsaoPass);
 }
 
 void GLWidget::SetSSAORenderMode(int mode) {
+    if (currentSSAORenderMode_ == mode) return;
     currentSSAORenderMode_ = mode;
-    update();
+    Invalidate(kFinalPass);
 }
 
 void GLWidget::EnableSSAO(bool enable) {
+    if (SSAO_enabled_ == enable) return;
     SSAO_enabled_ = enable;
-    update();
+    // The targets were not kept up to date without SSAO
+    Invalidate(kAllPasses);
 }
 
 void GLWidget::SetUseRandomization(bool use) {
+    if (use_randomization_ == use) return;
     use_randomization_ = use;
-    update();
+    Invalidate(kSsaoPass);
 }
 
 void GLWidget::SetBasicSSAO(bool set) {
-    if(set) {
-        ao_algorithm_ = 0;  // Basic SSAO algorithm
-        update();
-    }
+    if (!set || ao_algorithm_ == 0) return;
+    ao_algorithm_ = 0;  // Basic SSAO algorithm
+    Invalidate(kSsaoPass);
 }
 
 void GLWidget::SetHBAO(bool set) {
-    if(set) {
-        ao_algorithm_ = 1;  // HBAO algorithm
-        update();
-    }
+    if (!set || ao_algorithm_ == 1) return;
+    ao_algorithm_ = 1;  // HBAO algorithm
+    Invalidate(kSsaoPass);
 }
 
+// Chooses the target the composition reads. Without blur nothing reads the
+// blurred SSAO and the graph culls the blur pass; turned back on, the blurred
+// SSAO is stale if SSAO ran meanwhile and the graph runs the blur again.
 void GLWidget::SetUseBlur(bool use) {
+    if (use_blur_ == use) return;
     use_blur_ = use;
-    update();
+    Invalidate(kFinalPass);
 }
 
 void GLWidget::SetBlurType(int type) {
-    blur_type_ = std::max(0, std::min(3, type));
-    update();
+    type = std::max(0, std::min(3, type));
+    if (blur_type_ == type) return;
+    blur_type_ = type;
+    Invalidate(kBlurPass);
 }
 
 void GLWidget::SetBlurRadius(double radius) {
-    blur_radius_ = static_cast<float>(std::max(1.0, std::min(10.0, radius)));
-    update();
+    float blur_radius = static_cast<float>(std::max(1.0, std::min(10.0, radius)));
+    if (blur_radius_ == blur_radius) return;
+    blur_radius_ = blur_radius;
+    Invalidate(kBlurPass);
 }
 
 void GLWidget::SetNormalThreshold(double threshold) {
-    normal_threshold_ = static_cast<float>(std::max(0.0, std::min(1.0, threshold)));
-    update();
+    float normal_threshold = static_cast<float>(std::max(0.0, std::min(1.0, threshold)));
+    if (normal_threshold_ == normal_threshold) return;
+    normal_threshold_ = normal_threshold;
+    Invalidate(kBlurPass);
 }
 
 void GLWidget::SetDepthThreshold(double threshold) {
-    depth_threshold_ = static_cast<float>(std::max(0.001, std::min(0.1, threshold)));
-    update();
+    float depth_threshold = static_cast<float>(std::max(0.001, std::min(0.1, threshold)));
+    if (depth_threshold_ == depth_threshold) return;
+    depth_threshold_ = depth_threshold;
+    Invalidate(kBlurPass);
 }
 
 void GLWidget::SetBiasAngle(double angle) {
-    bias_angle_ = static_cast<float>(std::max(0.0, std::min(0.5, angle)));
-    update();
+    float bias_angle = static_cast<float>(std::max(0.0, std::min(0.5, angle)));
+    if (bias_angle_ == bias_angle) return;
+    bias_angle_ = bias_angle;
+    Invalidate(kSsaoPass);
 }
 
 void GLWidget::SetAOStrength(double strength) {
-    ao_strength_ = static_cast<float>(std::max(0.0, std::min(1.0, strength)));
-    update();
+    float ao_strength = static_cast<float>(std::max(0.0, std::min(1.0, strength)));
+    if (ao_strength_ == ao_strength) return;
+    ao_strength_ = ao_strength;
+    Invalidate(kFinalPass);
 }
 
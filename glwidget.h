@@ -10,10 +10,26 @@
 #include <QImage>
 #include <QMouseEvent>
 #include <QString>
+#include <QStringList>
 
+#include <cstdint>
+#include <future>
 #include <memory>
+#include <string>
+#include <vector>
 
+#include "./bvh.h"
 #include "./camera.h"
+#include "./chunk_streamer.h"
+#include "./environment_library.h"
+#include "./frame_capture.h"
+#include "./gbuffer_formats.h"
+#include "./light_clusters.h"
+#include "./material_library.h"
+#include "./mesh_buffers.h"
+#include "./mesh_io.h"
+#include "./render_graph.h"
+#include "./scene.h"
 #include "./triangle_mesh.h"
 
 #include <glm/vec3.hpp>
@@ -26,9 +42,11 @@ class GLWidget : public QOpenGLWidget, protected QOpenGLFunctions_3_3_Core {
   ~GLWidget();
 
   /**
-   * @brief LoadModel Loads a PLY model at the filename path into the mesh_ data
-   * structure.
-   * @param filename Path to the PLY model.
+   * @brief LoadModel Loads a PLY or OBJ model, or a scene description (see
+   * data_representation::ReadScene), at the filename path into scene_, or
+   * opens a chunked mesh file (see data_representation::WriteChunkedMesh) to
+   * stream it.
+   * @param filename Path to the model or the scene.
    * @return Whether it was able to load the model.
    */
   bool LoadModel(const QString &filename);
@@ -80,26 +98,163 @@ class GLWidget : public QOpenGLWidget, protected QOpenGLFunctions_3_3_Core {
   bool LoadColorMap(const QString &filename);
 
   /**
-   * @brief LoadRoughnessMap Will load load a texture map that will be used for the
-   * color component.
+   * @brief LoadORMMaps Packs the occlusion, roughness and metalness maps into
+   * the red, green and blue channels of a single texture (glTF ORM layout).
+   * @param occlusion Path to the occlusion texture file, may be empty.
+   * @param roughness Path to the roughness texture file, may be empty.
+   * @param metalness Path to the metalness texture file, may be empty.
+   * @return Whether it was able to load the textures.
+   */
+  bool LoadORMMaps(const QString &occlusion, const QString &roughness,
+                   const QString &metalness);
+
+  /**
+   * @brief LoadOcclusionMap Replaces the occlusion channel of the ORM texture.
+   * @param filename Path to the texture file.
+   * @return Whether it was able to load the texture.
+   */
+  bool LoadOcclusionMap(const QString &filename);
+
+  /**
+   * @brief LoadRoughnessMap Replaces the roughness channel of the ORM texture.
    * @param filename Path to the texture file.
    * @return Whether it was able to load the texture.
    */
   bool LoadRoughnessMap(const QString &filename);
 
   /**
-   * @brief LoadMetalnessMap Will load load a texture map that will be used for the
-   * color component.
+   * @brief LoadMetalnessMap Replaces the metalness channel of the ORM texture.
    * @param filename Path to the texture file.
    * @return Whether it was able to load the texture.
    */
   bool LoadMetalnessMap(const QString &filename);
 
+  /**
+   * @brief LoadMaterialLibrary Scans dir for materials (maps sharing a name
+   * prefix, see data_representation::FindMaterials) that can then be switched
+   * with SetMaterial. The textures of a material are only loaded the first
+   * time it is selected and stay resident until evicted by newer ones.
+   * @param dir Root directory of the textures.
+   * @return The names of the materials found, in SetMaterial index order.
+   */
+  QStringList LoadMaterialLibrary(const QString &dir);
+
+  /**
+   * @brief SetMaterial Selects a material of the library, uploading its
+   * textures if they are not resident.
+   * @param index Index of the material in the list returned by
+   * LoadMaterialLibrary.
+   */
+  void SetMaterial(int index);
+
+  /**
+   * @brief LoadEnvironmentLibrary Scans dir for environments (folders with
+   * sky, irradiance_map and specular_prefilter cube maps and a brdf_lut.png,
+   * see data_representation::FindEnvironments) that can then be switched with
+   * SetEnvironment.
+   * @param dir Root directory of the textures.
+   * @return The names of the environments found, in SetEnvironment index
+   * order.
+   */
+  QStringList LoadEnvironmentLibrary(const QString &dir);
+
+  /**
+   * @brief SetEnvironment Selects an environment of the library as a whole
+   * (sky, irradiance, prefiltered specular and BRDF LUT). Resident
+   * environments are switched by rebinding their textures, the others are
+   * uploaded from the background read started when a neighbouring one was
+   * selected. The neighbours of the new one are then read in the background.
+   * @param index Index of the environment in the list returned by
+   * LoadEnvironmentLibrary.
+   */
+  void SetEnvironment(int index);
+
   /**
    * @brief SetAlbedo Sets the albedo color.
    */
   void SetAlbedo(double, double, double);
 
+  /**
+   * @brief SetLights Replaces the point and spot lights of the PBS shader.
+   * Each fragment only evaluates the lights assigned to its froxel (see
+   * data_visualization::LightClusters), so the cost depends on the lights
+   * reaching a pixel rather than on the total number of lights.
+   */
+  void SetLights(const std::vector<data_visualization::Light> &lights);
+
+  /**
+   * @brief AddLight Adds a point or spot light to the PBS shader.
+   */
+  void AddLight(const data_visualization::Light &light);
+
+  const std::vector<data_visualization::Light> &Lights() const {
+    return lights_;
+  }
+
+  /**
+   * @brief Pick Casts the view ray through the pixel (x, y) against the BVHs
+   * of the scene meshes. Not available while the BVHs of the last loaded
+   * scene are being built.
+   * @param position The closest hit, in the space the model matrix is applied
+   * to.
+   * @return Whether anything was hit.
+   */
+  bool Pick(int x, int y, glm::vec3 *position);
+
+  /**
+   * @brief ShowModel Replaces the model by a scene read beforehand with
+   * data_representation::ReadModel, e.g. in the background.
+   * @param filename File the scene was read from.
+   * @return false, keeping the current model, when scene has no geometry.
+   */
+  bool ShowModel(data_representation::Scene *scene, const QString &filename);
+
+  /**
+   * @brief SetOrbit Places the camera around the model, see
+   * data_visualization::Camera::SetOrbit.
+   */
+  void SetOrbit(double rotation_x, double rotation_y);
+
+  /**
+   * @brief SetBackgroundBuilds Sets whether the models shown next build their
+   * BVHs and levels of detail in the background. Without them picking is not
+   * available and the full detail meshes are always drawn.
+   */
+  void SetBackgroundBuilds(bool set);
+
+  /**
+   * @brief SetCaptureSource Selects what the screenshots and recordings
+   * capture: 0 the shaded frame, the SSAO intermediates 1 albedo, 2 normals,
+   * 3 material, 4 depth, 5 SSAO, 6 blurred SSAO.
+   */
+  void SetCaptureSource(int source);
+
+  /**
+   * @brief SetGBufferFormats Changes the formats of the SSAO targets and
+   * prints their memory and bandwidth at the current size.
+   */
+  void SetGBufferFormats(const data_visualization::GBufferFormats &formats);
+
+  const data_visualization::GBufferFormats &GetGBufferFormats() const {
+    return gbuffer_formats_;
+  }
+
+  /**
+   * @brief SaveScreenshot Writes the next frame to filename as PNG.
+   */
+  void SaveScreenshot(const QString &filename);
+
+  /**
+   * @brief StartRecording Writes every frame, redrawn continuously, as
+   * <prefix><frame number>.png, or .raw for raw pixels, until StopRecording.
+   */
+  void StartRecording(const QString &prefix, bool raw);
+
+  /**
+   * @brief StopRecording Ends the recording once its frames are written.
+   */
+  void StopRecording();
+
  protected:
   /**
    * @brief initializeGL Initializes OpenGL variables and loads, compiles and
@@ -113,10 +268,173 @@ class GLWidget : public QOpenGLWidget, protected QOpenGLFunctions_3_3_Core {
   void LoadDefaultMaterials();
 
   /**
-   * @brief InitializeSSAO Initializes the Screen Space Ambient Occlusion (SSAO) effect.
+   * @brief UploadMaterial Creates and loads the textures of a library
+   * material.
+   * @return Whether it was able to load the textures.
+   */
+  bool UploadMaterial(const data_representation::MaterialMaps &maps,
+                      data_representation::MaterialLibrary::Resident *resident);
+
+  /**
+   * @brief ReleaseMaterials Deletes the textures of every resident library
+   * material.
+   */
+  void ReleaseMaterials();
+
+  /**
+   * @brief UploadEnvironment Creates and uploads the textures of a library
+   * environment. Missing maps are left as 0.
+   */
+  void UploadEnvironment(const data_representation::EnvironmentData &data,
+                         data_representation::EnvironmentLibrary::Resident *resident);
+
+  /**
+   * @brief DeleteEnvironment Deletes the textures of a library environment.
+   */
+  void DeleteEnvironment(const data_representation::EnvironmentLibrary::Resident &resident);
+
+  /**
+   * @brief ReleaseEnvironments Deletes the textures of every resident library
+   * environment and goes back to the loaded maps.
+   */
+  void ReleaseEnvironments();
+
+  /**
+   * @brief InitializeSSAO Initializes the Screen Space Ambient Occlusion (SSAO) effect:
+   * the fullscreen quad and the noise texture. The targets are render_graph_'s.
    */
   void InitializeSSAO();
 
+  /**
+   * @brief BindLightClusters Assigns the lights to the froxels of the current
+   * view, uploads the light list and the clusters to their buffer textures
+   * and sets the clustered lighting uniforms of the bound program.
+   * @param program Program being used, already bound.
+   * @param view View matrix.
+   */
+  void BindLightClusters(QOpenGLShaderProgram *program, const glm::mat4x4 &view);
+
+  /**
+   * @brief OpenChunkedMesh Replaces the model by the chunked mesh file, which
+   * is then streamed by chunk_streamer_.
+   */
+  bool OpenChunkedMesh(const std::string &file);
+
+  /**
+   * @brief LoadPly Starts reading a PLY model in the background. The current
+   * model is kept until the vertices of the new one are read, then its faces
+   * are drawn as they arrive (see UpdatePlyLoad).
+   * @return Whether the file could be opened.
+   */
+  bool LoadPly(const std::string &file);
+
+  /**
+   * @brief UpdatePlyLoad Shows the progress of the PLY model being read:
+   * replaces the model by its vertices once they are read, appends the faces
+   * read since the last frame to mesh_buffers_, and once the whole file is
+   * read makes it the model, with its computed normals.
+   */
+  void UpdatePlyLoad();
+
+  /**
+   * @brief CancelPlyLoad Stops reading the PLY model being read, if any, and
+   * drops what was shown of it.
+   */
+  void CancelPlyLoad();
+
+  /**
+   * @brief ShowScene Replaces scene_ by scene, with the ambient occlusion
+   * cached next to its file if any, and starts its background builds.
+   * @param file File the scene was read from, empty for generated ones.
+   * @return false, keeping scene_, when scene has no geometry.
+   */
+  bool ShowScene(data_representation::Scene *scene, const std::string &file);
+
+  /**
+   * @brief UploadScene Uploads the meshes of scene_ and their instance
+   * transforms to mesh_buffers_.
+   */
+  void UploadScene();
+
+  /**
+   * @brief BuildBvhs Starts building the BVHs of the meshes of scene_ in the
+   * background.
+   */
+  void BuildBvhs();
+
+  /**
+   * @brief BuildLods Starts simplifying the meshes of scene_ into their
+   * levels of detail in the background.
+   */
+  void BuildLods();
+
+  /**
+   * @brief WaitForBuilds Waits for the background tasks reading scene_, before
+   * it is replaced. The occlusion being baked is dropped, as it belongs to
+   * the meshes being replaced.
+   */
+  void WaitForBuilds();
+
+  /**
+   * @brief StartAmbientOcclusionBake Starts the background bake of the
+   * meshes of scene_ against bvhs_.
+   */
+  void StartAmbientOcclusionBake();
+
+  /**
+   * @brief UpdateAmbientOcclusion Starts the queued bake once the BVHs are
+   * built and, once the background bake is done, stores the occlusion in the
+   * meshes of scene_ and uploads it. Polls with progress frames meanwhile.
+   */
+  void UpdateAmbientOcclusion();
+
+  /**
+   * @brief UpdateLods Once the background build is done, stores the levels of
+   * detail in the meshes of scene_ and uploads them.
+   */
+  void UpdateLods();
+
+  /**
+   * @brief DrawScene Draws every instance of the meshes of scene_, one
+   * draw per mesh, at the levels of detail and with the meshlets selected by
+   * the last SetSceneView. Back
+   * faces are not rasterized when backface_culling_ is set.
+   * @param program Program being used, already bound. Its material_buffer is
+   * set to the material parameters (texture unit 15), indexed by the
+   * material_id attribute. nullptr draws the positions only.
+   */
+  void DrawScene(QOpenGLShaderProgram *program);
+
+  /**
+   * @brief SetSceneView Selects the levels of detail and culls the meshlets
+   * of scene_ for the camera, for the draws of the frame, and updates the
+   * chunks streamed by chunk_streamer_.
+   */
+  void SetSceneView(const glm::mat4x4 &model, const glm::mat4x4 &view,
+                    const glm::mat4x4 &projection);
+
+  /**
+   * @brief CaptureFrame Queues the readback of the capture source for the
+   * screenshot or recording in progress, and writes the frames already read
+   * back. Keeps redrawing while recording or frames are in flight.
+   */
+  void CaptureFrame();
+
+  /**
+   * @brief Invalidate Marks passes of renderWithSSAO (bits of the pass
+   * constants of glwidget.cc) as stale, and requests a frame. The requests
+   * until the frame is drawn are merged into it, and the passes not marked
+   * reuse their targets from the previous frame.
+   */
+  void Invalidate(unsigned passes);
+
+  /**
+   * @brief ScheduleProgressFrame Invalidate for the frames that only show
+   * background work progressing, chunks or faces arriving, which are spaced
+   * by at least kProgressFrameInterval instead of following the display.
+   */
+  void ScheduleProgressFrame(unsigned passes);
+
   /**
    * @brief resizeGL Resizes the viewport.
    * @param w New viewport width.
@@ -144,6 +462,13 @@ class GLWidget : public QOpenGLWidget, protected QOpenGLFunctions_3_3_Core {
   std::unique_ptr<QOpenGLShaderProgram> blur_program_;      // Blur pass
   std::unique_ptr<QOpenGLShaderProgram> final_program_;     // Final composition
 
+  /**
+   * @brief Depth pre-pass programs
+   * Depth only pass and overdraw visualization, both from the position only stream.
+   */
+  std::unique_ptr<QOpenGLShaderProgram> depth_program_;     // Depth pre-pass
+  std::unique_ptr<QOpenGLShaderProgram> overdraw_program_;  // Shaded fragments counter
+
 
   /**
    * @brief camera_ Class that computes the multiple camera transform matrices.
@@ -151,9 +476,47 @@ class GLWidget : public QOpenGLWidget, protected QOpenGLFunctions_3_3_Core {
   data_visualization::Camera camera_;
 
   /**
-   * @brief mesh_ Data structure representing a triangle mesh.
+   * @brief scene_ Meshes and the nodes placing them.
+   */
+  data_representation::Scene scene_;
+
+  /**
+   * @brief bvh_build_ Background build of the BVHs of scene_, moved to bvhs_
+   * by the first query after it finishes. Declared after scene_ so that it
+   * is waited for before the meshes it reads are destroyed.
+   */
+  std::future<std::vector<std::unique_ptr<data_representation::Bvh>>> bvh_build_;
+
+  /**
+   * @brief bvhs_ BVH of each mesh of scene_, in object space.
+   */
+  std::vector<std::unique_ptr<data_representation::Bvh>> bvhs_;
+
+  /**
+   * @brief lod_build_ Background simplification of the meshes of scene_, the
+   * levels of detail of each mesh. Declared after scene_ for the same reason
+   * as bvh_build_.
+   */
+  std::future<std::vector<std::vector<std::vector<int>>>> lod_build_;
+
+  /**
+   * @brief ao_bake_ Background ambient occlusion bake of the meshes of scene_
+   * against bvhs_, the occlusion of each mesh. Declared after both for the
+   * same reason as bvh_build_.
+   */
+  std::future<std::vector<std::vector<float>>> ao_bake_;
+
+  /**
+   * @brief ao_bake_queued_ Whether a bake was asked for and starts once
+   * bvh_build_ is done.
+   */
+  bool ao_bake_queued_;
+
+  /**
+   * @brief model_file_ File scene_ was read from, empty for generated
+   * models. The baked occlusion is cached next to it.
    */
-  std::unique_ptr<data_representation::TriangleMesh> mesh_;
+  std::string model_file_;
 
   /**
    * @brief diffuse_map_ Diffuse cubemap texture.
@@ -181,36 +544,30 @@ class GLWidget : public QOpenGLWidget, protected QOpenGLFunctions_3_3_Core {
   GLuint color_map_;
 
   /**
-   * @brief roughness_map_ Roughness texture.
+   * @brief orm_map_ Packed occlusion (red), roughness (green) and metalness
+   * (blue) texture.
    */
-  GLuint roughness_map_;
+  GLuint orm_map_;
 
   /**
-   * @brief metalness_map_ Metalness texture.
+   * @brief occlusion_path_, roughness_path_, metalness_path_ Source maps of
+   * orm_map_, kept to repack it when one of them is replaced.
    */
-  GLuint metalness_map_;
+  std::string occlusion_path_;
+  std::string roughness_path_;
+  std::string metalness_path_;
 
   /**
-   * @brief albedo_texture_ Albedo texture.
+   * @brief render_graph_ Passes and targets of renderWithSSAO: the albedo,
+   * the normals, the material (roughness, metalness, occlusion and coverage)
+   * and the depth of the G-buffer, the SSAO and the blurred SSAO.
    */
-  GLuint albedo_texture_;
+  data_visualization::RenderGraph render_graph_;
 
   /**
-   * @brief normal_texture_ Normal texture.
-   * This texture stores the normals of the scene for SSAO.
+   * @brief gbuffer_formats_ Formats of the targets of render_graph_.
    */
-  GLuint normal_texture_;
-
-  /**
-   * @brief depth_texture_ Depth texture.
-   * This texture stores the depth information of the scene for SSAO.
-   */
-  GLuint depth_texture_;
-
-  /**
-   * @brief g_buffer_FBO_ Framebuffer object for the G-Buffer used in SSAO.
-   */
-  GLuint g_buffer_FBO_;
+  data_visualization::GBufferFormats gbuffer_formats_;
 
   /**
    * @brief initialized_ Whether the widget has finished initializations.
@@ -299,25 +656,169 @@ class GLWidget : public QOpenGLWidget, protected QOpenGLFunctions_3_3_Core {
   float normal_threshold_;      // For bilateral blur
   float depth_threshold_;       // For bilateral blur
 
-  GLuint VAO;
-  GLuint VBO_v;
-  GLuint VBO_n;
-  GLuint VBO_tc;
-  GLuint VBO_i;
+  /**
+   * @brief compress_textures_ Whether material maps and cube maps are uploaded
+   * block compressed (BC1 color and ORM, BC5 BRDF LUT) from
+   * the texture cache instead of as uncompressed RGBA8.
+   */
+  bool compress_textures_;
+
+  /**
+   * @brief s3tc_supported_ Whether the context supports BC1 (S3TC) textures.
+   */
+  bool s3tc_supported_;
+
+  /**
+   * @brief materials_ Materials of the library and their resident textures.
+   */
+  data_representation::MaterialLibrary materials_;
+
+  /**
+   * @brief active_color_map_, active_orm_map_ Textures used for rendering,
+   * either color_map_ and orm_map_ or the ones of the selected library
+   * material.
+   */
+  GLuint active_color_map_;
+  GLuint active_orm_map_;
+
+  /**
+   * @brief environments_ Environments of the library, their resident
+   * textures and background reads.
+   */
+  data_representation::EnvironmentLibrary environments_;
+
+  /**
+   * @brief active_environment_ Index of the selected library environment, -1
+   * when the loaded maps are used.
+   */
+  int active_environment_;
+
+  /**
+   * @brief active_specular_map_, active_diffuse_map_,
+   * active_weighted_specular_map_, active_brdfLUT_map_ Textures used for
+   * rendering, either the loaded maps or the ones of the selected library
+   * environment.
+   */
+  GLuint active_specular_map_;
+  GLuint active_diffuse_map_;
+  GLuint active_weighted_specular_map_;
+  GLuint active_brdfLUT_map_;
+
+  /**
+   * @brief mesh_buffers_ GPU buffers, vertex arrays, instance transforms and
+   * materials of all the meshes of scene_, reused from one loaded scene to
+   * the next.
+   */
+  data_visualization::MeshBuffers mesh_buffers_;
+
+  /**
+   * @brief chunk_streamer_ Out of core mesh drawn along with scene_, open
+   * while a chunked mesh file is loaded.
+   */
+  data_visualization::ChunkStreamer chunk_streamer_;
 
   GLuint VAO_sky;
-  GLuint VBO_v_sky;
-  GLuint VBO_i_sky;
-  std::vector<float> skyVertices_;
-  std::vector<int> skyFaces_;
 
   GLuint quad_VAO;
   GLuint quad_VBO;
 
-  GLuint ssao_texture_;
-  GLuint ssao_FBO_;
-  GLuint blurred_ssao_texture_;
-  GLuint blur_FBO_;
+  /**
+   * @brief lights_ Point and spot lights of the PBS shader, in world space.
+   */
+  std::vector<data_visualization::Light> lights_;
+
+  /**
+   * @brief lights_changed_ Whether lights_ has to be uploaded again.
+   */
+  bool lights_changed_;
+
+  /**
+   * @brief light_clusters_ Lights assigned to the froxels of the last view.
+   */
+  data_visualization::LightClusters light_clusters_;
+
+  /**
+   * @brief Buffers and buffer textures of the packed lights (RGBA32F), the
+   * offset and count of each cluster (RG32UI) and the light indices of the
+   * clusters (R32UI).
+   */
+  GLuint light_buffer_;
+  GLuint light_texture_;
+  GLuint cluster_grid_buffer_;
+  GLuint cluster_grid_texture_;
+  GLuint cluster_lights_buffer_;
+  GLuint cluster_lights_texture_;
+
+  /**
+   * @brief depth_prepass_ Whether the depth of the mesh is laid down by a
+   * depth only pass before shading it with GL_EQUAL, so that only the visible
+   * fragments run the shading program.
+   */
+  bool depth_prepass_;
+
+  /**
+   * @brief show_overdraw_ Whether to show how many times each pixel is shaded
+   * instead of the shaded mesh.
+   */
+  bool show_overdraw_;
+
+  /**
+   * @brief backface_culling_ Whether back faces are discarded, which also
+   * lets whole meshlets facing away from the camera be skipped. Off by
+   * default since open meshes show their inside.
+   */
+  bool backface_culling_;
+
+  /**
+   * @brief ply_file_, ply_mesh_, ply_stream_ File and mesh being read by
+   * ply_load_, and its partial results. ply_streaming_ is set once its vertices are uploaded and
+   * mesh_buffers_ draws its faces as they arrive instead of scene_.
+   */
+  std::string ply_file_;
+  std::unique_ptr<data_representation::TriangleMesh> ply_mesh_;
+  std::unique_ptr<data_representation::PlyStream> ply_stream_;
+  std::future<bool> ply_load_;
+  bool ply_streaming_;
+
+  /**
+   * @brief background_builds_ Whether BuildBvhs and BuildLods start their
+   * builds. The batch renderer turns them off so that every view of a model
+   * draws the same triangles.
+   */
+  bool background_builds_;
+
+  /**
+   * @brief capture_ Screenshots and recordings, read back through a ring of
+   * pixel pack buffers. capture_source_ is the image captured (see
+   * SetCaptureSource).
+   */
+  data_visualization::FrameCapture capture_;
+  int capture_source_;
+
+  /**
+   * @brief dirty_passes_ Passes of renderWithSSAO whose targets are stale,
+   * see Invalidate. progress_frame_ is set while a frame of
+   * ScheduleProgressFrame is waiting for its interval.
+   */
+  unsigned dirty_passes_;
+  bool progress_frame_;
+
+  /**
+   * @brief mesh_version_ Counts the changes of the geometry in mesh_buffers_,
+   * for the inputs of the G-buffer pass.
+   */
+  uint64_t mesh_version_;
+
+  /**
+   * @brief gbuffer_key_, ssao_key_, blur_key_ Hashes of the inputs (camera
+   * matrices, viewport, mesh_version_ and parameters) the targets of each
+   * pass of renderWithSSAO were last rendered with, each chained to the one
+   * of the pass it reads from. A pass whose inputs hash the same is skipped.
+   */
+  uint64_t gbuffer_key_;
+  uint64_t ssao_key_;
+  uint64_t blur_key_;
+
   GLuint noise_texture_;
 
 
@@ -333,13 +834,30 @@ class GLWidget : public QOpenGLWidget, protected QOpenGLFunctions_3_3_Core {
   void renderMesh(glm::mat4x4 model, glm::mat4x4 view, glm::mat4x4 projection, glm::mat3 normal);
   
   /**
-   * @brief renderSkybox renders the skybox with the given transformation matrices.
+   * @brief renderSkybox renders the skybox as a single triangle covering the
+   * screen at the far plane, looking up the view ray of each pixel.
+   * @param view View matrix.
+   * @param projection Projection matrix.
+   */
+  void renderSkybox(glm::mat4x4 view, glm::mat4x4 projection);
+
+  /**
+   * @brief renderDepthPrepass renders the depth of the mesh only, with the
+   * color writes disabled.
+   * @param model Model matrix.
+   * @param view View matrix.
+   * @param projection Projection matrix.
+   */
+  void renderDepthPrepass(glm::mat4x4 model, glm::mat4x4 view, glm::mat4x4 projection);
+
+  /**
+   * @brief renderOverdraw renders the mesh with additive blending, adding the
+   * same brightness for every fragment that passes the depth test.
    * @param model Model matrix.
    * @param view View matrix.
    * @param projection Projection matrix.
-   * @param normal Normal matrix.
    */
-  void renderSkybox(glm::mat4x4 model, glm::mat4x4 view, glm::mat4x4 projection, glm::mat3 normal);
+  void renderOverdraw(glm::mat4x4 model, glm::mat4x4 view, glm::mat4x4 projection);
   
   /**
    * @brief paintGL Function that handles rendering the scene.
@@ -510,6 +1028,45 @@ class GLWidget : public QOpenGLWidget, protected QOpenGLFunctions_3_3_Core {
    */
   void SetAOStrength(double strength);
 
+  /**
+   * @brief AddRandomLights Scatters kRandomLights point and spot lights with
+   * random colors around the model.
+   */
+  void AddRandomLights();
+
+  /**
+   * @brief ClearLights Removes every light, leaving only the ambient term.
+   */
+  void ClearLights();
+
+  /**
+   * @brief SetDepthPrepass Sets whether to render a depth only pre-pass before
+   * shading the mesh.
+   */
+  void SetDepthPrepass(bool set);
+
+  /**
+   * @brief SetShowOverdraw Sets whether to show the number of times each
+   * pixel is shaded instead of the shaded mesh.
+   */
+  void SetShowOverdraw(bool set);
+
+  /**
+   * @brief SetBackfaceCulling Sets whether to discard the faces looking away
+   * from the camera.
+   */
+  void SetBackfaceCulling(bool set);
+
+  /**
+   * @brief BakeAmbientOcclusion Starts baking the ambient occlusion of the
+   * vertices of every mesh in the background (see
+   * data_representation::BakeAmbientOcclusion) and caches it next to the
+   * model file. The IBL PBS shader multiplies its ambient term by it. While
+   * the BVHs are still being built the bake is queued, and started by
+   * UpdateAmbientOcclusion once they are done.
+   */
+  void BakeAmbientOcclusion();
+
  signals:
   /**
    * @brief SetFaces Signal that updates the interface label "Faces".
@@ -0,0 +1,154 @@
+#include <light_clusters.h>
+
+#include <glm/geometric.hpp>
+#include <glm/vec4.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+#include "./parallel.h"
+
+namespace data_visualization {
+
+namespace {
+
+/**
+ * @brief kSliceNearFraction Fraction of the far plane where the exponential
+ * slicing starts, everything closer falls in the first slice. Avoids wasting
+ * most slices in front of a very close near plane.
+ */
+const float kSliceNearFraction = 0.005f;
+
+// Squared distance from p to the box [lo, hi].
+float SquaredDistance(const glm::vec3 &p, const glm::vec3 &lo,
+                      const glm::vec3 &hi) {
+  float distance = 0.0f;
+  for (int i = 0; i < 3; ++i) {
+    float d = std::max(std::max(lo[i] - p[i], 0.0f), p[i] - hi[i]);
+    distance += d * d;
+  }
+  return distance;
+}
+
+// Tile range [first, last] covered by the normalized device coordinates
+// [ndc_min, ndc_max], false if it is outside of the screen.
+bool TileRange(float ndc_min, float ndc_max, int tiles, int *first,
+               int *last) {
+  if (ndc_max < -1.0f || ndc_min > 1.0f) return false;
+  *first = std::max(0, static_cast<int>((ndc_min + 1.0f) * 0.5f * tiles));
+  *last = std::min(tiles - 1, static_cast<int>((ndc_max + 1.0f) * 0.5f * tiles));
+  return true;
+}
+
+}  // namespace
+
+std::vector<float> PackLights(const std::vector<Light> &lights) {
+  std::vector<float> texels;
+  texels.reserve(lights.size() * kTexelsPerLight * 4);
+  for (const Light &light : lights) {
+    glm::vec3 direction = glm::normalize(light.direction_);
+    float texel[kTexelsPerLight * 4] = {
+        light.position_.x, light.position_.y, light.position_.z, light.range_,
+        light.color_.r, light.color_.g, light.color_.b,
+        light.type_ == LightType::kSpot ? 1.0f : 0.0f,
+        direction.x, direction.y, direction.z, std::cos(light.outer_angle_),
+        std::cos(light.inner_angle_), 0.0f, 0.0f, 0.0f};
+    texels.insert(texels.end(), texel, texel + kTexelsPerLight * 4);
+  }
+  return texels;
+}
+
+LightClusters::LightClusters()
+    : clusters_(kClusterCount),
+      grid_(kClusterCount * 2, 0),
+      z_near_(0.0f),
+      slice_scale_(0.0f),
+      slice_bias_(0.0f),
+      max_lights_(0) {}
+
+float LightClusters::SliceDepth(int slice) const {
+  if (slice == 0) return z_near_;
+  return std::exp((slice - slice_bias_) / slice_scale_);
+}
+
+void LightClusters::Build(const std::vector<Light> &lights,
+                          const glm::mat4 &view, double fov, double aspect,
+                          double z_near, double z_far) {
+  z_near_ = static_cast<float>(z_near);
+  float slice_near =
+      std::max(z_near_, static_cast<float>(z_far) * kSliceNearFraction);
+  slice_scale_ = kClusterSlices / std::log(static_cast<float>(z_far) / slice_near);
+  slice_bias_ = -std::log(slice_near) * slice_scale_;
+
+  const float kTanY = static_cast<float>(std::tan(fov * M_PI / 360.0));
+  const float kTanX = kTanY * static_cast<float>(aspect);
+
+  std::vector<glm::vec3> centers(lights.size());
+  for (size_t i = 0; i < lights.size(); ++i)
+    centers[i] = glm::vec3(view * glm::vec4(lights[i].position_, 1.0f));
+
+  // Every slice only writes its own clusters
+  utils::ParallelFor(0, kClusterSlices, [&](size_t begin, size_t end) {
+    for (int slice = begin; slice < static_cast<int>(end); ++slice) {
+      const float kNear = SliceDepth(slice);
+      const float kFar = slice + 1 == kClusterSlices ? static_cast<float>(z_far)
+                                                     : SliceDepth(slice + 1);
+      std::vector<uint32_t> *cluster =
+          &clusters_[slice * kClusterTilesX * kClusterTilesY];
+      for (int i = 0; i < kClusterTilesX * kClusterTilesY; ++i)
+        cluster[i].clear();
+
+      for (size_t i = 0; i < lights.size(); ++i) {
+        if (lights[i].range_ <= 0.0f) {
+          for (int j = 0; j < kClusterTilesX * kClusterTilesY; ++j)
+            cluster[j].push_back(i);
+          continue;
+        }
+
+        const glm::vec3 &c = centers[i];
+        const float kRadius = lights[i].range_;
+        float lo = std::max(kNear, -c.z - kRadius);
+        float hi = std::min(kFar, -c.z + kRadius);
+        if (lo > hi) continue;
+
+        // Conservative screen bounds of the sphere between both depths
+        int x0, x1, y0, y1;
+        float left = c.x - kRadius, right = c.x + kRadius;
+        float bottom = c.y - kRadius, top = c.y + kRadius;
+        if (!TileRange(std::min(left / lo, left / hi) / kTanX,
+                       std::max(right / lo, right / hi) / kTanX,
+                       kClusterTilesX, &x0, &x1) ||
+            !TileRange(std::min(bottom / lo, bottom / hi) / kTanY,
+                       std::max(top / lo, top / hi) / kTanY, kClusterTilesY,
+                       &y0, &y1))
+          continue;
+
+        for (int y = y0; y <= y1; ++y) {
+          float v0 = 2.0f * y / kClusterTilesY - 1.0f;
+          float v1 = 2.0f * (y + 1) / kClusterTilesY - 1.0f;
+          for (int x = x0; x <= x1; ++x) {
+            float u0 = 2.0f * x / kClusterTilesX - 1.0f;
+            float u1 = 2.0f * (x + 1) / kClusterTilesX - 1.0f;
+            glm::vec3 box_min(std::min(u0 * kNear, u0 * kFar) * kTanX,
+                              std::min(v0 * kNear, v0 * kFar) * kTanY, -kFar);
+            glm::vec3 box_max(std::max(u1 * kNear, u1 * kFar) * kTanX,
+                              std::max(v1 * kNear, v1 * kFar) * kTanY, -kNear);
+            if (SquaredDistance(c, box_min, box_max) <= kRadius * kRadius)
+              cluster[y * kClusterTilesX + x].push_back(i);
+          }
+        }
+      }
+    }
+  });
+
+  indices_.clear();
+  max_lights_ = 0;
+  for (int i = 0; i < kClusterCount; ++i) {
+    grid_[2 * i] = indices_.size();
+    grid_[2 * i + 1] = clusters_[i].size();
+    indices_.insert(indices_.end(), clusters_[i].begin(), clusters_[i].end());
+    max_lights_ = std::max(max_lights_, clusters_[i].size());
+  }
+}
+
+}  //  namespace data_visualization
@@ -0,0 +1,109 @@
+#ifndef LIGHT_CLUSTERS_H_
+#define LIGHT_CLUSTERS_H_
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace data_visualization {
+
+/**
+ * @brief kClusterTilesX, kClusterTilesY, kClusterSlices Size of the froxel
+ * grid: screen tiles in x and y and exponential depth slices.
+ */
+const int kClusterTilesX = 16;
+const int kClusterTilesY = 9;
+const int kClusterSlices = 24;
+const int kClusterCount = kClusterTilesX * kClusterTilesY * kClusterSlices;
+
+/**
+ * @brief kTexelsPerLight RGBA32F texels used by a light in the buffer built by
+ * PackLights.
+ */
+const int kTexelsPerLight = 4;
+
+enum class LightType { kPoint, kSpot };
+
+/**
+ * @brief Light A point or spot light in world space.
+ */
+struct Light {
+  LightType type_;
+  glm::vec3 position_;
+  glm::vec3 color_;      // Color times intensity
+  float range_;          // Distance where it fades out, 0 for no attenuation
+  glm::vec3 direction_;  // Spot lights only
+  float inner_angle_;    // Spot lights only, radians from the direction
+  float outer_angle_;
+};
+
+/**
+ * @brief PackLights Packs the lights as kTexelsPerLight RGBA texels each:
+ * (position, range), (color, type), (direction, cos outer angle) and
+ * (cos inner angle, 0, 0, 0).
+ */
+std::vector<float> PackLights(const std::vector<Light> &lights);
+
+/**
+ * @brief LightClusters Assignment of lights to the clusters (froxels) of the
+ * view frustum, so that a fragment only loops over the lights that can reach
+ * its cluster. The frustum is split in kClusterTilesX x kClusterTilesY screen
+ * tiles and kClusterSlices depth slices that grow exponentially with the
+ * distance. The depth slices are assigned in parallel.
+ */
+class LightClusters {
+ public:
+  LightClusters();
+
+  /**
+   * @brief Build Assigns the lights to the clusters of the frustum of a
+   * perspective camera. Each light is bounded by the sphere of its range,
+   * lights without range reach every cluster.
+   * @param view World to view space matrix.
+   * @param fov Vertical field of view in degrees.
+   * @param aspect Width over height of the viewport.
+   */
+  void Build(const std::vector<Light> &lights, const glm::mat4 &view,
+             double fov, double aspect, double z_near, double z_far);
+
+  /**
+   * @brief Grid Offset in Indices and number of lights of each cluster, x
+   * major then y then slice.
+   */
+  const std::vector<uint32_t> &Grid() const { return grid_; }
+
+  /**
+   * @brief Indices Light indices of all the clusters, one run per cluster.
+   */
+  const std::vector<uint32_t> &Indices() const { return indices_; }
+
+  /**
+   * @brief SliceScale, SliceBias Slice of a fragment at view depth d:
+   * floor(log(d) * SliceScale + SliceBias), clamped to the grid.
+   */
+  float SliceScale() const { return slice_scale_; }
+  float SliceBias() const { return slice_bias_; }
+
+  size_t MaxLightsPerCluster() const { return max_lights_; }
+
+ private:
+  /**
+   * @brief SliceDepth View depth where slice starts.
+   */
+  float SliceDepth(int slice) const;
+
+  std::vector<std::vector<uint32_t>> clusters_;
+  std::vector<uint32_t> grid_;
+  std::vector<uint32_t> indices_;
+  float z_near_;
+  float slice_scale_;
+  float slice_bias_;
+  size_t max_lights_;
+};
+
+}  //  namespace data_visualization
+
+#endif  //  LIGHT_CLUSTERS_H_
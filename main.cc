@@ -1,15 +1,73 @@
 // Author: Marc Comino 2020
 
 #include <QApplication>
+#include <QCoreApplication>
 #include <QSurfaceFormat>
+
+#include <string>
+#include <vector>
+
+#include "./chunked_mesh.h"
 #include "./main_window.h"
+#include "./mesh_io.h"
+#include "./texture_cache.h"
+#include "./thumbnails.h"
+#include "./turntable.h"
+#include "./triangle_mesh.h"
 
 int main(int argc, char *argv[]) {
+    // Offline texture transcoding: ViewerPBS --bake-textures <dir>
+    if (argc == 3 && std::string(argv[1]) == "--bake-textures") {
+      QCoreApplication app(argc, argv);
+      return data_representation::BakeTextureCache(argv[2]) == 0 ? 0 : 1;
+    }
+
+    // Offline out of core preprocessing: ViewerPBS --chunk <model> <output.chunks>
+    if (argc == 4 && std::string(argv[1]) == "--chunk") {
+      std::string input = argv[2];
+      data_representation::TriangleMesh mesh;
+      bool read = input.substr(input.find_last_of(".") + 1) == "obj"
+                      ? data_representation::ReadFromObj(input, &mesh)
+                      : data_representation::ReadFromPly(input, &mesh);
+      return read && data_representation::WriteChunkedMesh(mesh, argv[3]) ? 0 : 1;
+    }
+
+    // Headless thumbnails: ViewerPBS --thumbnails <size> <output dir> <models...>
+    if (argc >= 5 && std::string(argv[1]) == "--thumbnails") {
+      QCoreApplication app(argc, argv);
+      std::vector<std::string> models(argv + 4, argv + argc);
+      return data_visualization::RenderThumbnails(models, argv[3], std::stoi(argv[2])) == 0 ? 0 : 1;
+    }
+
     QApplication a(argc, argv);
     QSurfaceFormat f;
     f.setVersion(3,3);
     f.setProfile(QSurfaceFormat::CoreProfile);
     QSurfaceFormat::setDefaultFormat(f);
+
+    // Batch turntables: ViewerPBS --turntable <views> <size> <output dir>
+    //   [--environment <library> <name>] [--material <library> <name>] <models or folders...>
+    if (argc >= 6 && std::string(argv[1]) == "--turntable") {
+      gui::TurntableSettings settings;
+      settings.views_ = std::stoi(argv[2]);
+      settings.size_ = std::stoi(argv[3]);
+      settings.output_dir_ = argv[4];
+      std::vector<std::string> models;
+      for (int i = 5; i < argc; ++i) {
+        std::string argument = argv[i];
+        if (argument == "--environment" && i + 2 < argc) {
+          settings.environments_ = argv[++i];
+          settings.environment_ = argv[++i];
+        } else if (argument == "--material" && i + 2 < argc) {
+          settings.materials_ = argv[++i];
+          settings.material_ = argv[++i];
+        } else {
+          models.push_back(argument);
+        }
+      }
+      return gui::RenderTurntables(settings, models) == 0 ? 0 : 1;
+    }
+
   gui::MainWindow w;
   w.show();
 
@@ -2,6 +2,7 @@
 
 #include <main_window.h>
 
+#include <QActionGroup>
 #include <QFileDialog>
 #include <QMessageBox>
 #include <QColorDialog>
@@ -12,6 +13,28 @@ namespace gui {
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent), ui(new Ui::MainWindow) {
   ui->setupUi(this);
+  LoadMaterialLibrary("../textures");
+  LoadEnvironmentLibrary("../textures");
+  FillLibraryMenu(ui->menuCapture_Source,
+                  QStringList() << "Frame" << "Albedo" << "Normals" << "Material"
+                                << "Depth" << "SSAO" << "Blurred SSAO",
+                  [this](int i) { ui->glwidget->SetCaptureSource(i); });
+  ui->menuCapture_Source->actions()[0]->setChecked(true);
+  FillFormatMenu(ui->menuGBuffer_Normals, data_visualization::NormalFormats(),
+                 [](data_visualization::GBufferFormats *formats,
+                    const data_visualization::RenderTargetFormat &format) {
+                   formats->normal_ = format;
+                 });
+  FillFormatMenu(ui->menuGBuffer_AO, data_visualization::AoFormats(),
+                 [](data_visualization::GBufferFormats *formats,
+                    const data_visualization::RenderTargetFormat &format) {
+                   formats->ao_ = format;
+                 });
+  FillFormatMenu(ui->menuGBuffer_Depth, data_visualization::DepthFormats(),
+                 [](data_visualization::GBufferFormats *formats,
+                    const data_visualization::RenderTargetFormat &format) {
+                   formats->depth_ = format;
+                 });
 }
 
 MainWindow::~MainWindow() { delete ui; }
@@ -24,7 +47,7 @@ void MainWindow::on_actionLoad_triggered() {
   QString filename;
 
   filename = QFileDialog::getOpenFileName(this, tr("Load model"), "./",
-                                          tr("3D Files ( *.ply *.obj )"));
+                                          tr("3D Files ( *.ply *.obj *.scene *.chunks )"));
   if (!filename.isNull()) {
     if (!ui->glwidget->LoadModel(filename))
       QMessageBox::warning(this, tr("Error"),
@@ -105,6 +128,89 @@ void MainWindow::on_actionLoad_Metalness_triggered()
     }
 }
 
+void MainWindow::on_actionLoad_Occlusion_triggered()
+{
+    QString file =
+        QFileDialog::getOpenFileName(this, "Occlusion texture.", "./");
+    if (!file.isEmpty()) {
+      if (!ui->glwidget->LoadOcclusionMap(file))
+        QMessageBox::warning(this, tr("Error"),
+                             tr("The file could not be opened"));
+    }
+}
+
+void MainWindow::on_actionLoad_MaterialLibrary_triggered() {
+  QString dir =
+      QFileDialog::getExistingDirectory(this, "Material library folder.", "./");
+  if (!dir.isEmpty()) LoadMaterialLibrary(dir);
+}
+
+void MainWindow::on_actionLoad_EnvironmentLibrary_triggered() {
+  QString dir =
+      QFileDialog::getExistingDirectory(this, "Environment library folder.", "./");
+  if (!dir.isEmpty()) LoadEnvironmentLibrary(dir);
+}
+
+void MainWindow::on_actionSave_Screenshot_triggered() {
+  QString file = QFileDialog::getSaveFileName(this, tr("Save screenshot"), "./screenshot.png",
+                                              tr("PNG images ( *.png )"));
+  if (!file.isEmpty()) ui->glwidget->SaveScreenshot(file);
+}
+
+void MainWindow::on_actionRecord_toggled(bool record) {
+  if (!record) {
+    ui->glwidget->StopRecording();
+    return;
+  }
+
+  QString dir = QFileDialog::getExistingDirectory(this, "Recording folder.", "./");
+  if (dir.isEmpty()) {
+    ui->actionRecord->setChecked(false);
+    return;
+  }
+  ui->glwidget->StartRecording(dir + "/frame_", ui->actionRecord_Raw->isChecked());
+}
+
+void MainWindow::LoadMaterialLibrary(const QString &dir) {
+  FillLibraryMenu(ui->menuMaterial, ui->glwidget->LoadMaterialLibrary(dir),
+                  [this](int i) { ui->glwidget->SetMaterial(i); });
+}
+
+void MainWindow::LoadEnvironmentLibrary(const QString &dir) {
+  FillLibraryMenu(ui->menuEnvironment, ui->glwidget->LoadEnvironmentLibrary(dir),
+                  [this](int i) { ui->glwidget->SetEnvironment(i); });
+}
+
+void MainWindow::FillLibraryMenu(QMenu *menu, const QStringList &names,
+                                 const std::function<void(int)> &select) {
+  menu->clear();
+  qDeleteAll(menu->findChildren<QActionGroup *>());
+  QActionGroup *group = new QActionGroup(menu);
+  for (int i = 0; i < names.size(); ++i) {
+    QAction *action = menu->addAction(names[i]);
+    action->setCheckable(true);
+    group->addAction(action);
+    connect(action, &QAction::triggered, this, [select, i]() { select(i); });
+  }
+  menu->setEnabled(!names.isEmpty());
+}
+
+void MainWindow::FillFormatMenu(
+    QMenu *menu, const std::vector<data_visualization::RenderTargetFormat> &formats,
+    const std::function<void(data_visualization::GBufferFormats *,
+                             const data_visualization::RenderTargetFormat &)> &set) {
+  QStringList names;
+  for (const data_visualization::RenderTargetFormat &format : formats)
+    names << QString::fromStdString(data_visualization::FormatName(format));
+  FillLibraryMenu(menu, names, [this, formats, set](int i) {
+    data_visualization::GBufferFormats gbuffer = ui->glwidget->GetGBufferFormats();
+    set(&gbuffer, formats[i]);
+    ui->glwidget->SetGBufferFormats(gbuffer);
+  });
+  // The first format is the default one
+  menu->actions()[0]->setChecked(true);
+}
+
 void gui::MainWindow::on_button_Albedo_Color_clicked() {
   QColor color = QColorDialog::getColor(Qt::white, this, "Select Albedo Color");
   
@@ -4,6 +4,14 @@
 #define MAIN_WINDOW_H_
 
 #include <QMainWindow>
+#include <QMenu>
+#include <QString>
+#include <QStringList>
+
+#include <functional>
+#include <vector>
+
+#include "./gbuffer_formats.h"
 
 namespace Ui {
 class MainWindow;
@@ -73,6 +81,36 @@ class MainWindow : public QMainWindow {
    */
   void on_actionLoad_Metalness_triggered();
 
+  /**
+   * @brief on_actionLoad_Occlusion_triggered Opens a file dialog to load a texture
+   * map that will be used for the ambient occlusion component.
+   */
+  void on_actionLoad_Occlusion_triggered();
+
+  /**
+   * @brief on_actionLoad_MaterialLibrary_triggered Opens a file dialog to
+   * choose the folder scanned for the materials of the Material menu.
+   */
+  void on_actionLoad_MaterialLibrary_triggered();
+
+  /**
+   * @brief on_actionLoad_EnvironmentLibrary_triggered Opens a file dialog to
+   * choose the folder scanned for the environments of the Environment menu.
+   */
+  void on_actionLoad_EnvironmentLibrary_triggered();
+
+  /**
+   * @brief on_actionSave_Screenshot_triggered Opens a file dialog to save the
+   * next frame as PNG.
+   */
+  void on_actionSave_Screenshot_triggered();
+
+  /**
+   * @brief on_actionRecord_toggled Opens a file dialog to choose the folder
+   * the frames are written to and starts recording, or stops it.
+   */
+  void on_actionRecord_toggled(bool record);
+
   /**
    * @brief on_button_Albedo_Color_clicked Opens a color dialog to set the albedo color.
   */
@@ -80,6 +118,34 @@ class MainWindow : public QMainWindow {
 
 
  private:
+  /**
+   * @brief LoadMaterialLibrary Scans dir for materials and lists them in the
+   * Material menu, selecting one of them switches the rendered material.
+   */
+  void LoadMaterialLibrary(const QString &dir);
+
+  /**
+   * @brief LoadEnvironmentLibrary Scans dir for environments and lists them in
+   * the Environment menu, selecting one of them switches the sky and IBL maps.
+   */
+  void LoadEnvironmentLibrary(const QString &dir);
+
+  /**
+   * @brief FillLibraryMenu Replaces the actions of menu by one exclusive
+   * checkable action per name, calling select with its index when triggered.
+   */
+  void FillLibraryMenu(QMenu *menu, const QStringList &names,
+                       const std::function<void(int)> &select);
+
+  /**
+   * @brief FillFormatMenu Lists formats in menu, selecting one of them sets it
+   * in the G-Buffer formats of the viewer through set.
+   */
+  void FillFormatMenu(
+      QMenu *menu, const std::vector<data_visualization::RenderTargetFormat> &formats,
+      const std::function<void(data_visualization::GBufferFormats *,
+                               const data_visualization::RenderTargetFormat &)> &set);
+
   Ui::MainWindow *ui;
 };
 
@@ -0,0 +1,13 @@
+#include <material_library.h>
+
+namespace data_representation {
+
+MaterialLibrary::MaterialLibrary(size_t budget) : resident_(budget) {}
+
+size_t MaterialLibrary::Scan(const std::string &dir) {
+  materials_ = FindMaterials(dir);
+  resident_.Reset(materials_.size());
+  return materials_.size();
+}
+
+}  // namespace data_representation
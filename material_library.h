@@ -0,0 +1,83 @@
+#ifndef MATERIAL_LIBRARY_H_
+#define MATERIAL_LIBRARY_H_
+
+#include <resident_set.h>
+#include <texture_cache.h>
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace data_representation {
+
+/**
+ * @brief MaterialLibrary Materials found in a textures folder and the GPU
+ * textures of the ones that are currently resident. Resident materials are
+ * kept under a memory budget, evicting the least recently used ones first.
+ * The library only does the bookkeeping, the owner creates and deletes the
+ * textures.
+ */
+class MaterialLibrary {
+ public:
+  /**
+   * @brief Resident GPU textures of a material and the memory they use.
+   */
+  struct Resident {
+    unsigned int color_map_;
+    unsigned int orm_map_;
+    size_t bytes_;
+  };
+
+  /**
+   * @brief MaterialLibrary Creates an empty library.
+   * @param budget Maximum bytes of the resident textures.
+   */
+  explicit MaterialLibrary(size_t budget);
+
+  /**
+   * @brief Scan Replaces the materials by the ones found in dir (see
+   * FindMaterials). The resident textures have to be released with Clear
+   * before.
+   * @return The number of materials found.
+   */
+  size_t Scan(const std::string &dir);
+
+  size_t Size() const { return materials_.size(); }
+  const MaterialMaps &Maps(size_t index) const { return materials_[index]; }
+  size_t ResidentBytes() const { return resident_.Bytes(); }
+
+  /**
+   * @brief Use Looks up the textures of a resident material and marks it as
+   * the most recently used one.
+   * @return Whether the material is resident.
+   */
+  bool Use(size_t index, Resident *resident) {
+    return resident_.Use(index, resident);
+  }
+
+  /**
+   * @brief Insert Makes a material resident with the given textures and
+   * evicts the least recently used materials until the budget is met again.
+   * The inserted material is never evicted.
+   * @param evicted Textures of the evicted materials, to be deleted by the
+   * caller.
+   */
+  void Insert(size_t index, const Resident &resident,
+              std::vector<Resident> *evicted) {
+    resident_.Insert(index, resident, resident.bytes_, evicted);
+  }
+
+  /**
+   * @brief Clear Evicts every material.
+   * @return Textures of the evicted materials, to be deleted by the caller.
+   */
+  std::vector<Resident> Clear() { return resident_.Clear(); }
+
+ private:
+  std::vector<MaterialMaps> materials_;
+  ResidentSet<Resident> resident_;
+};
+
+}  // namespace data_representation
+
+#endif  // MATERIAL_LIBRARY_H_
@@ -0,0 +1,395 @@
+#include <mesh_buffers.h>
+
+#include <glm/geometric.hpp>
+#include <glm/matrix.hpp>
+#include <glm/vec4.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+namespace data_visualization {
+
+MeshBuffers::MeshBuffers()
+    : gl_(nullptr),
+      positions_{0, GL_ARRAY_BUFFER, 0},
+      normals_{0, GL_ARRAY_BUFFER, 0},
+      tex_coords_{0, GL_ARRAY_BUFFER, 0},
+      material_ids_{0, GL_ARRAY_BUFFER, 0},
+      occlusion_{0, GL_ARRAY_BUFFER, 0},
+      indices_{0, GL_ELEMENT_ARRAY_BUFFER, 0},
+      instances_{0, GL_ARRAY_BUFFER, 0},
+      materials_{0, GL_TEXTURE_BUFFER, 0},
+      material_texture_(0),
+      vertex_array_(0),
+      position_array_(0),
+      meshlet_count_(0),
+      visible_meshlets_(0),
+      peak_bytes_(0) {}
+
+void MeshBuffers::Initialize(QOpenGLFunctions_3_3_Core *gl) {
+  gl_ = gl;
+  for (Buffer *buffer : {&positions_, &normals_, &tex_coords_, &material_ids_,
+                         &occlusion_, &indices_, &instances_, &materials_})
+    gl_->glGenBuffers(1, &buffer->id_);
+  gl_->glGenVertexArrays(1, &vertex_array_);
+  gl_->glGenVertexArrays(1, &position_array_);
+
+  // The buffer texture references the buffer object, it follows its storage
+  gl_->glGenTextures(1, &material_texture_);
+  gl_->glBindTexture(GL_TEXTURE_BUFFER, material_texture_);
+  gl_->glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, materials_.id_);
+  gl_->glBindTexture(GL_TEXTURE_BUFFER, 0);
+
+  // The attribute pointers keep referencing the same buffer objects when
+  // their storage is reallocated, so the vertex arrays are only set up once
+  gl_->glBindVertexArray(vertex_array_);
+  gl_->glBindBuffer(GL_ARRAY_BUFFER, positions_.id_);
+  gl_->glVertexAttribPointer(kVertexAttributeIdx, 3, GL_FLOAT, GL_FALSE, 0, (void *)0);
+  gl_->glEnableVertexAttribArray(kVertexAttributeIdx);
+  gl_->glBindBuffer(GL_ARRAY_BUFFER, normals_.id_);
+  gl_->glVertexAttribPointer(kNormalAttributeIdx, 3, GL_FLOAT, GL_FALSE, 0, (void *)0);
+  gl_->glEnableVertexAttribArray(kNormalAttributeIdx);
+  gl_->glBindBuffer(GL_ARRAY_BUFFER, tex_coords_.id_);
+  gl_->glVertexAttribPointer(kTexCoordAttributeIdx, 2, GL_FLOAT, GL_FALSE, 0, (void *)0);
+  gl_->glEnableVertexAttribArray(kTexCoordAttributeIdx);
+  gl_->glBindBuffer(GL_ARRAY_BUFFER, material_ids_.id_);
+  gl_->glVertexAttribIPointer(kMaterialAttributeIdx, 1, GL_INT, 0, (void *)0);
+  gl_->glEnableVertexAttribArray(kMaterialAttributeIdx);
+  gl_->glBindBuffer(GL_ARRAY_BUFFER, occlusion_.id_);
+  gl_->glVertexAttribPointer(kOcclusionAttributeIdx, 1, GL_FLOAT, GL_FALSE, 0, (void *)0);
+  gl_->glEnableVertexAttribArray(kOcclusionAttributeIdx);
+  SetInstanceAttributes(0);
+  gl_->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indices_.id_);
+
+  gl_->glBindVertexArray(position_array_);
+  gl_->glBindBuffer(GL_ARRAY_BUFFER, positions_.id_);
+  gl_->glVertexAttribPointer(kVertexAttributeIdx, 3, GL_FLOAT, GL_FALSE, 0, (void *)0);
+  gl_->glEnableVertexAttribArray(kVertexAttributeIdx);
+  SetInstanceAttributes(0);
+  gl_->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indices_.id_);
+
+  gl_->glBindVertexArray(0);
+  gl_->glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void MeshBuffers::Release() {
+  if (gl_ == nullptr) return;
+
+  for (Buffer *buffer : {&positions_, &normals_, &tex_coords_, &material_ids_,
+                         &occlusion_, &indices_, &instances_, &materials_}) {
+    gl_->glDeleteBuffers(1, &buffer->id_);
+    buffer->id_ = 0;
+    buffer->capacity_ = 0;
+  }
+  gl_->glDeleteTextures(1, &material_texture_);
+  gl_->glDeleteVertexArrays(1, &vertex_array_);
+  gl_->glDeleteVertexArrays(1, &position_array_);
+  material_texture_ = vertex_array_ = position_array_ = 0;
+  parts_.clear();
+  meshlet_count_ = visible_meshlets_ = 0;
+  gl_ = nullptr;
+}
+
+void MeshBuffers::Upload(const data_representation::Scene &scene) {
+  std::vector<float> positions, normals, tex_coords, occlusion;
+  std::vector<GLint> material_ids;
+  std::vector<GLuint> indices;
+  std::vector<glm::mat4> instances;
+  // Material 0 is the global one
+  std::vector<float> materials(kTexelsPerMaterial * 4, -1.0f);
+
+  std::vector<std::vector<glm::mat4>> transforms = scene.Instances();
+  parts_.clear();
+  meshlet_count_ = visible_meshlets_ = 0;
+  for (size_t i = 0; i < scene.MeshCount(); ++i) {
+    const data_representation::TriangleMesh &mesh = scene.Mesh(i);
+    if (transforms[i].empty() || mesh.faces_.empty()) continue;
+
+    const size_t kFirstVertex = positions.size() / 3;
+    const size_t kVertices = mesh.vertices_.size() / 3;
+    const GLint kFirstMaterial = materials.size() / (kTexelsPerMaterial * 4);
+
+    // Missing streams are zero filled to keep the meshes aligned
+    positions.insert(positions.end(), mesh.vertices_.begin(), mesh.vertices_.end());
+    if (mesh.normals_.size() == kVertices * 3)
+      normals.insert(normals.end(), mesh.normals_.begin(), mesh.normals_.end());
+    normals.resize(positions.size(), 0.0f);
+    if (mesh.texCoords_.size() == kVertices * 2)
+      tex_coords.insert(tex_coords.end(), mesh.texCoords_.begin(), mesh.texCoords_.end());
+    tex_coords.resize((kFirstVertex + kVertices) * 2, 0.0f);
+    if (mesh.ao_.size() == kVertices)
+      occlusion.insert(occlusion.end(), mesh.ao_.begin(), mesh.ao_.end());
+    occlusion.resize(kFirstVertex + kVertices, 1.0f);
+
+    material_ids.resize(kFirstVertex + kVertices, 0);
+    for (const data_representation::FaceRange &range : mesh.ranges_) {
+      if (range.material_ < 0) continue;
+      for (size_t j = range.first_; j < range.first_ + range.count_; ++j)
+        material_ids[kFirstVertex + mesh.faces_[j]] = kFirstMaterial + range.material_;
+    }
+    for (const data_representation::MeshMaterial &material : mesh.materials_) {
+      float texels[kTexelsPerMaterial * 4] = {
+          material.diffuse_.r, material.diffuse_.g, material.diffuse_.b,
+          material.roughness_, material.metalness_, 0.0f, 0.0f, 0.0f};
+      materials.insert(materials.end(), texels, texels + kTexelsPerMaterial * 4);
+    }
+
+    Part part = {{}, 0, instances.size(), static_cast<GLsizei>(transforms[i].size()),
+                 transforms[i], (mesh.min_ + mesh.max_) * 0.5f,
+                 glm::length(mesh.max_ - mesh.min_) * 0.5f, {}, false, {}, {}};
+    // Culling every instance separately would take a draw per instance
+    if (transforms[i].size() == 1) {
+      part.meshlets_ = mesh.meshlets_;
+      for (data_representation::Meshlet &meshlet : part.meshlets_)
+        meshlet.first_ += indices.size();
+      meshlet_count_ += part.meshlets_.size();
+    }
+
+    // The levels of detail follow the mesh faces
+    part.lods_.push_back({indices.size(), static_cast<GLsizei>(mesh.faces_.size())});
+    for (int index : mesh.faces_) indices.push_back(kFirstVertex + index);
+    for (const std::vector<int> &lod : mesh.lods_) {
+      part.lods_.push_back({indices.size(), static_cast<GLsizei>(lod.size())});
+      for (int index : lod) indices.push_back(kFirstVertex + index);
+    }
+    parts_.push_back(std::move(part));
+    instances.insert(instances.end(), transforms[i].begin(), transforms[i].end());
+  }
+
+  // The element buffer binding belongs to the vertex array
+  gl_->glBindVertexArray(0);
+
+  Write(&positions_, positions.data(), positions.size() * sizeof(float));
+  Write(&normals_, normals.data(), normals.size() * sizeof(float));
+  Write(&tex_coords_, tex_coords.data(), tex_coords.size() * sizeof(float));
+  Write(&material_ids_, material_ids.data(), material_ids.size() * sizeof(GLint));
+  Write(&occlusion_, occlusion.data(), occlusion.size() * sizeof(float));
+  Write(&instances_, instances.data(), instances.size() * sizeof(glm::mat4));
+  Write(&materials_, materials.data(), materials.size() * sizeof(float));
+  gl_->glBindVertexArray(vertex_array_);
+  Write(&indices_, indices.data(), indices.size() * sizeof(GLuint));
+  gl_->glBindVertexArray(0);
+  gl_->glBindBuffer(GL_ARRAY_BUFFER, 0);
+  gl_->glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+  peak_bytes_ = std::max(peak_bytes_, Bytes());
+}
+
+void MeshBuffers::BeginStream(const data_representation::TriangleMesh &mesh,
+                              const std::vector<float> &normals,
+                              size_t index_count) {
+  const size_t kVertices = mesh.vertices_.size() / 3;
+  std::vector<float> tex_coords(kVertices * 2, 0.0f);
+  std::vector<GLint> material_ids(kVertices, 0);
+  std::vector<float> occlusion(kVertices, 1.0f);
+  std::vector<float> materials(kTexelsPerMaterial * 4, -1.0f);
+  glm::mat4 identity(1.0f);
+
+  parts_.clear();
+  meshlet_count_ = visible_meshlets_ = 0;
+  parts_.push_back({{{0, 0}}, 0, 0, 1, {identity}, (mesh.min_ + mesh.max_) * 0.5f,
+                    glm::length(mesh.max_ - mesh.min_) * 0.5f, {}, false, {}, {}});
+
+  gl_->glBindVertexArray(0);
+  Write(&positions_, mesh.vertices_.data(), mesh.vertices_.size() * sizeof(float));
+  Write(&normals_, normals.data(), normals.size() * sizeof(float));
+  Write(&tex_coords_, tex_coords.data(), tex_coords.size() * sizeof(float));
+  Write(&material_ids_, material_ids.data(), material_ids.size() * sizeof(GLint));
+  Write(&occlusion_, occlusion.data(), occlusion.size() * sizeof(float));
+  Write(&instances_, &identity, sizeof(glm::mat4));
+  Write(&materials_, materials.data(), materials.size() * sizeof(float));
+  gl_->glBindVertexArray(vertex_array_);
+  // Orphaning the indices of the previous model, which frames in flight may
+  // still read, is what lets AppendFaces write without synchronizing
+  gl_->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indices_.id_);
+  indices_.capacity_ = std::max(indices_.capacity_, index_count * sizeof(GLuint));
+  gl_->glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices_.capacity_, nullptr, GL_STATIC_DRAW);
+  gl_->glBindVertexArray(0);
+  gl_->glBindBuffer(GL_ARRAY_BUFFER, 0);
+  gl_->glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+  peak_bytes_ = std::max(peak_bytes_, Bytes());
+}
+
+void MeshBuffers::AppendFaces(const std::vector<int> &indices) {
+  if (parts_.size() != 1 || indices.empty()) return;
+
+  // The vertices of the streamed mesh start at 0, so its indices are the
+  // ones of the file
+  Range &range = parts_[0].lods_[0];
+  const size_t kOffset = (range.first_index_ + range.index_count_) * sizeof(GLuint);
+  const size_t kBytes = indices.size() * sizeof(GLuint);
+  if (kOffset + kBytes > indices_.capacity_) return;
+
+  gl_->glBindVertexArray(vertex_array_);
+  Append(&indices_, kOffset, indices.data(), kBytes);
+  gl_->glBindVertexArray(0);
+  range.index_count_ += indices.size();
+}
+
+void MeshBuffers::SetView(const glm::mat4 &model, const glm::mat4 &view,
+                          const glm::mat4 &projection, int viewport_height,
+                          bool backfaces) {
+  visible_meshlets_ = 0;
+  const glm::mat4 kViewProjection = projection * view;
+  const glm::vec3 kEye = glm::vec3(glm::inverse(view) * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+  for (Part &part : parts_) {
+    part.lod_ = SelectLod(part, model, view, projection, viewport_height);
+    part.culled_ = false;
+    if (part.meshlets_.empty() || part.lod_ > 0) continue;
+
+    // Frustum planes of the clip matrix, in the space of the mesh, with unit
+    // normals so that they give distances to compare with the radii
+    glm::mat4 to_clip = kViewProjection * model * part.transforms_[0];
+    glm::vec4 planes[6];
+    for (int axis = 0; axis < 3; ++axis) {
+      for (int side = 0; side < 2; ++side) {
+        glm::vec4 plane;
+        for (int column = 0; column < 4; ++column)
+          plane[column] = to_clip[column][3] +
+                          (side == 0 ? 1.0f : -1.0f) * to_clip[column][axis];
+        planes[2 * axis + side] = plane / glm::length(glm::vec3(plane));
+      }
+    }
+    glm::vec3 local_eye = glm::vec3(glm::inverse(model * part.transforms_[0]) *
+                                    glm::vec4(kEye, 1.0f));
+
+    part.culled_ = true;
+    part.counts_.clear();
+    part.offsets_.clear();
+    size_t run_end = 0;
+    for (const data_representation::Meshlet &meshlet : part.meshlets_) {
+      bool visible = true;
+      for (int i = 0; i < 6 && visible; ++i)
+        visible = glm::dot(glm::vec3(planes[i]), meshlet.center_) + planes[i].w >
+                  -meshlet.radius_;
+      // Every view ray from the eye to the sphere is within 90 degrees of
+      // every normal of the cone
+      if (visible && backfaces) {
+        glm::vec3 to_center = meshlet.center_ - local_eye;
+        visible = glm::dot(to_center, meshlet.cone_axis_) <
+                  meshlet.cone_cutoff_ * glm::length(to_center) + meshlet.radius_;
+      }
+      if (!visible) continue;
+
+      ++visible_meshlets_;
+      if (!part.counts_.empty() && run_end == meshlet.first_) {
+        part.counts_.back() += meshlet.count_;
+      } else {
+        part.counts_.push_back(meshlet.count_);
+        part.offsets_.push_back((void *)(meshlet.first_ * sizeof(GLuint)));
+      }
+      run_end = meshlet.first_ + meshlet.count_;
+    }
+  }
+}
+
+size_t MeshBuffers::SelectLod(const Part &part, const glm::mat4 &model,
+                              const glm::mat4 &view, const glm::mat4 &projection,
+                              int viewport_height) const {
+  if (part.lods_.size() == 1) return 0;
+
+  // Radius in pixels of the largest instance
+  float pixels = 0.0f;
+  for (const glm::mat4 &transform : part.transforms_) {
+    glm::mat4 to_view = view * model * transform;
+    float scale = std::max(glm::length(glm::vec3(to_view[0])),
+                           std::max(glm::length(glm::vec3(to_view[1])),
+                                    glm::length(glm::vec3(to_view[2]))));
+    float radius = part.radius_ * scale;
+    float distance = glm::length(glm::vec3(to_view * glm::vec4(part.center_, 1.0f)));
+    // Inside the sphere the mesh may fill the screen
+    if (distance <= radius) return 0;
+    pixels = std::max(pixels, radius / distance * projection[1][1] * 0.5f * viewport_height);
+  }
+  const float kNeeded = 3.14159265f * pixels * pixels / kLodPixelsPerTriangle;
+
+  // Coarsest level with at least triangles, 0 if none
+  auto coarsest = [&part](float triangles) {
+    size_t level = 0;
+    while (level + 1 < part.lods_.size() &&
+           part.lods_[level + 1].index_count_ / 3 >= triangles)
+      ++level;
+    return level;
+  };
+  // Refining is immediate, coarsening waits for a margin
+  size_t level = std::min(part.lod_, part.lods_.size() - 1);
+  if (part.lods_[level].index_count_ / 3 < kNeeded) return coarsest(kNeeded);
+  return std::max(level, coarsest(kNeeded * (1.0f + kLodHysteresis)));
+}
+
+void MeshBuffers::Draw() { DrawParts(vertex_array_); }
+
+void MeshBuffers::DrawPositions() { DrawParts(position_array_); }
+
+size_t MeshBuffers::Bytes() const {
+  return positions_.capacity_ + normals_.capacity_ + tex_coords_.capacity_ +
+         material_ids_.capacity_ + occlusion_.capacity_ + indices_.capacity_ +
+         instances_.capacity_ + materials_.capacity_;
+}
+
+void MeshBuffers::SetInstanceAttributes(size_t first_instance) {
+  gl_->glBindBuffer(GL_ARRAY_BUFFER, instances_.id_);
+  for (int column = 0; column < 4; ++column) {
+    size_t offset = first_instance * sizeof(glm::mat4) + column * sizeof(glm::vec4);
+    gl_->glVertexAttribPointer(kInstanceAttributeIdx + column, 4, GL_FLOAT, GL_FALSE,
+                               sizeof(glm::mat4), (void *)offset);
+    gl_->glEnableVertexAttribArray(kInstanceAttributeIdx + column);
+    gl_->glVertexAttribDivisor(kInstanceAttributeIdx + column, 1);
+  }
+}
+
+void MeshBuffers::DrawParts(GLuint vertex_array) {
+  gl_->glBindVertexArray(vertex_array);
+  for (const Part &part : parts_) {
+    SetInstanceAttributes(part.first_instance_);
+    // Non instanced draws read the first element of the instance attributes
+    if (part.culled_) {
+      if (!part.counts_.empty())
+        gl_->glMultiDrawElements(GL_TRIANGLES, part.counts_.data(), GL_UNSIGNED_INT,
+                                 part.offsets_.data(), part.counts_.size());
+      continue;
+    }
+    const Range &range = part.lods_[part.lod_];
+    gl_->glDrawElementsInstanced(GL_TRIANGLES, range.index_count_, GL_UNSIGNED_INT,
+                                 (void *)(range.first_index_ * sizeof(GLuint)),
+                                 part.instance_count_);
+  }
+  gl_->glBindVertexArray(0);
+  gl_->glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void MeshBuffers::Write(Buffer *buffer, const void *data, size_t bytes) {
+  gl_->glBindBuffer(buffer->target_, buffer->id_);
+  if (bytes > buffer->capacity_) {
+    buffer->capacity_ = std::max(bytes, 2 * buffer->capacity_);
+    gl_->glBufferData(buffer->target_, buffer->capacity_, nullptr, GL_STATIC_DRAW);
+  }
+  if (bytes == 0) return;
+
+  // Invalidating the range lets the driver hand out fresh memory instead of
+  // waiting for the draws that still read the previous mesh
+  void *destination = gl_->glMapBufferRange(
+      buffer->target_, 0, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+  if (destination != nullptr) {
+    std::memcpy(destination, data, bytes);
+    if (gl_->glUnmapBuffer(buffer->target_) == GL_TRUE) return;
+  }
+  gl_->glBufferSubData(buffer->target_, 0, bytes, data);
+}
+
+void MeshBuffers::Append(Buffer *buffer, size_t offset, const void *data,
+                         size_t bytes) {
+  gl_->glBindBuffer(buffer->target_, buffer->id_);
+  void *destination = gl_->glMapBufferRange(
+      buffer->target_, offset, bytes,
+      GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+  if (destination != nullptr) {
+    std::memcpy(destination, data, bytes);
+    if (gl_->glUnmapBuffer(buffer->target_) == GL_TRUE) return;
+  }
+  gl_->glBufferSubData(buffer->target_, offset, bytes, data);
+}
+
+}  //  namespace data_visualization
@@ -0,0 +1,284 @@
+#ifndef MESH_BUFFERS_H_
+#define MESH_BUFFERS_H_
+
+#include <QOpenGLFunctions_3_3_Core>
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+
+#include <cstddef>
+#include <vector>
+
+#include "./scene.h"
+
+namespace data_visualization {
+
+/**
+ * @brief Vertex attribute locations of the mesh streams, shared by all the
+ * mesh shaders.
+ */
+const int kVertexAttributeIdx = 0;
+const int kNormalAttributeIdx = 1;
+const int kTexCoordAttributeIdx = 2;
+
+/**
+ * @brief kInstanceAttributeIdx First of the four consecutive locations of the
+ * per-instance transform (a mat4, one column per location).
+ */
+const int kInstanceAttributeIdx = 3;
+
+/**
+ * @brief kMaterialAttributeIdx Location of the integer material index of each
+ * vertex into the material buffer texture.
+ */
+const int kMaterialAttributeIdx = 7;
+
+/**
+ * @brief kOcclusionAttributeIdx Location of the baked ambient visibility of
+ * each vertex, 1 for the meshes without one.
+ */
+const int kOcclusionAttributeIdx = 8;
+
+/**
+ * @brief kTexelsPerMaterial RGBA32F texels used by a material in the material
+ * buffer texture: (albedo, roughness) and (metalness, 0, 0, 0). Negative
+ * values stand for the global value of the viewer. Material 0 is the global
+ * material itself.
+ */
+const int kTexelsPerMaterial = 2;
+
+/**
+ * @brief kLodPixelsPerTriangle Screen area, in pixels, that the level of
+ * detail of a mesh aims to give each of its triangles, measured over the
+ * projection of its bounding sphere.
+ */
+const float kLodPixelsPerTriangle = 4.0f;
+
+/**
+ * @brief kLodHysteresis A mesh only switches to a coarser level when it still
+ * has 1 + kLodHysteresis times the triangles needed, so that small camera
+ * motions around a threshold do not make it pop back and forth.
+ */
+const float kLodHysteresis = 0.5f;
+
+/**
+ * @brief MeshBuffers GPU buffers and vertex arrays of all the meshes of a
+ * scene, packed one after the other in a single set of vertex, index and
+ * instance buffers. The buffer objects and vertex arrays are created once and
+ * reused by every upload: a new scene is written into the existing storage
+ * when it fits, and the storage grows geometrically (at least doubling) when
+ * it does not, so cycling through many models neither leaks buffers nor
+ * reallocates them on every load.
+ *
+ * Every vertex carries the index of its material in a buffer texture of
+ * material parameters, so the faces of all the materials of a mesh are drawn
+ * together: each mesh takes a single instanced draw, however many materials
+ * and instances it has.
+ *
+ * The levels of detail of a mesh (see data_representation::BuildLods) are
+ * stored after its faces in the index buffer and share its vertices, so
+ * switching level only changes the index range of its draw. A mesh takes the
+ * level needed by its largest instance on screen.
+ *
+ * At full detail, the meshes drawn by a single instance are additionally
+ * drawn by meshlets (see data_representation::Meshlet): SetView tests their
+ * bounds against the view of the frame and the draws that follow only submit
+ * the ones that may be visible, merging consecutive meshlets into a single
+ * range of a multi draw. Instanced meshes are always drawn whole.
+ *
+ * A mesh can also be shown while its faces are still being read: BeginStream
+ * uploads its vertices and reserves its indices, and AppendFaces adds the
+ * faces read since, so each frame draws whatever has arrived.
+ */
+class MeshBuffers {
+ public:
+  MeshBuffers();
+
+  /**
+   * @brief Initialize Creates the buffers, the material buffer texture and
+   * the vertex arrays. Needs a current context.
+   * @param gl Functions of the context the buffers belong to.
+   */
+  void Initialize(QOpenGLFunctions_3_3_Core *gl);
+
+  /**
+   * @brief Release Deletes the buffers, the texture and the vertex arrays.
+   * Needs a current context.
+   */
+  void Release();
+
+  /**
+   * @brief Upload Replaces the contents of the buffers by the vertices,
+   * normals, texture coordinates, baked occlusion, faces and materials of the
+   * meshes of scene
+   * and the transforms of the nodes placing them. A vertex takes the material
+   * of the last range using it, faces of different materials are not expected
+   * to share vertices.
+   */
+  void Upload(const data_representation::Scene &scene);
+
+  /**
+   * @brief BeginStream Replaces the contents of the buffers by a single mesh
+   * whose faces are still being read, drawn once with the identity transform
+   * and the global material. Only the vertices_, min_ and max_ of mesh are
+   * read; the index buffer is sized for index_count indices, which are then
+   * added by AppendFaces. A later Upload replaces the stream.
+   * @param normals Normals to draw the mesh with until it is uploaded whole.
+   */
+  void BeginStream(const data_representation::TriangleMesh &mesh,
+                   const std::vector<float> &normals, size_t index_count);
+
+  /**
+   * @brief AppendFaces Adds indices to the streamed mesh, drawn from the next
+   * draw on. They are written after the previous ones, into storage no draw
+   * reads yet, so the upload never waits for the GPU.
+   */
+  void AppendFaces(const std::vector<int> &indices);
+
+  /**
+   * @brief SetView Prepares the next draws for a view: picks the level of
+   * detail of every mesh from the size of its projected bounding sphere, and
+   * culls the meshlets of the full detail single instance meshes whose
+   * bounding sphere is outside the frustum or, with backfaces, whose
+   * triangles all face away from the camera. The backface test is only valid
+   * when back faces are not rasterized.
+   * @param viewport_height Height of the viewport in pixels.
+   */
+  void SetView(const glm::mat4 &model, const glm::mat4 &view,
+               const glm::mat4 &projection, int viewport_height, bool backfaces);
+
+  /**
+   * @brief Draw Draws every instance of every mesh with the full vertex
+   * array, one draw per mesh, at the level of detail and with the meshlets
+   * selected by the last SetView.
+   */
+  void Draw();
+
+  /**
+   * @brief DrawPositions Same as Draw with the position only vertex array,
+   * for depth only passes.
+   */
+  void DrawPositions();
+
+  /**
+   * @brief MaterialTexture Buffer texture of the material parameters, see
+   * kTexelsPerMaterial.
+   */
+  GLuint MaterialTexture() const { return material_texture_; }
+
+  /**
+   * @brief DrawCount Draws issued by Draw and DrawPositions.
+   */
+  size_t DrawCount() const { return parts_.size(); }
+
+  /**
+   * @brief MeshletCount Meshlets of the meshes drawn by a single instance.
+   */
+  size_t MeshletCount() const { return meshlet_count_; }
+
+  /**
+   * @brief VisibleMeshlets Meshlets kept by the last SetView.
+   */
+  size_t VisibleMeshlets() const { return visible_meshlets_; }
+
+  /**
+   * @brief Bytes Current GPU memory of the buffers (their capacity).
+   */
+  size_t Bytes() const;
+
+  /**
+   * @brief PeakBytes Largest value of Bytes since Initialize.
+   */
+  size_t PeakBytes() const { return peak_bytes_; }
+
+ private:
+  /**
+   * @brief Buffer A buffer object and the bytes allocated for it.
+   */
+  struct Buffer {
+    GLuint id_;
+    GLenum target_;
+    size_t capacity_;
+  };
+
+  /**
+   * @brief Range A range of indices_.
+   */
+  struct Range {
+    size_t first_index_;
+    GLsizei index_count_;
+  };
+
+  /**
+   * @brief Part Index ranges of the levels of detail of one mesh of the
+   * scene (level 0 being the mesh itself), its instances and its bounding
+   * sphere. A single instance part keeps its meshlets, rebased to indices_,
+   * and the index ranges of the visible ones (counts_, offsets_) once culled.
+   */
+  struct Part {
+    std::vector<Range> lods_;
+    size_t lod_;
+    size_t first_instance_;
+    GLsizei instance_count_;
+    std::vector<glm::mat4> transforms_;
+    glm::vec3 center_;
+    float radius_;
+    std::vector<data_representation::Meshlet> meshlets_;
+    bool culled_;
+    std::vector<GLsizei> counts_;
+    std::vector<const void *> offsets_;
+  };
+
+  /**
+   * @brief Write Copies bytes of data to the start of buffer, growing its
+   * storage first if needed.
+   */
+  void Write(Buffer *buffer, const void *data, size_t bytes);
+
+  /**
+   * @brief Append Copies bytes of data at offset of buffer, within its
+   * storage, without synchronizing with the draws: the range must not be read
+   * by any pending one.
+   */
+  void Append(Buffer *buffer, size_t offset, const void *data, size_t bytes);
+
+  /**
+   * @brief SetInstanceAttributes Points the instance transform locations of
+   * the bound vertex array to instances_, starting at first_instance. GL 3.3
+   * has no base instance for the draws, so this is how each mesh reaches its
+   * own transforms.
+   */
+  void SetInstanceAttributes(size_t first_instance);
+
+  /**
+   * @brief SelectLod Level of detail of part for a view, see SetView.
+   */
+  size_t SelectLod(const Part &part, const glm::mat4 &model, const glm::mat4 &view,
+                   const glm::mat4 &projection, int viewport_height) const;
+
+  /**
+   * @brief DrawParts Draws every part with vertex_array.
+   */
+  void DrawParts(GLuint vertex_array);
+
+  QOpenGLFunctions_3_3_Core *gl_;
+  Buffer positions_;
+  Buffer normals_;
+  Buffer tex_coords_;
+  Buffer material_ids_;
+  Buffer occlusion_;
+  Buffer indices_;
+  Buffer instances_;
+  Buffer materials_;
+  GLuint material_texture_;
+  GLuint vertex_array_;
+  GLuint position_array_;
+  std::vector<Part> parts_;
+  size_t meshlet_count_;
+  size_t visible_meshlets_;
+  size_t peak_bytes_;
+};
+
+}  //  namespace data_visualization
+
+#endif  //  MESH_BUFFERS_H_
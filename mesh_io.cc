@@ -35,6 +35,7 @@ void Add3Items(T i1, T i2, T i3, size_t index, std::vector<T> *vector) {
 bool ReadPlyHeader(std::ifstream *fin, int *vertices, int *faces) {
   char line[100];
 
+  hasNormals = false;
   fin->getline(line, 100);
   if (strncmp(line, "ply", 3) != 0) return false;
 
@@ -75,11 +76,18 @@ void ReadPlyVertices(std::ifstream *fin, TriangleMesh *mesh) {
   }
 }
 
-void ReadPlyFaces(std::ifstream *fin, TriangleMesh *mesh) {
+bool ReadPlyFaces(std::ifstream *fin, TriangleMesh *mesh, PlyStream *stream) {
   unsigned char vertex_per_face;
 
   const size_t kFaces = mesh->faces_.size() / 3;
+  size_t pushed = 0;
   for (size_t i = 0; i < kFaces; ++i) {
+    if (stream != nullptr && i - pushed == kPlyStreamFaces) {
+      if (stream->Cancelled()) return false;
+      stream->PushFaces(&mesh->faces_[pushed * 3], (i - pushed) * 3);
+      pushed = i;
+    }
+
     int v1, v2, v3;
     fin->read(reinterpret_cast<char *>(&vertex_per_face),
               sizeof(unsigned char));
@@ -90,6 +98,9 @@ void ReadPlyFaces(std::ifstream *fin, TriangleMesh *mesh) {
     fin->read(reinterpret_cast<char *>(&v3), sizeof(int));
     Add3Items(v1, v2, v3, i * 3, &(mesh->faces_));
   }
+  if (stream != nullptr && kFaces > pushed)
+    stream->PushFaces(&mesh->faces_[pushed * 3], (kFaces - pushed) * 3);
+  return true;
 }
 
 void ComputeVertexNormals(const std::vector<float> &vertices,
@@ -195,7 +206,46 @@ void ComputeBoundingBox(const std::vector<float> vertices, TriangleMesh *mesh) {
 
 }  // namespace
 
-bool ReadFromPly(const std::string &filename, TriangleMesh *mesh) {
+PlyStream::PlyStream()
+    : published_(false), has_normals_(false), cancelled_(false), face_count_(0) {}
+
+void PlyStream::PublishVertices(bool has_normals, size_t faces) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  published_ = true;
+  has_normals_ = has_normals;
+  face_count_ = faces;
+}
+
+bool PlyStream::Vertices(bool *has_normals, size_t *faces) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  *has_normals = has_normals_;
+  *faces = face_count_;
+  return published_;
+}
+
+void PlyStream::PushFaces(const int *indices, size_t count) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  faces_.insert(faces_.end(), indices, indices + count);
+}
+
+void PlyStream::TakeFaces(std::vector<int> *faces) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  faces->swap(faces_);
+  faces_.clear();
+}
+
+void PlyStream::Cancel() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  cancelled_ = true;
+}
+
+bool PlyStream::Cancelled() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return cancelled_;
+}
+
+bool ReadFromPly(const std::string &filename, TriangleMesh *mesh,
+                 PlyStream *stream) {
   std::ifstream fin;
 
   fin.open(filename.c_str(), std::ios_base::in | std::ios_base::binary);
@@ -210,15 +260,18 @@ bool ReadFromPly(const std::string &filename, TriangleMesh *mesh) {
   mesh->vertices_.resize(static_cast<size_t>(vertices) * 3);
   if(hasNormals) mesh->normals_.resize(static_cast<size_t>(vertices) * 3);
   ReadPlyVertices(&fin, mesh);
+  ComputeBoundingBox(mesh->vertices_, mesh);
 
   mesh->faces_.resize(static_cast<size_t>(faces) * 3);
-  ReadPlyFaces(&fin, mesh);
+  if (stream != nullptr) stream->PublishVertices(hasNormals, mesh->faces_.size() / 3);
+  bool read = ReadPlyFaces(&fin, mesh, stream);
 
   fin.close();
+  if (!read) return false;
 
   if(!hasNormals) ComputeVertexNormals(mesh->vertices_, mesh->faces_, &mesh->normals_);
   ComputeTexCoords(mesh->vertices_, &mesh->texCoords_);
-  ComputeBoundingBox(mesh->vertices_, mesh);
+  mesh->BuildMeshlets();
 
   return true;
 }
@@ -258,23 +311,36 @@ bool ReadFromObj(const std::string &filename, TriangleMesh *mesh)
     }
 
     if (!ret) {
-      exit(1);
+      return false;
     }
 
+    // Checked before filling the mesh, so that it is left empty
+    for(const auto& shape: shapes)
+        for(const auto& nfv : shape.mesh.num_face_vertices)
+            if(size_t(nfv) != 3) {
+                std::cerr << "Only supports triangles." << std::endl;
+                return false;
+            }
+
     int currentIndex = 0;
     for(const auto& shape: shapes)
     {
         mesh->faces_.resize(mesh->faces_.size()+shape.mesh.indices.size());
-        mesh->vertices_.resize((mesh->vertices_.size()+shape.mesh.indices.size())*3);
+        mesh->vertices_.resize(mesh->vertices_.size()+shape.mesh.indices.size()*3);
         if(attrib.normals.size() > 0)
-            mesh->normals_.resize((mesh->normals_.size()+shape.mesh.indices.size())*3);
+            mesh->normals_.resize(mesh->normals_.size()+shape.mesh.indices.size()*3);
         if(attrib.texcoords.size() > 0)
-            mesh->texCoords_.resize((mesh->texCoords_.size()+shape.mesh.indices.size())*2);
+            mesh->texCoords_.resize(mesh->texCoords_.size()+shape.mesh.indices.size()*2);
 
-        for(const auto& nfv : shape.mesh.num_face_vertices)
-            if(size_t(nfv) != 3) {
-                std::cerr << "Only supports triangles." << std::endl;
-                exit(1);
+        // One range per run of faces of the shape with the same material
+        if(materials.size() > 0)
+            for(size_t f = 0; f < shape.mesh.material_ids.size(); ++f)
+            {
+                int material = shape.mesh.material_ids[f];
+                if(material >= static_cast<int>(materials.size())) material = -1;
+                if(f == 0 || material != mesh->ranges_.back().material_)
+                    mesh->ranges_.push_back({static_cast<size_t>(currentIndex) + 3*f, 0, material});
+                mesh->ranges_.back().count_ += 3;
             }
 
         for(const auto& index : shape.mesh.indices)
@@ -312,9 +378,25 @@ bool ReadFromObj(const std::string &filename, TriangleMesh *mesh)
     {
         mesh->diffuseMap_ = baseDir+"/"+materials[0].diffuse_texname;
     }
+
+    for(const auto& material: materials)
+    {
+        MeshMaterial meshMaterial;
+        meshMaterial.name_ = material.name;
+        meshMaterial.diffuse_ = glm::vec3(material.diffuse[0], material.diffuse[1], material.diffuse[2]);
+        // tinyobj leaves Pr and Pm at 0 when the file does not give them
+        meshMaterial.roughness_ = material.roughness > 0 ? material.roughness : -1.f;
+        meshMaterial.metalness_ = material.metallic > 0 ? material.metallic : -1.f;
+        if(!material.diffuse_texname.empty())
+            meshMaterial.diffuse_map_ = baseDir+"/"+material.diffuse_texname;
+        mesh->materials_.push_back(meshMaterial);
+    }
+    mesh->SortFacesByMaterial();
+    mesh->BuildMeshlets();
     //for(auto i = 0; i < mesh->texCoords_.size(); i+=2)
     //    std::cout << mesh->texCoords_[i] << " " << mesh->texCoords_[i+1] << std::endl;
 
+    return true;
 }
 
 bool CreateSphere(TriangleMesh *mesh)
@@ -405,6 +487,7 @@ bool CreateSphere(TriangleMesh *mesh)
     mesh->texCoords_ = texCoords;
 
     ComputeBoundingBox(mesh->vertices_, mesh);
+    mesh->BuildMeshlets();
 
     return true;
 
@@ -5,20 +5,83 @@
 
 #include <triangle_mesh.h>
 
+#include <cstddef>
+#include <mutex>
 #include <string>
+#include <vector>
 
 namespace data_representation {
 
 static bool hasNormals = false;
 
+/**
+ * @brief kPlyStreamFaces Faces read between two hand overs of the faces of a
+ * streamed PLY.
+ */
+const size_t kPlyStreamFaces = 65536;
+
+/**
+ * @brief PlyStream Partial results of a ReadFromPly running on another
+ * thread, so that the mesh can be shown while it is read. Once the vertices
+ * are published the vertices_, min_ and max_ of the mesh (and its normals_
+ * when the file has them) are final and may be read by other threads; the
+ * faces are handed over as copies, every kPlyStreamFaces faces, because the
+ * reader reorders faces_ once they are all read. The rest of the mesh
+ * belongs to the reader until it returns.
+ */
+class PlyStream {
+ public:
+  PlyStream();
+
+  /**
+   * @brief PublishVertices Called by the reader once the vertices are final.
+   * @param has_normals Whether the normals were read from the file.
+   * @param faces Faces that will follow.
+   */
+  void PublishVertices(bool has_normals, size_t faces);
+
+  /**
+   * @brief Vertices Whether the vertices are published and, if so, what
+   * PublishVertices was told.
+   */
+  bool Vertices(bool *has_normals, size_t *faces) const;
+
+  /**
+   * @brief PushFaces Called by the reader with the next indices read.
+   */
+  void PushFaces(const int *indices, size_t count);
+
+  /**
+   * @brief TakeFaces Moves the indices pushed since the last call to faces.
+   */
+  void TakeFaces(std::vector<int> *faces);
+
+  /**
+   * @brief Cancel Makes the reader give up at its next hand over.
+   */
+  void Cancel();
+  bool Cancelled() const;
+
+ private:
+  mutable std::mutex mutex_;
+  bool published_;
+  bool has_normals_;
+  bool cancelled_;
+  size_t face_count_;
+  std::vector<int> faces_;
+};
+
 /**
  * @brief ReadFromPly Read the mesh stored in PLY format at the path filename
  * and stores the corresponding TriangleMesh representation
  * @param filename The path to the PLY mesh.
  * @param mesh The resulting representation with computed per-vertex normals.
- * @return Whether it was able to read the file.
+ * @param stream When given, receives the vertices and the faces as they are
+ * read, see PlyStream.
+ * @return Whether it was able to read the file (false if cancelled).
  */
-bool ReadFromPly(const std::string &filename, TriangleMesh *mesh);
+bool ReadFromPly(const std::string &filename, TriangleMesh *mesh,
+                 PlyStream *stream = nullptr);
 
 /**
  * @brief WriteToPly Stores the mesh representation in PLY format at the path
@@ -31,8 +94,8 @@ bool WriteToPly(const std::string &filename, const TriangleMesh &mesh);
 
 /**
  * @brief ReadFromObj Read the mesh stored in OBJ format at the path filename
- * and stores the corresponding TriangleMesh representation. It only works for
- * models with a unique material.
+ * and stores the corresponding TriangleMesh representation. The faces of all
+ * the shapes are sorted by material, with one range per material.
  * @param filename The path to the OBJ mesh.
  * @param mesh The resulting representation with computed per-vertex normals.
  * @return Whether it was able to read the file.
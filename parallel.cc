@@ -0,0 +1,40 @@
+#include <parallel.h>
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+namespace utils {
+
+size_t WorkerCount() {
+  return std::max(1u, std::thread::hardware_concurrency());
+}
+
+void ParallelFor(size_t begin, size_t end,
+                 const std::function<void(size_t, size_t)> &body,
+                 size_t min_chunk) {
+  if (end <= begin) return;
+
+  const size_t kCount = end - begin;
+  const size_t kThreads = std::max<size_t>(
+      1, std::min(WorkerCount(), kCount / std::max<size_t>(1, min_chunk)));
+  if (kThreads == 1) {
+    body(begin, end);
+    return;
+  }
+
+  const size_t kChunk = (kCount + kThreads - 1) / kThreads;
+  std::vector<std::thread> workers;
+  workers.reserve(kThreads - 1);
+  for (size_t t = 1; t < kThreads; ++t) {
+    size_t b = begin + t * kChunk;
+    size_t e = std::min(end, b + kChunk);
+    if (b < e) workers.emplace_back(body, b, e);
+  }
+  // The calling thread takes the first chunk.
+  body(begin, std::min(end, begin + kChunk));
+
+  for (auto &worker : workers) worker.join();
+}
+
+}  // namespace utils
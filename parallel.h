@@ -0,0 +1,30 @@
+#ifndef PARALLEL_H_
+#define PARALLEL_H_
+
+#include <cstddef>
+#include <functional>
+
+namespace utils {
+
+/**
+ * @brief WorkerCount Number of worker threads used by the parallel helpers.
+ * @return The hardware concurrency, at least 1.
+ */
+size_t WorkerCount();
+
+/**
+ * @brief ParallelFor Splits the range [begin, end) into contiguous chunks and
+ * runs body(chunk_begin, chunk_end) on each of them from a different thread.
+ * Blocks until every chunk has been processed.
+ * @param begin First index of the range.
+ * @param end One past the last index of the range.
+ * @param body Function called once per chunk.
+ * @param min_chunk Minimum number of indices given to a single thread.
+ */
+void ParallelFor(size_t begin, size_t end,
+                 const std::function<void(size_t, size_t)> &body,
+                 size_t min_chunk = 1);
+
+}  // namespace utils
+
+#endif  // PARALLEL_H_
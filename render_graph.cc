@@ -0,0 +1,335 @@
+#include <render_graph.h>
+
+#include <algorithm>
+#include <iostream>
+
+namespace data_visualization {
+
+namespace {
+
+const int kMaxColorAttachments = 8;
+
+bool IsDepth(const RenderTargetFormat &format) {
+  return format.format_ == GL_DEPTH_COMPONENT || format.format_ == GL_DEPTH_STENCIL;
+}
+
+bool SameFormat(const RenderTargetFormat &a, const RenderTargetFormat &b) {
+  return a.internal_format_ == b.internal_format_ && a.format_ == b.format_ &&
+         a.type_ == b.type_;
+}
+
+const char *FramebufferStatusString(GLenum status) {
+  switch (status) {
+    case GL_FRAMEBUFFER_UNDEFINED: return "GL_FRAMEBUFFER_UNDEFINED";
+    case GL_FRAMEBUFFER_INCOMPLETE_ATTACHMENT: return "GL_FRAMEBUFFER_INCOMPLETE_ATTACHMENT";
+    case GL_FRAMEBUFFER_INCOMPLETE_MISSING_ATTACHMENT: return "GL_FRAMEBUFFER_INCOMPLETE_MISSING_ATTACHMENT";
+    case GL_FRAMEBUFFER_INCOMPLETE_DRAW_BUFFER: return "GL_FRAMEBUFFER_INCOMPLETE_DRAW_BUFFER";
+    case GL_FRAMEBUFFER_INCOMPLETE_READ_BUFFER: return "GL_FRAMEBUFFER_INCOMPLETE_READ_BUFFER";
+    case GL_FRAMEBUFFER_UNSUPPORTED: return "GL_FRAMEBUFFER_UNSUPPORTED";
+    case GL_FRAMEBUFFER_INCOMPLETE_MULTISAMPLE: return "GL_FRAMEBUFFER_INCOMPLETE_MULTISAMPLE";
+    default: return "Unknown";
+  }
+}
+
+}  // namespace
+
+size_t TexelBytes(GLenum internal_format) {
+  switch (internal_format) {
+    case GL_R8: return 1;
+    case GL_RG8:
+    case GL_R16:
+    case GL_R16F:
+    case GL_DEPTH_COMPONENT16: return 2;
+    case GL_RGBA16F:
+    case GL_RGBA16: return 8;
+    case GL_RGBA32F: return 16;
+    default: return 4;
+  }
+}
+
+RenderGraph::RenderGraph() : gl_(nullptr), width_(0), height_(0) {}
+
+void RenderGraph::Initialize(QOpenGLFunctions_3_3_Core *gl) { gl_ = gl; }
+
+void RenderGraph::Release() {
+  if (gl_ == nullptr) return;
+
+  for (PoolTexture &texture : pool_) gl_->glDeleteTextures(1, &texture.texture_);
+  pool_.clear();
+  ReleaseFramebuffers();
+  targets_.clear();
+  passes_.clear();
+  gl_ = nullptr;
+}
+
+void RenderGraph::Begin(int width, int height) {
+  if (width != width_ || height != height_) {
+    for (PoolTexture &texture : pool_) gl_->glDeleteTextures(1, &texture.texture_);
+    pool_.clear();
+    ReleaseFramebuffers();
+    width_ = width;
+    height_ = height;
+  }
+  targets_.clear();
+  passes_.clear();
+}
+
+int RenderGraph::AddTarget(const std::string &name, const RenderTargetFormat &format) {
+  targets_.push_back({name, format, false, -1, -1, -1, false});
+  return static_cast<int>(targets_.size()) - 1;
+}
+
+void RenderGraph::AddPass(const std::string &name, const std::vector<int> &reads,
+                          const std::vector<int> &writes, bool cached,
+                          const std::function<void()> &execute) {
+  passes_.push_back({name, reads, writes, cached, execute});
+}
+
+void RenderGraph::Keep(int target) { targets_[target].kept_ = true; }
+
+std::vector<bool> RenderGraph::Cull() const {
+  std::vector<bool> needed(passes_.size(), false);
+  std::vector<bool> read(targets_.size(), false);
+  for (size_t i = 0; i < targets_.size(); ++i) read[i] = targets_[i].kept_;
+
+  // Backwards, so that the readers of a target are known before its writers
+  for (size_t i = passes_.size(); i-- > 0;) {
+    const Pass &pass = passes_[i];
+    needed[i] = pass.writes_.empty();
+    for (int target : pass.writes_) needed[i] = needed[i] || read[target];
+    if (!needed[i]) continue;
+    for (int target : pass.reads_) read[target] = true;
+  }
+  return needed;
+}
+
+void RenderGraph::Allocate(const std::vector<bool> &needed) {
+  for (size_t i = 0; i < passes_.size(); ++i) {
+    if (!needed[i]) continue;
+    for (int target : passes_[i].writes_) {
+      if (targets_[target].first_ < 0) targets_[target].first_ = i;
+      targets_[target].last_ = i;
+    }
+    for (int target : passes_[i].reads_) targets_[target].last_ = i;
+  }
+
+  // Only the targets rendered again can share their textures, the ones of
+  // the passes expected to be skipped keep what they hold for later frames
+  std::vector<bool> rendered(targets_.size(), false);
+  for (size_t i = 0; i < passes_.size(); ++i) {
+    if (!needed[i]) continue;
+    bool runs = !passes_[i].cached_;
+    for (int target : passes_[i].reads_) runs = runs || rendered[target];
+    for (int target : passes_[i].writes_) rendered[target] = runs;
+  }
+
+  std::vector<int> order;
+  for (size_t i = 0; i < targets_.size(); ++i) {
+    if (targets_[i].first_ < 0) continue;
+    if (targets_[i].kept_ || !rendered[i]) targets_[i].last_ = passes_.size();
+    order.push_back(i);
+  }
+  std::stable_sort(order.begin(), order.end(), [this](int a, int b) {
+    return targets_[a].first_ < targets_[b].first_;
+  });
+
+  for (PoolTexture &texture : pool_) texture.busy_ = -1;
+  bool grown = false;
+  for (int index : order) {
+    Target &target = targets_[index];
+    // The texture already holding the target, then a free one holding
+    // nothing another target of the frame could still reuse. What culled
+    // targets hold is never reused, so that showing them again does not
+    // render them again
+    int chosen = -1;
+    bool chosen_claimed = false;
+    for (size_t i = 0; i < pool_.size(); ++i) {
+      const PoolTexture &texture = pool_[i];
+      if (!SameFormat(texture.format_, target.format_) || texture.busy_ >= target.first_)
+        continue;
+      if (texture.contents_ == target.name_) {
+        chosen = i;
+        break;
+      }
+      bool claimed = false, culled = false;
+      for (size_t other = 0; other < targets_.size(); ++other) {
+        if (static_cast<int>(other) == index || targets_[other].name_ != texture.contents_)
+          continue;
+        claimed = true;
+        culled = targets_[other].first_ < 0;
+      }
+      if (culled || (chosen >= 0 && claimed && !chosen_claimed)) continue;
+      chosen = i;
+      chosen_claimed = claimed;
+    }
+    if (chosen < 0) {
+      PoolTexture texture = {0, target.format_, "", -1};
+      gl_->glGenTextures(1, &texture.texture_);
+      gl_->glBindTexture(GL_TEXTURE_2D, texture.texture_);
+      gl_->glTexImage2D(GL_TEXTURE_2D, 0, target.format_.internal_format_, width_, height_, 0,
+                        target.format_.format_, target.format_.type_, nullptr);
+      gl_->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+      gl_->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+      gl_->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+      gl_->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+      gl_->glBindTexture(GL_TEXTURE_2D, 0);
+      pool_.push_back(texture);
+      chosen = pool_.size() - 1;
+      grown = true;
+    }
+    pool_[chosen].busy_ = target.last_;
+    target.texture_ = chosen;
+  }
+
+  // What the culled passes rendered is kept while valid, for when they are
+  // needed again; textures holding nothing are deleted
+  size_t kept = 0;
+  for (size_t i = 0; i < pool_.size(); ++i) {
+    bool valid = false;
+    for (const Target &target : targets_)
+      valid = valid || target.name_ == pool_[i].contents_;
+    if (pool_[i].busy_ < 0 && !valid) {
+      gl_->glDeleteTextures(1, &pool_[i].texture_);
+      continue;
+    }
+    for (Target &target : targets_)
+      if (target.texture_ == static_cast<int>(i)) target.texture_ = kept;
+    pool_[kept++] = pool_[i];
+  }
+  bool shrunk = kept < pool_.size();
+  pool_.resize(kept);
+  // Deleted textures stay attached to the framebuffers that are not bound,
+  // and their names are reused by the next textures
+  if (shrunk) ReleaseFramebuffers();
+
+  if (grown || shrunk)
+    std::cout << "Render targets: " << pool_.size() << " textures, " << Bytes() / 1024
+              << " KB" << std::endl;
+}
+
+void RenderGraph::BindFramebuffer(const Pass &pass) {
+  Framebuffer &framebuffer = framebuffers_[pass.name_];
+  if (framebuffer.framebuffer_ == 0) gl_->glGenFramebuffers(1, &framebuffer.framebuffer_);
+  gl_->glBindFramebuffer(GL_FRAMEBUFFER, framebuffer.framebuffer_);
+
+  std::vector<GLuint> attachments;
+  for (int target : pass.writes_) attachments.push_back(pool_[targets_[target].texture_].texture_);
+  if (attachments == framebuffer.attachments_) return;
+
+  for (int i = 0; i < kMaxColorAttachments; ++i)
+    gl_->glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, 0, 0);
+  gl_->glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, 0, 0);
+
+  std::vector<GLenum> draw_buffers;
+  for (size_t i = 0; i < pass.writes_.size(); ++i) {
+    if (IsDepth(targets_[pass.writes_[i]].format_)) {
+      gl_->glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D,
+                                  attachments[i], 0);
+    } else {
+      GLenum attachment = GL_COLOR_ATTACHMENT0 + draw_buffers.size();
+      gl_->glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, GL_TEXTURE_2D, attachments[i], 0);
+      draw_buffers.push_back(attachment);
+    }
+  }
+  if (draw_buffers.empty())
+    gl_->glDrawBuffer(GL_NONE);
+  else
+    gl_->glDrawBuffers(draw_buffers.size(), draw_buffers.data());
+
+  GLenum status = gl_->glCheckFramebufferStatus(GL_FRAMEBUFFER);
+  if (status != GL_FRAMEBUFFER_COMPLETE)
+    std::cerr << "Framebuffer of the " << pass.name_ << " pass is not complete: "
+              << FramebufferStatusString(status) << std::endl;
+  framebuffer.attachments_ = attachments;
+}
+
+void RenderGraph::Execute(GLuint framebuffer) {
+  std::vector<bool> needed = Cull();
+  Allocate(needed);
+
+  for (size_t i = 0; i < passes_.size(); ++i) {
+    const Pass &pass = passes_[i];
+    if (!needed[i]) continue;
+
+    // Cached passes only run when their inputs or their targets changed
+    bool run = !pass.cached_;
+    for (int target : pass.reads_) run = run || targets_[target].rendered_;
+    for (int target : pass.writes_)
+      run = run || pool_[targets_[target].texture_].contents_ != targets_[target].name_;
+    if (!run) continue;
+
+    if (pass.writes_.empty())
+      gl_->glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    else
+      BindFramebuffer(pass);
+    gl_->glViewport(0, 0, width_, height_);
+
+    units_.assign(targets_.size(), -1);
+    for (int unit = 0; unit < kRenderGraphUnits; ++unit) {
+      GLuint texture = 0;
+      if (unit < static_cast<int>(pass.reads_.size())) {
+        const Target &target = targets_[pass.reads_[unit]];
+        if (target.texture_ >= 0) texture = pool_[target.texture_].texture_;
+        units_[pass.reads_[unit]] = unit;
+      }
+      gl_->glActiveTexture(GL_TEXTURE0 + unit);
+      gl_->glBindTexture(GL_TEXTURE_2D, texture);
+    }
+
+    pass.execute_();
+
+    for (int target : pass.writes_) {
+      targets_[target].rendered_ = true;
+      pool_[targets_[target].texture_].contents_ = targets_[target].name_;
+    }
+  }
+  units_.clear();
+  gl_->glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+
+  // A culled pass that would have run leaves what it rendered before stale,
+  // and so the targets of the passes reading them
+  std::vector<bool> changed(targets_.size(), false);
+  for (size_t i = 0; i < targets_.size(); ++i) changed[i] = targets_[i].rendered_;
+  for (size_t i = 0; i < passes_.size(); ++i) {
+    const Pass &pass = passes_[i];
+    if (needed[i]) continue;
+
+    bool stale = !pass.cached_;
+    for (int target : pass.reads_) stale = stale || changed[target];
+    if (!stale) continue;
+    for (int target : pass.writes_) {
+      changed[target] = true;
+      for (PoolTexture &texture : pool_)
+        if (texture.contents_ == targets_[target].name_) texture.contents_.clear();
+    }
+  }
+}
+
+void RenderGraph::ReleaseFramebuffers() {
+  for (auto &framebuffer : framebuffers_)
+    gl_->glDeleteFramebuffers(1, &framebuffer.second.framebuffer_);
+  framebuffers_.clear();
+}
+
+int RenderGraph::Unit(int target) const {
+  if (target < static_cast<int>(units_.size()) && units_[target] >= 0) return units_[target];
+  return kRenderGraphUnits - 1;
+}
+
+GLuint RenderGraph::Texture(const std::string &name, RenderTargetFormat *format) const {
+  for (const Target &target : targets_) {
+    if (target.name_ != name || target.texture_ < 0) continue;
+    if (format != nullptr) *format = pool_[target.texture_].format_;
+    return pool_[target.texture_].texture_;
+  }
+  return 0;
+}
+
+size_t RenderGraph::Bytes() const {
+  size_t bytes = 0;
+  for (const PoolTexture &texture : pool_)
+    bytes += size_t(width_) * height_ * TexelBytes(texture.format_.internal_format_);
+  return bytes;
+}
+
+}  //  namespace data_visualization
@@ -0,0 +1,204 @@
+#ifndef RENDER_GRAPH_H_
+#define RENDER_GRAPH_H_
+
+#include <QOpenGLFunctions_3_3_Core>
+
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace data_visualization {
+
+/**
+ * @brief kRenderGraphUnits Texture units the targets read by a pass are bound
+ * to, from 0. The last one is left empty for the samplers of the targets the
+ * pass does not read; the units after them are free for other textures.
+ */
+const int kRenderGraphUnits = 6;
+
+/**
+ * @brief RenderTargetFormat Storage of a render target, the arguments of
+ * glTexImage2D. Depth formats are attached as the depth buffer.
+ */
+struct RenderTargetFormat {
+  GLenum internal_format_;
+  GLenum format_;
+  GLenum type_;
+};
+
+/**
+ * @brief TexelBytes Bytes of a texel of internal_format, as drivers usually
+ * store it.
+ */
+size_t TexelBytes(GLenum internal_format);
+
+/**
+ * @brief RenderGraph Fullscreen sized targets and the passes rendering them,
+ * declared again every frame.
+ *
+ * Passes declare the targets they read and write, in execution order; the
+ * ones without writes draw to the framebuffer given to Execute. Execute culls
+ * the passes whose writes nobody reads, nor Keep, then gives the targets of
+ * the remaining ones textures from a pool: a target reuses the texture of an
+ * earlier one of the same format whose last read is done, and the textures
+ * holding no target are deleted. Each pool texture remembers the target it
+ * last held, so that a cached pass is skipped while its targets still hold
+ * what it wrote in a previous frame and nothing it reads was rendered again.
+ * The textures of culled passes are kept until their inputs change, so that
+ * they are not rendered again when needed again.
+ */
+class RenderGraph {
+ public:
+  RenderGraph();
+
+  /**
+   * @brief Initialize Needs a current context.
+   * @param gl Functions of the context the textures belong to.
+   */
+  void Initialize(QOpenGLFunctions_3_3_Core *gl);
+
+  /**
+   * @brief Release Deletes the pool and the framebuffers. Needs a current
+   * context.
+   */
+  void Release();
+
+  /**
+   * @brief Begin Starts declaring the graph of a frame. A new size empties the
+   * pool.
+   */
+  void Begin(int width, int height);
+
+  /**
+   * @brief AddTarget Declares a target of the frame.
+   * @param name Identifies the target across frames.
+   * @return Index of the target for the passes.
+   */
+  int AddTarget(const std::string &name, const RenderTargetFormat &format);
+
+  /**
+   * @brief AddPass Declares the next pass of the frame.
+   * @param reads Targets bound to consecutive texture units from 0 while
+   * execute runs, see Unit. At most kRenderGraphUnits - 1.
+   * @param writes Color targets attached in order, and the depth one.
+   * @param cached Whether what the pass wrote in a previous frame is still
+   * valid for its inputs.
+   * @param execute Draws the pass, with its framebuffer bound and the
+   * viewport set.
+   */
+  void AddPass(const std::string &name, const std::vector<int> &reads,
+               const std::vector<int> &writes, bool cached,
+               const std::function<void()> &execute);
+
+  /**
+   * @brief Keep Marks a target as read after the frame, so that its pass is
+   * not culled and its texture is not reused in the frame.
+   */
+  void Keep(int target);
+
+  /**
+   * @brief Execute Culls, allocates and runs the passes of the frame.
+   * @param framebuffer Drawn by the passes without writes.
+   */
+  void Execute(GLuint framebuffer);
+
+  /**
+   * @brief Unit Texture unit of a target in the running pass, the empty one
+   * if the pass does not read it.
+   */
+  int Unit(int target) const;
+
+  /**
+   * @brief Texture Texture of the target called name in the last Execute, 0
+   * if it was culled.
+   * @param format Format of the texture, when not null and it is not 0.
+   */
+  GLuint Texture(const std::string &name, RenderTargetFormat *format = nullptr) const;
+
+  /**
+   * @brief Bytes Memory of the pool.
+   */
+  size_t Bytes() const;
+
+ private:
+  /**
+   * @brief Target A target of the frame. first_ and last_ are the passes
+   * writing it first and reading it last, texture_ its texture of the pool,
+   * -1 when culled.
+   */
+  struct Target {
+    std::string name_;
+    RenderTargetFormat format_;
+    bool kept_;
+    int first_;
+    int last_;
+    int texture_;
+    bool rendered_;  // In this frame
+  };
+
+  struct Pass {
+    std::string name_;
+    std::vector<int> reads_;
+    std::vector<int> writes_;
+    bool cached_;
+    std::function<void()> execute_;
+  };
+
+  /**
+   * @brief PoolTexture A texture of the pool, holding what the target called
+   * contents_ rendered, busy_ until that pass of the frame.
+   */
+  struct PoolTexture {
+    GLuint texture_;
+    RenderTargetFormat format_;
+    std::string contents_;
+    int busy_;
+  };
+
+  /**
+   * @brief Framebuffer Framebuffer of a pass and the textures attached to it.
+   */
+  struct Framebuffer {
+    GLuint framebuffer_;
+    std::vector<GLuint> attachments_;
+  };
+
+  /**
+   * @brief Cull Marks the passes that draw to the framebuffer, or write a
+   * target read by a marked pass or kept.
+   */
+  std::vector<bool> Cull() const;
+
+  /**
+   * @brief Allocate Gives a pool texture to every target of the needed
+   * passes, and deletes the unused ones.
+   */
+  void Allocate(const std::vector<bool> &needed);
+
+  /**
+   * @brief BindFramebuffer Binds the framebuffer of pass, attaching its
+   * targets when their textures changed.
+   */
+  void BindFramebuffer(const Pass &pass);
+
+  /**
+   * @brief ReleaseFramebuffers Deletes the framebuffers of the passes, once
+   * textures attached to them are deleted.
+   */
+  void ReleaseFramebuffers();
+
+  QOpenGLFunctions_3_3_Core *gl_;
+  int width_;
+  int height_;
+  std::vector<Target> targets_;
+  std::vector<Pass> passes_;
+  std::vector<PoolTexture> pool_;
+  std::map<std::string, Framebuffer> framebuffers_;
+  std::vector<int> units_;  // Of the targets in the running pass
+};
+
+}  //  namespace data_visualization
+
+#endif  //  RENDER_GRAPH_H_
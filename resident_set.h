@@ -0,0 +1,118 @@
+#ifndef RESIDENT_SET_H_
+#define RESIDENT_SET_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace data_representation {
+
+/**
+ * @brief ResidentSet Bookkeeping of the GPU resources of indexed items (e.g.
+ * materials or environments) that are kept loaded under a memory budget. When
+ * the budget is exceeded the least recently used items are evicted first. The
+ * resources themselves are created and deleted by the owner.
+ * @tparam T Handles of the resources of one item.
+ */
+template <typename T>
+class ResidentSet {
+ public:
+  /**
+   * @brief ResidentSet Creates an empty set.
+   * @param budget Maximum bytes of the resident items.
+   */
+  explicit ResidentSet(size_t budget) : budget_(budget), bytes_(0), clock_(0) {}
+
+  /**
+   * @brief Reset Forgets every item and makes room for count of them. The
+   * resident resources have to be released with Clear before.
+   */
+  void Reset(size_t count) {
+    entries_.assign(count, Entry());
+    bytes_ = 0;
+  }
+
+  size_t Bytes() const { return bytes_; }
+  bool Contains(size_t index) const { return entries_[index].resident_; }
+
+  /**
+   * @brief Use Looks up the handles of a resident item and marks it as the
+   * most recently used one.
+   * @return Whether the item is resident.
+   */
+  bool Use(size_t index, T *value) {
+    Entry &entry = entries_[index];
+    if (!entry.resident_) return false;
+
+    entry.last_use_ = ++clock_;
+    *value = entry.value_;
+    return true;
+  }
+
+  /**
+   * @brief Insert Makes an item resident and evicts the least recently used
+   * items until the budget is met again. The inserted item is never evicted.
+   * @param bytes Memory used by the resources of the item.
+   * @param evicted Handles of the evicted items, to be released by the caller.
+   */
+  void Insert(size_t index, const T &value, size_t bytes,
+              std::vector<T> *evicted) {
+    Entry &entry = entries_[index];
+    if (entry.resident_) {
+      evicted->push_back(entry.value_);
+      bytes_ -= entry.bytes_;
+    }
+    entry.resident_ = true;
+    entry.last_use_ = ++clock_;
+    entry.bytes_ = bytes;
+    entry.value_ = value;
+    bytes_ += bytes;
+
+    while (bytes_ > budget_) {
+      Entry *oldest = nullptr;
+      for (Entry &candidate : entries_)
+        if (candidate.resident_ && &candidate != &entry &&
+            (!oldest || candidate.last_use_ < oldest->last_use_))
+          oldest = &candidate;
+      if (!oldest) break;
+
+      oldest->resident_ = false;
+      bytes_ -= oldest->bytes_;
+      evicted->push_back(oldest->value_);
+    }
+  }
+
+  /**
+   * @brief Clear Evicts every item.
+   * @return Handles of the evicted items, to be released by the caller.
+   */
+  std::vector<T> Clear() {
+    std::vector<T> evicted;
+    for (Entry &entry : entries_) {
+      if (!entry.resident_) continue;
+      entry.resident_ = false;
+      evicted.push_back(entry.value_);
+    }
+    bytes_ = 0;
+    return evicted;
+  }
+
+ private:
+  struct Entry {
+    Entry() : resident_(false), last_use_(0), bytes_(0), value_() {}
+
+    bool resident_;
+    uint64_t last_use_;
+    size_t bytes_;
+    T value_;
+  };
+
+  std::vector<Entry> entries_;
+  size_t budget_;
+  size_t bytes_;
+  uint64_t clock_;
+};
+
+}  // namespace data_representation
+
+#endif  // RESIDENT_SET_H_
@@ -0,0 +1,185 @@
+#include <scene.h>
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/vec4.hpp>
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <utility>
+
+#include "./mesh_io.h"
+
+namespace data_representation {
+
+void Scene::Clear() {
+  meshes_.clear();
+  nodes_.clear();
+}
+
+int Scene::AddMesh(std::unique_ptr<TriangleMesh> mesh) {
+  meshes_.push_back(std::move(mesh));
+  return meshes_.size() - 1;
+}
+
+int Scene::AddNode(int parent, int mesh, const glm::mat4 &local) {
+  nodes_.push_back({parent, mesh, local});
+  return nodes_.size() - 1;
+}
+
+std::vector<std::vector<glm::mat4>> Scene::Instances() const {
+  // Parents come before their children, a single pass resolves them all
+  std::vector<glm::mat4> world(nodes_.size());
+  std::vector<std::vector<glm::mat4>> instances(meshes_.size());
+  for (size_t i = 0; i < nodes_.size(); ++i) {
+    const Node &node = nodes_[i];
+    world[i] = node.parent_ < 0 ? node.local_ : world[node.parent_] * node.local_;
+    if (node.mesh_ >= 0) instances[node.mesh_].push_back(world[i]);
+  }
+  return instances;
+}
+
+bool Scene::Bounds(glm::vec3 *min, glm::vec3 *max) const {
+  bool placed = false;
+  std::vector<std::vector<glm::mat4>> instances = Instances();
+  for (size_t i = 0; i < meshes_.size(); ++i) {
+    const TriangleMesh &mesh = *meshes_[i];
+    for (const glm::mat4 &transform : instances[i]) {
+      for (int corner = 0; corner < 8; ++corner) {
+        glm::vec4 point(corner & 1 ? mesh.max_.x : mesh.min_.x,
+                        corner & 2 ? mesh.max_.y : mesh.min_.y,
+                        corner & 4 ? mesh.max_.z : mesh.min_.z, 1.0f);
+        glm::vec3 world = glm::vec3(transform * point);
+        for (int j = 0; j < 3; ++j) {
+          (*min)[j] = placed ? std::min((*min)[j], world[j]) : world[j];
+          (*max)[j] = placed ? std::max((*max)[j], world[j]) : world[j];
+        }
+        placed = true;
+      }
+    }
+  }
+  return placed;
+}
+
+size_t Scene::Faces() const {
+  size_t faces = 0;
+  for (const Node &node : nodes_)
+    if (node.mesh_ >= 0) faces += meshes_[node.mesh_]->faces_.size() / 3;
+  return faces;
+}
+
+size_t Scene::Vertices() const {
+  size_t vertices = 0;
+  for (const Node &node : nodes_)
+    if (node.mesh_ >= 0) vertices += meshes_[node.mesh_]->vertices_.size() / 3;
+  return vertices;
+}
+
+namespace {
+
+bool ReadMesh(const std::string &filename, TriangleMesh *mesh) {
+  std::string type = filename.substr(filename.find_last_of(".") + 1);
+  if (type == "ply") return ReadFromPly(filename, mesh);
+  if (type == "obj") return ReadFromObj(filename, mesh);
+  return false;
+}
+
+// Index of name in names, -1 for "-". False if it is not defined.
+bool Lookup(const std::map<std::string, int> &names, const std::string &name,
+            int *index) {
+  if (name == "-") {
+    *index = -1;
+    return true;
+  }
+  auto found = names.find(name);
+  if (found == names.end()) return false;
+  *index = found->second;
+  return true;
+}
+
+}  // namespace
+
+bool ReadScene(const std::string &filename, Scene *scene) {
+  std::ifstream fin(filename.c_str());
+  if (!fin.is_open()) return false;
+
+  std::string base_dir = filename.substr(0, filename.rfind("/") + 1);
+  std::map<std::string, int> meshes;
+  std::map<std::string, int> nodes;
+
+  scene->Clear();
+  std::string line;
+  for (int number = 1; std::getline(fin, line); ++number) {
+    line = line.substr(0, line.find('#'));
+    std::istringstream tokens(line);
+    std::string keyword, name;
+    if (!(tokens >> keyword)) continue;
+    tokens >> name;
+
+    bool ok = !name.empty();
+    if (ok && keyword == "mesh") {
+      std::string path;
+      std::unique_ptr<TriangleMesh> mesh(new TriangleMesh());
+      ok = static_cast<bool>(tokens >> path) &&
+           ReadMesh(base_dir + path, mesh.get());
+      if (ok) meshes[name] = scene->AddMesh(std::move(mesh));
+    } else if (ok && (keyword == "node" || keyword == "grid")) {
+      std::string parent_name, mesh_name;
+      int parent = -1, mesh = -1;
+      ok = static_cast<bool>(tokens >> parent_name >> mesh_name) &&
+           Lookup(nodes, parent_name, &parent) &&
+           Lookup(meshes, mesh_name, &mesh);
+
+      if (ok && keyword == "node") {
+        glm::vec3 t, r;
+        float scale;
+        ok = static_cast<bool>(tokens >> t.x >> t.y >> t.z >> r.x >> r.y >>
+                               r.z >> scale);
+        glm::mat4 local = glm::translate(glm::mat4(1.0f), t);
+        local = glm::rotate(local, glm::radians(r.z), glm::vec3(0, 0, 1));
+        local = glm::rotate(local, glm::radians(r.y), glm::vec3(0, 1, 0));
+        local = glm::rotate(local, glm::radians(r.x), glm::vec3(1, 0, 0));
+        local = glm::scale(local, glm::vec3(scale, scale, scale));
+        if (ok) nodes[name] = scene->AddNode(parent, mesh, local);
+      } else if (ok) {
+        int nx, ny, nz;
+        float spacing;
+        ok = static_cast<bool>(tokens >> nx >> ny >> nz >> spacing) &&
+             mesh >= 0;
+        if (ok) {
+          int group = scene->AddNode(parent, -1, glm::mat4(1.0f));
+          nodes[name] = group;
+          for (int z = 0; z < nz; ++z)
+            for (int y = 0; y < ny; ++y)
+              for (int x = 0; x < nx; ++x)
+                scene->AddNode(group, mesh,
+                               glm::translate(glm::mat4(1.0f),
+                                              glm::vec3(x, y, z) * spacing));
+        }
+      }
+    } else {
+      ok = false;
+    }
+
+    if (!ok) {
+      std::cerr << filename << ":" << number << ": invalid " << keyword
+                << " line" << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+bool ReadModel(const std::string &filename, Scene *scene) {
+  std::string type = filename.substr(filename.find_last_of(".") + 1);
+  if (type == "scene") return ReadScene(filename, scene);
+
+  std::unique_ptr<TriangleMesh> mesh(new TriangleMesh());
+  bool read = type == "null" ? CreateSphere(mesh.get()) : ReadMesh(filename, mesh.get());
+  if (read) scene->AddNode(-1, scene->AddMesh(std::move(mesh)), glm::mat4(1.0f));
+  return read;
+}
+
+}  // namespace data_representation
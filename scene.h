@@ -0,0 +1,107 @@
+#ifndef SCENE_H_
+#define SCENE_H_
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "./triangle_mesh.h"
+
+namespace data_representation {
+
+/**
+ * @brief Scene A graph of nodes with local transforms, each optionally
+ * placing one of the meshes of the scene. Meshes are shared: a mesh placed by
+ * many nodes is stored once and drawn as instances of it.
+ */
+class Scene {
+ public:
+  /**
+   * @brief Node A transform relative to its parent node and the mesh it
+   * places, -1 for a group without geometry.
+   */
+  struct Node {
+    int parent_;
+    int mesh_;
+    glm::mat4 local_;
+  };
+
+  /**
+   * @brief Clear Removes every node and mesh.
+   */
+  void Clear();
+
+  /**
+   * @brief AddMesh Adds a mesh that nodes can place.
+   * @return Index of the mesh.
+   */
+  int AddMesh(std::unique_ptr<TriangleMesh> mesh);
+
+  /**
+   * @brief AddNode Adds a node, after its parent.
+   * @param parent Index of the parent node, -1 for a root node.
+   * @param mesh Index of the placed mesh, -1 for none.
+   * @param local Transform from the node to its parent.
+   * @return Index of the node.
+   */
+  int AddNode(int parent, int mesh, const glm::mat4 &local);
+
+  size_t MeshCount() const { return meshes_.size(); }
+  const TriangleMesh &Mesh(int index) const { return *meshes_[index]; }
+  TriangleMesh &Mesh(int index) { return *meshes_[index]; }
+
+  size_t NodeCount() const { return nodes_.size(); }
+  const Node &GetNode(int index) const { return nodes_[index]; }
+
+  /**
+   * @brief Instances World transforms of the nodes placing each mesh, indexed
+   * by mesh.
+   */
+  std::vector<std::vector<glm::mat4>> Instances() const;
+
+  /**
+   * @brief Bounds Bounding box of all the placed meshes in world space.
+   * @return Whether the scene places any mesh.
+   */
+  bool Bounds(glm::vec3 *min, glm::vec3 *max) const;
+
+  /**
+   * @brief Faces, Vertices Triangles and vertices of all the placed meshes,
+   * counting every instance.
+   */
+  size_t Faces() const;
+  size_t Vertices() const;
+
+ private:
+  std::vector<std::unique_ptr<TriangleMesh>> meshes_;
+  std::vector<Node> nodes_;
+};
+
+/**
+ * @brief ReadScene Reads a scene description at the path filename. Each line
+ * is one of (angles in degrees, paths relative to the scene file, '-' for no
+ * parent or mesh, '#' starts a comment):
+ *   mesh <name> <path to a PLY or OBJ file>
+ *   node <name> <parent> <mesh> <tx ty tz> <rx ry rz> <scale>
+ *   grid <name> <parent> <mesh> <nx ny nz> <spacing>
+ * where grid adds a group node with nx * ny * nz children placing the mesh
+ * spacing apart.
+ * @return Whether it was able to read the scene and all its meshes.
+ */
+bool ReadScene(const std::string &filename, Scene *scene);
+
+/**
+ * @brief ReadModel Reads what the viewer can load as a scene: a scene
+ * description, or a PLY or OBJ model placed by a single node. The "null" file
+ * type generates a sphere. Does not need a GL context, so that models can be
+ * read in the background.
+ * @return Whether it was able to read the model.
+ */
+bool ReadModel(const std::string &filename, Scene *scene);
+
+}  // namespace data_representation
+
+#endif  //  SCENE_H_
@@ -6,6 +6,7 @@ in vec2 v_uv;
 uniform sampler2D ssao_texture;
 uniform sampler2D normal_texture;
 uniform sampler2D depth_texture;
+uniform bool octahedral_normals;    // Two channel normal target
 
 uniform int blur_type; // 0=Simple, 1=Bilateral, 2=Gaussian
 uniform float blur_radius;
@@ -19,6 +20,19 @@ out vec4 frag_color;
 
 const float PI = 3.14159265359;
 
+// Normal stored in the G-buffer, octahedral encoded in two channels or
+// encoded from [-1, 1] to [0, 1] in three
+vec3 decode_normal(vec4 texel)
+{
+    if (!octahedral_normals) return normalize(texel.xyz * 2.0 - 1.0);
+
+    vec2 e = texel.xy * 2.0 - 1.0;
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
+
 // Gaussian weights for blur
 float gaussian(float x, float sigma) {
     return exp(-(x * x) / (2.0 * sigma * sigma)) / (sqrt(2.0 * PI) * sigma);
@@ -84,7 +98,7 @@ vec4 gaussianBlur() {
 vec4 bilateralBlur() {
     vec2 texel_size = 1.0 / viewport_size;
     vec4 center_ssao = texture(ssao_texture, v_uv);
-    vec3 center_normal = texture(normal_texture, v_uv).xyz;
+    vec3 center_normal = decode_normal(texture(normal_texture, v_uv));
     float center_depth = texture(depth_texture, v_uv).r;
     
     vec4 result = vec4(0.0);
@@ -104,7 +118,7 @@ vec4 bilateralBlur() {
                 
                 // Sample neighboring SSAO, normal, and depth
                 vec4 sample_ssao = texture(ssao_texture, sample_coord);
-                vec3 sample_normal = texture(normal_texture, sample_coord).xyz;
+                vec3 sample_normal = decode_normal(texture(normal_texture, sample_coord));
                 float sample_depth = texture(depth_texture, sample_coord).r;
                 
                 // Spatial weight (Gaussian) - based on distance from center pixel
@@ -0,0 +1,5 @@
+#version 330
+
+// Depth only, the color writes are disabled
+void main(void) {
+}
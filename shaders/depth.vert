@@ -0,0 +1,18 @@
+#version 330
+
+layout (location = 0) in vec3 vert;
+layout (location = 3) in mat4 instance_transform;   // object to world, before model (locations 3 to 6)
+
+uniform mat4 projection;
+uniform mat4 view;
+uniform mat4 model;
+
+// Same expression as the shading vertex shaders, so that the depth pass and
+// the GL_EQUAL shading pass produce bit-identical depths
+invariant gl_Position;
+
+void main(void)  {
+    mat4 world = model * instance_transform;
+    vec3 world_position = vec3(world * vec4( vert, 1.0f ));             // position of the vertex in world space
+    gl_Position = projection * view * vec4(world_position, 1.0f);      // position of the vertex in clip space
+}
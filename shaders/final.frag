@@ -7,6 +7,13 @@ uniform sampler2D normal_texture;
 uniform sampler2D depth_texture;
 uniform sampler2D ssao_texture;
 uniform sampler2D blurred_ssao_texture;
+uniform sampler2D material_texture;     // r: roughness, g: metalness, b: occlusion, a: coverage
+uniform bool octahedral_normals;        // Two channel normal target
+
+// Environment Maps
+uniform samplerCube diffuse_map;
+uniform samplerCube weighted_specular_map;
+uniform sampler2D brdfLUT_map;
 
 uniform int ssao_render_mode;
 uniform bool use_blurred_ssao;
@@ -15,14 +22,196 @@ uniform float ao_strength;
 uniform float zNear;
 uniform float zFar;
 
+// Clustered Lights
+uniform samplerBuffer light_buffer;     // 4 texels per light: (position, range), (color, spot), (direction, cos outer), (cos inner)
+uniform usamplerBuffer cluster_grid;    // offset and count of the lights of each cluster
+uniform usamplerBuffer cluster_lights;  // light indices of the clusters
+uniform ivec3 cluster_size;             // tiles in x and y, depth slices
+uniform vec2 viewport_size;
+uniform float slice_scale;
+uniform float slice_bias;
+
+// Deferred shading
+uniform int lighting_model;             // 0: albedo, 1: PBS, 2: IBL-PBS
+uniform mat4 inverse_view_projection;
+uniform mat4 inverse_view;
+uniform vec3 camera_position;           // Camera position
+uniform vec3 fresnel;                   // F0: Frenel
+uniform bool gamma_correction;
+
 out vec4 frag_color;
-  
+
+const float PI = 3.14159265358979323846;
+const float RECIPROCAL_PI = 0.3183098861837697;
+
+// Normal stored in the G-buffer, octahedral encoded in two channels or
+// encoded from [-1, 1] to [0, 1] in three
+vec3 decode_normal(vec4 texel)
+{
+    if (!octahedral_normals) return normalize(texel.xyz * 2.0 - 1.0);
+
+    vec2 e = texel.xy * 2.0 - 1.0;
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
+
+// BRDF FUNCTIONS (same as pbs.frag and ibl-pbs.frag)
+// Fresnel Schlick Approximation
+vec3 fresnel_schlick(vec3 F0, float  LdotH){
+    return F0 + (1.0 - F0) * pow(1.0 - LdotH, 5.0);
+}
+
+vec3 fresnel_schlick_roughness(float cos_theta, vec3 F0, float roughness)
+{
+    return F0 + (max(vec3(1.0 - roughness), F0) - F0) * pow(clamp(1.0 - cos_theta, 0.0, 1.0), 5.0);
+}
+
+// GGX Distribution Function
+float D_GGX(float alphaSqr, float NdotH){
+    float NdotH2 = NdotH * NdotH;
+    float f = NdotH2 * (alphaSqr - 1.0) + 1.0;
+
+    return alphaSqr / (PI * f * f);
+}
+
+// Schlick GGX Distribution Function
+float GGX(float NdotVec, float k){
+    return NdotVec / (NdotVec * (1.0 - k) + k);
+}
+
+// Smith Model
+float GeometrySmith(float alpha, float NdotL, float NdotV)
+{
+    float k = pow(alpha + 1.0, 2.0) / 8.0;
+    return GGX(NdotL, k) * GGX(NdotV, k);
+}
+
+// Cook-Torrance BRDF for one light
+vec3 direct_light(vec3 L, vec3 N, vec3 V, vec3 F0, float material_metalness, float material_roughness, vec3 material_albedo)
+{
+    vec3 H = normalize(L + V);
+    float NdotH = clamp(dot(N,H), 0.0, 1.0);
+    float NdotV = clamp(dot(N,V), 0.0, 1.0);
+    float LdotH = clamp(dot(L,H), 0.0, 1.0);
+    float NdotL = clamp(dot(N,L), 0.0, 1.0);
+
+    vec3 Ks = fresnel_schlick(F0, LdotH);
+    vec3 Kd = (vec3(1.0) - Ks) * (1.0 - material_metalness);
+
+    float alpha = material_roughness * material_roughness;
+    float alphaSqr = (alpha * alpha) + 1e-6;
+
+    vec3 diffuse = Kd * material_albedo * RECIPROCAL_PI;
+    vec3 specular = (D_GGX(alphaSqr, NdotH) * GeometrySmith(alpha, NdotL, NdotV) * Ks) / (4.0 * NdotL * NdotV + 1e-6);
+
+    return (diffuse + specular) * NdotL;
+}
+
+// CLUSTERED LIGHTS
+// Offset and count of the lights of the cluster of a fragment at the given window depth
+uvec2 cluster_lights_range(vec2 frag_coord, float window_depth)
+{
+    float view_depth = (2.0 * zNear * zFar) / (zFar + zNear - (window_depth * 2.0 - 1.0) * (zFar - zNear));
+    ivec2 tile = clamp(ivec2(frag_coord / viewport_size * vec2(cluster_size.xy)), ivec2(0), cluster_size.xy - 1);
+    int slice = clamp(int(log(view_depth) * slice_scale + slice_bias), 0, cluster_size.z - 1);
+    return texelFetch(cluster_grid, (slice * cluster_size.y + tile.y) * cluster_size.x + tile.x).rg;
+}
+
+// Radiance reaching position from a light, and the direction towards it
+vec3 light_radiance(int light_index, vec3 position, out vec3 L)
+{
+    vec4 position_range = texelFetch(light_buffer, light_index * 4);
+    vec4 color_spot = texelFetch(light_buffer, light_index * 4 + 1);
+
+    vec3 to_light = position_range.xyz - position;
+    float distance = length(to_light);
+    L = to_light / distance;
+
+    // Windowed inverse square falloff, lights without range are not attenuated
+    float attenuation = 1.0;
+    if (position_range.w > 0.0) {
+        float ratio = distance / position_range.w;
+        float window = clamp(1.0 - ratio * ratio * ratio * ratio, 0.0, 1.0);
+        attenuation = window * window / (distance * distance + 1.0);
+    }
+
+    // Smooth cone falloff of the spot lights
+    if (color_spot.w > 0.5) {
+        vec4 direction_outer = texelFetch(light_buffer, light_index * 4 + 2);
+        float cos_inner = texelFetch(light_buffer, light_index * 4 + 3).x;
+        attenuation *= smoothstep(direction_outer.w, cos_inner, dot(-L, direction_outer.xyz));
+    }
+
+    return color_spot.rgb * attenuation;
+}
+
+// Image based lighting, all the light comes from the environment
+vec3 environment_light(vec3 N, vec3 V, vec3 F0, float material_metalness, float material_roughness, vec3 material_albedo)
+{
+    vec3 R = normalize(reflect(-V, N));
+    float NdotV = clamp(dot(N,V), 0.0, 1.0);
+
+    vec3 Ks = fresnel_schlick_roughness(NdotV, F0, material_roughness);
+    vec3 Kd = (vec3(1.0) - Ks) * (1.0 - material_metalness);
+
+    vec3 ambient = Kd * texture(diffuse_map, N).rgb * material_albedo;
+
+    float lod = material_roughness * 4.0; // convert from [0, 1] to [0, 4] (5 mip levels)
+    vec3 prefiltered_color = textureLod(weighted_specular_map, R,  lod).rgb;
+    vec2 env_BRDF = texture(brdfLUT_map, vec2(NdotV, material_roughness)).rg;
+    vec3 specular = prefiltered_color * (Ks * env_BRDF.x + env_BRDF.y);
+
+    return ambient + specular;
+}
+
+// Shades the pixel once with the material stored in the G-Buffer. The AO
+// only darkens the light that comes from the environment.
+vec3 deferred_shading(vec3 color, float depth, float ao)
+{
+    vec4 material = texture(material_texture, v_uv);
+    float material_roughness = material.r;
+    float material_metalness = material.g;
+    float occlusion = material.b * ao;
+
+    // World position from the depth and world normal from the view space one
+    vec4 position = inverse_view_projection * vec4(vec3(v_uv, depth) * 2.0 - 1.0, 1.0);
+    position /= position.w;
+    vec3 N = normalize(mat3(inverse_view) * decode_normal(texture(normal_texture, v_uv)));
+    vec3 V = normalize(camera_position - position.xyz);
+    vec3 F0 = mix(fresnel, color, material_metalness);
+
+    vec3 result;
+    if (lighting_model == 1) {
+        vec3 ambient_light = vec3(0.2);
+        result = ambient_light * color * occlusion;
+
+        // Only the lights assigned to the cluster of the pixel
+        uvec2 lights = cluster_lights_range(gl_FragCoord.xy, depth);
+        for (uint i = 0u; i < lights.y; ++i) {
+            int light_index = int(texelFetch(cluster_lights, int(lights.x + i)).r);
+            vec3 L;
+            vec3 radiance = light_radiance(light_index, position.xyz, L);
+            result += direct_light(L, N, V, F0, material_metalness, material_roughness, color) * radiance;
+        }
+    } else {
+        result = environment_light(N, V, F0, material_metalness, material_roughness, color) * occlusion;
+    }
+
+    // Gamma correction
+    if (gamma_correction) {
+        result = pow(result, vec3(1.0 / 2.2));
+    }
+    return result;
+}
+
 
 void main()
 {
     // Sample from G-Buffer textures
     vec3 color = texture(albedo_texture, v_uv).rgb;
-    vec3 normal = texture(normal_texture, v_uv).rgb;
+    vec3 normal = decode_normal(texture(normal_texture, v_uv));
     float depth = texture(depth_texture, v_uv).r;
     float ssao = texture(ssao_texture, v_uv).r;
     float ssao_blurred = texture(blurred_ssao_texture, v_uv).r; 
@@ -32,8 +221,7 @@ void main()
 
     // Normal
     if(ssao_render_mode == 0){ 
-        normal = normalize(normal);
-        frag_color = vec4(normal, 1.0);
+        frag_color = vec4(normal * 0.5 + 0.5, 1.0);
 
     // Albedo
     } else if(ssao_render_mode == 1){ 
@@ -55,9 +243,13 @@ void main()
     else if(ssao_render_mode == 4) {
         frag_color = vec4(vec3(ssao_blurred), 1.0);
     }
-    // Final result: Albedo * AO
+    // Final result: deferred PBS/IBL shading, or Albedo * AO for the other shaders
     else if (ssao_render_mode == 5) {
-        frag_color = vec4(color.rgb * ao * ao_strength, 1.0);
+        if (lighting_model == 0 || depth >= 1.0) {
+            frag_color = vec4(color.rgb * ao * ao_strength, 1.0);
+        } else {
+            frag_color = vec4(deferred_shading(color, depth, ao * ao_strength), 1.0);
+        }
     }
     // Default case: just output the color
     else {
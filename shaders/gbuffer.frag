@@ -2,27 +2,48 @@
 
 smooth in vec3 v_normal;
 in vec2 v_uv;
+flat in vec3 v_albedo;      // Material, global or per vertex
+flat in float v_roughness;
+flat in float v_metalness;
 
-uniform vec3 albedo; 
 uniform bool use_textures;
 uniform sampler2D color_map;
+uniform sampler2D orm_map;       // r: occlusion, g: roughness, b: metalness
+uniform bool octahedral_normals; // Two channel normal target
 
 layout (location = 0) out vec4 frag_albedo;
 layout (location = 1) out vec4 frag_normal;
+layout (location = 2) out vec4 frag_material;   // r: roughness, g: metalness, b: occlusion, a: coverage
+
+// Octahedral encoding of a unit vector, in [-1, 1]
+vec2 octahedral_encode(vec3 n)
+{
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    vec2 e = n.xy;
+    if (n.z < 0.0) e = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return e;
+}
 
 void main(void) {
     vec3 normal = normalize(v_normal);
 
-    // Output the albedo
+    // Output the albedo and the material properties
     if (use_textures) {
         vec3 color = texture(color_map, v_uv).rgb;
+        vec3 orm = texture(orm_map, v_uv).rgb;
         frag_albedo = vec4(color, 1.0);
+        frag_material = vec4(orm.g, orm.b, orm.r, 1.0);
 
     } else {
-        frag_albedo = vec4(albedo, 1.0);
+        frag_albedo = vec4(v_albedo, 1.0);
+        frag_material = vec4(v_roughness, v_metalness, 1.0, 1.0);
     }
 
 
-    // Output the normal
-    frag_normal = vec4(normal, 1.0);
+    // Output the normal, encoded from [-1, 1] to [0, 1] for the unsigned
+    // normalized targets
+    if (octahedral_normals)
+        frag_normal = vec4(octahedral_encode(normal) * 0.5 + 0.5, 0.0, 1.0);
+    else
+        frag_normal = vec4(normal * 0.5 + 0.5, 1.0);
 }
@@ -3,19 +3,37 @@
 layout (location = 0) in vec3 vertex;
 layout (location = 1) in vec3 normal;
 layout (location = 2) in vec2 texCoord;
+layout (location = 3) in mat4 instance_transform;   // object to world, before model (locations 3 to 6)
+layout (location = 7) in int material_id;          // texel pair in material_buffer
 
 uniform mat4 projection;
 uniform mat4 view;
 uniform mat4 model;
 uniform mat3 normal_matrix;
 
+// Materials
+uniform samplerBuffer material_buffer;  // 2 texels per material: (albedo, roughness), (metalness, 0, 0, 0), negative for the global values
+uniform vec3 albedo;
+uniform float roughness;
+uniform float metalness;
+
 smooth out vec3 v_normal;
 out vec2 v_uv;
+flat out vec3 v_albedo;
+flat out float v_roughness;
+flat out float v_metalness;
 
 void main(void) {
-    vec4 view_vertex = view * model * vec4(vertex, 1);
-    v_normal = normalize(normal_matrix * normal);
+    vec4 view_vertex = view * model * instance_transform * vec4(vertex, 1);
+    v_normal = normalize(normal_matrix * mat3(transpose(inverse(instance_transform))) * normal);
     v_uv = texCoord;
 
     gl_Position = projection * view_vertex;
+
+    // Material of the vertex, negative values fall back to the global ones
+    vec4 material = texelFetch(material_buffer, 2 * material_id);
+    float material_metalness = texelFetch(material_buffer, 2 * material_id + 1).r;
+    v_albedo = material.r < 0.0 ? albedo : material.rgb;
+    v_roughness = material.a < 0.0 ? roughness : material.a;
+    v_metalness = material_metalness < 0.0 ? metalness : material_metalness;
 }
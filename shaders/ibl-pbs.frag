@@ -1,7 +1,11 @@
 #version 330
 in vec3 v_normal;
 in vec3 v_world_position;
+flat in vec3 v_albedo;      // Material, global or per vertex
+flat in float v_roughness;
+flat in float v_metalness;
 in vec2 v_uv;
+in float v_baked_occlusion;    // Baked ambient visibility of the mesh
 
 uniform vec3 light;             // Light position
 uniform vec3 camera_position;   // Camera position
@@ -11,15 +15,9 @@ uniform bool use_textures;
 // Material Properties
 uniform vec3 fresnel;           // F0: Frenel 
 
-// Global Values
-uniform vec3 albedo; 
-uniform float roughness;
-uniform float metalness;
-
 // Material Maps
 uniform sampler2D color_map;
-uniform sampler2D roughness_map;
-uniform sampler2D metalness_map;
+uniform sampler2D orm_map;       // r: occlusion, g: roughness, b: metalness
 
 uniform samplerCube weighted_specular_map;
 uniform samplerCube diffuse_map;
@@ -38,7 +36,7 @@ vec3 fresnel_schlick_roughness(float cos_theta, vec3 F0, float roughness)
 } 
   
 // rendering equation for one light
-vec3 compute_light(vec3 N, vec3 R, vec3 V, float material_metalness, float material_roughness, vec3 material_albedo)
+vec3 compute_light(vec3 N, vec3 R, vec3 V, float material_metalness, float material_roughness, vec3 material_albedo, float material_occlusion)
 {
     vec3 F0 = mix(fresnel, material_albedo, material_metalness);
     float NdotV = clamp(dot(N,V), 0.0, 1.0);
@@ -58,8 +56,8 @@ vec3 compute_light(vec3 N, vec3 R, vec3 V, float material_metalness, float mater
     vec2 env_BRDF = texture(brdfLUT_map, vec2(NdotV, material_roughness)).rg;
     vec3 specular = prefiltered_color * (Ks * env_BRDF.x + env_BRDF.y);
 
-    // BRDF
-    return ambient + specular;
+    // BRDF, all the light comes from the environment so it is occluded
+    return (ambient + specular) * material_occlusion;
 }
 
 void main (void) {
@@ -72,19 +70,25 @@ void main (void) {
     vec3 material_albedo;
     float material_roughness;
     float material_metalness;
+    float material_occlusion;
 
     if (use_textures) {
+        vec3 orm = texture(orm_map, v_uv).rgb;
         material_albedo = texture(color_map, v_uv).xyz;
-        material_roughness = texture(roughness_map, v_uv).x;
-        material_metalness = texture(metalness_map, v_uv).x;
+        material_occlusion = orm.r;
+        material_roughness = orm.g;
+        material_metalness = orm.b;
     }
     else{
-        material_albedo = albedo;
-        material_roughness = roughness;
-        material_metalness = metalness;
+        material_albedo = v_albedo;
+        material_occlusion = 1.0;
+        material_roughness = v_roughness;
+        material_metalness = v_metalness;
     }
 
-    vec3 color = compute_light(normal, reflect_dir, view_dir, material_metalness, material_roughness, material_albedo);
+    material_occlusion *= v_baked_occlusion;
+
+    vec3 color = compute_light(normal, reflect_dir, view_dir, material_metalness, material_roughness, material_albedo, material_occlusion);
     
     // Gamma correction
     if (gamma_correction) {
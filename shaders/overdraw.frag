@@ -0,0 +1,11 @@
+#version 330
+
+uniform float increment;    // Brightness added by every shaded fragment
+
+out vec4 frag_color;
+
+// Drawn with additive blending: the brightness of a pixel counts the
+// fragments that passed the depth test, i.e. how many times it is shaded
+void main(void) {
+    frag_color = vec4(vec3(increment), 1.0);
+}
@@ -2,8 +2,10 @@
 in vec3 v_normal;
 in vec2 v_uv;
 in vec3 v_world_position;
+flat in vec3 v_albedo;      // Material, global or per vertex
+flat in float v_roughness;
+flat in float v_metalness;
 
-uniform vec3 light;            // Light position
 uniform vec3 camera_position;  // Camera position
 
 // Material Properties
@@ -11,15 +13,20 @@ uniform bool use_textures;
 uniform bool gamma_correction;
 uniform vec3 fresnel;          // F0: Frenel 
 
-// Global Values
-uniform vec3 albedo; 
-uniform float roughness;
-uniform float metalness;
-
 // Material Maps
 uniform sampler2D color_map;
-uniform sampler2D roughness_map;
-uniform sampler2D metalness_map;
+uniform sampler2D orm_map;       // r: occlusion, g: roughness, b: metalness
+
+// Clustered Lights
+uniform samplerBuffer light_buffer;     // 4 texels per light: (position, range), (color, spot), (direction, cos outer), (cos inner)
+uniform usamplerBuffer cluster_grid;    // offset and count of the lights of each cluster
+uniform usamplerBuffer cluster_lights;  // light indices of the clusters
+uniform ivec3 cluster_size;             // tiles in x and y, depth slices
+uniform vec2 viewport_size;
+uniform float slice_scale;
+uniform float slice_bias;
+uniform float zNear;
+uniform float zFar;
 
 out vec4 frag_color;
 
@@ -57,6 +64,44 @@ float GeometrySmith(float alpha, float NdotL, float NdotV)
     return GGX(NdotL, k) * GGX(NdotV, k);
 }
   
+// CLUSTERED LIGHTS
+// Offset and count of the lights of the cluster of a fragment at the given window depth
+uvec2 cluster_lights_range(vec2 frag_coord, float window_depth)
+{
+    float view_depth = (2.0 * zNear * zFar) / (zFar + zNear - (window_depth * 2.0 - 1.0) * (zFar - zNear));
+    ivec2 tile = clamp(ivec2(frag_coord / viewport_size * vec2(cluster_size.xy)), ivec2(0), cluster_size.xy - 1);
+    int slice = clamp(int(log(view_depth) * slice_scale + slice_bias), 0, cluster_size.z - 1);
+    return texelFetch(cluster_grid, (slice * cluster_size.y + tile.y) * cluster_size.x + tile.x).rg;
+}
+
+// Radiance reaching position from a light, and the direction towards it
+vec3 light_radiance(int light_index, vec3 position, out vec3 L)
+{
+    vec4 position_range = texelFetch(light_buffer, light_index * 4);
+    vec4 color_spot = texelFetch(light_buffer, light_index * 4 + 1);
+
+    vec3 to_light = position_range.xyz - position;
+    float distance = length(to_light);
+    L = to_light / distance;
+
+    // Windowed inverse square falloff, lights without range are not attenuated
+    float attenuation = 1.0;
+    if (position_range.w > 0.0) {
+        float ratio = distance / position_range.w;
+        float window = clamp(1.0 - ratio * ratio * ratio * ratio, 0.0, 1.0);
+        attenuation = window * window / (distance * distance + 1.0);
+    }
+
+    // Smooth cone falloff of the spot lights
+    if (color_spot.w > 0.5) {
+        vec4 direction_outer = texelFetch(light_buffer, light_index * 4 + 2);
+        float cos_inner = texelFetch(light_buffer, light_index * 4 + 3).x;
+        attenuation *= smoothstep(direction_outer.w, cos_inner, dot(-L, direction_outer.xyz));
+    }
+
+    return color_spot.rgb * attenuation;
+}
+
 // PBR for one light
 vec3 compute_PBR(vec3 L, vec3 N, float material_metalness, float material_roughness, vec3 material_albedo, vec3 light_color){
     // Compute vectors
@@ -92,32 +137,42 @@ vec3 compute_PBR(vec3 L, vec3 N, float material_metalness, float material_roughn
 }
 
 void main (void) {
-    vec3 light_color = vec3 (1.0f);
     vec3 ambient_light = vec3(0.2f); 
 
     // get vectors
     vec3 normal = normalize(v_normal);
-    vec3 light_dir = normalize(light - v_world_position);
 
     // Get material properties
     vec3 material_albedo;
     float material_roughness;
     float material_metalness;
+    float material_occlusion;
 
     if (use_textures) {
+        vec3 orm = texture(orm_map, v_uv).rgb;
         material_albedo = texture(color_map, v_uv).xyz;
-        material_roughness = texture(roughness_map, v_uv).x;
-        material_metalness = texture(metalness_map, v_uv).x;
+        material_occlusion = orm.r;
+        material_roughness = orm.g;
+        material_metalness = orm.b;
     }
     else{
-        material_albedo = albedo;
-        material_roughness = roughness;
-        material_metalness = metalness;
+        material_albedo = v_albedo;
+        material_occlusion = 1.0;
+        material_roughness = v_roughness;
+        material_metalness = v_metalness;
     }
 
-    vec3 total_light = compute_PBR(light_dir, normal, material_metalness, material_roughness, material_albedo, light_color);
+    // Only the lights assigned to the cluster of the fragment
+    vec3 total_light = vec3(0.0);
+    uvec2 lights = cluster_lights_range(gl_FragCoord.xy, gl_FragCoord.z);
+    for (uint i = 0u; i < lights.y; ++i) {
+        int light_index = int(texelFetch(cluster_lights, int(lights.x + i)).r);
+        vec3 light_dir;
+        vec3 light_color = light_radiance(light_index, v_world_position, light_dir);
+        total_light += compute_PBR(light_dir, normal, material_metalness, material_roughness, material_albedo, light_color);
+    }
 
-    vec3 color = ambient_light * material_albedo;
+    vec3 color = ambient_light * material_albedo * material_occlusion;
     color += total_light;
 
     // Gamma correction
@@ -3,21 +3,42 @@
 layout (location = 0) in vec3 vert;
 layout (location = 1) in vec3 normal;
 layout (location = 2) in vec2 texCoord;
+layout (location = 3) in mat4 instance_transform;   // object to world, before model (locations 3 to 6)
+layout (location = 7) in int material_id;          // texel pair in material_buffer
 
 uniform mat4 projection;
 uniform mat4 view;
 uniform mat4 model;
 uniform mat3 normal_matrix;
 
+// Materials
+uniform samplerBuffer material_buffer;  // 2 texels per material: (albedo, roughness), (metalness, 0, 0, 0), negative for the global values
+uniform vec3 albedo;
+uniform float roughness;
+uniform float metalness;
+
 out vec3 v_normal;
 out vec2 v_uv;
 out vec3 v_world_position;
+flat out vec3 v_albedo;
+flat out float v_roughness;
+flat out float v_metalness;
+
+// Matches the depth pre-pass (depth.vert) for GL_EQUAL depth testing
+invariant gl_Position;
 
 void main(void)  {
-    v_normal = mat3(transpose(inverse(model))) * normal; // normal in world space
+    mat4 world = model * instance_transform;
+    v_normal = mat3(transpose(inverse(world))) * normal; // normal in world space
     v_uv = texCoord;
      
-    v_world_position = vec3(model * vec4( vert, 1.0f ));               // position of the vertex in world space
+    v_world_position = vec3(world * vec4( vert, 1.0f ));               // position of the vertex in world space
     gl_Position = projection * view * vec4(v_world_position, 1.0f);    // position of the vertex in clip space
-}
 
+    // Material of the vertex, negative values fall back to the global ones
+    vec4 material = texelFetch(material_buffer, 2 * material_id);
+    float material_metalness = texelFetch(material_buffer, 2 * material_id + 1).r;
+    v_albedo = material.r < 0.0 ? albedo : material.rgb;
+    v_roughness = material.a < 0.0 ? roughness : material.a;
+    v_metalness = material_metalness < 0.0 ? metalness : material_metalness;
+}
@@ -2,18 +2,17 @@
 in vec3 v_normal;
 in vec2 v_uv;
 in vec3 v_world_position;
+flat in vec3 v_albedo;      // Material, global or per vertex
 
 uniform vec3 light;           // Light position
 uniform vec3 camera_position; // Camera position
 
-uniform vec3 albedo; 
-
 out vec4 frag_color;
 
 void main(void) {
     // light and object colors
     vec3 light_color = vec3 (1.0f);
-    vec3 object_color = albedo;
+    vec3 object_color = v_albedo;
 
     // get vectors
     vec3 normal = normalize(v_normal);
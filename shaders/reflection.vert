@@ -3,6 +3,7 @@
 layout (location = 0) in vec3 vert;
 layout (location = 1) in vec3 normal;
 layout (location = 2) in vec2 texCoord;
+layout (location = 3) in mat4 instance_transform;   // object to world, before model (locations 3 to 6)
 
 uniform mat4 projection;
 uniform mat4 view;
@@ -12,10 +13,14 @@ uniform mat3 normal_matrix;
 out vec3 v_normal;
 out vec3 v_world_position;
 
+// Matches the depth pre-pass (depth.vert) for GL_EQUAL depth testing
+invariant gl_Position;
+
 void main(void)  {
-    v_normal = mat3(transpose(inverse(model))) * normal;               // normal in world space
+    mat4 world = model * instance_transform;
+    v_normal = mat3(transpose(inverse(world))) * normal;               // normal in world space
      
-    v_world_position = vec3(model * vec4( vert, 1.0f ));               // position of the vertex in world space
+    v_world_position = vec3(world * vec4( vert, 1.0f ));               // position of the vertex in world space
     gl_Position = projection * view * vec4(v_world_position, 1.0f);    // position of the vertex in clip space
 
 }
@@ -1,24 +1,16 @@
 #version 330
 
-layout (location = 0) in vec3 vert;
-layout (location = 1) in vec3 normal;
-layout (location = 2) in vec2 texCoord;
+uniform mat4 inverse_view_projection;   // Inverse of projection * view without translation
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
-
-out vec3 v_position;
+out vec3 v_direction;
 
 void main(void)  {
-    v_position = vert; 
+    // Fullscreen triangle: (-1,-1), (3,-1), (-1,3)
+    vec2 position = vec2(float((gl_VertexID & 1) << 2) - 1.0, float((gl_VertexID & 2) << 1) - 1.0);
 
-    // Remove translation from view matrix -> so that the skybox is not moved when the 
-    // camera moves (illusion of being far away)
-    mat4 sky_view = view;
-    sky_view[3][0] = 0.0f;
-    sky_view[3][1] = 0.0f;
-    sky_view[3][2] = 0.0f;
+    // View ray through the far plane, the perspective divide only scales it
+    // and interpolates linearly since w is 1 for the whole triangle
+    v_direction = (inverse_view_projection * vec4(position, 1.0, 1.0)).xyz;
 
-    gl_Position = projection * sky_view * vec4(vert, 1.0f);  // position of the vertex in clip space
+    gl_Position = vec4(position, 1.0, 1.0);   // z = w, at depth 1.0
 }
@@ -6,6 +6,7 @@ in vec2 v_uv;
 uniform sampler2D normal_texture;
 uniform sampler2D depth_texture;
 uniform sampler2D noise_texture;
+uniform bool octahedral_normals;    // Two channel normal target
 
 // SSAO parameters
 uniform int num_directions;
@@ -29,6 +30,19 @@ out vec4 frag_color;
 
 const float PI = 3.14159265359;
 
+// Normal stored in the G-buffer, octahedral encoded in two channels or
+// encoded from [-1, 1] to [0, 1] in three
+vec3 decode_normal(vec4 texel)
+{
+    if (!octahedral_normals) return normalize(texel.xyz * 2.0 - 1.0);
+
+    vec2 e = texel.xy * 2.0 - 1.0;
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
+
 
 vec3 reconstructPosition(vec2 texCoord, float depth) {
     // transform depth from [0, 1] to [-1, 1] NDC space and then to eye space
@@ -255,7 +269,7 @@ void main()
     }
 
     // Sample G-buffer data - reconstruct position to eye space
-    vec3 normal = normalize(texture(normal_texture, v_uv).rgb * 2.0 - 1.0);
+    vec3 normal = decode_normal(texture(normal_texture, v_uv));
     vec3 position = reconstructPosition(v_uv, depth);
 
     float ao;
@@ -4,8 +4,7 @@ in vec2 v_uv;
 
 uniform int current_texture;
 uniform sampler2D color_map;
-uniform sampler2D roughness_map;
-uniform sampler2D metalness_map;
+uniform sampler2D orm_map;
 
 out vec4 frag_color;
 
@@ -16,11 +15,15 @@ void main (void) {
         } 
     // Roughness Map
     else if (current_texture == 1) {
-        frag_color = texture(roughness_map, v_uv);
+        frag_color = vec4(texture(orm_map, v_uv).ggg, 1.0);
         } 
     // Metalness Map
     else if (current_texture == 2) {
-        frag_color = texture(metalness_map, v_uv);
+        frag_color = vec4(texture(orm_map, v_uv).bbb, 1.0);
+        } 
+    // Occlusion Map
+    else if (current_texture == 3) {
+        frag_color = vec4(texture(orm_map, v_uv).rrr, 1.0);
         } 
     // Default: gray color
     else {
@@ -3,6 +3,7 @@
 layout (location = 0) in vec3 vert;
 layout (location = 1) in vec3 normal;
 layout (location = 2) in vec2 texCoord;
+layout (location = 3) in mat4 instance_transform;   // object to world, before model (locations 3 to 6)
 
 uniform mat4 projection;
 uniform mat4 view;
@@ -10,9 +11,13 @@ uniform mat4 model;
 
 out vec2 v_uv;
 
+// Matches the depth pre-pass (depth.vert) for GL_EQUAL depth testing
+invariant gl_Position;
+
 void main(void)  {
     v_uv = texCoord;
     
-    vec3 v_world_position = vec3(model * vec4( vert, 1.0f ));               // position of the vertex in world space
+    mat4 world = model * instance_transform;
+    vec3 v_world_position = vec3(world * vec4( vert, 1.0f ));               // position of the vertex in world space
     gl_Position = projection * view * vec4(v_world_position, 1.0f);  
 }
@@ -0,0 +1,317 @@
+#include <simplify.h>
+
+#include <glm/geometric.hpp>
+#include <glm/vec3.hpp>
+
+#include <algorithm>
+#include <array>
+#include <numeric>
+#include <utility>
+
+#include "./parallel.h"
+
+namespace data_representation {
+
+namespace {
+
+// Weight of the border planes relative to the faces they border.
+const double kBorderWeight = 10.0;
+
+// Faces whose normal turns more than about 75 degrees reject the collapse.
+const float kMaxFlip = 0.25f;
+
+// Symmetric 4x4 matrix summing the squared distances to a set of planes.
+struct Quadric {
+  double a2, ab, ac, ad, b2, bc, bd, c2, cd, d2;
+};
+
+// Quadric of the plane dot(normal, p) + d = 0, normal of unit length.
+Quadric PlaneQuadric(const glm::vec3 &normal, float d, double weight) {
+  double a = normal.x, b = normal.y, c = normal.z;
+  return {weight * a * a, weight * a * b, weight * a * c, weight * a * d,
+          weight * b * b, weight * b * c, weight * b * d,
+          weight * c * c, weight * c * d, weight * d * d};
+}
+
+void Add(Quadric *to, const Quadric &quadric) {
+  to->a2 += quadric.a2; to->ab += quadric.ab; to->ac += quadric.ac;
+  to->ad += quadric.ad; to->b2 += quadric.b2; to->bc += quadric.bc;
+  to->bd += quadric.bd; to->c2 += quadric.c2; to->cd += quadric.cd;
+  to->d2 += quadric.d2;
+}
+
+double Error(const Quadric &q, const glm::vec3 &p) {
+  double x = p.x, y = p.y, z = p.z;
+  return q.a2 * x * x + q.b2 * y * y + q.c2 * z * z +
+         2.0 * (q.ab * x * y + q.ac * x * z + q.bc * y * z) +
+         2.0 * (q.ad * x + q.bd * y + q.cd * z) + q.d2;
+}
+
+// Triangles around each vertex: those of vertex v are
+// faces_[offsets_[v], offsets_[v + 1]).
+struct Adjacency {
+  std::vector<size_t> offsets_;
+  std::vector<int> faces_;
+};
+
+void BuildAdjacency(size_t vertices, const std::vector<int> &faces,
+                    Adjacency *adjacency) {
+  adjacency->offsets_.assign(vertices + 1, 0);
+  for (int index : faces) ++adjacency->offsets_[index + 1];
+  for (size_t v = 0; v < vertices; ++v)
+    adjacency->offsets_[v + 1] += adjacency->offsets_[v];
+
+  std::vector<size_t> next(adjacency->offsets_.begin(), adjacency->offsets_.end() - 1);
+  adjacency->faces_.resize(faces.size());
+  for (size_t i = 0; i < faces.size(); ++i)
+    adjacency->faces_[next[faces[i]]++] = static_cast<int>(i / 3);
+}
+
+// Edges of faces as (smaller, larger) vertex pairs with the triangle they
+// come from, sorted so that the copies of an edge are consecutive.
+std::vector<std::pair<std::pair<int, int>, int>> SortedEdges(
+    const std::vector<int> &faces) {
+  std::vector<std::pair<std::pair<int, int>, int>> edges;
+  edges.reserve(faces.size());
+  for (size_t i = 0; i < faces.size(); i += 3) {
+    for (int j = 0; j < 3; ++j) {
+      int a = faces[i + j], b = faces[i + (j + 1) % 3];
+      edges.push_back({{std::min(a, b), std::max(a, b)}, static_cast<int>(i / 3)});
+    }
+  }
+  std::sort(edges.begin(), edges.end());
+  return edges;
+}
+
+// Class of each vertex: the first vertex with the same position, or with the
+// same position and attributes when normals and texture coordinates are given.
+std::vector<int> WeldVertices(const std::vector<float> &vertices,
+                              const std::vector<float> &normals,
+                              const std::vector<float> &texture_coordinates) {
+  const size_t kVertices = vertices.size() / 3;
+  const bool kNormals = normals.size() == vertices.size();
+  const bool kTextureCoordinates = texture_coordinates.size() / 2 == kVertices;
+  std::vector<std::array<float, 8>> keys(kVertices);
+  utils::ParallelFor(0, kVertices, [&](size_t begin, size_t end) {
+    for (size_t v = begin; v < end; ++v) {
+      keys[v].fill(0.0f);
+      std::copy(&vertices[3 * v], &vertices[3 * v + 3], &keys[v][0]);
+      if (kNormals) std::copy(&normals[3 * v], &normals[3 * v + 3], &keys[v][3]);
+      if (kTextureCoordinates)
+        std::copy(&texture_coordinates[2 * v], &texture_coordinates[2 * v + 2], &keys[v][6]);
+    }
+  }, 1 << 12);
+  std::vector<int> order(kVertices);
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [&keys](int a, int b) {
+    return keys[a] < keys[b] || (keys[a] == keys[b] && a < b);
+  });
+
+  std::vector<int> classes(kVertices);
+  for (size_t i = 0; i < kVertices; ++i)
+    classes[order[i]] = i > 0 && keys[order[i - 1]] == keys[order[i]]
+                            ? classes[order[i - 1]] : order[i];
+  return classes;
+}
+
+}  // namespace
+
+std::vector<int> Simplify(const std::vector<float> &vertices,
+                          const std::vector<int> &faces,
+                          size_t target_triangles) {
+  std::vector<int> result = faces;
+  if (result.size() / 3 <= target_triangles) return result;
+
+  const size_t kVertices = vertices.size() / 3;
+  auto position = [&vertices](int v) {
+    return glm::vec3(vertices[3 * v], vertices[3 * v + 1], vertices[3 * v + 2]);
+  };
+  auto normal = [&position](int a, int b, int c) {
+    return glm::cross(position(b) - position(a), position(c) - position(a));
+  };
+
+  // The collapses work on positions: the vertices sharing one (texture or
+  // normal seams) are a single class, and the faces by class are kept next
+  // to the ones by vertex
+  const std::vector<int> kClasses = WeldVertices(vertices, {}, {});
+  std::vector<int> class_faces(result.size());
+  for (size_t i = 0; i < result.size(); ++i) class_faces[i] = kClasses[result[i]];
+  Adjacency adjacency;
+  BuildAdjacency(kVertices, class_faces, &adjacency);
+
+  // Area weighted planes of the faces around each class
+  std::vector<Quadric> quadrics(kVertices, Quadric{0, 0, 0, 0, 0, 0, 0, 0, 0, 0});
+  utils::ParallelFor(0, kVertices, [&](size_t begin, size_t end) {
+    for (size_t v = begin; v < end; ++v) {
+      for (size_t i = adjacency.offsets_[v]; i < adjacency.offsets_[v + 1]; ++i) {
+        const int *face = &class_faces[3 * adjacency.faces_[i]];
+        glm::vec3 n = normal(face[0], face[1], face[2]);
+        float length = glm::length(n);
+        if (length <= 0.0f) continue;
+        n /= length;
+        Add(&quadrics[v], PlaneQuadric(n, -glm::dot(n, position(face[0])), 0.5 * length));
+      }
+    }
+  }, 1 << 12);
+
+  // Edges used by a single face are on a border, a plane through the edge
+  // perpendicular to the face keeps it in place
+  std::vector<std::pair<std::pair<int, int>, int>> edges = SortedEdges(class_faces);
+  for (size_t i = 0; i < edges.size(); ++i) {
+    bool single = (i == 0 || edges[i - 1].first != edges[i].first) &&
+                  (i + 1 == edges.size() || edges[i + 1].first != edges[i].first);
+    if (!single) continue;
+    int a = edges[i].first.first, b = edges[i].first.second;
+    const int *face = &class_faces[3 * edges[i].second];
+    glm::vec3 edge = position(b) - position(a);
+    glm::vec3 n = glm::cross(edge, normal(face[0], face[1], face[2]));
+    float length = glm::length(n);
+    if (length <= 0.0f) continue;
+    n /= length;
+    Quadric border = PlaneQuadric(n, -glm::dot(n, position(a)),
+                                  kBorderWeight * glm::dot(edge, edge));
+    Add(&quadrics[a], border);
+    Add(&quadrics[b], border);
+  }
+
+  struct Collapse {
+    int from_, to_;
+    double cost_;
+  };
+
+  for (bool first_pass = true;; first_pass = false) {
+    size_t triangles = result.size() / 3;
+    if (triangles <= target_triangles) break;
+    if (!first_pass) {
+      BuildAdjacency(kVertices, class_faces, &adjacency);
+      edges = SortedEdges(class_faces);
+    }
+    edges.erase(std::unique(edges.begin(), edges.end(),
+                            [](const std::pair<std::pair<int, int>, int> &a,
+                               const std::pair<std::pair<int, int>, int> &b) {
+                              return a.first == b.first;
+                            }),
+                edges.end());
+
+    // Each edge collapses its cheapest end onto the other one
+    std::vector<Collapse> collapses(edges.size());
+    utils::ParallelFor(0, edges.size(), [&](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; ++i) {
+        int a = edges[i].first.first, b = edges[i].first.second;
+        Quadric sum = quadrics[a];
+        Add(&sum, quadrics[b]);
+        double a_to_b = Error(sum, position(b));
+        double b_to_a = Error(sum, position(a));
+        collapses[i] = a_to_b <= b_to_a ? Collapse{a, b, a_to_b}
+                                        : Collapse{b, a, b_to_a};
+      }
+    }, 1 << 12);
+    std::sort(collapses.begin(), collapses.end(),
+              [](const Collapse &a, const Collapse &b) { return a.cost_ < b.cost_; });
+
+    // A collapse freezes the faces around the moved class for the rest of
+    // the pass, so that the flip tests only see up to date positions
+    std::vector<char> touched(kVertices, 0);
+    std::vector<int> remap(kVertices);
+    std::iota(remap.begin(), remap.end(), 0);
+    std::vector<std::pair<int, int>> wedges;
+    size_t remaining = triangles, collapsed = 0;
+    for (const Collapse &collapse : collapses) {
+      if (remaining <= target_triangles) break;
+      if (touched[collapse.from_] || touched[collapse.to_]) continue;
+
+      const size_t kBegin = adjacency.offsets_[collapse.from_];
+      const size_t kEnd = adjacency.offsets_[collapse.from_ + 1];
+      bool flips = false;
+      for (size_t i = kBegin; i < kEnd && !flips; ++i) {
+        const int *face = &class_faces[3 * adjacency.faces_[i]];
+        if (face[0] == collapse.to_ || face[1] == collapse.to_ ||
+            face[2] == collapse.to_)
+          continue;
+        glm::vec3 before = normal(face[0], face[1], face[2]);
+        glm::vec3 p[3];
+        for (int j = 0; j < 3; ++j)
+          p[j] = position(face[j] == collapse.from_ ? collapse.to_ : face[j]);
+        glm::vec3 after = glm::cross(p[1] - p[0], p[2] - p[0]);
+        flips = glm::dot(before, after) <
+                kMaxFlip * glm::length(before) * glm::length(after);
+      }
+      if (flips) continue;
+
+      // Each vertex of the moved class goes to the vertex of the other class
+      // it shares a face with, so that attribute seams stay where they are.
+      // A vertex without one would leave its seam, the collapse is skipped
+      wedges.clear();
+      for (size_t i = kBegin; i < kEnd; ++i) {
+        const int kFace = adjacency.faces_[i];
+        int from = -1, to = -1;
+        for (int j = 0; j < 3; ++j) {
+          if (class_faces[3 * kFace + j] == collapse.from_) from = result[3 * kFace + j];
+          if (class_faces[3 * kFace + j] == collapse.to_) to = result[3 * kFace + j];
+        }
+        if (to >= 0) wedges.push_back({from, to});
+      }
+      bool seam = false;
+      for (size_t i = kBegin; i < kEnd && !seam; ++i) {
+        const int kFace = adjacency.faces_[i];
+        int from = -1;
+        for (int j = 0; j < 3; ++j)
+          if (class_faces[3 * kFace + j] == collapse.from_) from = result[3 * kFace + j];
+        seam = std::none_of(wedges.begin(), wedges.end(),
+                            [from](const std::pair<int, int> &w) { return w.first == from; });
+      }
+      if (seam) continue;
+
+      for (size_t i = kBegin; i < kEnd; ++i) {
+        const int *face = &class_faces[3 * adjacency.faces_[i]];
+        if (face[0] == collapse.to_ || face[1] == collapse.to_ ||
+            face[2] == collapse.to_)
+          --remaining;
+        touched[face[0]] = touched[face[1]] = touched[face[2]] = 1;
+      }
+      for (const std::pair<int, int> &wedge : wedges) remap[wedge.first] = wedge.second;
+      Add(&quadrics[collapse.to_], quadrics[collapse.from_]);
+      ++collapsed;
+    }
+    if (collapsed == 0) break;
+
+    // Faces that lost a position are dropped
+    size_t size = 0;
+    for (size_t i = 0; i < result.size(); i += 3) {
+      int a = remap[result[i]], b = remap[result[i + 1]], c = remap[result[i + 2]];
+      if (kClasses[a] == kClasses[b] || kClasses[b] == kClasses[c] ||
+          kClasses[c] == kClasses[a])
+        continue;
+      class_faces[size] = kClasses[a];
+      result[size++] = a;
+      class_faces[size] = kClasses[b];
+      result[size++] = b;
+      class_faces[size] = kClasses[c];
+      result[size++] = c;
+    }
+    result.resize(size);
+    class_faces.resize(size);
+  }
+  return result;
+}
+
+std::vector<std::vector<int>> BuildLods(const TriangleMesh &mesh) {
+  // The corners with the same position and attributes share a vertex, the
+  // readers that emit one vertex per face corner (OBJ) make them distinct
+  const std::vector<int> kWelded = WeldVertices(mesh.vertices_, mesh.normals_, mesh.texCoords_);
+  std::vector<int> faces(mesh.faces_.size());
+  for (size_t i = 0; i < faces.size(); ++i) faces[i] = kWelded[mesh.faces_[i]];
+
+  std::vector<std::vector<int>> lods;
+  const std::vector<int> *previous = &faces;
+  while (previous->size() / 3 > kLodMinTriangles) {
+    std::vector<int> level = Simplify(mesh.vertices_, *previous, previous->size() / 6);
+    // A level that could not get much smaller only costs memory
+    if (level.size() > previous->size() * 3 / 4) break;
+    lods.push_back(std::move(level));
+    previous = &lods.back();
+  }
+  return lods;
+}
+
+}  // namespace data_representation
@@ -0,0 +1,53 @@
+#ifndef SIMPLIFY_H_
+#define SIMPLIFY_H_
+
+#include <cstddef>
+#include <vector>
+
+#include "./triangle_mesh.h"
+
+namespace data_representation {
+
+/**
+ * @brief kLodMinTriangles Levels with at most this many triangles are not
+ * simplified any further.
+ */
+const size_t kLodMinTriangles = 1024;
+
+/**
+ * @brief Simplify Reduces faces to about target_triangles triangles by
+ * quadric error edge collapses (Garland and Heckbert), keeping the vertices:
+ * a vertex collapses onto the other end of an edge, so the result indexes
+ * the same vertex array and keeps its normals, texture coordinates and
+ * materials.
+ *
+ * The collapses run in passes: the quadrics and the cost of every edge are
+ * evaluated in parallel, then the cheapest edges are collapsed in order,
+ * skipping the ones next to a vertex already moved in the pass and the ones
+ * that would flip a triangle. Mesh borders are kept by extra quadrics
+ * perpendicular to the border faces. The vertices sharing a position
+ * (texture or normal seams) collapse together, each onto the vertex of the
+ * other end it shares a face with, so that seams only move along themselves.
+ * @param vertices Vertex positions, three floats per vertex.
+ * @param faces Triangles, three indices per triangle.
+ * @return The simplified triangles. May have more than target_triangles
+ * when no more edges can be collapsed.
+ */
+std::vector<int> Simplify(const std::vector<float> &vertices,
+                          const std::vector<int> &faces,
+                          size_t target_triangles);
+
+/**
+ * @brief BuildLods Simplifies mesh into a chain of levels of detail, each
+ * with about half the triangles of the previous one (50%, 25%, ...), down to
+ * kLodMinTriangles or until the simplification stalls. Every level is
+ * simplified from the previous one. The vertices with the same position and
+ * attributes are merged first, as readers like the OBJ one emit a vertex per
+ * face corner.
+ * @return The faces of each level, the original mesh not included.
+ */
+std::vector<std::vector<int>> BuildLods(const TriangleMesh &mesh);
+
+}  // namespace data_representation
+
+#endif  //  SIMPLIFY_H_
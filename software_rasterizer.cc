@@ -0,0 +1,375 @@
+#include <software_rasterizer.h>
+
+#include <glm/geometric.hpp>
+#include <glm/matrix.hpp>
+#include <glm/vec4.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+
+#include "./parallel.h"
+
+namespace data_visualization {
+
+namespace {
+
+/**
+ * @brief kBinBatch Triangles binned by the same thread. The tiles read the
+ * batches in order, so the triangles keep the order of the mesh.
+ */
+const size_t kBinBatch = 16384;
+
+const uint32_t kNoTriangle = std::numeric_limits<uint32_t>::max();
+
+const float kPi = 3.14159265358979323846f;
+
+// Twice the signed area of (a, b, p), positive with p to the left of a-b
+// in a y down window
+inline float Edge(float ax, float ay, float bx, float by, float px, float py) {
+  return (bx - ax) * (py - ay) - (by - ay) * (px - ax);
+}
+
+glm::vec3 Reflect(const glm::vec3 &incident, const glm::vec3 &normal) {
+  return incident - normal * (2.0f * glm::dot(normal, incident));
+}
+
+float Saturate(float value) { return std::min(std::max(value, 0.0f), 1.0f); }
+
+// phong.frag
+glm::vec3 ShadePhong(const glm::vec3 &normal, const glm::vec3 &position,
+                     const glm::vec3 &eye, const glm::vec3 &light,
+                     const glm::vec3 &albedo) {
+  glm::vec3 light_dir = glm::normalize(light - position);
+  glm::vec3 reflect_dir = glm::normalize(Reflect(-light_dir, normal));
+  glm::vec3 view_dir = glm::normalize(eye - position);
+
+  float ambient = 0.4f;
+  float diffuse = Saturate(glm::dot(normal, light_dir));
+  float specular = std::pow(Saturate(glm::dot(reflect_dir, view_dir)), 45.0f);
+  return albedo * (ambient + diffuse + specular);
+}
+
+// light_radiance of pbs.frag
+glm::vec3 LightRadiance(const Light &light, const glm::vec3 &position, glm::vec3 *to_light) {
+  glm::vec3 offset = light.position_ - position;
+  float distance = glm::length(offset);
+  *to_light = offset / distance;
+
+  float attenuation = 1.0f;
+  if (light.range_ > 0.0f) {
+    float ratio = distance / light.range_;
+    float window = Saturate(1.0f - ratio * ratio * ratio * ratio);
+    attenuation = window * window / (distance * distance + 1.0f);
+  }
+  if (light.type_ == LightType::kSpot) {
+    float cos_outer = std::cos(light.outer_angle_);
+    float cos_inner = std::cos(light.inner_angle_);
+    float t = Saturate((glm::dot(-*to_light, light.direction_) - cos_outer) /
+                       (cos_inner - cos_outer));
+    attenuation *= t * t * (3.0f - 2.0f * t);
+  }
+  return light.color_ * attenuation;
+}
+
+// compute_PBR of pbs.frag
+glm::vec3 ShadePbs(const glm::vec3 &to_light, const glm::vec3 &normal,
+                   const glm::vec3 &view_dir, float metalness, float roughness,
+                   const glm::vec3 &albedo, const glm::vec3 &fresnel,
+                   const glm::vec3 &light_color) {
+  glm::vec3 half = glm::normalize(to_light + view_dir);
+  float n_dot_h = Saturate(glm::dot(normal, half));
+  float n_dot_v = Saturate(glm::dot(normal, view_dir));
+  float l_dot_h = Saturate(glm::dot(to_light, half));
+  float n_dot_l = Saturate(glm::dot(normal, to_light));
+
+  glm::vec3 f0 = fresnel + (albedo - fresnel) * metalness;
+  glm::vec3 ks = f0 + (glm::vec3(1.0f) - f0) * std::pow(1.0f - l_dot_h, 5.0f);
+  glm::vec3 kd = (glm::vec3(1.0f) - ks) * (1.0f - metalness);
+
+  float alpha = roughness * roughness;
+  float alpha_sqr = alpha * alpha + 1e-6f;
+  glm::vec3 diffuse = kd * albedo / kPi;
+
+  float f = n_dot_h * n_dot_h * (alpha_sqr - 1.0f) + 1.0f;
+  float distribution = alpha_sqr / (kPi * f * f);
+  float k = (alpha + 1.0f) * (alpha + 1.0f) / 8.0f;
+  float geometry = n_dot_l / (n_dot_l * (1.0f - k) + k) * n_dot_v / (n_dot_v * (1.0f - k) + k);
+  glm::vec3 specular = ks * (distribution * geometry) / (4.0f * n_dot_l * n_dot_v + 1e-6f);
+
+  return (diffuse + specular) * light_color * n_dot_l;
+}
+
+uint32_t Pack(const glm::vec3 &color) {
+  uint32_t pixel = 0xFF000000u;
+  for (int i = 0; i < 3; ++i)
+    pixel |= static_cast<uint32_t>(Saturate(color[i]) * 255.0f + 0.5f) << (16 - 8 * i);
+  return pixel;
+}
+
+}  // namespace
+
+SoftwareRasterizer::SoftwareRasterizer()
+    : width_(0), height_(0), tiles_x_(0), tiles_y_(0), blocks_x_(0) {}
+
+void SoftwareRasterizer::Resize(int width, int height) {
+  width_ = width;
+  height_ = height;
+  tiles_x_ = (width + kRasterTileSize - 1) / kRasterTileSize;
+  tiles_y_ = (height + kRasterTileSize - 1) / kRasterTileSize;
+  blocks_x_ = (width + kHizBlockSize - 1) / kHizBlockSize;
+  const int kBlocksY = (height + kHizBlockSize - 1) / kHizBlockSize;
+  pixels_.assign(size_t(width) * height, 0);
+  depth_.assign(size_t(width) * height, 1.0f);
+  block_depth_.assign(size_t(blocks_x_) * kBlocksY, 1.0f);
+  triangles_.assign(size_t(width) * height, kNoTriangle);
+}
+
+void SoftwareRasterizer::Clear(const glm::vec3 &color) {
+  std::fill(pixels_.begin(), pixels_.end(), Pack(color));
+  std::fill(depth_.begin(), depth_.end(), 1.0f);
+  std::fill(block_depth_.begin(), block_depth_.end(), 1.0f);
+}
+
+void SoftwareRasterizer::Draw(const data_representation::TriangleMesh &mesh,
+                              const glm::mat4 &model, const glm::mat4 &view,
+                              const glm::mat4 &projection,
+                              const SoftwareShadingParameters &parameters) {
+  const size_t kVertices = mesh.vertices_.size() / 3;
+  const size_t kTriangles = mesh.faces_.size() / 3;
+  if (kTriangles == 0 || width_ == 0 || height_ == 0) return;
+  const bool kHasNormals = mesh.normals_.size() == mesh.vertices_.size();
+
+  // Vertex stage
+  const glm::mat4 kToClip = projection * view * model;
+  const glm::mat3 kNormalMatrix = glm::transpose(glm::inverse(glm::mat3(model)));
+  vertices_.resize(kVertices);
+  utils::ParallelFor(0, kVertices, [&](size_t begin, size_t end) {
+    for (size_t v = begin; v < end; ++v) {
+      glm::vec4 position(mesh.vertices_[3 * v], mesh.vertices_[3 * v + 1],
+                         mesh.vertices_[3 * v + 2], 1.0f);
+      glm::vec4 clip = kToClip * position;
+      ScreenVertex &vertex = vertices_[v];
+      // Behind the eye, the triangles using it are dropped
+      vertex.inverse_w_ = clip.w > 0.0f ? 1.0f / clip.w : 0.0f;
+      vertex.x_ = (clip.x * vertex.inverse_w_ * 0.5f + 0.5f) * width_;
+      vertex.y_ = (0.5f - clip.y * vertex.inverse_w_ * 0.5f) * height_;
+      vertex.z_ = clip.z * vertex.inverse_w_ * 0.5f + 0.5f;
+      vertex.world_ = glm::vec3(model * position);
+      vertex.normal_ = kHasNormals ? kNormalMatrix * glm::vec3(mesh.normals_[3 * v],
+                                                               mesh.normals_[3 * v + 1],
+                                                               mesh.normals_[3 * v + 2])
+                                   : glm::vec3(0.0f);
+    }
+  }, 4096);
+
+  // Material of every triangle, -1 for the global one
+  std::vector<int> materials(kTriangles, -1);
+  for (const data_representation::FaceRange &range : mesh.ranges_)
+    std::fill(materials.begin() + range.first_ / 3,
+              materials.begin() + (range.first_ + range.count_) / 3, range.material_);
+
+  // Binning, each batch keeps its own bins so that no lock is needed
+  const size_t kBatches = (kTriangles + kBinBatch - 1) / kBinBatch;
+  const int kTiles = tiles_x_ * tiles_y_;
+  std::vector<std::vector<std::vector<uint32_t>>> bins(
+      kBatches, std::vector<std::vector<uint32_t>>(kTiles));
+  utils::ParallelFor(0, kBatches, [&](size_t first_batch, size_t last_batch) {
+    for (size_t batch = first_batch; batch < last_batch; ++batch) {
+      const size_t kEnd = std::min(kTriangles, (batch + 1) * kBinBatch);
+      for (size_t t = batch * kBinBatch; t < kEnd; ++t) {
+        const ScreenVertex &a = vertices_[mesh.faces_[3 * t]];
+        const ScreenVertex &b = vertices_[mesh.faces_[3 * t + 1]];
+        const ScreenVertex &c = vertices_[mesh.faces_[3 * t + 2]];
+        if (a.inverse_w_ == 0.0f || b.inverse_w_ == 0.0f || c.inverse_w_ == 0.0f) continue;
+        if (Edge(a.x_, a.y_, b.x_, b.y_, c.x_, c.y_) == 0.0f) continue;
+
+        float min_x = std::min(a.x_, std::min(b.x_, c.x_));
+        float max_x = std::max(a.x_, std::max(b.x_, c.x_));
+        float min_y = std::min(a.y_, std::min(b.y_, c.y_));
+        float max_y = std::max(a.y_, std::max(b.y_, c.y_));
+        if (max_x < 0.0f || max_y < 0.0f || min_x >= width_ || min_y >= height_) continue;
+
+        int first_x = std::max(0, static_cast<int>(min_x) / kRasterTileSize);
+        int last_x = std::min(tiles_x_ - 1, static_cast<int>(max_x) / kRasterTileSize);
+        int first_y = std::max(0, static_cast<int>(min_y) / kRasterTileSize);
+        int last_y = std::min(tiles_y_ - 1, static_cast<int>(max_y) / kRasterTileSize);
+        for (int y = first_y; y <= last_y; ++y)
+          for (int x = first_x; x <= last_x; ++x)
+            bins[batch][y * tiles_x_ + x].push_back(t);
+      }
+    }
+  });
+
+  // The tiles do not take the same time, so the threads take them one at a
+  // time instead of in fixed ranges
+  const glm::vec3 kEye = glm::vec3(glm::inverse(view) * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+  std::atomic<int> next_tile(0);
+  utils::ParallelFor(0, utils::WorkerCount(), [&](size_t, size_t) {
+    for (int tile = next_tile++; tile < kTiles; tile = next_tile++) {
+      RasterizeTile(tile, mesh.faces_, bins);
+      ShadeTile(tile, mesh.faces_, materials, mesh, kEye, parameters);
+    }
+  });
+}
+
+void SoftwareRasterizer::RasterizeTile(
+    int tile, const std::vector<int> &faces,
+    const std::vector<std::vector<std::vector<uint32_t>>> &bins) {
+  const int kTileX = (tile % tiles_x_) * kRasterTileSize;
+  const int kTileY = (tile / tiles_x_) * kRasterTileSize;
+  const int kTileEndX = std::min(width_, kTileX + kRasterTileSize);
+  const int kTileEndY = std::min(height_, kTileY + kRasterTileSize);
+
+  for (int y = kTileY; y < kTileEndY; ++y)
+    std::fill(triangles_.begin() + size_t(y) * width_ + kTileX,
+              triangles_.begin() + size_t(y) * width_ + kTileEndX, kNoTriangle);
+
+  for (const std::vector<std::vector<uint32_t>> &batch : bins) {
+    for (uint32_t t : batch[tile]) {
+      const ScreenVertex *a = &vertices_[faces[3 * t]];
+      const ScreenVertex *b = &vertices_[faces[3 * t + 1]];
+      const ScreenVertex *c = &vertices_[faces[3 * t + 2]];
+      // Both sides are drawn, the back ones with their winding reversed
+      float area = Edge(a->x_, a->y_, b->x_, b->y_, c->x_, c->y_);
+      if (area < 0.0f) {
+        std::swap(b, c);
+        area = -area;
+      }
+      const float kInverseArea = 1.0f / area;
+      const float kMinDepth = std::min(a->z_, std::min(b->z_, c->z_));
+
+      int min_x = std::max(kTileX, static_cast<int>(std::floor(std::min(a->x_, std::min(b->x_, c->x_)))));
+      int max_x = std::min(kTileEndX - 1, static_cast<int>(std::ceil(std::max(a->x_, std::max(b->x_, c->x_)))));
+      int min_y = std::max(kTileY, static_cast<int>(std::floor(std::min(a->y_, std::min(b->y_, c->y_)))));
+      int max_y = std::min(kTileEndY - 1, static_cast<int>(std::ceil(std::max(a->y_, std::max(b->y_, c->y_)))));
+      if (min_x > max_x || min_y > max_y) continue;
+
+      // Edge functions step linearly along the rows and columns
+      const float kStepX0 = -(c->y_ - b->y_), kStepY0 = c->x_ - b->x_;
+      const float kStepX1 = -(a->y_ - c->y_), kStepY1 = a->x_ - c->x_;
+      const float kStepX2 = -(b->y_ - a->y_), kStepY2 = b->x_ - a->x_;
+
+      for (int block_y = min_y / kHizBlockSize; block_y <= max_y / kHizBlockSize; ++block_y) {
+        for (int block_x = min_x / kHizBlockSize; block_x <= max_x / kHizBlockSize; ++block_x) {
+          // Hierarchical depth test of the whole block
+          if (kMinDepth >= block_depth_[block_y * blocks_x_ + block_x]) continue;
+
+          const int kX0 = std::max(min_x, block_x * kHizBlockSize);
+          const int kX1 = std::min(max_x, block_x * kHizBlockSize + kHizBlockSize - 1);
+          const int kY0 = std::max(min_y, block_y * kHizBlockSize);
+          const int kY1 = std::min(max_y, block_y * kHizBlockSize + kHizBlockSize - 1);
+          float row0 = Edge(b->x_, b->y_, c->x_, c->y_, kX0 + 0.5f, kY0 + 0.5f);
+          float row1 = Edge(c->x_, c->y_, a->x_, a->y_, kX0 + 0.5f, kY0 + 0.5f);
+          float row2 = Edge(a->x_, a->y_, b->x_, b->y_, kX0 + 0.5f, kY0 + 0.5f);
+          bool written = false;
+          for (int y = kY0; y <= kY1; ++y) {
+            float e0 = row0, e1 = row1, e2 = row2;
+            const size_t kRow = size_t(y) * width_;
+            for (int x = kX0; x <= kX1; ++x) {
+              if (e0 >= 0.0f && e1 >= 0.0f && e2 >= 0.0f) {
+                float z = (e0 * a->z_ + e1 * b->z_ + e2 * c->z_) * kInverseArea;
+                if (z >= 0.0f && z < depth_[kRow + x]) {
+                  depth_[kRow + x] = z;
+                  triangles_[kRow + x] = t;
+                  written = true;
+                }
+              }
+              e0 += kStepX0;
+              e1 += kStepX1;
+              e2 += kStepX2;
+            }
+            row0 += kStepY0;
+            row1 += kStepY1;
+            row2 += kStepY2;
+          }
+          if (written) BoundBlock(block_x, block_y);
+        }
+      }
+    }
+  }
+}
+
+void SoftwareRasterizer::ShadeTile(int tile, const std::vector<int> &faces,
+                                   const std::vector<int> &materials,
+                                   const data_representation::TriangleMesh &mesh,
+                                   const glm::vec3 &eye,
+                                   const SoftwareShadingParameters &parameters) {
+  const int kTileX = (tile % tiles_x_) * kRasterTileSize;
+  const int kTileY = (tile / tiles_x_) * kRasterTileSize;
+  const int kTileEndX = std::min(width_, kTileX + kRasterTileSize);
+  const int kTileEndY = std::min(height_, kTileY + kRasterTileSize);
+  const glm::vec3 kPhongLight = parameters.lights_.empty()
+                                    ? glm::vec3(10.0f, 0.0f, 0.0f)
+                                    : parameters.lights_[0].position_;
+
+  for (int y = kTileY; y < kTileEndY; ++y) {
+    for (int x = kTileX; x < kTileEndX; ++x) {
+      const size_t kPixel = size_t(y) * width_ + x;
+      const uint32_t kTriangle = triangles_[kPixel];
+      if (kTriangle == kNoTriangle) continue;
+
+      // Perspective correct barycentrics at the pixel center
+      const ScreenVertex &a = vertices_[faces[3 * kTriangle]];
+      const ScreenVertex &b = vertices_[faces[3 * kTriangle + 1]];
+      const ScreenVertex &c = vertices_[faces[3 * kTriangle + 2]];
+      float px = x + 0.5f, py = y + 0.5f;
+      float wa = Edge(b.x_, b.y_, c.x_, c.y_, px, py) * a.inverse_w_;
+      float wb = Edge(c.x_, c.y_, a.x_, a.y_, px, py) * b.inverse_w_;
+      float wc = Edge(a.x_, a.y_, b.x_, b.y_, px, py) * c.inverse_w_;
+      float sum = wa + wb + wc;
+      if (sum == 0.0f) continue;
+      wa /= sum;
+      wb /= sum;
+      wc /= sum;
+      glm::vec3 position = a.world_ * wa + b.world_ * wb + c.world_ * wc;
+      glm::vec3 normal = a.normal_ * wa + b.normal_ * wb + c.normal_ * wc;
+      float length = glm::length(normal);
+      normal = length > 0.0f ? normal / length : glm::vec3(0.0f);
+
+      glm::vec3 albedo = parameters.albedo_;
+      float roughness = parameters.roughness_;
+      float metalness = parameters.metalness_;
+      if (materials[kTriangle] >= 0) {
+        const data_representation::MeshMaterial &material = mesh.materials_[materials[kTriangle]];
+        albedo = material.diffuse_;
+        // Like the shaders, the values the material does not give (-1) are
+        // the global ones
+        if (material.roughness_ >= 0.0f) roughness = material.roughness_;
+        if (material.metalness_ >= 0.0f) metalness = material.metalness_;
+      }
+
+      glm::vec3 color;
+      if (parameters.shading_ == SoftwareShading::kPhong) {
+        color = ShadePhong(normal, position, eye, kPhongLight, albedo);
+      } else {
+        glm::vec3 view_dir = glm::normalize(eye - position);
+        color = albedo * 0.2f;
+        for (const Light &light : parameters.lights_) {
+          glm::vec3 to_light;
+          glm::vec3 radiance = LightRadiance(light, position, &to_light);
+          color += ShadePbs(to_light, normal, view_dir, metalness, roughness, albedo,
+                            parameters.fresnel_, radiance);
+        }
+      }
+      if (parameters.gamma_correction_)
+        for (int i = 0; i < 3; ++i) color[i] = std::pow(std::max(color[i], 0.0f), 1.0f / 2.2f);
+      pixels_[kPixel] = Pack(color);
+    }
+  }
+}
+
+void SoftwareRasterizer::BoundBlock(int block_x, int block_y) {
+  const int kX0 = block_x * kHizBlockSize;
+  const int kY0 = block_y * kHizBlockSize;
+  const int kX1 = std::min(width_, kX0 + kHizBlockSize);
+  const int kY1 = std::min(height_, kY0 + kHizBlockSize);
+  float farthest = 0.0f;
+  for (int y = kY0; y < kY1; ++y)
+    for (int x = kX0; x < kX1; ++x)
+      farthest = std::max(farthest, depth_[size_t(y) * width_ + x]);
+  block_depth_[block_y * blocks_x_ + block_x] = farthest;
+}
+
+}  //  namespace data_visualization
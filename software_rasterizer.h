@@ -0,0 +1,144 @@
+#ifndef SOFTWARE_RASTERIZER_H_
+#define SOFTWARE_RASTERIZER_H_
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "./light_clusters.h"
+#include "./triangle_mesh.h"
+
+namespace data_visualization {
+
+/**
+ * @brief kRasterTileSize Side in pixels of the screen tiles the triangles are
+ * binned to, each rasterized and shaded by a single thread.
+ */
+const int kRasterTileSize = 64;
+
+/**
+ * @brief kHizBlockSize Side in pixels of the blocks of the hierarchical depth
+ * buffer, which keeps the farthest depth of each block.
+ */
+const int kHizBlockSize = 8;
+
+/**
+ * @brief SoftwareShading Shading equations of the software rasterizer, C++
+ * ports of the ones of phong.frag and pbs.frag.
+ */
+enum class SoftwareShading { kPhong, kPbs };
+
+/**
+ * @brief SoftwareShadingParameters What the uniforms of the shaders give the
+ * GL renderer. The materials of the mesh ranges override the global one.
+ */
+struct SoftwareShadingParameters {
+  SoftwareShading shading_;
+  glm::vec3 albedo_;        // Global material
+  float roughness_;
+  float metalness_;
+  glm::vec3 fresnel_;       // F0 of the dielectrics
+  std::vector<Light> lights_;  // Phong only uses the position of the first one
+  bool gamma_correction_;
+};
+
+/**
+ * @brief SoftwareRasterizer CPU renderer of triangle meshes, for the places
+ * without a GL context (headless thumbnails).
+ *
+ * Draw transforms the vertices in parallel, then bins the triangles to the
+ * kRasterTileSize screen tiles they overlap, keeping their order, and
+ * rasterizes every tile on its own thread, so that no two threads write the
+ * same pixel. Triangles are scanned with half-space edge functions, by
+ * kHizBlockSize blocks whose farthest depth is kept: a block the triangle is
+ * entirely behind is skipped without testing its pixels. The rasterization
+ * only writes the depth and the triangle of each pixel; every visible pixel
+ * is shaded once, after the whole mesh is rasterized, with perspective
+ * correct attributes.
+ *
+ * Triangles are drawn from both sides, and the ones with a vertex behind the
+ * eye are dropped instead of clipped.
+ */
+class SoftwareRasterizer {
+ public:
+  SoftwareRasterizer();
+
+  /**
+   * @brief Resize Sets the size of the image, clearing it.
+   */
+  void Resize(int width, int height);
+
+  /**
+   * @brief Clear Fills the image with color and the depth with the far plane.
+   */
+  void Clear(const glm::vec3 &color);
+
+  /**
+   * @brief Draw Renders mesh over the image, depth tested against what was
+   * drawn since the last Clear.
+   * @param model Object to world transform, the lights and the camera are in
+   * world space.
+   */
+  void Draw(const data_representation::TriangleMesh &mesh, const glm::mat4 &model,
+            const glm::mat4 &view, const glm::mat4 &projection,
+            const SoftwareShadingParameters &parameters);
+
+  int Width() const { return width_; }
+  int Height() const { return height_; }
+
+  /**
+   * @brief Pixels The image, 0xAARRGGBB per pixel with the top row first.
+   */
+  const std::vector<uint32_t> &Pixels() const { return pixels_; }
+
+ private:
+  /**
+   * @brief ScreenVertex A vertex after the vertex stage: window position and
+   * depth, the reciprocal of its clip w for the perspective correction, and
+   * the world space attributes shaded with.
+   */
+  struct ScreenVertex {
+    float x_, y_, z_;
+    float inverse_w_;
+    glm::vec3 world_;
+    glm::vec3 normal_;
+  };
+
+  /**
+   * @brief RasterizeTile Scans the triangles binned to tile into the depth
+   * and triangle buffers.
+   */
+  void RasterizeTile(int tile, const std::vector<int> &faces,
+                     const std::vector<std::vector<std::vector<uint32_t>>> &bins);
+
+  /**
+   * @brief ShadeTile Shades the pixels of tile covered by the last Draw.
+   */
+  void ShadeTile(int tile, const std::vector<int> &faces,
+                 const std::vector<int> &materials,
+                 const data_representation::TriangleMesh &mesh,
+                 const glm::vec3 &eye, const SoftwareShadingParameters &parameters);
+
+  /**
+   * @brief BoundBlock Recomputes the farthest depth of a hierarchical block.
+   */
+  void BoundBlock(int block_x, int block_y);
+
+  int width_;
+  int height_;
+  int tiles_x_;
+  int tiles_y_;
+  int blocks_x_;
+  std::vector<uint32_t> pixels_;
+  std::vector<float> depth_;
+  std::vector<float> block_depth_;   // Farthest depth of each block
+  std::vector<uint32_t> triangles_;  // Triangle of each pixel in the last Draw
+  std::vector<ScreenVertex> vertices_;
+};
+
+}  //  namespace data_visualization
+
+#endif  //  SOFTWARE_RASTERIZER_H_
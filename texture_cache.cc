@@ -0,0 +1,270 @@
+#include <texture_cache.h>
+
+#include <QDir>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QRegularExpression>
+
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <utility>
+
+#include "./environment_library.h"
+#include "./parallel.h"
+#include "./texture_io.h"
+
+namespace data_representation {
+
+namespace {
+
+// Whether the viewer requests the image with its mip chain, the flag its
+// cache entry is keyed by. Cube map faces are only mipmapped in the
+// specular_prefilter maps of the environments; the other cube maps, sky,
+// irradiance and the flat "<name>_specular" and "<name>_diffuse" folders of
+// Load Specular and Load Diffuse, are sampled without mipmaps.
+bool IsMipmapped(const QFileInfo &info) {
+  bool face = false;
+  for (const char *name : kCubeFaces)
+    face = face || "/" + info.fileName() == name;
+  return !face || info.dir().dirName() == "specular_prefilter";
+}
+
+enum class MapKind { kNone, kColor, kOcclusion, kRoughness, kMetalness };
+
+// Kind of material map, from the last word of names like
+// "<material>_Roughness.png" or "<material>-ao.png".
+MapKind GetMapKind(const QFileInfo &info) {
+  QStringList tokens =
+      info.completeBaseName().toLower().split(QRegularExpression("[-_ ]"));
+  const QString &kind = tokens.back();
+  if (tokens.size() < 2) return MapKind::kNone;
+  if (kind == "color" || kind == "albedo" || kind == "basecolor")
+    return MapKind::kColor;
+  if (kind == "ao" || kind == "occlusion") return MapKind::kOcclusion;
+  if (kind.startsWith("rough")) return MapKind::kRoughness;
+  if (kind.startsWith("metal")) return MapKind::kMetalness;
+  return MapKind::kNone;
+}
+
+// Single channel maps, only uploaded packed into the uncompressed ORM texture.
+bool IsScalarMap(const QFileInfo &info) {
+  MapKind kind = GetMapKind(info);
+  return kind == MapKind::kOcclusion || kind == MapKind::kRoughness ||
+         kind == MapKind::kMetalness;
+}
+
+// Decodes the image at path as 8 bit grayscale. An empty path gives an empty
+// image.
+bool LoadGrayscale(const std::string &path, DecodedImage *image) {
+  image->width_ = image->height_ = 0;
+  if (path.empty()) return true;
+  if (!DecodeImage(path, PixelFormat::kR8, image)) {
+    std::cerr << "Error reading " << path << std::endl;
+    return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+bool LoadCompressedTexture(const std::string &path, BlockFormat format,
+                           bool mipmaps, CompressedTexture *texture) {
+  uint64_t hash;
+  if (!HashFile(path, &hash)) return false;
+
+  std::string cache = CachePath(path, hash, format, mipmaps);
+  if (ReadCompressedTexture(cache, texture)) return true;
+
+  DecodedImage image;
+  if (!DecodeImage(path, PixelFormat::kRGBA8, &image)) return false;
+
+  CompressTexture(image.Pixels(), image.width_, image.height_, format, mipmaps,
+                  texture);
+
+  QDir().mkpath(QFileInfo(QString::fromStdString(cache)).absolutePath());
+  if (!WriteCompressedTexture(cache, *texture))
+    std::cerr << "Could not write texture cache " << cache << std::endl;
+
+  return true;
+}
+
+std::vector<MaterialMaps> FindMaterials(const std::string &dir) {
+  std::map<std::pair<QString, QString>, MaterialMaps> materials;
+  QDirIterator it(QString::fromStdString(dir),
+                  QStringList() << "*.png" << "*.jpg", QDir::Files,
+                  QDirIterator::Subdirectories);
+  while (it.hasNext()) {
+    QFileInfo info(it.next());
+    if (info.path().contains("/.cache")) continue;
+
+    MapKind kind = GetMapKind(info);
+    if (kind == MapKind::kNone) continue;
+
+    QString base = info.completeBaseName();
+    QString name = base.left(base.lastIndexOf(QRegularExpression("[-_ ]")));
+    MaterialMaps &material = materials[std::make_pair(info.path(), name)];
+    material.name_ = name.toStdString();
+
+    std::string path = info.filePath().toStdString();
+    switch (kind) {
+      case MapKind::kColor:
+        material.color_ = path;
+        break;
+      case MapKind::kOcclusion:
+        material.occlusion_ = path;
+        break;
+      case MapKind::kRoughness:
+        material.roughness_ = path;
+        break;
+      case MapKind::kMetalness:
+        material.metalness_ = path;
+        break;
+      case MapKind::kNone:
+        break;
+    }
+  }
+
+  std::vector<MaterialMaps> result;
+  for (const auto &material : materials) {
+    const MaterialMaps &maps = material.second;
+    if (!maps.color_.empty() || !maps.roughness_.empty() ||
+        !maps.metalness_.empty())
+      result.push_back(maps);
+  }
+  std::sort(result.begin(), result.end(),
+            [](const MaterialMaps &a, const MaterialMaps &b) {
+              return a.name_ < b.name_;
+            });
+  return result;
+}
+
+bool PackORMImage(const std::string &occlusion, const std::string &roughness,
+                  const std::string &metalness,
+                  std::vector<unsigned char> *rgba, int *width, int *height,
+                  size_t *bytes_copied) {
+  const std::string *paths[3] = {&occlusion, &roughness, &metalness};
+  const unsigned char kDefaults[3] = {255, 255, 0};
+
+  DecodedImage images[3];
+  bool loaded[3];
+  utils::ParallelFor(0, 3, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i)
+      loaded[i] = LoadGrayscale(*paths[i], &images[i]);
+  });
+  if (!loaded[0] || !loaded[1] || !loaded[2]) return false;
+
+  const DecodedImage *reference = nullptr;
+  for (const DecodedImage &image : images)
+    if (!reference && image.width_ > 0) reference = &image;
+  if (!reference) return false;
+
+  *width = reference->width_;
+  *height = reference->height_;
+  *bytes_copied = 0;
+  for (DecodedImage &image : images) {
+    if (image.width_ == 0) continue;
+    *bytes_copied += image.bytes_copied_;
+    if (image.width_ == *width && image.height_ == *height) continue;
+    image.image_ = image.image_.scaled(*width, *height, Qt::IgnoreAspectRatio,
+                                       Qt::SmoothTransformation);
+    *bytes_copied += image.image_.sizeInBytes();
+    image.width_ = *width;
+    image.height_ = *height;
+    image.stride_ = image.image_.bytesPerLine();
+  }
+
+  rgba->resize(static_cast<size_t>(*width) * *height * 4);
+  utils::ParallelFor(0, *height, [&](size_t begin, size_t end) {
+    for (size_t y = begin; y < end; ++y) {
+      unsigned char *out = rgba->data() + y * *width * 4;
+      for (int c = 0; c < 3; ++c) {
+        const unsigned char *in = images[c].width_ > 0 ? images[c].Row(y) : nullptr;
+        for (int x = 0; x < *width; ++x)
+          out[x * 4 + c] = in ? in[x] : kDefaults[c];
+      }
+      for (int x = 0; x < *width; ++x) out[x * 4 + 3] = 255;
+    }
+  }, 16);
+
+  return true;
+}
+
+bool LoadORMImage(const std::string &occlusion, const std::string &roughness,
+                  const std::string &metalness,
+                  std::vector<unsigned char> *rgba, int *width, int *height,
+                  size_t *bytes_copied) {
+  // Combined FNV-1a of the source hashes, missing maps count as 0
+  const std::string *source = nullptr;
+  uint64_t hash = 14695981039346656037ull;
+  for (const std::string *path : {&occlusion, &roughness, &metalness}) {
+    uint64_t map_hash = 0;
+    if (!path->empty()) {
+      if (!HashFile(*path, &map_hash)) {
+        std::cerr << "Error reading " << *path << std::endl;
+        return false;
+      }
+      if (!source) source = path;
+    }
+    hash = (hash ^ map_hash) * 1099511628211ull;
+  }
+  if (!source) return false;
+
+  *bytes_copied = 0;
+  std::string cache = PackedCachePath(*source, hash, "orm");
+  if (ReadRGBA8Texture(cache, rgba, width, height)) return true;
+
+  if (!PackORMImage(occlusion, roughness, metalness, rgba, width, height,
+                    bytes_copied))
+    return false;
+
+  QDir().mkpath(QFileInfo(QString::fromStdString(cache)).absolutePath());
+  if (!WriteRGBA8Texture(cache, rgba->data(), *width, *height))
+    std::cerr << "Could not write texture cache " << cache << std::endl;
+
+  return true;
+}
+
+int BakeTextureCache(const std::string &dir) {
+  int failed = 0;
+  QDirIterator it(QString::fromStdString(dir), QStringList() << "*.png",
+                  QDir::Files, QDirIterator::Subdirectories);
+  while (it.hasNext()) {
+    QFileInfo info(it.next());
+    if (info.path().contains("/.cache") || IsScalarMap(info)) continue;
+
+    BlockFormat format = BlockFormat::kBC1;
+    if (info.fileName().toLower().contains("brdf")) format = BlockFormat::kBC5;
+    bool mipmaps = IsMipmapped(info);
+
+    CompressedTexture texture;
+    std::string path = info.filePath().toStdString();
+    if (LoadCompressedTexture(path, format, mipmaps, &texture)) {
+      std::cout << "Cached " << path << std::endl;
+    } else {
+      std::cerr << "Error transcoding " << path << std::endl;
+      ++failed;
+    }
+  }
+
+  for (const MaterialMaps &maps : FindMaterials(dir)) {
+    if (maps.occlusion_.empty() && maps.roughness_.empty() &&
+        maps.metalness_.empty())
+      continue;
+
+    std::vector<unsigned char> rgba;
+    int width, height;
+    size_t bytes_copied;
+    if (LoadORMImage(maps.occlusion_, maps.roughness_, maps.metalness_, &rgba,
+                     &width, &height, &bytes_copied)) {
+      std::cout << "Cached ORM of " << maps.name_ << std::endl;
+    } else {
+      std::cerr << "Error packing the ORM of " << maps.name_ << std::endl;
+      ++failed;
+    }
+  }
+
+  return failed;
+}
+
+}  // namespace data_representation
@@ -0,0 +1,97 @@
+#ifndef TEXTURE_CACHE_H_
+#define TEXTURE_CACHE_H_
+
+#include <texture_compression.h>
+
+#include <string>
+#include <vector>
+
+namespace data_representation {
+
+/**
+ * @brief MaterialMaps Paths of the maps of a material. Empty when the
+ * material does not provide that map.
+ */
+struct MaterialMaps {
+  std::string name_;
+  std::string color_;
+  std::string occlusion_;
+  std::string roughness_;
+  std::string metalness_;
+};
+
+/**
+ * @brief FindMaterials Groups the images of dir and its subdirectories into
+ * materials. A map kind is recognised from the last word of the file name
+ * ("_Color", "-ao", "_Roughness", "_Metallic", ...) and maps sharing the same
+ * directory and prefix belong to the same material.
+ * @param dir Root directory of the textures.
+ * @return The materials with at least a color, roughness or metalness map,
+ * sorted by name.
+ */
+std::vector<MaterialMaps> FindMaterials(const std::string &dir);
+
+/**
+ * @brief LoadCompressedTexture Returns the block compressed version of the
+ * image at path. The cache entry keyed by the image contents hash is used when
+ * it exists, otherwise the image is decoded, transcoded and stored in the
+ * cache for the next time.
+ * @param path Path to the source image.
+ * @param format Target block format.
+ * @param mipmaps Whether the full mip chain is needed.
+ * @param texture The resulting compressed texture.
+ * @return Whether it was able to read or decode the image.
+ */
+bool LoadCompressedTexture(const std::string &path, BlockFormat format,
+                           bool mipmaps, CompressedTexture *texture);
+
+/**
+ * @brief PackORMImage Packs the occlusion, roughness and metalness maps into
+ * the red, green and blue channels of one RGBA8 image (glTF ORM convention).
+ * The maps are decoded and packed in parallel. Missing maps are filled with
+ * full occlusion, full roughness and no metalness, and maps with a different
+ * size are resampled to the size of the first available one.
+ * @param occlusion Path to the occlusion map, may be empty.
+ * @param roughness Path to the roughness map, may be empty.
+ * @param metalness Path to the metalness map, may be empty.
+ * @param rgba The resulting tightly packed pixels.
+ * @param width The resulting image width.
+ * @param height The resulting image height.
+ * @param bytes_copied Bytes copied to convert and resample the decoded maps
+ * before packing them.
+ * @return Whether at least one map was given and all of them could be read.
+ */
+bool PackORMImage(const std::string &occlusion, const std::string &roughness,
+                  const std::string &metalness,
+                  std::vector<unsigned char> *rgba, int *width, int *height,
+                  size_t *bytes_copied);
+
+/**
+ * @brief LoadORMImage Returns the ORM image of the maps (see PackORMImage).
+ * The cache entry keyed by the contents hashes of the three maps, stored
+ * uncompressed next to the first given one, is used when it exists, otherwise
+ * the maps are packed and stored in the cache for the next time.
+ * @param bytes_copied Bytes copied by the packing, 0 when read from the
+ * cache.
+ * @return Whether at least one map was given and all of them could be read.
+ */
+bool LoadORMImage(const std::string &occlusion, const std::string &roughness,
+                  const std::string &metalness,
+                  std::vector<unsigned char> *rgba, int *width, int *height,
+                  size_t *bytes_copied);
+
+/**
+ * @brief BakeTextureCache Offline transcoder. Walks dir recursively and fills
+ * the cache with the textures the viewer will request: the BRDF LUTs as BC5,
+ * every other image but the occlusion, roughness and metalness maps as BC1,
+ * mipmapped except the cube maps other than the prefiltered specular ones
+ * (as the loaders request them), and the ORM image of
+ * every material of FindMaterials.
+ * @param dir Root directory of the textures.
+ * @return The number of images that could not be transcoded.
+ */
+int BakeTextureCache(const std::string &dir);
+
+}  // namespace data_representation
+
+#endif  // TEXTURE_CACHE_H_
@@ -0,0 +1,480 @@
+#include <texture_compression.h>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include "./parallel.h"
+
+namespace data_representation {
+
+namespace {
+
+const uint32_t kDDSMagic = 0x20534444;  // "DDS "
+const uint32_t kDDSHeaderSize = 124;
+const uint32_t kDDSPixelFormatSize = 32;
+
+// DDS header flags.
+const uint32_t kDDSDCaps = 0x1;
+const uint32_t kDDSDHeight = 0x2;
+const uint32_t kDDSDWidth = 0x4;
+const uint32_t kDDSDPixelFormat = 0x1000;
+const uint32_t kDDSDMipMapCount = 0x20000;
+const uint32_t kDDSDLinearSize = 0x80000;
+const uint32_t kDDSDPitch = 0x8;
+const uint32_t kDDPFAlphaPixels = 0x1;
+const uint32_t kDDPFFourCC = 0x4;
+const uint32_t kDDPFRGB = 0x40;
+const uint32_t kDDSCapsComplex = 0x8;
+const uint32_t kDDSCapsTexture = 0x1000;
+const uint32_t kDDSCapsMipMap = 0x400000;
+
+// Largest width or height accepted from a cache file.
+const uint32_t kMaxTextureSize = 1 << 15;
+
+uint32_t FourCC(char a, char b, char c, char d) {
+  return static_cast<uint32_t>(a) | (static_cast<uint32_t>(b) << 8) |
+         (static_cast<uint32_t>(c) << 16) | (static_cast<uint32_t>(d) << 24);
+}
+
+uint32_t FormatFourCC(BlockFormat format) {
+  switch (format) {
+    case BlockFormat::kBC1: return FourCC('D', 'X', 'T', '1');
+    case BlockFormat::kBC4: return FourCC('A', 'T', 'I', '1');
+    case BlockFormat::kBC5: return FourCC('A', 'T', 'I', '2');
+  }
+  return 0;
+}
+
+const char *FormatName(BlockFormat format) {
+  switch (format) {
+    case BlockFormat::kBC1: return "bc1";
+    case BlockFormat::kBC4: return "bc4";
+    case BlockFormat::kBC5: return "bc5";
+  }
+  return "";
+}
+
+size_t LevelBytes(BlockFormat format, int width, int height) {
+  size_t blocks_x = static_cast<size_t>(std::max(1, (width + 3) / 4));
+  size_t blocks_y = static_cast<size_t>(std::max(1, (height + 3) / 4));
+  return blocks_x * blocks_y * BlockBytes(format);
+}
+
+// Bytes left to read in the file, so that a truncated or corrupt file is
+// rejected before allocating the size its header claims.
+size_t RemainingBytes(std::ifstream &fin) {
+  std::streamoff offset = fin.tellg();
+  fin.seekg(0, std::ios_base::end);
+  std::streamoff end = fin.tellg();
+  fin.seekg(offset);
+  return static_cast<size_t>(end - offset);
+}
+
+// Loads the 4x4 block at (bx, by) clamping reads at the image borders.
+void FetchBlock(const unsigned char *rgba, int width, int height, int bx,
+                int by, unsigned char block[16][4]) {
+  for (int y = 0; y < 4; ++y) {
+    int py = std::min(by * 4 + y, height - 1);
+    for (int x = 0; x < 4; ++x) {
+      int px = std::min(bx * 4 + x, width - 1);
+      const unsigned char *texel =
+          rgba + (static_cast<size_t>(py) * width + px) * 4;
+      for (int c = 0; c < 4; ++c) block[y * 4 + x][c] = texel[c];
+    }
+  }
+}
+
+uint16_t To565(const int color[3]) {
+  int r = (color[0] * 31 + 127) / 255;
+  int g = (color[1] * 63 + 127) / 255;
+  int b = (color[2] * 31 + 127) / 255;
+  return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+}
+
+void From565(uint16_t packed, int color[3]) {
+  int r = (packed >> 11) & 31;
+  int g = (packed >> 5) & 63;
+  int b = packed & 31;
+  color[0] = (r << 3) | (r >> 2);
+  color[1] = (g << 2) | (g >> 4);
+  color[2] = (b << 3) | (b >> 2);
+}
+
+// BC1 encoder based on an inset bounding box whose diagonal is chosen from the
+// sign of the color covariance (J.M.P. van Waveren, "Real-Time DXT
+// Compression").
+void EncodeBC1Block(const unsigned char block[16][4], unsigned char *out) {
+  int min_color[3] = {255, 255, 255};
+  int max_color[3] = {0, 0, 0};
+  for (int i = 0; i < 16; ++i) {
+    for (int c = 0; c < 3; ++c) {
+      min_color[c] = std::min(min_color[c], static_cast<int>(block[i][c]));
+      max_color[c] = std::max(max_color[c], static_cast<int>(block[i][c]));
+    }
+  }
+
+  // Select the bounding box diagonal that follows the colors distribution.
+  int center[3];
+  for (int c = 0; c < 3; ++c) center[c] = (min_color[c] + max_color[c]) / 2;
+  int cov_rg = 0, cov_bg = 0;
+  for (int i = 0; i < 16; ++i) {
+    int g = block[i][1] - center[1];
+    cov_rg += (block[i][0] - center[0]) * g;
+    cov_bg += (block[i][2] - center[2]) * g;
+  }
+  if (cov_rg < 0) std::swap(min_color[0], max_color[0]);
+  if (cov_bg < 0) std::swap(min_color[2], max_color[2]);
+
+  // Inset the box to reduce the error of the interpolated colors.
+  for (int c = 0; c < 3; ++c) {
+    int inset = (max_color[c] - min_color[c]) / 16;
+    max_color[c] = std::max(0, std::min(255, max_color[c] - inset));
+    min_color[c] = std::max(0, std::min(255, min_color[c] + inset));
+  }
+
+  uint16_t c0 = To565(max_color);
+  uint16_t c1 = To565(min_color);
+  if (c0 < c1) std::swap(c0, c1);
+
+  uint32_t indices = 0;
+  if (c0 != c1) {
+    int palette[4][3];
+    From565(c0, palette[0]);
+    From565(c1, palette[1]);
+    for (int c = 0; c < 3; ++c) {
+      palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+      palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+    }
+
+    for (int i = 0; i < 16; ++i) {
+      int best = 0, best_error = 0x7fffffff;
+      for (int p = 0; p < 4; ++p) {
+        int error = 0;
+        for (int c = 0; c < 3; ++c) {
+          int d = block[i][c] - palette[p][c];
+          error += d * d;
+        }
+        if (error < best_error) {
+          best_error = error;
+          best = p;
+        }
+      }
+      indices |= static_cast<uint32_t>(best) << (2 * i);
+    }
+  }
+
+  out[0] = c0 & 0xff;
+  out[1] = c0 >> 8;
+  out[2] = c1 & 0xff;
+  out[3] = c1 >> 8;
+  for (int i = 0; i < 4; ++i) out[4 + i] = (indices >> (8 * i)) & 0xff;
+}
+
+// BC4 encoder for the given channel using the 8 value interpolation mode
+// with the block min/max as endpoints.
+void EncodeBC4Block(const unsigned char block[16][4], int channel,
+                    unsigned char *out) {
+  int min_value = 255, max_value = 0;
+  for (int i = 0; i < 16; ++i) {
+    min_value = std::min(min_value, static_cast<int>(block[i][channel]));
+    max_value = std::max(max_value, static_cast<int>(block[i][channel]));
+  }
+
+  uint64_t indices = 0;
+  if (max_value > min_value) {
+    const int kRange = max_value - min_value;
+    for (int i = 0; i < 16; ++i) {
+      // Position of the value between min (0) and max (7).
+      int t = ((block[i][channel] - min_value) * 7 + kRange / 2) / kRange;
+      // Index 0 is max, 1 is min and 2..7 go from max to min.
+      uint64_t index = t == 7 ? 0 : (t == 0 ? 1 : 8 - t);
+      indices |= index << (3 * i);
+    }
+  }
+
+  out[0] = static_cast<unsigned char>(max_value);
+  out[1] = static_cast<unsigned char>(min_value);
+  for (int i = 0; i < 6; ++i) out[2 + i] = (indices >> (8 * i)) & 0xff;
+}
+
+void EncodeBlock(const unsigned char block[16][4], BlockFormat format,
+                 unsigned char *out) {
+  switch (format) {
+    case BlockFormat::kBC1:
+      EncodeBC1Block(block, out);
+      break;
+    case BlockFormat::kBC4:
+      EncodeBC4Block(block, 0, out);
+      break;
+    case BlockFormat::kBC5:
+      EncodeBC4Block(block, 0, out);
+      EncodeBC4Block(block, 1, out + 8);
+      break;
+  }
+}
+
+void EncodeLevel(const unsigned char *rgba, int width, int height,
+                 BlockFormat format, std::vector<unsigned char> *blocks) {
+  const int kBlocksX = std::max(1, (width + 3) / 4);
+  const int kBlocksY = std::max(1, (height + 3) / 4);
+  const size_t kBlockBytes = BlockBytes(format);
+  blocks->resize(LevelBytes(format, width, height));
+
+  utils::ParallelFor(0, kBlocksY, [&](size_t begin, size_t end) {
+    unsigned char block[16][4];
+    for (size_t by = begin; by < end; ++by) {
+      for (int bx = 0; bx < kBlocksX; ++bx) {
+        FetchBlock(rgba, width, height, bx, static_cast<int>(by), block);
+        EncodeBlock(block, format,
+                    &(*blocks)[(by * kBlocksX + bx) * kBlockBytes]);
+      }
+    }
+  });
+}
+
+// Halves the image with a 2x2 box filter.
+void Downsample(const std::vector<unsigned char> &src, int width, int height,
+                std::vector<unsigned char> *dst) {
+  const int kWidth = std::max(1, width / 2);
+  const int kHeight = std::max(1, height / 2);
+  dst->resize(static_cast<size_t>(kWidth) * kHeight * 4);
+
+  utils::ParallelFor(0, kHeight, [&](size_t begin, size_t end) {
+    for (size_t y = begin; y < end; ++y) {
+      int y0 = std::min(static_cast<int>(y) * 2, height - 1);
+      int y1 = std::min(y0 + 1, height - 1);
+      for (int x = 0; x < kWidth; ++x) {
+        int x0 = std::min(x * 2, width - 1);
+        int x1 = std::min(x0 + 1, width - 1);
+        for (int c = 0; c < 4; ++c) {
+          int sum = src[(static_cast<size_t>(y0) * width + x0) * 4 + c] +
+                    src[(static_cast<size_t>(y0) * width + x1) * 4 + c] +
+                    src[(static_cast<size_t>(y1) * width + x0) * 4 + c] +
+                    src[(static_cast<size_t>(y1) * width + x1) * 4 + c];
+          (*dst)[(y * kWidth + x) * 4 + c] =
+              static_cast<unsigned char>((sum + 2) / 4);
+        }
+      }
+    }
+  });
+}
+
+}  // namespace
+
+size_t BlockBytes(BlockFormat format) {
+  return format == BlockFormat::kBC5 ? 16 : 8;
+}
+
+void CompressTexture(const unsigned char *rgba, int width, int height,
+                     BlockFormat format, bool mipmaps,
+                     CompressedTexture *texture) {
+  texture->format_ = format;
+  texture->width_ = width;
+  texture->height_ = height;
+  texture->levels_.clear();
+
+  texture->levels_.emplace_back();
+  EncodeLevel(rgba, width, height, format, &texture->levels_.back());
+  if (!mipmaps) return;
+
+  std::vector<unsigned char> current(
+      rgba, rgba + static_cast<size_t>(width) * height * 4);
+  std::vector<unsigned char> next;
+  while (width > 1 || height > 1) {
+    Downsample(current, width, height, &next);
+    width = std::max(1, width / 2);
+    height = std::max(1, height / 2);
+    current.swap(next);
+
+    texture->levels_.emplace_back();
+    EncodeLevel(current.data(), width, height, format,
+                &texture->levels_.back());
+  }
+}
+
+bool HashFile(const std::string &filename, uint64_t *hash) {
+  std::ifstream fin(filename.c_str(), std::ios_base::in | std::ios_base::binary);
+  if (!fin.is_open() || !fin.good()) return false;
+
+  uint64_t h = 14695981039346656037ull;
+  std::vector<char> buffer(1 << 20);
+  while (fin) {
+    fin.read(buffer.data(), buffer.size());
+    std::streamsize read = fin.gcount();
+    for (std::streamsize i = 0; i < read; ++i) {
+      h ^= static_cast<unsigned char>(buffer[i]);
+      h *= 1099511628211ull;
+    }
+  }
+
+  *hash = h;
+  return true;
+}
+
+std::string CachePath(const std::string &source, uint64_t hash,
+                      BlockFormat format, bool mipmaps) {
+  return PackedCachePath(source, hash,
+                         std::string(FormatName(format)) +
+                             (mipmaps ? "" : "-nomips"));
+}
+
+std::string PackedCachePath(const std::string &source, uint64_t hash,
+                            const std::string &kind) {
+  size_t slash = source.find_last_of("/");
+  std::string dir = slash == std::string::npos ? "." : source.substr(0, slash);
+  std::string name =
+      slash == std::string::npos ? source : source.substr(slash + 1);
+  name = name.substr(0, name.find_last_of("."));
+
+  std::stringstream path;
+  path << dir << "/.cache/" << name << "-" << std::hex << hash << "-" << kind
+       << ".dds";
+  return path.str();
+}
+
+bool ReadCompressedTexture(const std::string &filename,
+                           CompressedTexture *texture) {
+  std::ifstream fin(filename.c_str(), std::ios_base::in | std::ios_base::binary);
+  if (!fin.is_open() || !fin.good()) return false;
+
+  uint32_t header[32];
+  fin.read(reinterpret_cast<char *>(header), sizeof(header));
+  if (!fin || header[0] != kDDSMagic || header[1] != kDDSHeaderSize)
+    return false;
+
+  const uint32_t kFourCC = header[21];
+  if (kFourCC == FormatFourCC(BlockFormat::kBC1)) {
+    texture->format_ = BlockFormat::kBC1;
+  } else if (kFourCC == FormatFourCC(BlockFormat::kBC4)) {
+    texture->format_ = BlockFormat::kBC4;
+  } else if (kFourCC == FormatFourCC(BlockFormat::kBC5)) {
+    texture->format_ = BlockFormat::kBC5;
+  } else {
+    return false;
+  }
+
+  if (header[3] == 0 || header[4] == 0 || header[3] > kMaxTextureSize ||
+      header[4] > kMaxTextureSize)
+    return false;
+  texture->height_ = static_cast<int>(header[3]);
+  texture->width_ = static_cast<int>(header[4]);
+
+  // At most the full mip chain, floor(log2(max(width, height))) + 1 levels
+  uint32_t max_levels = 1;
+  while ((std::max(header[3], header[4]) >> max_levels) > 0) ++max_levels;
+  const uint32_t kLevels = std::max<uint32_t>(1, header[7]);
+  if (kLevels > max_levels) return false;
+
+  std::vector<size_t> sizes(kLevels);
+  size_t total = 0;
+  int width = texture->width_, height = texture->height_;
+  for (size_t &size : sizes) {
+    size = LevelBytes(texture->format_, width, height);
+    total += size;
+    width = std::max(1, width / 2);
+    height = std::max(1, height / 2);
+  }
+  if (RemainingBytes(fin) < total) return false;
+
+  texture->levels_.resize(kLevels);
+  for (uint32_t i = 0; i < kLevels; ++i) {
+    texture->levels_[i].resize(sizes[i]);
+    fin.read(reinterpret_cast<char *>(texture->levels_[i].data()), sizes[i]);
+  }
+
+  return static_cast<bool>(fin);
+}
+
+bool WriteCompressedTexture(const std::string &filename,
+                            const CompressedTexture &texture) {
+  std::ofstream fout(filename.c_str(),
+                     std::ios_base::out | std::ios_base::binary);
+  if (!fout.is_open() || !fout.good()) return false;
+
+  const bool kMipmaps = texture.levels_.size() > 1;
+  uint32_t header[32];
+  std::memset(header, 0, sizeof(header));
+  header[0] = kDDSMagic;
+  header[1] = kDDSHeaderSize;
+  header[2] = kDDSDCaps | kDDSDHeight | kDDSDWidth | kDDSDPixelFormat |
+              kDDSDLinearSize | (kMipmaps ? kDDSDMipMapCount : 0);
+  header[3] = static_cast<uint32_t>(texture.height_);
+  header[4] = static_cast<uint32_t>(texture.width_);
+  header[5] = static_cast<uint32_t>(
+      texture.levels_.empty() ? 0 : texture.levels_[0].size());
+  header[7] = static_cast<uint32_t>(texture.levels_.size());
+  header[19] = kDDSPixelFormatSize;
+  header[20] = kDDPFFourCC;
+  header[21] = FormatFourCC(texture.format_);
+  header[27] = kDDSCapsTexture |
+               (kMipmaps ? kDDSCapsComplex | kDDSCapsMipMap : 0);
+
+  fout.write(reinterpret_cast<const char *>(header), sizeof(header));
+  for (const auto &level : texture.levels_)
+    fout.write(reinterpret_cast<const char *>(level.data()), level.size());
+
+  return static_cast<bool>(fout);
+}
+
+bool ReadRGBA8Texture(const std::string &filename,
+                      std::vector<unsigned char> *rgba, int *width,
+                      int *height) {
+  std::ifstream fin(filename.c_str(), std::ios_base::in | std::ios_base::binary);
+  if (!fin.is_open() || !fin.good()) return false;
+
+  uint32_t header[32];
+  fin.read(reinterpret_cast<char *>(header), sizeof(header));
+  if (!fin || header[0] != kDDSMagic || header[1] != kDDSHeaderSize ||
+      header[20] != (kDDPFRGB | kDDPFAlphaPixels) || header[22] != 32 ||
+      header[23] != 0x000000ff || header[26] != 0xff000000)
+    return false;
+
+  if (header[3] == 0 || header[4] == 0 || header[3] > kMaxTextureSize ||
+      header[4] > kMaxTextureSize)
+    return false;
+  *height = static_cast<int>(header[3]);
+  *width = static_cast<int>(header[4]);
+
+  const size_t kBytes = static_cast<size_t>(*width) * *height * 4;
+  if (RemainingBytes(fin) < kBytes) return false;
+
+  rgba->resize(kBytes);
+  fin.read(reinterpret_cast<char *>(rgba->data()), rgba->size());
+  return static_cast<bool>(fin);
+}
+
+bool WriteRGBA8Texture(const std::string &filename,
+                       const unsigned char *rgba, int width, int height) {
+  std::ofstream fout(filename.c_str(),
+                     std::ios_base::out | std::ios_base::binary);
+  if (!fout.is_open() || !fout.good()) return false;
+
+  uint32_t header[32];
+  std::memset(header, 0, sizeof(header));
+  header[0] = kDDSMagic;
+  header[1] = kDDSHeaderSize;
+  header[2] = kDDSDCaps | kDDSDHeight | kDDSDWidth | kDDSDPixelFormat |
+              kDDSDPitch;
+  header[3] = static_cast<uint32_t>(height);
+  header[4] = static_cast<uint32_t>(width);
+  header[5] = static_cast<uint32_t>(width) * 4;
+  header[19] = kDDSPixelFormatSize;
+  header[20] = kDDPFRGB | kDDPFAlphaPixels;
+  header[22] = 32;
+  header[23] = 0x000000ff;
+  header[24] = 0x0000ff00;
+  header[25] = 0x00ff0000;
+  header[26] = 0xff000000;
+  header[27] = kDDSCapsTexture;
+
+  fout.write(reinterpret_cast<const char *>(header), sizeof(header));
+  fout.write(reinterpret_cast<const char *>(rgba),
+             static_cast<std::streamsize>(width) * height * 4);
+
+  return static_cast<bool>(fout);
+}
+
+}  // namespace data_representation
@@ -0,0 +1,115 @@
+#ifndef TEXTURE_COMPRESSION_H_
+#define TEXTURE_COMPRESSION_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace data_representation {
+
+/**
+ * @brief BlockFormat GPU block compression formats produced by the
+ * transcoder. All of them encode 4x4 texel blocks.
+ *  - kBC1: RGB color, 8 bytes per block (GL_EXT_texture_compression_s3tc).
+ *  - kBC4: Single channel (red), 8 bytes per block (RGTC1, core in GL 3.0).
+ *  - kBC5: Two channels (red, green), 16 bytes per block (RGTC2, core in GL
+ *    3.0).
+ */
+enum class BlockFormat { kBC1, kBC4, kBC5 };
+
+/**
+ * @brief CompressedTexture A block compressed texture with its mip chain.
+ */
+struct CompressedTexture {
+  BlockFormat format_;
+  int width_;
+  int height_;
+
+  /**
+   * @brief levels_ Compressed blocks of each mip level, level 0 first.
+   */
+  std::vector<std::vector<unsigned char>> levels_;
+};
+
+/**
+ * @brief BlockBytes Size in bytes of one 4x4 block.
+ */
+size_t BlockBytes(BlockFormat format);
+
+/**
+ * @brief CompressTexture Encodes an RGBA8 image into the given block format.
+ * The mip chain is built with a box filter and every level is encoded in
+ * parallel by rows of blocks.
+ * @param rgba Tightly packed RGBA8 pixels, width * height * 4 bytes.
+ * @param width Image width.
+ * @param height Image height.
+ * @param format Target block format.
+ * @param mipmaps Whether to build and encode the full mip chain.
+ * @param texture The resulting compressed texture.
+ */
+void CompressTexture(const unsigned char *rgba, int width, int height,
+                     BlockFormat format, bool mipmaps,
+                     CompressedTexture *texture);
+
+/**
+ * @brief HashFile Computes a 64 bit FNV-1a hash of the file contents.
+ * @param filename Path to the file.
+ * @param hash The resulting hash.
+ * @return Whether it was able to read the file.
+ */
+bool HashFile(const std::string &filename, uint64_t *hash);
+
+/**
+ * @brief CachePath Path of the cache entry of a source image, stored in a
+ * ".cache" directory next to it and keyed by the source contents hash and the
+ * block format.
+ */
+std::string CachePath(const std::string &source, uint64_t hash,
+                      BlockFormat format, bool mipmaps);
+
+/**
+ * @brief PackedCachePath Path of the cache entry of an uncompressed image
+ * packed from several sources, stored next to source (one of them) and keyed
+ * by the combined hash of the sources and the kind of packing ("orm").
+ */
+std::string PackedCachePath(const std::string &source, uint64_t hash,
+                            const std::string &kind);
+
+/**
+ * @brief ReadCompressedTexture Reads a DDS file written by
+ * WriteCompressedTexture.
+ * @return Whether it was able to read the file.
+ */
+bool ReadCompressedTexture(const std::string &filename,
+                           CompressedTexture *texture);
+
+/**
+ * @brief WriteCompressedTexture Stores the texture as a DDS file. The parent
+ * directory must already exist.
+ * @return Whether it was able to write the file.
+ */
+bool WriteCompressedTexture(const std::string &filename,
+                            const CompressedTexture &texture);
+
+/**
+ * @brief ReadRGBA8Texture Reads an uncompressed DDS file written by
+ * WriteRGBA8Texture.
+ * @param rgba The resulting tightly packed RGBA8 pixels.
+ * @return Whether it was able to read the file.
+ */
+bool ReadRGBA8Texture(const std::string &filename,
+                      std::vector<unsigned char> *rgba, int *width,
+                      int *height);
+
+/**
+ * @brief WriteRGBA8Texture Stores tightly packed RGBA8 pixels, without mip
+ * levels, as an uncompressed DDS file. The parent directory must already
+ * exist.
+ * @return Whether it was able to write the file.
+ */
+bool WriteRGBA8Texture(const std::string &filename,
+                       const unsigned char *rgba, int width, int height);
+
+}  // namespace data_representation
+
+#endif  // TEXTURE_COMPRESSION_H_
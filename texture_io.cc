@@ -0,0 +1,63 @@
+#include <texture_io.h>
+
+#include <QImageReader>
+
+namespace data_representation {
+
+namespace {
+
+// Whether the decoder output can be used as format without a conversion.
+// QImage stores 32 bit pixels as native endian 0xAARRGGBB words, that is
+// B, G, R, A bytes on the little endian targets of the viewer.
+bool HasLayout(const QImage &image, PixelFormat format) {
+  switch (format) {
+    case PixelFormat::kR8:
+      return image.format() == QImage::Format_Grayscale8;
+    case PixelFormat::kRGBA8:
+      return image.format() == QImage::Format_RGBA8888 ||
+             image.format() == QImage::Format_RGBX8888;
+    case PixelFormat::kBGRA8:
+      return image.format() == QImage::Format_ARGB32 ||
+             image.format() == QImage::Format_RGB32;
+  }
+  return false;
+}
+
+QImage::Format QtFormat(PixelFormat format) {
+  switch (format) {
+    case PixelFormat::kR8: return QImage::Format_Grayscale8;
+    case PixelFormat::kRGBA8: return QImage::Format_RGBA8888;
+    case PixelFormat::kBGRA8: return QImage::Format_ARGB32;
+  }
+  return QImage::Format_Invalid;
+}
+
+}  // namespace
+
+int Channels(PixelFormat format) {
+  return format == PixelFormat::kR8 ? 1 : 4;
+}
+
+bool DecodeImage(const std::string &path, PixelFormat format,
+                 DecodedImage *image) {
+  QImageReader reader(QString::fromStdString(path));
+  // Keep the stored row order, the texture coordinates of the viewer expect
+  // the first row of the file at t = 0
+  reader.setAutoTransform(false);
+  if (!reader.read(&image->image_)) return false;
+
+  image->bytes_copied_ = 0;
+  if (!HasLayout(image->image_, format)) {
+    image->image_.convertTo(QtFormat(format));
+    image->bytes_copied_ = image->image_.sizeInBytes();
+  }
+
+  image->format_ = format;
+  image->width_ = image->image_.width();
+  image->height_ = image->image_.height();
+  image->stride_ = image->image_.bytesPerLine();
+
+  return true;
+}
+
+}  // namespace data_representation
@@ -0,0 +1,75 @@
+#ifndef TEXTURE_IO_H_
+#define TEXTURE_IO_H_
+
+#include <QImage>
+
+#include <cstddef>
+#include <string>
+
+namespace data_representation {
+
+/**
+ * @brief PixelFormat Memory layout of 8 bit per channel pixels, matching the
+ * OpenGL upload formats.
+ *  - kR8: One channel (GL_RED).
+ *  - kRGBA8: Four channels in R, G, B, A byte order (GL_RGBA).
+ *  - kBGRA8: Four channels in B, G, R, A byte order (GL_BGRA), the native
+ *    layout QImage decodes most PNG and JPEG files to.
+ */
+enum class PixelFormat { kR8, kRGBA8, kBGRA8 };
+
+/**
+ * @brief Channels Size in bytes of one pixel of the given format.
+ */
+int Channels(PixelFormat format);
+
+/**
+ * @brief DecodedImage Pixels of a decoded image ready to be uploaded, top row
+ * first. The pixels are owned by the decoder buffer, which is used as is when
+ * its layout already is the requested one.
+ */
+struct DecodedImage {
+  PixelFormat format_;
+  int width_;
+  int height_;
+
+  /**
+   * @brief stride_ Bytes between the start of two consecutive rows. It is
+   * width_ * Channels(format_) except for one channel images whose width is
+   * not a multiple of 4.
+   */
+  int stride_;
+
+  /**
+   * @brief bytes_copied_ Bytes copied after decoding to reach the requested
+   * layout, 0 when the decoder buffer is used directly. The viewer reports
+   * their sum for every map, material and environment it loads.
+   */
+  size_t bytes_copied_;
+
+  /**
+   * @brief image_ Buffer that owns the pixels.
+   */
+  QImage image_;
+
+  const unsigned char *Pixels() const { return image_.constBits(); }
+  const unsigned char *Row(int y) const { return image_.constScanLine(y); }
+};
+
+/**
+ * @brief DecodeImage Decodes the image at path into the given pixel layout.
+ * The decoder output is kept without copies when it already has that layout
+ * (32 bit color images requested as kBGRA8, grayscale images requested as
+ * kR8), otherwise it is converted once, see DecodedImage::bytes_copied_.
+ * Prints nothing, so that it can run on worker threads.
+ * @param path Path to the image file.
+ * @param format Requested pixel layout.
+ * @param image The resulting image.
+ * @return Whether it was able to read the image.
+ */
+bool DecodeImage(const std::string &path, PixelFormat format,
+                 DecodedImage *image);
+
+}  // namespace data_representation
+
+#endif  // TEXTURE_IO_H_
@@ -0,0 +1,141 @@
+#include <thumbnails.h>
+
+#include <QDir>
+#include <QFileInfo>
+#include <QImage>
+
+#include <glm/ext/matrix_clip_space.hpp>
+#include <glm/ext/matrix_transform.hpp>
+#include <glm/trigonometric.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <future>
+#include <iostream>
+#include <memory>
+
+#include "./mesh_io.h"
+#include "./software_rasterizer.h"
+#include "./triangle_mesh.h"
+
+namespace data_visualization {
+
+namespace {
+
+const float kFieldOfView = 60.0f;
+
+// Further than the one of the viewer, the depth buffer of the software
+// rasterizer is a float
+const float kZNear = 0.05f;
+const float kZFar = 20.0f;
+
+const float kDistance = 1.6f;
+const float kRotationX = 0.45f;
+const float kRotationY = -0.65f;
+
+const glm::vec3 kBackground(0.15f, 0.15f, 0.15f);
+
+std::unique_ptr<data_representation::TriangleMesh> ReadModel(const std::string &file) {
+  std::unique_ptr<data_representation::TriangleMesh> mesh(
+      new data_representation::TriangleMesh);
+  bool read = file.substr(file.find_last_of(".") + 1) == "obj"
+                  ? data_representation::ReadFromObj(file, mesh.get())
+                  : data_representation::ReadFromPly(file, mesh.get());
+  if (!read) mesh.reset();
+  return mesh;
+}
+
+bool SavePixels(std::vector<uint32_t> pixels, int size, const std::string &file) {
+  QImage image(reinterpret_cast<const uchar *>(pixels.data()), size, size,
+               size * sizeof(uint32_t), QImage::Format_ARGB32);
+  if (!image.save(QString::fromStdString(file))) {
+    std::cerr << "Unable to write " << file << std::endl;
+    return false;
+  }
+  std::cout << "Saved " << file << std::endl;
+  return true;
+}
+
+// Light at the default position of the viewer
+SoftwareShadingParameters DefaultShading() {
+  SoftwareShadingParameters parameters;
+  parameters.shading_ = SoftwareShading::kPbs;
+  parameters.albedo_ = glm::vec3(1.0f);
+  parameters.roughness_ = 0.5f;
+  parameters.metalness_ = 0.0f;
+  parameters.fresnel_ = glm::vec3(0.04f);
+  Light light;
+  light.type_ = LightType::kPoint;
+  light.position_ = glm::vec3(10, 0, 0);
+  light.color_ = glm::vec3(1.0f);
+  light.range_ = 0.0f;
+  light.direction_ = glm::vec3(-1, 0, 0);
+  light.inner_angle_ = 0.0f;
+  light.outer_angle_ = 0.0f;
+  parameters.lights_.push_back(light);
+  parameters.gamma_correction_ = true;
+  return parameters;
+}
+
+}  // namespace
+
+int RenderThumbnails(const std::vector<std::string> &models,
+                     const std::string &output_dir, int size) {
+  if (!QDir().mkpath(QString::fromStdString(output_dir))) {
+    std::cerr << "Unable to create " << output_dir << std::endl;
+    return static_cast<int>(models.size());
+  }
+
+  SoftwareRasterizer rasterizer;
+  rasterizer.Resize(size, size);
+  const SoftwareShadingParameters kShading = DefaultShading();
+  // Rendered from the camera of the viewer, moved towards the model
+  const glm::mat4 kView =
+      glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -kDistance)) *
+      glm::rotate(glm::mat4(1.0f), kRotationX, glm::vec3(1.0f, 0.0f, 0.0f)) *
+      glm::rotate(glm::mat4(1.0f), kRotationY, glm::vec3(0.0f, 1.0f, 0.0f));
+  const glm::mat4 kProjection =
+      glm::perspective(glm::radians(kFieldOfView), 1.0f, kZNear, kZFar);
+
+  int failed = 0;
+  int rendered = 0;
+  auto start = std::chrono::steady_clock::now();
+  std::future<std::unique_ptr<data_representation::TriangleMesh>> next;
+  std::future<bool> save;
+  if (!models.empty()) next = std::async(std::launch::async, ReadModel, models[0]);
+  for (size_t i = 0; i < models.size(); ++i) {
+    std::unique_ptr<data_representation::TriangleMesh> mesh = next.get();
+    if (i + 1 < models.size())
+      next = std::async(std::launch::async, ReadModel, models[i + 1]);
+    if (!mesh) {
+      std::cerr << "Unable to read " << models[i] << std::endl;
+      ++failed;
+      continue;
+    }
+
+    // Same framing as Camera::UpdateModel
+    glm::vec3 extent = mesh->max_ - mesh->min_;
+    float longest_edge = std::max(extent[0], std::max(extent[1], extent[2]));
+    glm::mat4 model =
+        glm::scale(glm::mat4(1.0f), glm::vec3(longest_edge > 0.0f ? 1.0f / longest_edge : 1.0f)) *
+        glm::translate(glm::mat4(1.0f), -(mesh->min_ + mesh->max_) * 0.5f);
+
+    rasterizer.Clear(kBackground);
+    rasterizer.Draw(*mesh, model, kView, kProjection, kShading);
+    ++rendered;
+
+    if (save.valid() && !save.get()) ++failed;
+    std::string name = QFileInfo(QString::fromStdString(models[i])).completeBaseName().toStdString();
+    save = std::async(std::launch::async, SavePixels, rasterizer.Pixels(), size,
+                      output_dir + "/" + name + ".png");
+  }
+  if (save.valid() && !save.get()) ++failed;
+
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  std::cout << rendered << " thumbnails in " << seconds << " s ("
+            << (seconds > 0.0 ? rendered / seconds : 0.0) << " per second)" << std::endl;
+  return failed;
+}
+
+}  //  namespace data_visualization
@@ -0,0 +1,24 @@
+#ifndef THUMBNAILS_H_
+#define THUMBNAILS_H_
+
+#include <string>
+#include <vector>
+
+namespace data_visualization {
+
+/**
+ * @brief RenderThumbnails Headless batch renderer. Draws every model with the
+ * software rasterizer, PBS shaded with the default material and light, from
+ * the three quarter view the viewer would frame it with, and saves it as
+ * <output_dir>/<model name>.png. The next model is read while the current one
+ * is drawn and the PNG of the previous one is encoded, so reading, drawing
+ * and encoding overlap.
+ * @param size Side in pixels of the square thumbnails.
+ * @return The number of models that could not be read or saved.
+ */
+int RenderThumbnails(const std::vector<std::string> &models,
+                     const std::string &output_dir, int size);
+
+}  //  namespace data_visualization
+
+#endif  //  THUMBNAILS_H_
@@ -5,9 +5,14 @@
 #include <algorithm>
 #include <limits>
 
+#include <cmath>
+#include <cstdint>
 #include <iostream>
+#include <utility>
 #include <glm/geometric.hpp>
 
+#include "./parallel.h"
+
 namespace data_representation {
 
 TriangleMesh::TriangleMesh() { Clear(); }
@@ -17,6 +22,11 @@ void TriangleMesh::Clear() {
   faces_.clear();
   normals_.clear();
   texCoords_.clear();
+  materials_.clear();
+  ranges_.clear();
+  meshlets_.clear();
+  lods_.clear();
+  ao_.clear();
 
   min_ = glm::vec3(std::numeric_limits<float>::max(),
                          std::numeric_limits<float>::max(),
@@ -64,4 +74,133 @@ void TriangleMesh::computeNormals()
     std::cout << "Normals computed!" << std::endl;
 }
 
+void TriangleMesh::SortFacesByMaterial() {
+  if (ranges_.size() <= 1) return;
+
+  // Counting sort of the ranges, slot 0 for the global material
+  std::vector<size_t> counts(materials_.size() + 1, 0);
+  for (const FaceRange &range : ranges_) counts[range.material_ + 1] += range.count_;
+
+  std::vector<size_t> offsets(counts.size(), 0);
+  for (size_t i = 1; i < counts.size(); ++i)
+    offsets[i] = offsets[i - 1] + counts[i - 1];
+
+  std::vector<int> sorted(faces_.size());
+  for (const FaceRange &range : ranges_) {
+    size_t &offset = offsets[range.material_ + 1];
+    std::copy(faces_.begin() + range.first_,
+              faces_.begin() + range.first_ + range.count_,
+              sorted.begin() + offset);
+    offset += range.count_;
+  }
+  faces_.swap(sorted);
+
+  ranges_.clear();
+  size_t first = 0;
+  for (size_t i = 0; i < counts.size(); ++i) {
+    if (counts[i] == 0) continue;
+    ranges_.push_back({first, counts[i], static_cast<int>(i) - 1});
+    first += counts[i];
+  }
+}
+
+namespace {
+
+// Spreads the low 10 bits of value so that there are two zeros between each.
+uint32_t SpreadBits(uint32_t value) {
+  value &= 0x3ff;
+  value = (value | (value << 16)) & 0x030000ff;
+  value = (value | (value << 8)) & 0x0300f00f;
+  value = (value | (value << 4)) & 0x030c30c3;
+  value = (value | (value << 2)) & 0x09249249;
+  return value;
+}
+
+}  // namespace
+
+void TriangleMesh::BuildMeshlets() {
+  meshlets_.clear();
+  const size_t kTriangles = faces_.size() / 3;
+  if (kTriangles == 0) return;
+
+  auto vertex = [this](int index) {
+    return glm::vec3(vertices_[3 * index], vertices_[3 * index + 1],
+                     vertices_[3 * index + 2]);
+  };
+
+  // Morton code of each centroid, quantized to 10 bits per axis of the box
+  glm::vec3 extent = glm::max(max_ - min_, glm::vec3(1e-20f));
+  std::vector<std::pair<uint32_t, uint32_t>> keys(kTriangles);
+  utils::ParallelFor(0, kTriangles, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      glm::vec3 centroid = (vertex(faces_[3 * i]) + vertex(faces_[3 * i + 1]) +
+                            vertex(faces_[3 * i + 2])) / 3.0f;
+      glm::vec3 cell = glm::clamp((centroid - min_) / extent, 0.0f, 1.0f) * 1023.0f;
+      keys[i] = {SpreadBits(static_cast<uint32_t>(cell.x)) |
+                     SpreadBits(static_cast<uint32_t>(cell.y)) << 1 |
+                     SpreadBits(static_cast<uint32_t>(cell.z)) << 2,
+                 static_cast<uint32_t>(i)};
+    }
+  }, 1 << 14);
+
+  // Sort within each range so that the materials stay contiguous
+  std::vector<FaceRange> ranges = ranges_;
+  if (ranges.empty()) ranges.push_back({0, faces_.size(), -1});
+  std::vector<int> sorted(faces_.size());
+  for (const FaceRange &range : ranges) {
+    auto first = keys.begin() + range.first_ / 3;
+    auto last = first + range.count_ / 3;
+    std::sort(first, last);
+    for (auto key = first; key != last; ++key) {
+      size_t to = 3 * (key - keys.begin());
+      std::copy(faces_.begin() + 3 * key->second,
+                faces_.begin() + 3 * key->second + 3, sorted.begin() + to);
+    }
+
+    for (size_t i = range.first_; i < range.first_ + range.count_;
+         i += 3 * kMeshletTriangles) {
+      size_t count = std::min(3 * kMeshletTriangles, range.first_ + range.count_ - i);
+      meshlets_.push_back({i, count, glm::vec3(0.0f), 0.0f, glm::vec3(0.0f), 1.0f});
+    }
+  }
+  faces_.swap(sorted);
+
+  utils::ParallelFor(0, meshlets_.size(), [&](size_t begin, size_t end) {
+    for (size_t m = begin; m < end; ++m) {
+      Meshlet &meshlet = meshlets_[m];
+      glm::vec3 lower(std::numeric_limits<float>::max());
+      glm::vec3 upper(std::numeric_limits<float>::lowest());
+      glm::vec3 normal_sum(0.0f);
+      std::vector<glm::vec3> normals;
+      normals.reserve(meshlet.count_ / 3);
+      for (size_t i = meshlet.first_; i < meshlet.first_ + meshlet.count_; i += 3) {
+        glm::vec3 a = vertex(faces_[i]), b = vertex(faces_[i + 1]),
+                  c = vertex(faces_[i + 2]);
+        lower = glm::min(lower, glm::min(a, glm::min(b, c)));
+        upper = glm::max(upper, glm::max(a, glm::max(b, c)));
+        glm::vec3 normal = glm::cross(b - a, c - a);
+        float length = glm::length(normal);
+        // Degenerate triangles are never rasterized, they do not widen the cone
+        if (length <= 0.0f) continue;
+        normals.push_back(normal / length);
+        normal_sum += normals.back();
+      }
+
+      meshlet.center_ = (lower + upper) * 0.5f;
+      for (size_t i = meshlet.first_; i < meshlet.first_ + meshlet.count_; ++i)
+        meshlet.radius_ = std::max(meshlet.radius_,
+                                   glm::length(vertex(faces_[i]) - meshlet.center_));
+
+      float length = glm::length(normal_sum);
+      if (normals.empty() || length <= 0.0f) continue;
+      meshlet.cone_axis_ = normal_sum / length;
+      float min_dot = 1.0f;
+      for (const glm::vec3 &normal : normals)
+        min_dot = std::min(min_dot, glm::dot(normal, meshlet.cone_axis_));
+      // A cone wider than 90 degrees always has a front facing triangle
+      if (min_dot > 0.0f) meshlet.cone_cutoff_ = std::sqrt(1.0f - min_dot * min_dot);
+    }
+  }, 64);
+}
+
 }  // namespace data_representation
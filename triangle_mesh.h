@@ -10,6 +10,47 @@
 
 namespace data_representation {
 
+/**
+ * @brief MeshMaterial Material of a range of faces, read from the OBJ
+ * materials. Negative roughness or metalness means unspecified, the global
+ * values of the viewer are used instead.
+ */
+struct MeshMaterial {
+  std::string name_;
+  glm::vec3 diffuse_;
+  float roughness_;
+  float metalness_;
+  std::string diffuse_map_;
+};
+
+/**
+ * @brief FaceRange Contiguous run of faces_ indices sharing a material.
+ */
+struct FaceRange {
+  size_t first_;   // First index in faces_
+  size_t count_;   // Number of indices, three per triangle
+  int material_;   // Index in materials_, -1 for the global material
+};
+
+/**
+ * @brief kMeshletTriangles Largest number of triangles of a meshlet.
+ */
+const size_t kMeshletTriangles = 128;
+
+/**
+ * @brief Meshlet Contiguous run of faces_ indices within a material range,
+ * with the bounds used to cull it as a whole: a bounding sphere and a cone
+ * containing the normals of its triangles.
+ */
+struct Meshlet {
+  size_t first_;         // First index in faces_
+  size_t count_;         // Number of indices, three per triangle
+  glm::vec3 center_;     // Bounding sphere
+  float radius_;
+  glm::vec3 cone_axis_;  // Average face normal
+  float cone_cutoff_;    // Sine of the cone half angle, 1 if it spans 90 degrees
+};
+
 class TriangleMesh {
  public:
   /**
@@ -32,6 +73,21 @@ class TriangleMesh {
   */
   void computeNormals();
 
+  /**
+   * @brief SortFacesByMaterial Reorders the faces so that every material
+   * (the global one first) covers a single contiguous range, keeping the
+   * order of the faces within a material.
+   */
+  void SortFacesByMaterial();
+
+  /**
+   * @brief BuildMeshlets Reorders the faces of every material range along a
+   * Morton curve of their centroids and splits the result into meshlets of
+   * kMeshletTriangles, so that each meshlet covers a compact patch of the
+   * surface. Must be called after the ranges are final.
+   */
+  void BuildMeshlets();
+
  public:
   std::vector<float> vertices_;
   std::vector<int> faces_;
@@ -39,6 +95,36 @@ class TriangleMesh {
   std::vector<float> texCoords_;
   std::string diffuseMap_;
 
+  /**
+   * @brief materials_ Materials referenced by ranges_, empty when the whole
+   * mesh uses the global material.
+   */
+  std::vector<MeshMaterial> materials_;
+
+  /**
+   * @brief ranges_ Material ranges covering faces_ in order. Empty means a
+   * single range of the whole mesh with the global material.
+   */
+  std::vector<FaceRange> ranges_;
+
+  /**
+   * @brief meshlets_ Clusters covering faces_ in order, see BuildMeshlets.
+   */
+  std::vector<Meshlet> meshlets_;
+
+  /**
+   * @brief lods_ Faces of the simplified versions of the mesh over the same
+   * vertices, each with about half the triangles of the previous one. Empty
+   * until they are built, see BuildLods.
+   */
+  std::vector<std::vector<int>> lods_;
+
+  /**
+   * @brief ao_ Baked ambient visibility of each vertex, empty when none has
+   * been baked (see BakeAmbientOcclusion).
+   */
+  std::vector<float> ao_;
+
   /**
    * @brief min The minimum point of the bounding box.
    */
@@ -0,0 +1,153 @@
+#include <turntable.h>
+
+#include <QDir>
+#include <QFileInfo>
+#include <QImage>
+#include <QMetaObject>
+#include <QString>
+#include <QStringList>
+
+#include <chrono>
+#include <cmath>
+#include <deque>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+
+#include "./glwidget.h"
+#include "./parallel.h"
+#include "./scene.h"
+
+namespace gui {
+
+namespace {
+
+// The files of the folders, sorted by name
+std::vector<std::string> FindModels(const std::vector<std::string> &paths) {
+  std::vector<std::string> models;
+  for (const std::string &path : paths) {
+    QDir dir(QString::fromStdString(path));
+    if (!QFileInfo(QString::fromStdString(path)).isDir()) {
+      models.push_back(path);
+      continue;
+    }
+    QStringList files = dir.entryList(QStringList() << "*.ply" << "*.obj" << "*.scene",
+                                      QDir::Files, QDir::Name);
+    for (const QString &file : files)
+      models.push_back(dir.filePath(file).toStdString());
+  }
+  return models;
+}
+
+std::unique_ptr<data_representation::Scene> ReadScene(const std::string &file) {
+  std::unique_ptr<data_representation::Scene> scene(new data_representation::Scene());
+  if (!data_representation::ReadModel(file, scene.get())) scene.reset();
+  return scene;
+}
+
+bool SaveImage(const QImage &image, const std::string &file) {
+  if (!image.save(QString::fromStdString(file))) {
+    std::cerr << "Unable to write " << file << std::endl;
+    return false;
+  }
+  return true;
+}
+
+// Index of name in the library, its first entry for an empty name
+int FindEntry(const QStringList &names, const std::string &name) {
+  if (names.empty()) return -1;
+  return name.empty() ? 0 : names.indexOf(QString::fromStdString(name));
+}
+
+}  // namespace
+
+int RenderTurntables(const TurntableSettings &settings,
+                     const std::vector<std::string> &paths) {
+  std::vector<std::string> models = FindModels(paths);
+  if (!QDir().mkpath(QString::fromStdString(settings.output_dir_))) {
+    std::cerr << "Unable to create " << settings.output_dir_ << std::endl;
+    return static_cast<int>(models.size());
+  }
+
+  // Never shown, the first grab creates its context and initializes it
+  GLWidget widget;
+  widget.setAttribute(Qt::WA_DontShowOnScreen);
+  widget.resize(settings.size_, settings.size_);
+  widget.show();
+  widget.grabFramebuffer();
+  widget.SetBackgroundBuilds(false);
+
+  // The shader switches are slots, called through the meta object
+  if (!settings.environments_.empty()) {
+    QStringList names =
+        widget.LoadEnvironmentLibrary(QString::fromStdString(settings.environments_));
+    int index = FindEntry(names, settings.environment_);
+    if (index < 0) {
+      std::cerr << "Environment " << settings.environment_ << " not found in "
+                << settings.environments_ << std::endl;
+      return static_cast<int>(models.size());
+    }
+    widget.SetEnvironment(index);
+    QMetaObject::invokeMethod(&widget, "SetIBLPBS", Q_ARG(bool, true));
+  } else {
+    QMetaObject::invokeMethod(&widget, "SetPBS", Q_ARG(bool, true));
+  }
+  if (!settings.materials_.empty()) {
+    QStringList names = widget.LoadMaterialLibrary(QString::fromStdString(settings.materials_));
+    int index = FindEntry(names, settings.material_);
+    if (index < 0) {
+      std::cerr << "Material " << settings.material_ << " not found in "
+                << settings.materials_ << std::endl;
+      return static_cast<int>(models.size());
+    }
+    widget.SetMaterial(index);
+    QMetaObject::invokeMethod(&widget, "SetUseTextures", Q_ARG(bool, true));
+  }
+
+  int failed = 0;
+  int rendered = 0;
+  auto start = std::chrono::steady_clock::now();
+  std::future<std::unique_ptr<data_representation::Scene>> next;
+  std::deque<std::future<bool>> encodes;
+  if (!models.empty()) next = std::async(std::launch::async, ReadScene, models[0]);
+  for (size_t i = 0; i < models.size(); ++i) {
+    // Reads the next model while this one is rendered
+    std::unique_ptr<data_representation::Scene> scene = next.get();
+    if (i + 1 < models.size()) next = std::async(std::launch::async, ReadScene, models[i + 1]);
+    if (!scene || !widget.ShowModel(scene.get(), QString::fromStdString(models[i]))) {
+      std::cerr << "Unable to read " << models[i] << std::endl;
+      ++failed;
+      continue;
+    }
+
+    std::string name =
+        QFileInfo(QString::fromStdString(models[i])).completeBaseName().toStdString();
+    for (int view = 0; view < settings.views_; ++view) {
+      widget.SetOrbit(kTurntableElevation, 2.0 * M_PI * view / settings.views_);
+      QImage image = widget.grabFramebuffer();
+      ++rendered;
+
+      // Bounded, so that a slow disk does not pile up images
+      while (encodes.size() >= utils::WorkerCount()) {
+        if (!encodes.front().get()) ++failed;
+        encodes.pop_front();
+      }
+      std::ostringstream file;
+      file << settings.output_dir_ << "/" << name << "_" << std::setw(3)
+           << std::setfill('0') << view << ".png";
+      encodes.push_back(std::async(std::launch::async, SaveImage, image, file.str()));
+    }
+    std::cout << "Rendered " << models[i] << std::endl;
+  }
+  for (std::future<bool> &encode : encodes)
+    if (!encode.get()) ++failed;
+
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  std::cout << rendered << " images of " << models.size() << " models in " << seconds << " s ("
+            << (seconds > 0.0 ? rendered / seconds : 0.0) << " per second)" << std::endl;
+  return failed;
+}
+
+}  //  namespace gui
@@ -0,0 +1,49 @@
+#ifndef TURNTABLE_H_
+#define TURNTABLE_H_
+
+#include <string>
+#include <vector>
+
+namespace gui {
+
+/**
+ * @brief kTurntableElevation Rotation in radians around the X axis of the
+ * turntable cameras, looking slightly down at the model.
+ */
+const double kTurntableElevation = 0.35;
+
+/**
+ * @brief TurntableSettings What every model of a batch is rendered with.
+ */
+struct TurntableSettings {
+  int views_;                  // Camera angles per model, evenly spaced around it
+  int size_;                   // Side in pixels of the square images
+  std::string output_dir_;
+  std::string environments_;   // Environment library, empty for the default maps
+  std::string environment_;    // Name in the library, empty for its first one
+  std::string materials_;      // Material library, empty for the global material
+  std::string material_;       // Name in the library, empty for its first one
+};
+
+/**
+ * @brief RenderTurntables Batch renderer. Renders settings.views_ images of
+ * every model around the vertical axis with the shaders of the viewer, IBL
+ * PBS when an environment is given and PBS otherwise, into
+ * <output dir>/<model name>_<view>.png.
+ *
+ * A single hidden GLWidget, and so a single GL context, renders the whole
+ * batch. The next model is read in the background while the views of the
+ * current one are rendered, and the images are encoded by a pool of
+ * background tasks, one per core, so that the GPU is not waiting for the
+ * disk or the PNG encoder. Needs a QApplication; on machines without a
+ * display it runs with QT_QPA_PLATFORM=offscreen.
+ * @param paths Models, scene descriptions, or folders whose PLY, OBJ and
+ * scene files are all rendered.
+ * @return The number of models and images that could not be read or saved.
+ */
+int RenderTurntables(const TurntableSettings &settings,
+                     const std::vector<std::string> &paths);
+
+}  //  namespace gui
+
+#endif  //  TURNTABLE_H_